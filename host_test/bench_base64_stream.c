@@ -0,0 +1,103 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* base64_stream throughput against a plain scalar encoder and mbedtls, in the piece sizes of the SR upload */
+#include "base64_stream.h"
+#include "test_util.h"
+#ifdef TEST_HAVE_MBEDTLS
+#include "mbedtls/base64.h"
+#endif
+
+#define BENCH_BYTES     (64 * 1024)
+#define BENCH_ROUNDS    (200)
+
+static uint8_t src[BENCH_BYTES];
+static char dst[BASE64_ENC_MAX_OUT(BENCH_BYTES) + 4];
+
+static double _stream_mbps(int piece)
+{
+    int64_t start = test_now_us();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        base64_enc_t enc;
+        base64_enc_init(&enc);
+        int o = 0;
+        for (int pos = 0; pos < BENCH_BYTES; pos += piece) {
+            o += base64_enc_update(&enc, src + pos, BENCH_BYTES - pos < piece ? BENCH_BYTES - pos : piece, dst + o);
+        }
+        base64_enc_finish(&enc, dst + o);
+    }
+    return (double)BENCH_BYTES * BENCH_ROUNDS / (test_now_us() - start);
+}
+
+static double _ref_mbps(void)
+{
+    int64_t start = test_now_us();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        test_base64_ref(src, BENCH_BYTES, dst);
+    }
+    return (double)BENCH_BYTES * BENCH_ROUNDS / (test_now_us() - start);
+}
+
+#ifdef TEST_HAVE_MBEDTLS
+/* As the SR upload did before base64_stream: each piece encoded on its own, the 0 to 2 bytes
+ * left over carried to the next piece */
+static double _mbedtls_mbps(int piece)
+{
+    int64_t start = test_now_us();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        size_t o = 0;
+        for (int pos = 0; pos < BENCH_BYTES;) {
+            int n = BENCH_BYTES - pos < piece ? BENCH_BYTES - pos : piece;
+            if (pos + n < BENCH_BYTES) {
+                n -= n % 3;
+            }
+            size_t olen = 0;
+            CHECK_EQ(mbedtls_base64_encode((unsigned char *)dst + o, sizeof(dst) - o, &olen, src + pos, n), 0);
+            o += olen;
+            pos += n;
+        }
+    }
+    return (double)BENCH_BYTES * BENCH_ROUNDS / (test_now_us() - start);
+}
+#endif
+
+int main(void)
+{
+    for (int i = 0; i < BENCH_BYTES; i++) {
+        src[i] = (uint8_t)test_rand();
+    }
+    printf("reference scalar        %8.1f MB/s\n", _ref_mbps());
+    const int pieces[] = { 320, 1000, 4096, BENCH_BYTES };
+    for (int i = 0; i < (int)(sizeof(pieces) / sizeof(pieces[0])); i++) {
+        printf("base64_stream %6d B  %8.1f MB/s\n", pieces[i], _stream_mbps(pieces[i]));
+    }
+#ifdef TEST_HAVE_MBEDTLS
+    for (int i = 0; i < (int)(sizeof(pieces) / sizeof(pieces[0])); i++) {
+        printf("mbedtls       %6d B  %8.1f MB/s\n", pieces[i], _mbedtls_mbps(pieces[i]));
+    }
+#else
+    printf("mbedtls not available\n");
+#endif
+    return 0;
+}
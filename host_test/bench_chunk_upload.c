@@ -0,0 +1,197 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Writes and wire bytes per second of audio of the chunked SR upload, for the framing before
+ * http_chunk_writer and for the writer with and without gathering, over a local server */
+#include <unistd.h>
+#include "esp_http_client.h"
+#include "google_sr.h"
+#include "http_chunk_writer.h"
+#include "host_stub.h"
+#include "test_util.h"
+
+#define SECONDS         (2)
+#define READ_MS         (32)                    /* Audio per pipeline read */
+#define READS           (SECONDS * 1000 / READ_MS)
+#define PAYLOAD_MAX     (4096)
+#define TLS_RECORD_COST (29)                    /* Header, explicit nonce and tag of an AES-GCM record */
+#define TCP_SEGMENT     (1460)
+#define TCP_HEADER_COST (40)
+
+typedef enum {
+    UPLOAD_THREE_WRITES,                        /* Size line, payload and chunk end written apart */
+    UPLOAD_WRITER,
+} upload_mode_t;
+
+typedef struct {
+    host_http_request_t req;
+    int                 ret;
+} server_ctx_t;
+
+typedef struct {
+    uint32_t writes;
+    uint32_t wire_bytes;
+    uint64_t est_bytes;                         /* Wire bytes with TLS records and TCP/IP headers */
+} upload_count_t;
+
+static void _handler(int fd, void *pv)
+{
+    server_ctx_t *ctx = (server_ctx_t *)pv;
+    ctx->ret = host_http_read_request(fd, &ctx->req);
+    host_http_respond(fd, "text/plain", "ok", 2, 0);
+}
+
+static char _payload_byte(int pos)
+{
+    return 'A' + pos % 26;
+}
+
+/* A write goes out as one TLS record, in as many TCP segments as it needs */
+static int _est_bytes(int len)
+{
+    return len + TLS_RECORD_COST + (len + TCP_SEGMENT - 1) / TCP_SEGMENT * TCP_HEADER_COST;
+}
+
+static int _write(esp_http_client_handle_t http, const char *buf, int len, upload_count_t *count)
+{
+    count->writes++;
+    count->wire_bytes += len;
+    count->est_bytes += _est_bytes(len);
+    return esp_http_client_write(http, buf, len);
+}
+
+/* The upload before http_chunk_writer: every read was sent as its own chunk in three writes */
+static void _three_writes_chunk(esp_http_client_handle_t http, const char *payload, int len, upload_count_t *count)
+{
+    char head[16];
+    int head_len = len > 0 ? sprintf(head, "%x\r\n", len) : sprintf(head, "0\r\n\r\n");
+    CHECK_EQ(_write(http, head, head_len, count), head_len);
+    if (len > 0) {
+        CHECK_EQ(_write(http, payload, len, count), len);
+        CHECK_EQ(_write(http, "\r\n", 2, count), 2);
+    }
+}
+
+/* Encoded audio of `bytes_per_s` arriving a read every READ_MS, sent in real time */
+static void _bench(const char *encoding, int bytes_per_s, const char *mode_name, upload_mode_t mode,
+                   int flush_size, int flush_ms)
+{
+    server_ctx_t ctx = { 0 };
+    host_server_t *server = host_server_start(_handler, &ctx);
+    CHECK(server);
+    host_net_redirect(host_server_port(server));
+    esp_http_client_config_t cfg = { .url = "http://speech.example.com/v1/speech:recognize" };
+    esp_http_client_handle_t http = esp_http_client_init(&cfg);
+    CHECK_EQ(esp_http_client_open(http, -1), ESP_OK);
+
+    static char buffer[HTTP_CHUNK_BUFFER_SIZE(PAYLOAD_MAX)];
+    static char piece[PAYLOAD_MAX];
+    http_chunk_writer_t writer;
+    http_chunk_writer_init(&writer, http, buffer, sizeof(buffer), flush_size, flush_ms);
+    upload_count_t count = { 0 };
+    int sent = 0;
+    int64_t start = test_now_us();
+    for (int r = 0; r < READS; r++) {
+        int64_t due = start + (int64_t)r * READ_MS * 1000;
+        int64_t now = test_now_us();
+        if (due > now) {
+            usleep(due - now);
+        }
+        int len = (int)((int64_t)bytes_per_s * (r + 1) * READ_MS / 1000 - (int64_t)bytes_per_s * r * READ_MS / 1000);
+        if (mode == UPLOAD_THREE_WRITES) {
+            for (int k = 0; k < len; k++) {
+                piece[k] = _payload_byte(sent + k);
+            }
+            _three_writes_chunk(http, piece, len, &count);
+        } else {
+            uint32_t writes = writer.writes;
+            uint32_t wire_bytes = writer.wire_bytes;
+            if (http_chunk_writer_room(&writer) < len) {
+                CHECK_EQ(http_chunk_writer_flush(&writer, false), ESP_OK);
+            }
+            char *tail = http_chunk_writer_tail(&writer);
+            for (int k = 0; k < len; k++) {
+                tail[k] = _payload_byte(sent + k);
+            }
+            CHECK_EQ(http_chunk_writer_commit(&writer, len), ESP_OK);
+            CHECK_EQ(http_chunk_writer_poll(&writer), ESP_OK);
+            for (uint32_t w = writes; w < writer.writes; w++) {
+                /* The writer only counts totals, a flush and a commit in one read split them evenly */
+                count.est_bytes += _est_bytes((writer.wire_bytes - wire_bytes) / (writer.writes - writes));
+            }
+        }
+        sent += len;
+    }
+    if (mode == UPLOAD_THREE_WRITES) {
+        _three_writes_chunk(http, NULL, 0, &count);
+    } else {
+        uint32_t wire_bytes = writer.wire_bytes;
+        CHECK_EQ(http_chunk_writer_end(&writer, 0), ESP_OK);
+        count.est_bytes += _est_bytes(writer.wire_bytes - wire_bytes);
+        count.writes = writer.writes;
+        count.wire_bytes = writer.wire_bytes;
+    }
+    CHECK(esp_http_client_fetch_headers(http) >= 0);
+    CHECK_EQ(esp_http_client_get_status_code(http), 200);
+    esp_http_client_cleanup(http);
+    host_server_stop(server);
+    host_net_redirect(0);
+
+    /* The server got the same body whatever the framing */
+    CHECK(ctx.ret >= 0);
+    CHECK(ctx.req.chunked);
+    CHECK_EQ(ctx.req.body_len, sent);
+    for (int k = 0; k < sent; k++) {
+        CHECK_EQ(ctx.req.body[k], _payload_byte(k));
+    }
+    host_http_request_free(&ctx.req);
+    printf("%-18s %-22s %8.1f %10.0f %8.2f%% %12.0f\n", encoding, mode_name,
+           count.writes / (double)SECONDS, count.wire_bytes / (double)SECONDS,
+           100.0 * (count.wire_bytes - sent) / sent, count.est_bytes / (double)SECONDS);
+}
+
+int main(void)
+{
+    /* Base64 text of the encoded audio, as it goes in the JSON body */
+    static const struct {
+        const char *name;
+        int        bytes_per_s;
+    } encodings[] = {
+        { "LINEAR16 16 kHz", 32000 * 4 / 3 },
+        { "FLAC 16 kHz", 17600 * 4 / 3 },       /* About 55% of LINEAR16 on speech */
+        { "OGG_OPUS 24 kbps", 3000 * 4 / 3 },
+    };
+    printf("%d s of audio per run, a read every %d ms, TLS+TCP estimated at %d B a record and %d B a segment\n",
+           SECONDS, READ_MS, TLS_RECORD_COST, TCP_HEADER_COST);
+    printf("%-18s %-22s %8s %10s %9s %12s\n", "encoding", "upload", "writes/s", "wire B/s", "framing", "TLS+TCP B/s");
+    for (int e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+        _bench(encodings[e].name, encodings[e].bytes_per_s, "three writes a read", UPLOAD_THREE_WRITES, 0, 0);
+        _bench(encodings[e].name, encodings[e].bytes_per_s, "one write a read", UPLOAD_WRITER, 0, 0);
+        _bench(encodings[e].name, encodings[e].bytes_per_s, "gathered 4096 B/100 ms", UPLOAD_WRITER,
+               DEFAULT_SR_UPLOAD_FLUSH_SIZE, DEFAULT_SR_UPLOAD_FLUSH_MS);
+        _bench(encodings[e].name, encodings[e].bytes_per_s, "gathered 4096 B/500 ms", UPLOAD_WRITER,
+               DEFAULT_SR_UPLOAD_FLUSH_SIZE, 500);
+    }
+    return 0;
+}
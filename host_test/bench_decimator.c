@@ -0,0 +1,98 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* decimator cost per input sample, against a direct FIR of the same length that filters every sample */
+#include <math.h>
+#include "decimator.h"
+#include "test_util.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()  ((int64_t)__rdtsc())
+#else
+#define BENCH_CYCLES()  ((int64_t)0)
+#endif
+
+#define SECONDS         (10)
+#define BENCH_ROUNDS    (3)
+
+/* The same number of Q15 taps, evaluated at every input sample and then thrown away */
+static int64_t _direct_fir(const int16_t *in, int n, int taps, int factor, int16_t *out)
+{
+    int16_t *h = malloc(taps * sizeof(int16_t));
+    for (int i = 0; i < taps; i++) {
+        h[i] = (int16_t)(32767 / taps);
+    }
+    int64_t start = BENCH_CYCLES();
+    int o = 0;
+    for (int i = taps; i < n; i++) {
+        int32_t acc = 0;
+        for (int k = 0; k < taps; k++) {
+            acc += h[k] * in[i - k];
+        }
+        if (i % factor == 0) {
+            out[o++] = acc >> 15;
+        }
+    }
+    int64_t cycles = BENCH_CYCLES() - start;
+    free(h);
+    return cycles;
+}
+
+static void _bench(int src_rate, int dst_rate)
+{
+    int n = src_rate * SECONDS;
+    int factor = src_rate / dst_rate;
+    int16_t *in = malloc(n * sizeof(int16_t));
+    for (int i = 0; i < n; i++) {
+        in[i] = (int16_t)lrint(8000 * sin(2 * M_PI * 440 * i / src_rate)) + (int16_t)(test_rand() % 512);
+    }
+    int64_t best_us = INT64_MAX, best_cycles = INT64_MAX;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        decimator_cfg_t cfg = { .src_rate = src_rate, .dst_rate = dst_rate };
+        audio_element_handle_t el = decimator_init(&cfg);
+        CHECK(el);
+        uint8_t *out;
+        int64_t start = test_now_us(), cycles = BENCH_CYCLES();
+        CHECK_EQ(test_element_run(el, in, n * sizeof(int16_t), 4096, &out), n / factor * (int)sizeof(int16_t));
+        cycles = BENCH_CYCLES() - cycles;
+        int64_t us = test_now_us() - start;
+        best_us = us < best_us ? us : best_us;
+        best_cycles = cycles < best_cycles ? cycles : best_cycles;
+        free(out);
+    }
+    int16_t *direct_out = malloc((n / factor + 1) * sizeof(int16_t));
+    int64_t direct = _direct_fir(in, n, DECIMATOR_TAPS_PER_PHASE * factor, factor, direct_out);
+    printf("%5d -> %5d Hz  %6.2f ns/sample  %6.2f cycles/sample (pipeline included)  direct FIR %7.2f cycles/sample\n",
+           src_rate, dst_rate, best_us * 1000.0 / n, (double)best_cycles / n, (double)direct / n);
+    free(direct_out);
+    free(in);
+}
+
+int main(void)
+{
+    _bench(48000, 16000);
+    _bench(16000, 8000);
+    _bench(48000, 8000);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* mic_frontend cost per sample for each stage combination, over a noisy speech recording */
+#include <math.h>
+#include "mic_frontend.h"
+#include "test_util.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()  ((int64_t)__rdtsc())
+#else
+#define BENCH_CYCLES()  ((int64_t)0)
+#endif
+
+#define RATE            (16000)
+#define SECONDS         (10)
+#define SAMPLES         (RATE * SECONDS)
+#define BENCH_ROUNDS    (3)
+
+static int16_t pcm[SAMPLES];
+
+/* Fan noise and mains hum with a DC offset, voiced syllables half of the time */
+static void _recording(void)
+{
+    test_srand(19);
+    double phase = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        double v = 300 + (int)(test_rand() % 1601) - 800 + 400 * sin(2 * M_PI * 50 * i / RATE);
+        if (i % (RATE * 4 / 10) < RATE / 5) {
+            double pitch = 120 + 20 * (i / (RATE * 4 / 10) % 5);
+            phase += 2 * M_PI * pitch / RATE;
+            for (int h = 1; h * pitch < 3500; h++) {
+                v += 2500.0 / h * sin(h * phase);
+            }
+        }
+        pcm[i] = (int16_t)lrint(v);
+    }
+}
+
+static void _bench(const char *name, bool agc, bool ns)
+{
+    int64_t best_us = INT64_MAX, best_cycles = INT64_MAX;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        mic_frontend_cfg_t cfg = { .sample_rate = RATE, .agc_enable = agc, .ns_enable = ns };
+        audio_element_handle_t el = mic_frontend_init(&cfg);
+        CHECK(el);
+        uint8_t *out;
+        int64_t start = test_now_us(), cycles = BENCH_CYCLES();
+        CHECK_EQ(test_element_run(el, pcm, sizeof(pcm), 4096, &out), (int)sizeof(pcm));
+        cycles = BENCH_CYCLES() - cycles;
+        int64_t us = test_now_us() - start;
+        best_us = us < best_us ? us : best_us;
+        best_cycles = cycles < best_cycles ? cycles : best_cycles;
+        free(out);
+    }
+    printf("%-22s %6.2f ns/sample  %7.2f cycles/sample  %6.0fx real time\n", name,
+           best_us * 1000.0 / SAMPLES, (double)best_cycles / SAMPLES, SECONDS * 1e6 / best_us);
+}
+
+int main(void)
+{
+    _recording();
+    printf("Pipeline included, cycles are read on x86 only\n");
+    _bench("DC + high-pass", false, false);
+    _bench("DC + high-pass + AGC", true, false);
+    _bench("DC + high-pass + NS", false, true);
+    _bench("all stages", true, true);
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Upload size and encode time of the SR encodings, over recordings like the ones the device uploads */
+#include <math.h>
+#include "flac_encoder.h"
+#include "google_sr.h"
+#include "test_util.h"
+
+#define RATE            (16000)
+#define SECONDS         (10)
+#define SAMPLES         (RATE * SECONDS)
+#define BENCH_ROUNDS    (5)
+
+static int16_t pcm[SAMPLES];
+
+/* Room noise of `noise` peak, voiced (harmonics of 140 Hz) in `speech_pct` of each 5 s */
+static void _recording(int noise, int speech_pct)
+{
+    test_srand(11);
+    for (int i = 0; i < SAMPLES; i++) {
+        double v = noise ? (int)(test_rand() % (2 * noise + 1)) - noise : 0;
+        if ((i / (RATE / 2)) % 10 < speech_pct / 10) {
+            for (int h = 1; h * 140 < 3500; h++) {
+                v += 3000.0 / h * sin(2 * M_PI * 140 * h * i / RATE);
+            }
+        }
+        pcm[i] = (int16_t)lrint(v);
+    }
+}
+
+static void _bench_flac(const char *name, int block_size)
+{
+    int64_t best = INT64_MAX;
+    int out_len = 0;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        flac_encoder_cfg_t cfg = { .sample_rate = RATE, .block_size = block_size };
+        audio_element_handle_t el = flac_encoder_init(&cfg);
+        CHECK(el);
+        uint8_t *out;
+        int64_t start = test_now_us();
+        out_len = test_element_run(el, pcm, sizeof(pcm), 4096, &out);
+        int64_t spent = test_now_us() - start;
+        best = spent < best ? spent : best;
+        free(out);
+    }
+    int frames = (SAMPLES + block_size - 1) / block_size;
+    printf("%-14s FLAC/%-4d  ratio %5.2f  %7.1f us/frame  %6.0fx real time\n", name, block_size,
+           (double)sizeof(pcm) / out_len, (double)best / frames, SECONDS * 1e6 / best);
+}
+
+int main(void)
+{
+    const struct {
+        const char  *name;
+        int         noise;
+        int         speech_pct;
+    } recordings[] = {
+        { "silence", 0, 0 },
+        { "quiet room", 100, 0 },
+        { "speech", 100, 60 },
+        { "noisy speech", 1500, 60 },
+    };
+    printf("LINEAR16 uploads %d B/s as base64, OGG_OPUS %d B/s (ratio %.1f, encoder only on the device)\n",
+           RATE * 2 * 4 / 3, GOOGLE_SR_OPUS_BITRATE / 8, RATE * 16.0 / GOOGLE_SR_OPUS_BITRATE);
+    for (int i = 0; i < (int)(sizeof(recordings) / sizeof(recordings[0])); i++) {
+        _recording(recordings[i].noise, recordings[i].speech_pct);
+        _bench_flac(recordings[i].name, 256);
+        _bench_flac(recordings[i].name, FLAC_ENCODER_BLOCK_SIZE);
+        _bench_flac(recordings[i].name, FLAC_ENCODER_MAX_BLOCK_SIZE);
+    }
+    return 0;
+}
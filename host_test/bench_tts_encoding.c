@@ -0,0 +1,166 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* TTS first-sample latency and CPU time per encoding, with the answer sent at a slow link rate */
+#include <time.h>
+#include <unistd.h>
+#include "base64_stream.h"
+#include "google_tts.h"
+#include "host_stub.h"
+#include "test_util.h"
+
+#define TTS_RATE        (16000)
+#define AUDIO_SECONDS   (3)
+#define LINK_BPS        (2 * 1000 * 1000)   /* A congested 2.4 GHz link */
+#define LINK_PACKET     (1460)
+#define BENCH_ROUNDS    (3)
+
+static char *s_response;
+static int s_response_len;
+
+static void _tts_handler(int fd, void *ctx)
+{
+    host_http_request_t req;
+    if (host_http_read_request(fd, &req) != 0) {
+        return;
+    }
+    host_http_request_free(&req);
+    char head[128];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %d\r\n\r\n",
+                     s_response_len);
+    host_send_all(fd, head, n);
+    int64_t start = test_now_us();
+    for (int pos = 0; pos < s_response_len; pos += LINK_PACKET) {
+        int64_t due = start + (int64_t)pos * 8 * 1000000 / LINK_BPS;
+        int64_t now = test_now_us();
+        if (due > now) {
+            usleep(due - now);
+        }
+        int len = s_response_len - pos < LINK_PACKET ? s_response_len - pos : LINK_PACKET;
+        if (host_send_all(fd, s_response + pos, len) < 0) {
+            break;
+        }
+    }
+    char buf[512];
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* The audio is random bytes of the size the encoding has, the stand-in decoders pass them through.
+ * LINEAR16 comes as a WAV file */
+static void _serve(int audio_len, bool wav)
+{
+    static const uint8_t wav_head[] = {
+        'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0, 0x80, 0x3E, 0, 0, 0, 0x7D, 0, 0, 2, 0, 16, 0,
+        'd', 'a', 't', 'a', 0, 0, 0, 0,
+    };
+    int head_len = wav ? sizeof(wav_head) : 0;
+    uint8_t *audio = malloc(head_len + audio_len);
+    memcpy(audio, wav_head, head_len);
+    for (int i = 0; i < audio_len; i++) {
+        audio[head_len + i] = (uint8_t)test_rand();
+    }
+    audio_len += head_len;
+    free(s_response);
+    s_response = malloc(BASE64_ENC_MAX_OUT(audio_len) + 64);
+    int n = sprintf(s_response, "{\n  \"audioContent\": \"");
+    base64_enc_t enc;
+    base64_enc_init(&enc);
+    n += base64_enc_update(&enc, audio, audio_len, s_response + n);
+    n += base64_enc_finish(&enc, s_response + n);
+    n += sprintf(s_response + n, "\"\n}\n");
+    s_response_len = n;
+    free(audio);
+}
+
+static int64_t _cpu_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void _bench(const char *name, google_tts_encoding_t encoding, int audio_len)
+{
+    google_tts_config_t cfg = {
+        .api_key = "key",
+        .lang_code = "en-US",
+        .playback_sample_rate = TTS_RATE,
+        .encoding = encoding,
+    };
+    google_tts_handle_t tts = google_tts_init(&cfg);
+    CHECK(tts);
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    google_tts_set_listener(tts, evt);
+    _serve(audio_len, encoding == TTS_ENCODING_LINEAR16);
+
+    int64_t first_total = 0, done_total = 0, cpu_total = 0;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        host_i2s_reset_playback();
+        const int16_t *played;
+        int64_t cpu = _cpu_us();
+        int64_t start = test_now_us(), first = 0;
+        CHECK_EQ(google_tts_start(tts, "Benchmark", "en-US"), ESP_OK);
+        while (1) {
+            if (first == 0 && host_i2s_playback(&played) > 0) {
+                first = test_now_us();
+            }
+            audio_event_iface_msg_t msg;
+            if (audio_event_iface_listen(evt, &msg, first ? pdMS_TO_TICKS(20) : 0) == ESP_OK
+                    && google_tts_check_event_finish(tts, &msg)) {
+                break;
+            }
+            if (first == 0) {
+                usleep(100);
+            }
+        }
+        CHECK(first);
+        first_total += first - start;
+        done_total += test_now_us() - start;
+        cpu_total += _cpu_us() - cpu;
+    }
+    printf("%-9s %7d B  first sample %6.1f ms  done %7.1f ms  cpu %6.1f ms\n", name, s_response_len,
+           first_total / 1000.0 / BENCH_ROUNDS, done_total / 1000.0 / BENCH_ROUNDS, cpu_total / 1000.0 / BENCH_ROUNDS);
+    google_tts_destroy(tts);
+    audio_event_iface_destroy(evt);
+}
+
+int main(void)
+{
+    host_server_t *server = host_server_start(_tts_handler, NULL);
+    CHECK(server);
+    host_net_redirect(host_server_port(server));
+    host_decoder_set_info(TTS_RATE, 1);
+    printf("%d s of speech over a %d kbit/s link, decoders are pass-through stand-ins\n", AUDIO_SECONDS, LINK_BPS / 1000);
+    /* Google's default MP3 is 32 kbit/s, Opus voice about 24 kbit/s */
+    _bench("LINEAR16", TTS_ENCODING_LINEAR16, TTS_RATE * 2 * AUDIO_SECONDS);
+    _bench("MP3", TTS_ENCODING_MP3, 32000 / 8 * AUDIO_SECONDS);
+    _bench("OGG_OPUS", TTS_ENCODING_OGG_OPUS, 24000 / 8 * AUDIO_SECONDS);
+    host_server_stop(server);
+    host_net_redirect(0);
+    free(s_response);
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* wake_word cost per feature frame for models of growing size, random weights */
+#include <math.h>
+#include "wake_word.h"
+#include "test_util.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()  ((int64_t)__rdtsc())
+#else
+#define BENCH_CYCLES()  ((int64_t)0)
+#endif
+
+#define RATE            (WAKE_WORD_SAMPLE_RATE)
+#define SECONDS         (30)
+#define SAMPLES         (RATE * SECONDS)
+#define FRAMES          (SECONDS * 1000 / WAKE_WORD_FRAME_MS)
+#define BENCH_ROUNDS    (3)
+#define MAX_LAYERS      (4)
+
+static int16_t pcm[SAMPLES];
+
+/* Voiced syllables in noise, the detector costs the same whatever it hears */
+static void _recording(void)
+{
+    test_srand(22);
+    double phase = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        double v = (int)(test_rand() % 1601) - 800;
+        if (i % (RATE * 4 / 10) < RATE / 5) {
+            double pitch = 120 + 20 * (i / (RATE * 4 / 10) % 5);
+            phase += 2 * M_PI * pitch / RATE;
+            for (int h = 1; h * pitch < 3500; h++) {
+                v += 2500.0 / h * sin(h * phase);
+            }
+        }
+        pcm[i] = (int16_t)lrint(v);
+    }
+}
+
+static void _inspect(audio_element_handle_t el, void *ctx)
+{
+    wake_word_get_stats(el, (wake_word_stats_t *)ctx);
+}
+
+/* `units` lists the outputs of each layer, the last one has the keyword and the fillers */
+static void _bench(const char *name, int num_frames, int num_mfcc, const int *units, int num_layers)
+{
+    wake_word_layer_t layers[MAX_LAYERS];
+    int in_dim = num_frames * num_mfcc, macs = 0;
+    for (int l = 0; l < num_layers; l++) {
+        int8_t *w = malloc(in_dim * units[l]);
+        for (int i = 0; i < in_dim * units[l]; i++) {
+            w[i] = (int8_t)test_rand();
+        }
+        layers[l] = (wake_word_layer_t) {
+            .in_dim = in_dim,
+            .out_dim = units[l],
+            .weights = w,
+            .shift = 8,
+            .relu = l < num_layers - 1,
+        };
+        macs += in_dim * units[l];
+        in_dim = units[l];
+    }
+    wake_word_model_t model = {
+        .num_frames = num_frames,
+        .num_mfcc = num_mfcc,
+        .input_shift = 6,
+        .layers = layers,
+        .num_layers = num_layers,
+        .threshold = INT32_MAX,
+    };
+    wake_word_stats_t best = { .avg_us = UINT32_MAX };
+    int64_t best_cycles = INT64_MAX;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        wake_word_cfg_t cfg = { .model = &model };
+        audio_element_handle_t el = wake_word_init(&cfg);
+        CHECK(el);
+        wake_word_stats_t stats;
+        uint8_t *out;
+        int64_t cycles = BENCH_CYCLES();
+        CHECK_EQ(test_element_run_inspect(el, pcm, sizeof(pcm), 1280, &out, _inspect, &stats), (int)sizeof(pcm));
+        cycles = BENCH_CYCLES() - cycles;
+        CHECK_EQ(stats.frames, FRAMES);
+        best = stats.avg_us < best.avg_us ? stats : best;
+        best_cycles = cycles < best_cycles ? cycles : best_cycles;
+        free(out);
+    }
+    printf("%-24s %7d MACs  %5u us/frame (max %5u)  %8.0f cycles/frame  %5.2f %% of the hop\n", name, macs,
+           (unsigned)best.avg_us, (unsigned)best.max_us, (double)best_cycles / FRAMES,
+           best.avg_us * 100.0 / (WAKE_WORD_FRAME_MS * 1000));
+    for (int l = 0; l < num_layers; l++) {
+        free((void *)layers[l].weights);
+    }
+}
+
+int main(void)
+{
+    _recording();
+    printf("Timed by the element, cycles on x86 only with the pipeline included\n");
+    static const int features_only[] = { 2 };
+    static const int small[] = { 2 };
+    static const int dnn[] = { 128, 128, 12 };
+    static const int wide[] = { 128, 128, 128, 12 };
+    _bench("features only", 1, 1, features_only, 1);
+    _bench("25x10 -> 2", 25, 10, small, 1);
+    _bench("49x10 -> 128-128-12", 49, 10, dnn, 3);
+    _bench("64x16 -> 128-128-128-12", 64, 16, wide, 4);
+    return 0;
+}
@@ -0,0 +1,665 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF audio element, following the state machine of the real one:
+ * run starts the task, resume opens the element and processes until the input is done (finished),
+ * an error or a stop, each closing the element and reporting the status to the listeners */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "audio_element.h"
+#include "esp_log.h"
+
+static const char *TAG = "HOST_AEL";
+
+typedef enum {
+    IO_TYPE_NONE = 0,
+    IO_TYPE_RB,
+    IO_TYPE_CB,
+} io_type_t;
+
+struct audio_element {
+    el_io_func                  open;
+    process_func                process;
+    el_io_func                  close;
+    el_io_func                  destroy;
+    io_type_t                   read_type;
+    io_type_t                   write_type;
+    stream_func                 read_cb;
+    void                        *read_ctx;
+    stream_func                 write_cb;
+    void                        *write_ctx;
+    ringbuf_handle_t            input_rb;
+    ringbuf_handle_t            output_rb;
+    int                         out_rb_size;
+    TickType_t                  input_wait;
+    TickType_t                  output_wait;
+    char                        *buf;
+    int                         buf_size;
+    int                         task_stack;
+    void                        *data;
+    char                        *tag;
+    audio_element_info_t        info;
+    audio_event_iface_handle_t  iface;
+
+    pthread_mutex_t             lock;
+    pthread_cond_t              cond;
+    pthread_t                   thread;
+    bool                        task_run;
+    bool                        resume_cmd;
+    bool                        stop_cmd;
+    bool                        destroy_cmd;
+    bool                        is_running;
+    bool                        is_open;
+    bool                        stopping;
+    bool                        winding_down;   /* The task is closing the element and reporting the end */
+    audio_element_state_t       state;
+};
+
+static void _set_state(audio_element_handle_t el, audio_element_state_t state)
+{
+    pthread_mutex_lock(&el->lock);
+    el->state = state;
+    pthread_mutex_unlock(&el->lock);
+}
+
+static void _stopped(audio_element_handle_t el, audio_element_state_t state, audio_element_status_t status)
+{
+    pthread_mutex_lock(&el->lock);
+    el->winding_down = true;
+    pthread_mutex_unlock(&el->lock);
+    if (el->is_open && el->close) {
+        el->close(el);
+    }
+    el->is_open = false;
+    ESP_LOGD(TAG, "[%s] Stopped, state=%d", el->tag, state);
+    pthread_mutex_lock(&el->lock);
+    el->state = state;
+    el->stop_cmd = false;
+    el->stopping = false;
+    pthread_mutex_unlock(&el->lock);
+    if (status != AEL_STATUS_NONE) {
+        audio_element_report_status(el, status);
+    }
+    pthread_mutex_lock(&el->lock);
+    /* A resume that came while stopping runs the element again, as the command queue of ADF does */
+    el->is_running = el->resume_cmd;
+    el->winding_down = false;
+    pthread_cond_broadcast(&el->cond);
+    pthread_mutex_unlock(&el->lock);
+}
+
+static void _run(audio_element_handle_t el)
+{
+    if (!el->is_open) {
+        _set_state(el, AEL_STATE_INITIALIZING);
+        el->is_open = true;
+        if (el->open && el->open(el) != ESP_OK) {
+            ESP_LOGE(TAG, "[%s] Open failed", el->tag);
+            el->is_open = false;
+            audio_element_report_status(el, AEL_STATUS_ERROR_OPEN);
+            _stopped(el, AEL_STATE_ERROR, AEL_STATUS_NONE);
+            return;
+        }
+        _set_state(el, AEL_STATE_RUNNING);
+        audio_element_report_status(el, AEL_STATUS_STATE_RUNNING);
+    }
+    while (1) {
+        pthread_mutex_lock(&el->lock);
+        bool stop = el->stop_cmd || el->destroy_cmd;
+        pthread_mutex_unlock(&el->lock);
+        if (stop) {
+            _stopped(el, AEL_STATE_STOPPED, AEL_STATUS_STATE_STOPPED);
+            return;
+        }
+        int ret = el->process(el, el->buf, el->buf_size);
+        if (ret > 0 || ret == AEL_IO_TIMEOUT) {
+            continue;
+        }
+        switch (ret) {
+            case AEL_IO_ABORT:
+                _stopped(el, AEL_STATE_STOPPED, AEL_STATUS_STATE_STOPPED);
+                return;
+            case AEL_IO_OK:
+            case AEL_IO_DONE:
+                /* Downstream may finish, and the element be resumed, as soon as the output is done */
+                pthread_mutex_lock(&el->lock);
+                el->winding_down = true;
+                pthread_mutex_unlock(&el->lock);
+                audio_element_set_ringbuf_done(el);
+                _stopped(el, AEL_STATE_FINISHED, AEL_STATUS_STATE_FINISHED);
+                return;
+            default:
+                ESP_LOGE(TAG, "[%s] Process failed, ret=%d", el->tag, ret);
+                audio_element_report_status(el, AEL_STATUS_ERROR_PROCESS);
+                _stopped(el, AEL_STATE_ERROR, AEL_STATUS_NONE);
+                return;
+        }
+    }
+}
+
+static void *_task(void *pv)
+{
+    audio_element_handle_t el = (audio_element_handle_t)pv;
+    pthread_mutex_lock(&el->lock);
+    while (!el->destroy_cmd) {
+        if (!el->resume_cmd) {
+            pthread_cond_wait(&el->cond, &el->lock);
+            continue;
+        }
+        el->resume_cmd = false;
+        pthread_mutex_unlock(&el->lock);
+        _run(el);
+        pthread_mutex_lock(&el->lock);
+    }
+    pthread_mutex_unlock(&el->lock);
+    if (el->is_open && el->close) {
+        el->close(el);
+    }
+    el->is_open = false;
+    return NULL;
+}
+
+audio_element_handle_t audio_element_init(audio_element_cfg_t *config)
+{
+    audio_element_handle_t el = calloc(1, sizeof(struct audio_element));
+    if (el == NULL) {
+        return NULL;
+    }
+    el->open = config->open;
+    el->process = config->process;
+    el->close = config->close;
+    el->destroy = config->destroy;
+    if (config->read) {
+        el->read_cb = config->read;
+        el->read_type = IO_TYPE_CB;
+    }
+    if (config->write) {
+        el->write_cb = config->write;
+        el->write_type = IO_TYPE_CB;
+    }
+    el->out_rb_size = config->out_rb_size > 0 ? config->out_rb_size : DEFAULT_ELEMENT_RINGBUF_SIZE;
+    el->buf_size = config->buffer_len > 0 ? config->buffer_len : DEFAULT_ELEMENT_BUFFER_LENGTH;
+    el->buf = malloc(el->buf_size);
+    el->task_stack = config->task_stack;
+    el->data = config->data;
+    el->tag = strdup(config->tag ? config->tag : "unknown");
+    el->input_wait = portMAX_DELAY;
+    el->output_wait = portMAX_DELAY;
+    el->state = AEL_STATE_INIT;
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    el->iface = audio_event_iface_init(&evt_cfg);
+    pthread_mutex_init(&el->lock, NULL);
+    pthread_cond_init(&el->cond, NULL);
+    return el;
+}
+
+esp_err_t audio_element_deinit(audio_element_handle_t el)
+{
+    audio_element_terminate(el);
+    if (el->destroy) {
+        el->destroy(el);
+    }
+    audio_event_iface_destroy(el->iface);
+    pthread_cond_destroy(&el->cond);
+    pthread_mutex_destroy(&el->lock);
+    free(el->info.uri);
+    free(el->tag);
+    free(el->buf);
+    free(el);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_setdata(audio_element_handle_t el, void *data)
+{
+    el->data = data;
+    return ESP_OK;
+}
+
+void *audio_element_getdata(audio_element_handle_t el)
+{
+    return el->data;
+}
+
+esp_err_t audio_element_set_tag(audio_element_handle_t el, const char *tag)
+{
+    free(el->tag);
+    el->tag = strdup(tag);
+    return ESP_OK;
+}
+
+char *audio_element_get_tag(audio_element_handle_t el)
+{
+    return el->tag;
+}
+
+esp_err_t audio_element_setinfo(audio_element_handle_t el, audio_element_info_t *info)
+{
+    char *uri = el->info.uri;
+    el->info = *info;
+    el->info.uri = uri;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_getinfo(audio_element_handle_t el, audio_element_info_t *info)
+{
+    *info = el->info;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_uri(audio_element_handle_t el, const char *uri)
+{
+    free(el->info.uri);
+    el->info.uri = uri ? strdup(uri) : NULL;
+    return ESP_OK;
+}
+
+char *audio_element_get_uri(audio_element_handle_t el)
+{
+    return el->info.uri;
+}
+
+esp_err_t audio_element_run(audio_element_handle_t el)
+{
+    pthread_mutex_lock(&el->lock);
+    if (el->task_run) {
+        pthread_mutex_unlock(&el->lock);
+        return ESP_OK;
+    }
+    el->task_run = true;
+    el->destroy_cmd = false;
+    if (el->task_stack <= 0) {
+        el->is_running = true;
+        el->state = AEL_STATE_RUNNING;
+        pthread_mutex_unlock(&el->lock);
+        audio_element_report_status(el, AEL_STATUS_STATE_RUNNING);
+        return ESP_OK;
+    }
+    if (pthread_create(&el->thread, NULL, _task, el) != 0) {
+        el->task_run = false;
+        pthread_mutex_unlock(&el->lock);
+        return ESP_FAIL;
+    }
+    pthread_mutex_unlock(&el->lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_terminate(audio_element_handle_t el)
+{
+    pthread_mutex_lock(&el->lock);
+    if (!el->task_run) {
+        pthread_mutex_unlock(&el->lock);
+        return ESP_OK;
+    }
+    el->task_run = false;
+    if (el->task_stack <= 0) {
+        el->is_running = false;
+        pthread_mutex_unlock(&el->lock);
+        return ESP_OK;
+    }
+    el->destroy_cmd = true;
+    pthread_cond_broadcast(&el->cond);
+    pthread_mutex_unlock(&el->lock);
+    /* Unlike the target, a terminated element blocked on its buffers is woken */
+    audio_element_abort_input_ringbuf(el);
+    audio_element_abort_output_ringbuf(el);
+    pthread_join(el->thread, NULL);
+    pthread_mutex_lock(&el->lock);
+    el->is_running = false;
+    el->destroy_cmd = false;
+    pthread_mutex_unlock(&el->lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_stop(audio_element_handle_t el)
+{
+    pthread_mutex_lock(&el->lock);
+    if (!el->task_run || !el->is_running) {
+        pthread_mutex_unlock(&el->lock);
+        return ESP_FAIL;
+    }
+    if (el->task_stack <= 0) {
+        el->is_running = false;
+        el->state = AEL_STATE_STOPPED;
+        pthread_mutex_unlock(&el->lock);
+        audio_element_abort_output_ringbuf(el);
+        audio_element_report_status(el, AEL_STATUS_STATE_STOPPED);
+        return ESP_OK;
+    }
+    if (el->stopping) {
+        pthread_mutex_unlock(&el->lock);
+        return ESP_OK;
+    }
+    el->stopping = true;
+    el->stop_cmd = true;
+    pthread_cond_broadcast(&el->cond);
+    pthread_mutex_unlock(&el->lock);
+    audio_element_abort_output_ringbuf(el);
+    audio_element_abort_input_ringbuf(el);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_wait_for_stop(audio_element_handle_t el)
+{
+    pthread_mutex_lock(&el->lock);
+    if (!el->is_running) {
+        pthread_mutex_unlock(&el->lock);
+        return ESP_FAIL;
+    }
+    while (el->is_running) {
+        pthread_cond_wait(&el->cond, &el->lock);
+    }
+    pthread_mutex_unlock(&el->lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_wait_for_stop_ms(audio_element_handle_t el, TickType_t ticks_to_wait)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t ns = (uint64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000000ULL + ts.tv_nsec;
+    ts.tv_sec += ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&el->lock);
+    while (el->is_running) {
+        if (ticks_to_wait != portMAX_DELAY) {
+            if (pthread_cond_timedwait(&el->cond, &el->lock, &ts) != 0 && el->is_running) {
+                ret = ESP_FAIL;
+                break;
+            }
+        } else {
+            pthread_cond_wait(&el->cond, &el->lock);
+        }
+    }
+    pthread_mutex_unlock(&el->lock);
+    return ret;
+}
+
+esp_err_t audio_element_pause(audio_element_handle_t el)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t audio_element_resume(audio_element_handle_t el, float wait_for_rb_threshold, TickType_t timeout)
+{
+    pthread_mutex_lock(&el->lock);
+    if (!el->task_run) {
+        pthread_mutex_unlock(&el->lock);
+        return ESP_FAIL;
+    }
+    if (el->winding_down) {
+        el->resume_cmd = true;
+        pthread_mutex_unlock(&el->lock);
+        return ESP_OK;
+    }
+    if (el->state == AEL_STATE_RUNNING) {
+        pthread_mutex_unlock(&el->lock);
+        return ESP_OK;
+    }
+    if (el->task_stack <= 0) {
+        el->state = AEL_STATE_RUNNING;
+        el->is_running = true;
+        pthread_mutex_unlock(&el->lock);
+        audio_element_report_status(el, AEL_STATUS_STATE_RUNNING);
+        return ESP_OK;
+    }
+    if (el->is_running) {
+        /* Still opening */
+        pthread_mutex_unlock(&el->lock);
+        return ESP_OK;
+    }
+    el->is_running = true;
+    el->stop_cmd = false;
+    el->stopping = false;
+    el->resume_cmd = true;
+    pthread_cond_broadcast(&el->cond);
+    pthread_mutex_unlock(&el->lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_msg_set_listener(audio_element_handle_t el, audio_event_iface_handle_t listener)
+{
+    return audio_event_iface_set_listener(el->iface, listener);
+}
+
+esp_err_t audio_element_msg_remove_listener(audio_element_handle_t el, audio_event_iface_handle_t listener)
+{
+    return audio_event_iface_remove_listener(listener, el->iface);
+}
+
+audio_element_state_t audio_element_get_state(audio_element_handle_t el)
+{
+    pthread_mutex_lock(&el->lock);
+    audio_element_state_t state = el->state;
+    pthread_mutex_unlock(&el->lock);
+    return state;
+}
+
+esp_err_t audio_element_set_input_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb)
+{
+    el->input_rb = rb;
+    if (rb) {
+        el->read_type = IO_TYPE_RB;
+    }
+    return ESP_OK;
+}
+
+ringbuf_handle_t audio_element_get_input_ringbuf(audio_element_handle_t el)
+{
+    return el->read_type == IO_TYPE_RB ? el->input_rb : NULL;
+}
+
+esp_err_t audio_element_set_output_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb)
+{
+    el->output_rb = rb;
+    if (rb) {
+        el->write_type = IO_TYPE_RB;
+    }
+    return ESP_OK;
+}
+
+ringbuf_handle_t audio_element_get_output_ringbuf(audio_element_handle_t el)
+{
+    return el->write_type == IO_TYPE_RB ? el->output_rb : NULL;
+}
+
+int audio_element_get_output_ringbuf_size(audio_element_handle_t el)
+{
+    return el->out_rb_size;
+}
+
+esp_err_t audio_element_set_output_ringbuf_size(audio_element_handle_t el, int rb_size)
+{
+    el->out_rb_size = rb_size;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_ringbuf_done(audio_element_handle_t el)
+{
+    if (el->write_type == IO_TYPE_RB && el->output_rb) {
+        return rb_done_write(el->output_rb);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_element_reset_state(audio_element_handle_t el)
+{
+    pthread_mutex_lock(&el->lock);
+    if (!el->is_running) {
+        el->state = AEL_STATE_INIT;
+    }
+    pthread_mutex_unlock(&el->lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_reset_input_ringbuf(audio_element_handle_t el)
+{
+    return el->read_type == IO_TYPE_RB ? rb_reset(el->input_rb) : ESP_FAIL;
+}
+
+esp_err_t audio_element_reset_output_ringbuf(audio_element_handle_t el)
+{
+    return el->write_type == IO_TYPE_RB ? rb_reset(el->output_rb) : ESP_FAIL;
+}
+
+esp_err_t audio_element_abort_input_ringbuf(audio_element_handle_t el)
+{
+    return el->read_type == IO_TYPE_RB ? rb_abort(el->input_rb) : ESP_FAIL;
+}
+
+esp_err_t audio_element_abort_output_ringbuf(audio_element_handle_t el)
+{
+    return el->write_type == IO_TYPE_RB ? rb_abort(el->output_rb) : ESP_FAIL;
+}
+
+audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size)
+{
+    int in_len;
+    if (el->read_type == IO_TYPE_CB) {
+        in_len = el->read_cb(el, buffer, wanted_size, el->input_wait, el->read_ctx);
+    } else if (el->read_type == IO_TYPE_RB && el->input_rb) {
+        in_len = rb_read(el->input_rb, buffer, wanted_size, el->input_wait);
+    } else {
+        ESP_LOGE(TAG, "[%s] No input", el->tag);
+        return AEL_IO_FAIL;
+    }
+    if (in_len == AEL_IO_FAIL) {
+        audio_element_report_status(el, AEL_STATUS_ERROR_INPUT);
+    }
+    return in_len;
+}
+
+audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size)
+{
+    int out_len = write_size;
+    if (write_size <= 0) {
+        return write_size;
+    }
+    if (el->write_type == IO_TYPE_CB) {
+        out_len = el->write_cb(el, buffer, write_size, el->output_wait, el->write_ctx);
+    } else if (el->write_type == IO_TYPE_RB && el->output_rb) {
+        out_len = rb_write(el->output_rb, buffer, write_size, el->output_wait);
+    }
+    if (out_len == AEL_IO_FAIL) {
+        audio_element_report_status(el, AEL_STATUS_ERROR_OUTPUT);
+    }
+    return out_len;
+}
+
+esp_err_t audio_element_set_read_cb(audio_element_handle_t el, stream_func fn, void *context)
+{
+    el->read_cb = fn;
+    el->read_ctx = context;
+    el->read_type = IO_TYPE_CB;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_write_cb(audio_element_handle_t el, stream_func fn, void *context)
+{
+    el->write_cb = fn;
+    el->write_ctx = context;
+    el->write_type = IO_TYPE_CB;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_input_timeout(audio_element_handle_t el, TickType_t timeout)
+{
+    el->input_wait = timeout;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_output_timeout(audio_element_handle_t el, TickType_t timeout)
+{
+    el->output_wait = timeout;
+    return ESP_OK;
+}
+
+static esp_err_t _report(audio_element_handle_t el, int cmd, void *data)
+{
+    audio_event_iface_msg_t msg = {
+        .cmd = cmd,
+        .data = data,
+        .data_len = sizeof(int),
+        .source = el,
+        .source_type = AUDIO_ELEMENT_TYPE_ELEMENT,
+    };
+    return audio_event_iface_sendout(el->iface, &msg);
+}
+
+esp_err_t audio_element_report_info(audio_element_handle_t el)
+{
+    return _report(el, AEL_MSG_CMD_REPORT_MUSIC_INFO, NULL);
+}
+
+esp_err_t audio_element_report_codec_fmt(audio_element_handle_t el)
+{
+    return _report(el, AEL_MSG_CMD_REPORT_CODEC_FMT, NULL);
+}
+
+esp_err_t audio_element_report_status(audio_element_handle_t el, audio_element_status_t status)
+{
+    return _report(el, AEL_MSG_CMD_REPORT_STATUS, (void *)(intptr_t)status);
+}
+
+esp_err_t audio_element_report_pos(audio_element_handle_t el)
+{
+    return _report(el, AEL_MSG_CMD_REPORT_POSITION, NULL);
+}
+
+esp_err_t audio_element_set_byte_pos(audio_element_handle_t el, int64_t pos)
+{
+    el->info.byte_pos = pos;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_update_byte_pos(audio_element_handle_t el, int pos)
+{
+    el->info.byte_pos += pos;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_total_bytes(audio_element_handle_t el, int64_t total_bytes)
+{
+    el->info.total_bytes = total_bytes;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_music_info(audio_element_handle_t el, int sample_rates, int channels, int bits)
+{
+    el->info.sample_rates = sample_rates;
+    el->info.channels = channels;
+    el->info.bits = bits;
+    return ESP_OK;
+}
+
+bool audio_element_is_stopping(audio_element_handle_t el)
+{
+    pthread_mutex_lock(&el->lock);
+    bool stopping = el->stopping;
+    pthread_mutex_unlock(&el->lock);
+    return stopping;
+}
@@ -0,0 +1,132 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF event interface */
+#include <pthread.h>
+#include <stdlib.h>
+#include "audio_event_iface.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+
+static const char *TAG = "HOST_EVT";
+
+#define EVT_LISTENER_MAX    (8)
+
+struct audio_event_iface {
+    QueueHandle_t               queue;
+    pthread_mutex_t             lock;
+    audio_event_iface_handle_t  listeners[EVT_LISTENER_MAX];
+    on_event_iface_func         on_cmd;
+    void                        *context;
+};
+
+audio_event_iface_handle_t audio_event_iface_init(audio_event_iface_cfg_t *config)
+{
+    struct audio_event_iface *evt = calloc(1, sizeof(struct audio_event_iface));
+    if (evt == NULL) {
+        return NULL;
+    }
+    int size = config->queue_set_size > config->internal_queue_size ? config->queue_set_size : config->internal_queue_size;
+    /* Deeper than on the target: host threads are not scheduled by priority, a slow listener must
+     * not make a sender drop events */
+    evt->queue = xQueueCreate(size > 0 ? size * 16 : 64, sizeof(audio_event_iface_msg_t));
+    evt->on_cmd = config->on_cmd;
+    evt->context = config->context;
+    pthread_mutex_init(&evt->lock, NULL);
+    return evt;
+}
+
+esp_err_t audio_event_iface_destroy(audio_event_iface_handle_t evt)
+{
+    if (evt == NULL) {
+        return ESP_FAIL;
+    }
+    vQueueDelete(evt->queue);
+    pthread_mutex_destroy(&evt->lock);
+    free(evt);
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_set_listener(audio_event_iface_handle_t evt, audio_event_iface_handle_t listener)
+{
+    pthread_mutex_lock(&evt->lock);
+    for (int i = 0; i < EVT_LISTENER_MAX; i++) {
+        if (evt->listeners[i] == listener) {
+            pthread_mutex_unlock(&evt->lock);
+            return ESP_OK;
+        }
+    }
+    for (int i = 0; i < EVT_LISTENER_MAX; i++) {
+        if (evt->listeners[i] == NULL) {
+            evt->listeners[i] = listener;
+            pthread_mutex_unlock(&evt->lock);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&evt->lock);
+    return ESP_FAIL;
+}
+
+esp_err_t audio_event_iface_remove_listener(audio_event_iface_handle_t listener, audio_event_iface_handle_t evt)
+{
+    pthread_mutex_lock(&evt->lock);
+    for (int i = 0; i < EVT_LISTENER_MAX; i++) {
+        if (evt->listeners[i] == listener) {
+            evt->listeners[i] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&evt->lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_sendout(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg)
+{
+    if (evt == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&evt->lock);
+    for (int i = 0; i < EVT_LISTENER_MAX; i++) {
+        if (evt->listeners[i] && xQueueSend(evt->listeners[i]->queue, msg, 0) != pdTRUE) {
+            ESP_LOGW(TAG, "Listener queue full, event cmd=%d dropped", msg->cmd);
+        }
+    }
+    pthread_mutex_unlock(&evt->lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_cmd(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg)
+{
+    return xQueueSend(evt->queue, msg, portMAX_DELAY) == pdTRUE ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t audio_event_iface_listen(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg, TickType_t wait_time)
+{
+    return xQueueReceive(evt->queue, msg, wait_time) == pdTRUE ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t audio_event_iface_discard(audio_event_iface_handle_t evt)
+{
+    xQueueReset(evt->queue);
+    return ESP_OK;
+}
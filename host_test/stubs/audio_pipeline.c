@@ -0,0 +1,325 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF audio pipeline: linked elements are chained with ringbuffers sized from
+ * the upstream element, and run/stop/wait follow the pipeline state checks of the real one */
+#include <stdlib.h>
+#include <string.h>
+#include "audio_pipeline.h"
+#include "esp_log.h"
+
+static const char *TAG = "HOST_PIPELINE";
+
+#define MAX_ITEMS   16
+
+typedef struct {
+    audio_element_handle_t  el;
+    bool                    linked;
+} el_item_t;
+
+typedef struct {
+    ringbuf_handle_t    rb;
+    bool                used;
+} rb_item_t;
+
+struct audio_pipeline {
+    el_item_t                   els[MAX_ITEMS];
+    int                         el_num;
+    rb_item_t                   rbs[MAX_ITEMS];
+    int                         rb_num;
+    audio_element_state_t       state;
+    audio_event_iface_handle_t  listener;
+    bool                        linked;
+};
+
+audio_pipeline_handle_t audio_pipeline_init(audio_pipeline_cfg_t *config)
+{
+    audio_pipeline_handle_t pipeline = calloc(1, sizeof(struct audio_pipeline));
+    if (pipeline) {
+        pipeline->state = AEL_STATE_INIT;
+    }
+    return pipeline;
+}
+
+esp_err_t audio_pipeline_deinit(audio_pipeline_handle_t pipeline)
+{
+    audio_pipeline_terminate(pipeline);
+    for (int i = 0; i < pipeline->el_num; i++) {
+        audio_element_deinit(pipeline->els[i].el);
+    }
+    for (int i = 0; i < pipeline->rb_num; i++) {
+        rb_destroy(pipeline->rbs[i].rb);
+    }
+    free(pipeline);
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_register(audio_pipeline_handle_t pipeline, audio_element_handle_t el, const char *name)
+{
+    if (pipeline->el_num == MAX_ITEMS) {
+        return ESP_FAIL;
+    }
+    audio_element_set_tag(el, name);
+    pipeline->els[pipeline->el_num].el = el;
+    pipeline->els[pipeline->el_num].linked = false;
+    pipeline->el_num++;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_unregister(audio_pipeline_handle_t pipeline, audio_element_handle_t el)
+{
+    for (int i = 0; i < pipeline->el_num; i++) {
+        if (pipeline->els[i].el == el) {
+            memmove(&pipeline->els[i], &pipeline->els[i + 1], (pipeline->el_num - i - 1) * sizeof(el_item_t));
+            pipeline->el_num--;
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+static el_item_t *_find(audio_pipeline_handle_t pipeline, const char *tag)
+{
+    for (int i = 0; i < pipeline->el_num; i++) {
+        if (strcmp(audio_element_get_tag(pipeline->els[i].el), tag) == 0) {
+            return &pipeline->els[i];
+        }
+    }
+    return NULL;
+}
+
+audio_element_handle_t audio_pipeline_get_el_by_tag(audio_pipeline_handle_t pipeline, const char *tag)
+{
+    el_item_t *item = _find(pipeline, tag);
+    return item ? item->el : NULL;
+}
+
+static ringbuf_handle_t _take_rb(audio_pipeline_handle_t pipeline, int size)
+{
+    for (int i = 0; i < pipeline->rb_num; i++) {
+        if (!pipeline->rbs[i].used && rb_get_size(pipeline->rbs[i].rb) == size) {
+            pipeline->rbs[i].used = true;
+            rb_reset(pipeline->rbs[i].rb);
+            return pipeline->rbs[i].rb;
+        }
+    }
+    if (pipeline->rb_num == MAX_ITEMS) {
+        return NULL;
+    }
+    ringbuf_handle_t rb = rb_create(size, 1);
+    pipeline->rbs[pipeline->rb_num].rb = rb;
+    pipeline->rbs[pipeline->rb_num].used = true;
+    pipeline->rb_num++;
+    return rb;
+}
+
+esp_err_t audio_pipeline_relink(audio_pipeline_handle_t pipeline, const char *link_tag[], int link_num)
+{
+    el_item_t *prev = NULL;
+    for (int i = 0; i < link_num; i++) {
+        el_item_t *item = _find(pipeline, link_tag[i]);
+        if (item == NULL) {
+            ESP_LOGE(TAG, "No element registered as %s", link_tag[i]);
+            return ESP_FAIL;
+        }
+        item->linked = true;
+        if (prev) {
+            ringbuf_handle_t rb = _take_rb(pipeline, audio_element_get_output_ringbuf_size(prev->el));
+            if (rb == NULL) {
+                return ESP_FAIL;
+            }
+            audio_element_set_output_ringbuf(prev->el, rb);
+            audio_element_set_input_ringbuf(item->el, rb);
+        }
+        prev = item;
+    }
+    pipeline->linked = true;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_link(audio_pipeline_handle_t pipeline, const char *link_tag[], int link_num)
+{
+    if (pipeline->linked) {
+        ESP_LOGE(TAG, "Pipeline already linked");
+        return ESP_FAIL;
+    }
+    return audio_pipeline_relink(pipeline, link_tag, link_num);
+}
+
+esp_err_t audio_pipeline_breakup_elements(audio_pipeline_handle_t pipeline, audio_element_handle_t kept_ctx_el)
+{
+    for (int i = 0; i < pipeline->el_num; i++) {
+        el_item_t *item = &pipeline->els[i];
+        if (!item->linked) {
+            continue;
+        }
+        item->linked = false;
+        if (audio_element_get_input_ringbuf(item->el)) {
+            audio_element_set_input_ringbuf(item->el, NULL);
+        }
+        if (audio_element_get_output_ringbuf(item->el)) {
+            audio_element_set_output_ringbuf(item->el, NULL);
+        }
+    }
+    for (int i = 0; i < pipeline->rb_num; i++) {
+        pipeline->rbs[i].used = false;
+    }
+    pipeline->linked = false;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_unlink(audio_pipeline_handle_t pipeline)
+{
+    audio_pipeline_breakup_elements(pipeline, NULL);
+    for (int i = 0; i < pipeline->rb_num; i++) {
+        rb_destroy(pipeline->rbs[i].rb);
+    }
+    pipeline->rb_num = 0;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_resume(audio_pipeline_handle_t pipeline)
+{
+    for (int i = 0; i < pipeline->el_num; i++) {
+        if (pipeline->els[i].linked) {
+            audio_element_resume(pipeline->els[i].el, 0, portMAX_DELAY);
+        }
+    }
+    pipeline->state = AEL_STATE_RUNNING;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_pause(audio_pipeline_handle_t pipeline)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t audio_pipeline_run(audio_pipeline_handle_t pipeline)
+{
+    if (pipeline->state != AEL_STATE_INIT) {
+        ESP_LOGW(TAG, "Pipeline already started, state:%d", pipeline->state);
+        return ESP_OK;
+    }
+    for (int i = 0; i < pipeline->el_num; i++) {
+        if (pipeline->els[i].linked && audio_element_run(pipeline->els[i].el) != ESP_OK) {
+            audio_pipeline_terminate(pipeline);
+            return ESP_FAIL;
+        }
+    }
+    return audio_pipeline_resume(pipeline);
+}
+
+esp_err_t audio_pipeline_stop(audio_pipeline_handle_t pipeline)
+{
+    if (pipeline->state != AEL_STATE_RUNNING) {
+        ESP_LOGW(TAG, "Without stop, st:%d", pipeline->state);
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < pipeline->el_num; i++) {
+        if (pipeline->els[i].linked) {
+            audio_element_stop(pipeline->els[i].el);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_wait_for_stop_with_ticks(audio_pipeline_handle_t pipeline, TickType_t ticks_to_wait)
+{
+    if (pipeline->state != AEL_STATE_RUNNING) {
+        ESP_LOGW(TAG, "Without wait stop, st:%d", pipeline->state);
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < pipeline->el_num; i++) {
+        if (pipeline->els[i].linked && audio_element_wait_for_stop_ms(pipeline->els[i].el, ticks_to_wait) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    pipeline->state = AEL_STATE_STOPPED;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_wait_for_stop(audio_pipeline_handle_t pipeline)
+{
+    return audio_pipeline_wait_for_stop_with_ticks(pipeline, portMAX_DELAY);
+}
+
+esp_err_t audio_pipeline_terminate(audio_pipeline_handle_t pipeline)
+{
+    for (int i = 0; i < pipeline->el_num; i++) {
+        audio_element_terminate(pipeline->els[i].el);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_reset_items_state(audio_pipeline_handle_t pipeline)
+{
+    for (int i = 0; i < pipeline->el_num; i++) {
+        if (pipeline->els[i].linked) {
+            audio_element_reset_state(pipeline->els[i].el);
+            audio_element_set_byte_pos(pipeline->els[i].el, 0);
+            audio_element_set_total_bytes(pipeline->els[i].el, 0);
+        }
+    }
+    pipeline->state = AEL_STATE_INIT;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_reset_ringbuffer(audio_pipeline_handle_t pipeline)
+{
+    for (int i = 0; i < pipeline->el_num; i++) {
+        if (pipeline->els[i].linked) {
+            audio_element_reset_output_ringbuf(pipeline->els[i].el);
+            audio_element_reset_input_ringbuf(pipeline->els[i].el);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_reset_elements(audio_pipeline_handle_t pipeline)
+{
+    return audio_pipeline_reset_items_state(pipeline);
+}
+
+esp_err_t audio_pipeline_set_listener(audio_pipeline_handle_t pipeline, audio_event_iface_handle_t listener)
+{
+    for (int i = 0; i < pipeline->el_num; i++) {
+        if (pipeline->els[i].linked) {
+            audio_element_msg_set_listener(pipeline->els[i].el, listener);
+        }
+    }
+    pipeline->listener = listener;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_remove_listener(audio_pipeline_handle_t pipeline)
+{
+    if (pipeline->listener == NULL) {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < pipeline->el_num; i++) {
+        audio_element_msg_remove_listener(pipeline->els[i].el, pipeline->listener);
+    }
+    pipeline->listener = NULL;
+    return ESP_OK;
+}
@@ -0,0 +1,404 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-IDF HTTP client, HTTP/1.1 over plain TCP with the request framing
+ * and the post field rules of the real client */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "host_net.h"
+
+static const char *TAG = "HOST_HTTP_CLIENT";
+
+#define MAX_HEADERS     16
+#define HEAD_MAX        4096
+
+typedef struct {
+    char *key;
+    char *value;
+} header_t;
+
+struct esp_http_client {
+    char                        host[128];
+    int                         port;
+    char                        *path;
+    esp_http_client_method_t    method;
+    int                         timeout_ms;
+    header_t                    headers[MAX_HEADERS];
+    char                        *post_data;
+    int                         post_len;
+    int                         sock;
+    /* Response */
+    int                         status_code;
+    int                         content_length;
+    bool                        chunked;
+    bool                        complete;
+    int                         body_left;      /* Of the content, or of the current chunk */
+    char                        rx[HEAD_MAX];
+    int                         rx_pos;
+    int                         rx_len;
+};
+
+static const char *s_methods[] = { "GET", "POST", "PUT", "PATCH", "DELETE", "HEAD" };
+
+static esp_err_t _parse_url(esp_http_client_handle_t client, const char *url)
+{
+    const char *p = strstr(url, "://");
+    bool https = p && strncmp(url, "https", 5) == 0;
+    p = p ? p + 3 : url;
+    const char *path = strchr(p, '/');
+    int host_len = path ? path - p : (int)strlen(p);
+    const char *colon = memchr(p, ':', host_len);
+    client->port = https ? 443 : 80;
+    if (colon) {
+        client->port = atoi(colon + 1);
+        host_len = colon - p;
+    }
+    snprintf(client->host, sizeof(client->host), "%.*s", host_len, p);
+    free(client->path);
+    client->path = strdup(path ? path : "/");
+    return ESP_OK;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t client = calloc(1, sizeof(struct esp_http_client));
+    if (client == NULL) {
+        return NULL;
+    }
+    client->sock = -1;
+    client->method = config->method;
+    client->timeout_ms = config->timeout_ms ? config->timeout_ms : 5000;
+    if (config->url) {
+        _parse_url(client, config->url);
+    }
+    return client;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+    esp_http_client_close(client);
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        free(client->headers[i].key);
+        free(client->headers[i].value);
+    }
+    free(client->path);
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url)
+{
+    return _parse_url(client, url);
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method)
+{
+    client->method = method;
+    return ESP_OK;
+}
+
+static header_t *_find_header(esp_http_client_handle_t client, const char *key)
+{
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        if (client->headers[i].key && strcasecmp(client->headers[i].key, key) == 0) {
+            return &client->headers[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key)
+{
+    header_t *h = _find_header(client, key);
+    if (h) {
+        free(h->key);
+        free(h->value);
+        h->key = NULL;
+        h->value = NULL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    if (value == NULL) {
+        return esp_http_client_delete_header(client, key);
+    }
+    header_t *h = _find_header(client, key);
+    if (h == NULL) {
+        for (int i = 0; i < MAX_HEADERS && h == NULL; i++) {
+            if (client->headers[i].key == NULL) {
+                h = &client->headers[i];
+                h->key = strdup(key);
+            }
+        }
+        if (h == NULL) {
+            return ESP_FAIL;
+        }
+    }
+    free(h->value);
+    h->value = strdup(value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_get_header(esp_http_client_handle_t client, const char *key, char **value)
+{
+    header_t *h = _find_header(client, key);
+    *value = h ? h->value : NULL;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len)
+{
+    client->post_data = (char *)data;
+    client->post_len = len;
+    if (client->post_data) {
+        char *value = NULL;
+        esp_http_client_get_header(client, "Content-Type", &value);
+        if (value == NULL) {
+            return esp_http_client_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
+        }
+        return ESP_OK;
+    }
+    client->post_len = 0;
+    return esp_http_client_set_header(client, "Content-Type", NULL);
+}
+
+int esp_http_client_get_post_field(esp_http_client_handle_t client, char **data)
+{
+    if (client->post_data) {
+        *data = client->post_data;
+        return client->post_len;
+    }
+    return 0;
+}
+
+static int _send_all(int sock, const char *buf, int len)
+{
+    int sent = 0;
+    while (sent < len) {
+        int n = send(sock, buf + sent, len - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return -1;
+        }
+        sent += n;
+    }
+    return sent;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    esp_http_client_close(client);
+    client->sock = host_net_connect(client->host, client->port, client->timeout_ms);
+    if (client->sock < 0) {
+        ESP_LOGE(TAG, "Connection failed, %s:%d", client->host, client->port);
+        return ESP_FAIL;
+    }
+    char len_str[16];
+    if (write_len >= 0) {
+        snprintf(len_str, sizeof(len_str), "%d", write_len);
+        esp_http_client_set_header(client, "Content-Length", len_str);
+        esp_http_client_delete_header(client, "Transfer-Encoding");
+    } else {
+        esp_http_client_set_header(client, "Transfer-Encoding", "chunked");
+        esp_http_client_delete_header(client, "Content-Length");
+        esp_http_client_set_method(client, HTTP_METHOD_POST);
+    }
+    char head[HEAD_MAX];
+    int n = snprintf(head, sizeof(head), "%s %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n",
+                     s_methods[client->method], client->path, client->host);
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        if (client->headers[i].key) {
+            n += snprintf(head + n, sizeof(head) - n, "%s: %s\r\n", client->headers[i].key, client->headers[i].value);
+        }
+    }
+    n += snprintf(head + n, sizeof(head) - n, "\r\n");
+    if (_send_all(client->sock, head, n) < 0) {
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len)
+{
+    if (client->sock < 0) {
+        return -1;
+    }
+    return _send_all(client->sock, buffer, len);
+}
+
+/* Buffered receive of up to len bytes, 0 on end of stream */
+static int _recv(esp_http_client_handle_t client, char *buf, int len)
+{
+    if (client->rx_pos == client->rx_len) {
+        int n = recv(client->sock, client->rx, sizeof(client->rx), 0);
+        if (n <= 0) {
+            return n;
+        }
+        client->rx_pos = 0;
+        client->rx_len = n;
+    }
+    int n = client->rx_len - client->rx_pos;
+    if (n > len) {
+        n = len;
+    }
+    memcpy(buf, client->rx + client->rx_pos, n);
+    client->rx_pos += n;
+    return n;
+}
+
+static int _recv_line(esp_http_client_handle_t client, char *line, int size)
+{
+    int n = 0;
+    char c;
+    while (_recv(client, &c, 1) == 1) {
+        if (c == '\n') {
+            if (n > 0 && line[n - 1] == '\r') {
+                n--;
+            }
+            line[n] = 0;
+            return n;
+        }
+        if (n < size - 1) {
+            line[n++] = c;
+        }
+    }
+    return -1;
+}
+
+int esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    char line[1024];
+    client->status_code = -1;
+    client->content_length = -1;
+    client->chunked = false;
+    client->complete = false;
+    if (client->sock < 0 || _recv_line(client, line, sizeof(line)) < 0) {
+        return ESP_FAIL;
+    }
+    sscanf(line, "HTTP/%*s %d", &client->status_code);
+    while (_recv_line(client, line, sizeof(line)) > 0) {
+        char *colon = strchr(line, ':');
+        if (colon == NULL) {
+            continue;
+        }
+        *colon = 0;
+        char *value = colon + 1;
+        while (*value == ' ') {
+            value++;
+        }
+        if (strcasecmp(line, "Content-Length") == 0) {
+            client->content_length = atoi(value);
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasecmp(value, "chunked") == 0) {
+            client->chunked = true;
+        }
+    }
+    if (client->chunked) {
+        client->content_length = -1;
+        client->body_left = 0;
+    } else {
+        client->body_left = client->content_length;
+        client->complete = client->content_length == 0;
+    }
+    return client->content_length;
+}
+
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t client)
+{
+    return client->chunked;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    int ridx = 0;
+    char line[64];
+    while (ridx < len && !client->complete) {
+        if (client->chunked && client->body_left == 0) {
+            if (_recv_line(client, line, sizeof(line)) < 0) {
+                break;
+            }
+            if (line[0] == 0) {
+                /* The CRLF that ends the previous chunk */
+                continue;
+            }
+            client->body_left = strtol(line, NULL, 16);
+            if (client->body_left == 0) {
+                while (_recv_line(client, line, sizeof(line)) > 0) {
+                }
+                client->complete = true;
+                break;
+            }
+        }
+        int want = len - ridx;
+        if (client->body_left >= 0 && want > client->body_left) {
+            want = client->body_left;
+        }
+        int n = _recv(client, buffer + ridx, want);
+        if (n <= 0) {
+            if (client->body_left < 0) {
+                client->complete = true;
+            }
+            break;
+        }
+        ridx += n;
+        if (client->body_left > 0) {
+            client->body_left -= n;
+            if (client->body_left == 0 && !client->chunked) {
+                client->complete = true;
+            }
+        }
+    }
+    return ridx;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status_code;
+}
+
+int esp_http_client_get_content_length(esp_http_client_handle_t client)
+{
+    return client->content_length;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    if (client->sock >= 0) {
+        close(client->sock);
+        client->sock = -1;
+    }
+    client->rx_pos = 0;
+    client->rx_len = 0;
+    return ESP_OK;
+}
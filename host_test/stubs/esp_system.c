@@ -0,0 +1,289 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-ins for the ESP-IDF log, timer, allocators, ROM CRC and flash partitions */
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "esp_partition.h"
+#include "esp_crt_bundle.h"
+#include "mbedtls/ssl.h"
+#include "audio_mem.h"
+#include "host_stub.h"
+
+static int s_log_level = -1;
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    s_log_level = level;
+}
+
+void host_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (s_log_level < 0) {
+        const char *env = getenv("HOST_LOG_LEVEL");
+        const char *levels = "NEWIDV";
+        const char *l = env && env[0] ? strchr(levels, env[0]) : NULL;
+        s_log_level = l ? (int)(l - levels) : ESP_LOG_WARN;
+    }
+    if ((int)level > s_log_level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&s_log_lock);
+    fprintf(stderr, "%c (%lld) %s: ", "NEWIDV"[level], (long long)(esp_timer_get_time() / 1000), tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    pthread_mutex_unlock(&s_log_lock);
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_FAIL:
+            return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:
+            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:
+            return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:
+            return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:
+            return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:
+            return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:
+            return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:
+            return "ESP_ERR_TIMEOUT";
+        default:
+            return "UNKNOWN ERROR";
+    }
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static volatile uint32_t s_alloc_count;
+
+uint32_t host_mem_alloc_count(void)
+{
+    return __atomic_load_n(&s_alloc_count, __ATOMIC_RELAXED);
+}
+
+static void *_counted(void *ptr)
+{
+    if (ptr) {
+        __atomic_add_fetch(&s_alloc_count, 1, __ATOMIC_RELAXED);
+    }
+    return ptr;
+}
+
+void *audio_malloc(size_t size)
+{
+    return _counted(malloc(size));
+}
+
+void audio_free(void *ptr)
+{
+    free(ptr);
+}
+
+void *audio_calloc(size_t nmemb, size_t size)
+{
+    return _counted(calloc(nmemb, size));
+}
+
+void *audio_calloc_inner(size_t nmemb, size_t size)
+{
+    return _counted(calloc(nmemb, size));
+}
+
+void *audio_realloc(void *ptr, size_t size)
+{
+    return _counted(realloc(ptr, size));
+}
+
+char *audio_strdup(const char *str)
+{
+    return _counted(strdup(str));
+}
+
+void audio_mem_print(char *tag, int line, const char *func)
+{
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return _counted(malloc(size));
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    return _counted(calloc(n, size));
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+/* The sizes of the ESP32-WROVER regions, there is no meaningful value on the host */
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return caps & MALLOC_CAP_SPIRAM ? 4 * 1024 * 1024 : 300 * 1024;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static int _bundle_verify(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    return 0;
+}
+
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    /* Every server is trusted, the check only has to run */
+    if (conf) {
+        mbedtls_ssl_conf_verify((mbedtls_ssl_config *)conf, _bundle_verify, NULL);
+    }
+    return ESP_OK;
+}
+
+#define HOST_PARTITION_MAX  (4)
+
+typedef struct {
+    esp_partition_t part;
+    uint8_t         *flash;
+} host_partition_t;
+
+static host_partition_t s_partitions[HOST_PARTITION_MAX];
+
+void host_partition_add(const char *label, uint32_t size)
+{
+    for (int i = 0; i < HOST_PARTITION_MAX; i++) {
+        if (s_partitions[i].flash == NULL) {
+            s_partitions[i].part.type = ESP_PARTITION_TYPE_DATA;
+            s_partitions[i].part.subtype = ESP_PARTITION_SUBTYPE_ANY;
+            s_partitions[i].part.size = size;
+            snprintf(s_partitions[i].part.label, sizeof(s_partitions[i].part.label), "%s", label);
+            s_partitions[i].flash = malloc(size);
+            memset(s_partitions[i].flash, 0xff, size);
+            return;
+        }
+    }
+    abort();
+}
+
+void host_partition_remove_all(void)
+{
+    for (int i = 0; i < HOST_PARTITION_MAX; i++) {
+        free(s_partitions[i].flash);
+        memset(&s_partitions[i], 0, sizeof(host_partition_t));
+    }
+}
+
+static host_partition_t *_partition(const esp_partition_t *part)
+{
+    return (host_partition_t *)part;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    for (int i = 0; i < HOST_PARTITION_MAX; i++) {
+        if (s_partitions[i].flash && s_partitions[i].part.type == type
+                && (label == NULL || strcmp(s_partitions[i].part.label, label) == 0)) {
+            return &s_partitions[i].part;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t src_offset, void *dst, size_t size)
+{
+    if (src_offset + size > part->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, _partition(part)->flash + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t dst_offset, const void *src, size_t size)
+{
+    if (dst_offset + size > part->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    /* NOR flash: writing only clears bits */
+    uint8_t *flash = _partition(part)->flash + dst_offset;
+    for (size_t i = 0; i < size; i++) {
+        flash[i] &= ((const uint8_t *)src)[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size)
+{
+    if (offset % 4096 || size % 4096 || offset + size > part->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(_partition(part)->flash + offset, 0xff, size);
+    return ESP_OK;
+}
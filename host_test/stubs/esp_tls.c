@@ -0,0 +1,185 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for ESP-TLS over plain TCP */
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "esp_tls.h"
+#include "esp_log.h"
+#include "mbedtls/ssl.h"
+#include "host_net.h"
+#include "host_stub.h"
+
+static const char *TAG = "HOST_TLS";
+
+static int s_redirect_port;
+static int s_session_id;
+static int s_session_epoch;     /* Sessions up to this id are no longer resumed */
+static int s_full_handshakes;
+
+void host_net_redirect(int port)
+{
+    s_redirect_port = port;
+}
+
+int host_net_connect(const char *host, int port, int timeout_ms)
+{
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    char port_str[8];
+    if (s_redirect_port) {
+        host = "127.0.0.1";
+        port = s_redirect_port;
+    }
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    if (getaddrinfo(host, port_str, &hints, &res) != 0 || res == NULL) {
+        ESP_LOGE(TAG, "Failed to resolve %s", host);
+        return -1;
+    }
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock >= 0 && timeout_ms > 0) {
+        struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    if (sock >= 0) {
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return sock;
+}
+
+esp_tls_t *esp_tls_init(void)
+{
+    esp_tls_t *tls = calloc(1, sizeof(esp_tls_t));
+    if (tls) {
+        tls->sockfd = -1;
+    }
+    return tls;
+}
+
+void host_tls_forget_sessions(void)
+{
+    s_session_epoch = s_session_id;
+}
+
+int host_tls_full_handshakes(void)
+{
+    return s_full_handshakes;
+}
+
+void mbedtls_ssl_conf_verify(mbedtls_ssl_config *conf, int (*f_vrfy)(void *, mbedtls_x509_crt *, int, uint32_t *),
+                             void *p_vrfy)
+{
+    conf->MBEDTLS_PRIVATE(f_vrfy) = f_vrfy;
+    conf->MBEDTLS_PRIVATE(p_vrfy) = p_vrfy;
+}
+
+int esp_tls_conn_new_sync(const char *hostname, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_t *tls)
+{
+    char host[256];
+    mbedtls_ssl_config conf = { 0 };
+    if (cfg && cfg->crt_bundle_attach) {
+        cfg->crt_bundle_attach(&conf);
+    }
+    snprintf(host, sizeof(host), "%.*s", hostlen, hostname);
+    tls->sockfd = host_net_connect(host, port, cfg ? cfg->timeout_ms : 0);
+    if (tls->sockfd < 0) {
+        return -1;
+    }
+    /* A session still known is resumed, otherwise the server certificate is checked */
+    if (cfg == NULL || cfg->client_session == NULL || cfg->client_session->id <= s_session_epoch) {
+        uint32_t flags = 0;
+        s_full_handshakes++;
+        if (conf.MBEDTLS_PRIVATE(f_vrfy)
+                && conf.MBEDTLS_PRIVATE(f_vrfy)(conf.MBEDTLS_PRIVATE(p_vrfy), NULL, 0, &flags) != 0) {
+            close(tls->sockfd);
+            tls->sockfd = -1;
+            return -1;
+        }
+    }
+    return 1;
+}
+
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen)
+{
+    ssize_t ret = send(tls->sockfd, data, datalen, MSG_NOSIGNAL);
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return ESP_TLS_ERR_SSL_WANT_WRITE;
+    }
+    return ret;
+}
+
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen)
+{
+    ssize_t ret = recv(tls->sockfd, data, datalen, 0);
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return ESP_TLS_ERR_SSL_WANT_READ;
+    }
+    return ret;
+}
+
+int esp_tls_conn_destroy(esp_tls_t *tls)
+{
+    if (tls == NULL) {
+        return -1;
+    }
+    if (tls->sockfd >= 0) {
+        close(tls->sockfd);
+    }
+    free(tls);
+    return 0;
+}
+
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls, int *sockfd)
+{
+    *sockfd = tls->sockfd;
+    return ESP_OK;
+}
+
+esp_tls_client_session_t *esp_tls_get_client_session(esp_tls_t *tls)
+{
+    esp_tls_client_session_t *session = calloc(1, sizeof(esp_tls_client_session_t));
+    if (session) {
+        session->id = ++s_session_id;
+    }
+    return session;
+}
+
+void esp_tls_free_client_session(esp_tls_client_session_t *client_session)
+{
+    free(client_session);
+}
@@ -0,0 +1,322 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for FreeRTOS: tasks are detached pthreads, queues and semaphores are guarded
+ * ring buffers */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+static const char *TAG = "HOST_RTOS";
+
+struct host_task {
+    TaskFunction_t  fn;
+    void            *arg;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t  can_read;
+    pthread_cond_t  can_write;
+    int             length;
+    int             item_size;
+    int             count;
+    int             head;
+    uint8_t         *items;
+};
+
+static void _deadline(struct timespec *ts, TickType_t ticks)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    uint64_t ns = (uint64_t)ticks * portTICK_PERIOD_MS * 1000000ULL + ts->tv_nsec;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+}
+
+/* Wait on `cond` until `ready` is true, false on timeout */
+static bool _wait(struct host_queue *q, pthread_cond_t *cond, bool (*ready)(struct host_queue *), TickType_t ticks)
+{
+    if (ready(q)) {
+        return true;
+    }
+    if (ticks == 0) {
+        return false;
+    }
+    struct timespec ts;
+    _deadline(&ts, ticks);
+    while (!ready(q)) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, &q->lock);
+        } else if (pthread_cond_timedwait(cond, &q->lock, &ts) == ETIMEDOUT) {
+            return ready(q);
+        }
+    }
+    return true;
+}
+
+static bool _has_item(struct host_queue *q)
+{
+    return q->count > 0;
+}
+
+static bool _has_room(struct host_queue *q)
+{
+    return q->count < q->length;
+}
+
+static void *_task_entry(void *pv)
+{
+    struct host_task *task = (struct host_task *)pv;
+    task->fn(task->arg);
+    free(task);
+    return NULL;
+}
+
+static __thread struct host_task *s_current;
+
+static void *_task_start(void *pv)
+{
+    s_current = (struct host_task *)pv;
+    return _task_entry(pv);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle)
+{
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (handle) {
+        *handle = task;
+    }
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(&thread, &attr, _task_start, task);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                                   TaskHandle_t *handle, BaseType_t core)
+{
+    return xTaskCreate(fn, name, stack, arg, prio, handle);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task != NULL && task != s_current) {
+        ESP_LOGE(TAG, "Only a task can delete itself on the host");
+        abort();
+    }
+    free(s_current);
+    s_current = NULL;
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = (ticks * portTICK_PERIOD_MS) / 1000,
+        .tv_nsec = ((ticks * portTICK_PERIOD_MS) % 1000) * 1000000L,
+    };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)((ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000) / portTICK_PERIOD_MS);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(struct host_queue));
+    if (q == NULL) {
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    if (item_size > 0 && (q->items = calloc(length, item_size)) == NULL) {
+        free(q);
+        return NULL;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&q->can_read, &attr);
+    pthread_cond_init(&q->can_write, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&q->lock, NULL);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (q == NULL) {
+        return;
+    }
+    pthread_cond_destroy(&q->can_read);
+    pthread_cond_destroy(&q->can_write);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+    free(q);
+}
+
+static BaseType_t _send(QueueHandle_t q, const void *item, TickType_t ticks, bool front)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!_wait(q, &q->can_write, _has_room, ticks)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    int slot;
+    if (front) {
+        q->head = (q->head + q->length - 1) % q->length;
+        slot = q->head;
+    } else {
+        slot = (q->head + q->count) % q->length;
+    }
+    if (q->item_size > 0) {
+        memcpy(q->items + slot * q->item_size, item, q->item_size);
+    }
+    q->count++;
+    pthread_cond_broadcast(&q->can_read);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    return _send(q, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    return _send(q, item, ticks, true);
+}
+
+static BaseType_t _receive(QueueHandle_t q, void *item, TickType_t ticks, bool peek)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!_wait(q, &q->can_read, _has_item, ticks)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    if (q->item_size > 0) {
+        memcpy(item, q->items + q->head * q->item_size, q->item_size);
+    }
+    if (!peek) {
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_broadcast(&q->can_write);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    return _receive(q, item, ticks, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    return _receive(q, item, ticks, true);
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->count = 0;
+    q->head = 0;
+    pthread_cond_broadcast(&q->can_write);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    int count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    int room = q->length - q->count;
+    pthread_mutex_unlock(&q->lock);
+    return room;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t sem = xQueueCreate(1, 0);
+    if (sem) {
+        xSemaphoreGive(sem);
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    SemaphoreHandle_t sem = xQueueCreate(max, 0);
+    for (UBaseType_t i = 0; sem && i < initial; i++) {
+        xSemaphoreGive(sem);
+    }
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return xQueueReceive(sem, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return xQueueSend(sem, NULL, 0);
+}
@@ -0,0 +1,305 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* A test server on 127.0.0.1, and HTTP/1.1 request parsing for its handlers */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "host_stub.h"
+
+struct host_server {
+    int                     listen_fd;
+    int                     port;
+    host_server_handler_t   handler;
+    void                    *ctx;
+    pthread_t               thread;
+    pthread_mutex_t         lock;
+    int                     connections;
+    int                     active;
+    bool                    stop;
+};
+
+typedef struct {
+    host_server_t   *server;
+    int             fd;
+} conn_arg_t;
+
+static void *_conn_task(void *pv)
+{
+    conn_arg_t *arg = (conn_arg_t *)pv;
+    host_server_t *server = arg->server;
+    server->handler(arg->fd, server->ctx);
+    close(arg->fd);
+    free(arg);
+    pthread_mutex_lock(&server->lock);
+    server->active--;
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+static void *_accept_task(void *pv)
+{
+    host_server_t *server = (host_server_t *)pv;
+    while (1) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            break;
+        }
+        pthread_mutex_lock(&server->lock);
+        if (server->stop) {
+            pthread_mutex_unlock(&server->lock);
+            close(fd);
+            break;
+        }
+        server->connections++;
+        server->active++;
+        pthread_mutex_unlock(&server->lock);
+        conn_arg_t *arg = malloc(sizeof(conn_arg_t));
+        arg->server = server;
+        arg->fd = fd;
+        pthread_t thread;
+        pthread_create(&thread, NULL, _conn_task, arg);
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+host_server_t *host_server_start(host_server_handler_t handler, void *ctx)
+{
+    host_server_t *server = calloc(1, sizeof(host_server_t));
+    server->handler = handler;
+    server->ctx = ctx;
+    pthread_mutex_init(&server->lock, NULL);
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+            || listen(server->listen_fd, 8) != 0
+            || getsockname(server->listen_fd, (struct sockaddr *)&addr, &len) != 0) {
+        close(server->listen_fd);
+        free(server);
+        return NULL;
+    }
+    server->port = ntohs(addr.sin_port);
+    pthread_create(&server->thread, NULL, _accept_task, server);
+    return server;
+}
+
+int host_server_port(host_server_t *server)
+{
+    return server->port;
+}
+
+int host_server_connections(host_server_t *server)
+{
+    pthread_mutex_lock(&server->lock);
+    int n = server->connections;
+    pthread_mutex_unlock(&server->lock);
+    return n;
+}
+
+void host_server_stop(host_server_t *server)
+{
+    pthread_mutex_lock(&server->lock);
+    server->stop = true;
+    pthread_mutex_unlock(&server->lock);
+    shutdown(server->listen_fd, SHUT_RDWR);
+    close(server->listen_fd);
+    pthread_join(server->thread, NULL);
+    /* Handlers end when their client closes */
+    while (1) {
+        pthread_mutex_lock(&server->lock);
+        int active = server->active;
+        pthread_mutex_unlock(&server->lock);
+        if (active == 0) {
+            break;
+        }
+        usleep(1000);
+    }
+    pthread_mutex_destroy(&server->lock);
+    free(server);
+}
+
+static int _fill(int fd, host_http_request_t *req, int *cap)
+{
+    if (req->raw_len == *cap) {
+        *cap *= 2;
+        req->raw = realloc(req->raw, *cap + 1);
+    }
+    int n = recv(fd, req->raw + req->raw_len, *cap - req->raw_len, 0);
+    if (n > 0) {
+        req->raw_len += n;
+        req->raw[req->raw_len] = 0;
+    }
+    return n;
+}
+
+/* Position of the next CRLF at or after pos, reading more as needed */
+static int _find_crlf(int fd, host_http_request_t *req, int *cap, int pos)
+{
+    while (1) {
+        for (int i = pos; i + 1 < req->raw_len; i++) {
+            if (req->raw[i] == '\r' && req->raw[i + 1] == '\n') {
+                return i;
+            }
+        }
+        if (_fill(fd, req, cap) <= 0) {
+            return -1;
+        }
+    }
+}
+
+int host_http_read_request(int fd, host_http_request_t *req)
+{
+    memset(req, 0, sizeof(*req));
+    int cap = 4096;
+    req->raw = malloc(cap + 1);
+    req->content_length = -1;
+    char *end;
+    while ((end = strstr(req->raw_len ? req->raw : "", "\r\n\r\n")) == NULL) {
+        if (_fill(fd, req, &cap) <= 0) {
+            return -1;
+        }
+    }
+    req->head_len = end - req->raw + 4;
+    char value[32];
+    if (host_http_header(req, "Content-Length", value, sizeof(value))) {
+        req->content_length = atoi(value);
+    }
+    if (host_http_header(req, "Transfer-Encoding", value, sizeof(value)) && strcasecmp(value, "chunked") == 0) {
+        req->chunked = true;
+    }
+    req->body = malloc(1);
+    if (req->chunked) {
+        int pos = req->head_len;
+        while (1) {
+            int eol = _find_crlf(fd, req, &cap, pos);
+            if (eol < 0) {
+                return -1;
+            }
+            int size = strtol(req->raw + pos, NULL, 16);
+            pos = eol + 2;
+            while (req->raw_len < pos + size + 2) {
+                if (_fill(fd, req, &cap) <= 0) {
+                    return -1;
+                }
+            }
+            if (size == 0) {
+                break;
+            }
+            req->body = realloc(req->body, req->body_len + size + 1);
+            memcpy(req->body + req->body_len, req->raw + pos, size);
+            req->body_len += size;
+            req->chunks++;
+            pos += size + 2;
+        }
+    } else if (req->content_length > 0) {
+        while (req->raw_len < req->head_len + req->content_length) {
+            if (_fill(fd, req, &cap) <= 0) {
+                return -1;
+            }
+        }
+        req->body = realloc(req->body, req->content_length + 1);
+        memcpy(req->body, req->raw + req->head_len, req->content_length);
+        req->body_len = req->content_length;
+    }
+    req->body[req->body_len] = 0;
+    return 0;
+}
+
+bool host_http_header(const host_http_request_t *req, const char *name, char *value, int size)
+{
+    int name_len = strlen(name);
+    const char *line = strstr(req->raw, "\r\n");
+    while (line && line + 2 < req->raw + req->head_len) {
+        line += 2;
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char *v = line + name_len + 1;
+            while (*v == ' ') {
+                v++;
+            }
+            const char *eol = strstr(v, "\r\n");
+            snprintf(value, size, "%.*s", (int)(eol - v), v);
+            return true;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return false;
+}
+
+void host_http_request_free(host_http_request_t *req)
+{
+    free(req->raw);
+    free(req->body);
+    memset(req, 0, sizeof(*req));
+}
+
+int host_send_all(int fd, const void *buf, int len)
+{
+    int sent = 0;
+    while (sent < len) {
+        int n = send(fd, (const char *)buf + sent, len - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return -1;
+        }
+        sent += n;
+    }
+    return sent;
+}
+
+int host_http_respond(int fd, const char *content_type, const void *body, int len, int chunk)
+{
+    char head[256];
+    int n;
+    if (chunk > 0) {
+        n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n\r\n",
+                     content_type);
+    } else {
+        n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %d\r\n\r\n",
+                     content_type, len);
+    }
+    if (host_send_all(fd, head, n) < 0) {
+        return -1;
+    }
+    if (chunk <= 0) {
+        return host_send_all(fd, body, len) < 0 ? -1 : 0;
+    }
+    for (int pos = 0; pos < len; pos += chunk) {
+        int size = len - pos < chunk ? len - pos : chunk;
+        n = snprintf(head, sizeof(head), "%x\r\n", size);
+        if (host_send_all(fd, head, n) < 0 || host_send_all(fd, (const char *)body + pos, size) < 0
+                || host_send_all(fd, "\r\n", 2) < 0) {
+            return -1;
+        }
+    }
+    return host_send_all(fd, "0\r\n\r\n", 5) < 0 ? -1 : 0;
+}
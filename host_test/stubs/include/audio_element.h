@@ -0,0 +1,197 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF audio element. An element with a task stack runs in its own
+ * thread: open, process until the input is done, an error or a stop, then close. Elements
+ * without a task stack are driven by their caller, as raw_stream is */
+#ifndef _HOST_AUDIO_ELEMENT_H_
+#define _HOST_AUDIO_ELEMENT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "audio_common.h"
+#include "audio_event_iface.h"
+#include "ringbuf.h"
+#include "audio_error.h"
+
+typedef enum {
+    AEL_IO_OK           = ESP_OK,
+    AEL_IO_FAIL         = ESP_FAIL,
+    AEL_IO_DONE         = -2,
+    AEL_IO_ABORT        = -3,
+    AEL_IO_TIMEOUT      = -4,
+    AEL_PROCESS_FAIL    = -5,
+} audio_element_err_t;
+
+typedef enum {
+    AEL_STATE_NONE          = 0,
+    AEL_STATE_INIT          = 1,
+    AEL_STATE_INITIALIZING  = 2,
+    AEL_STATE_RUNNING       = 3,
+    AEL_STATE_PAUSED        = 4,
+    AEL_STATE_STOPPED       = 5,
+    AEL_STATE_FINISHED      = 6,
+    AEL_STATE_ERROR         = 7,
+} audio_element_state_t;
+
+typedef enum {
+    AEL_MSG_CMD_NONE                = 0,
+    AEL_MSG_CMD_FINISH              = 2,
+    AEL_MSG_CMD_STOP                = 3,
+    AEL_MSG_CMD_PAUSE               = 4,
+    AEL_MSG_CMD_RESUME              = 5,
+    AEL_MSG_CMD_DESTROY             = 6,
+    AEL_MSG_CMD_REPORT_STATUS       = 8,
+    AEL_MSG_CMD_REPORT_MUSIC_INFO   = 9,
+    AEL_MSG_CMD_REPORT_CODEC_FMT    = 10,
+    AEL_MSG_CMD_REPORT_POSITION     = 11,
+} audio_element_msg_cmd_t;
+
+typedef enum {
+    AEL_STATUS_NONE             = 0,
+    AEL_STATUS_ERROR_OPEN       = 1,
+    AEL_STATUS_ERROR_INPUT      = 2,
+    AEL_STATUS_ERROR_PROCESS    = 3,
+    AEL_STATUS_ERROR_OUTPUT     = 4,
+    AEL_STATUS_ERROR_CLOSE      = 5,
+    AEL_STATUS_ERROR_TIMEOUT    = 6,
+    AEL_STATUS_ERROR_UNKNOWN    = 7,
+    AEL_STATUS_INPUT_DONE       = 8,
+    AEL_STATUS_INPUT_BUFFERING  = 9,
+    AEL_STATUS_OUTPUT_DONE      = 10,
+    AEL_STATUS_OUTPUT_BUFFERING = 11,
+    AEL_STATUS_STATE_RUNNING    = 12,
+    AEL_STATUS_STATE_PAUSED     = 13,
+    AEL_STATUS_STATE_STOPPED    = 14,
+    AEL_STATUS_STATE_FINISHED   = 15,
+    AEL_STATUS_MOUNTED          = 16,
+    AEL_STATUS_UNMOUNTED        = 17,
+} audio_element_status_t;
+
+typedef struct audio_element *audio_element_handle_t;
+
+typedef struct {
+    int     sample_rates;
+    int     channels;
+    int     bits;
+    int     bps;
+    int64_t byte_pos;
+    int64_t total_bytes;
+    int     duration;
+    char    *uri;
+    int     codec_fmt;
+} audio_element_info_t;
+
+typedef esp_err_t (*el_io_func)(audio_element_handle_t self);
+typedef audio_element_err_t (*process_func)(audio_element_handle_t self, char *el_buffer, int el_buf_len);
+typedef audio_element_err_t (*stream_func)(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait,
+        void *context);
+typedef esp_err_t (*ctrl_func)(audio_element_handle_t self, void *in_data, int in_size, void *out_data, int *out_size);
+
+typedef struct {
+    el_io_func      open;
+    ctrl_func       seek;
+    process_func    process;
+    el_io_func      close;
+    el_io_func      destroy;
+    stream_func     read;
+    stream_func     write;
+    int             buffer_len;
+    int             task_stack;
+    int             task_prio;
+    int             task_core;
+    int             out_rb_size;
+    void            *data;
+    const char      *tag;
+    bool            stack_in_ext;
+    int             multi_in_rb_num;
+    int             multi_out_rb_num;
+} audio_element_cfg_t;
+
+#define DEFAULT_ELEMENT_RINGBUF_SIZE    (8*1024)
+#define DEFAULT_ELEMENT_BUFFER_LENGTH   (1024)
+#define DEFAULT_ELEMENT_STACK_SIZE      (2*1024)
+#define DEFAULT_ELEMENT_TASK_PRIO       (5)
+#define DEFAULT_ELEMENT_TASK_CORE       (0)
+
+#define DEFAULT_AUDIO_ELEMENT_CONFIG() {                \
+    .buffer_len         = DEFAULT_ELEMENT_BUFFER_LENGTH,\
+    .task_stack         = DEFAULT_ELEMENT_STACK_SIZE,   \
+    .task_prio          = DEFAULT_ELEMENT_TASK_PRIO,    \
+    .task_core          = DEFAULT_ELEMENT_TASK_CORE,    \
+    .multi_in_rb_num    = 0,                            \
+    .multi_out_rb_num   = 0,                            \
+}
+
+audio_element_handle_t audio_element_init(audio_element_cfg_t *config);
+esp_err_t audio_element_deinit(audio_element_handle_t el);
+esp_err_t audio_element_setdata(audio_element_handle_t el, void *data);
+void *audio_element_getdata(audio_element_handle_t el);
+esp_err_t audio_element_set_tag(audio_element_handle_t el, const char *tag);
+char *audio_element_get_tag(audio_element_handle_t el);
+esp_err_t audio_element_setinfo(audio_element_handle_t el, audio_element_info_t *info);
+esp_err_t audio_element_getinfo(audio_element_handle_t el, audio_element_info_t *info);
+esp_err_t audio_element_set_uri(audio_element_handle_t el, const char *uri);
+char *audio_element_get_uri(audio_element_handle_t el);
+esp_err_t audio_element_run(audio_element_handle_t el);
+esp_err_t audio_element_terminate(audio_element_handle_t el);
+esp_err_t audio_element_stop(audio_element_handle_t el);
+esp_err_t audio_element_wait_for_stop(audio_element_handle_t el);
+esp_err_t audio_element_wait_for_stop_ms(audio_element_handle_t el, TickType_t ticks_to_wait);
+esp_err_t audio_element_pause(audio_element_handle_t el);
+esp_err_t audio_element_resume(audio_element_handle_t el, float wait_for_rb_threshold, TickType_t timeout);
+esp_err_t audio_element_msg_set_listener(audio_element_handle_t el, audio_event_iface_handle_t listener);
+esp_err_t audio_element_msg_remove_listener(audio_element_handle_t el, audio_event_iface_handle_t listener);
+audio_element_state_t audio_element_get_state(audio_element_handle_t el);
+esp_err_t audio_element_set_input_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb);
+ringbuf_handle_t audio_element_get_input_ringbuf(audio_element_handle_t el);
+esp_err_t audio_element_set_output_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb);
+ringbuf_handle_t audio_element_get_output_ringbuf(audio_element_handle_t el);
+int audio_element_get_output_ringbuf_size(audio_element_handle_t el);
+esp_err_t audio_element_set_output_ringbuf_size(audio_element_handle_t el, int rb_size);
+esp_err_t audio_element_set_ringbuf_done(audio_element_handle_t el);
+esp_err_t audio_element_reset_state(audio_element_handle_t el);
+esp_err_t audio_element_reset_input_ringbuf(audio_element_handle_t el);
+esp_err_t audio_element_reset_output_ringbuf(audio_element_handle_t el);
+esp_err_t audio_element_abort_input_ringbuf(audio_element_handle_t el);
+esp_err_t audio_element_abort_output_ringbuf(audio_element_handle_t el);
+audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size);
+audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size);
+esp_err_t audio_element_set_read_cb(audio_element_handle_t el, stream_func fn, void *context);
+esp_err_t audio_element_set_write_cb(audio_element_handle_t el, stream_func fn, void *context);
+esp_err_t audio_element_set_input_timeout(audio_element_handle_t el, TickType_t timeout);
+esp_err_t audio_element_set_output_timeout(audio_element_handle_t el, TickType_t timeout);
+esp_err_t audio_element_report_info(audio_element_handle_t el);
+esp_err_t audio_element_report_codec_fmt(audio_element_handle_t el);
+esp_err_t audio_element_report_status(audio_element_handle_t el, audio_element_status_t status);
+esp_err_t audio_element_report_pos(audio_element_handle_t el);
+esp_err_t audio_element_set_byte_pos(audio_element_handle_t el, int64_t pos);
+esp_err_t audio_element_update_byte_pos(audio_element_handle_t el, int pos);
+esp_err_t audio_element_set_total_bytes(audio_element_handle_t el, int64_t total_bytes);
+esp_err_t audio_element_set_music_info(audio_element_handle_t el, int sample_rates, int channels, int bits);
+bool audio_element_is_stopping(audio_element_handle_t el);
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF error helpers */
+#ifndef _HOST_AUDIO_ERROR_H_
+#define _HOST_AUDIO_ERROR_H_
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#define ESP_EXISTS                  (ESP_OK + 1)
+
+#define AUDIO_CHECK(TAG, a, action, msg) if (!(a)) {                                    \
+        ESP_LOGE(TAG, "%s:%d (%s): %s", __FILE__, __LINE__, __FUNCTION__, msg);         \
+        action;                                                                         \
+    }
+
+#define AUDIO_MEM_CHECK(TAG, a, action)     AUDIO_CHECK(TAG, a, action, "Memory exhausted")
+#define AUDIO_NULL_CHECK(TAG, a, action)    AUDIO_CHECK(TAG, a, action, "Got NULL Pointer")
+#define AUDIO_ERROR(TAG, str)               ESP_LOGE(TAG, "%s:%d (%s): %s", __FILE__, __LINE__, __FUNCTION__, str)
+
+#endif
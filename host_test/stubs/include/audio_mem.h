@@ -0,0 +1,45 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF allocator, allocations are counted for the benchmarks */
+#ifndef _HOST_AUDIO_MEM_H_
+#define _HOST_AUDIO_MEM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+void *audio_malloc(size_t size);
+void audio_free(void *ptr);
+void *audio_calloc(size_t nmemb, size_t size);
+void *audio_calloc_inner(size_t nmemb, size_t size);
+void *audio_realloc(void *ptr, size_t size);
+char *audio_strdup(const char *str);
+void audio_mem_print(char *tag, int line, const char *func);
+
+#define AUDIO_MEM_SHOW(x)           audio_mem_print(x, __LINE__, __func__)
+
+/* Allocations made through audio_malloc, audio_calloc, audio_realloc, audio_strdup and heap_caps_malloc */
+uint32_t host_mem_alloc_count(void);
+
+#endif
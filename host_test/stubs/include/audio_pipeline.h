@@ -0,0 +1,65 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF audio pipeline */
+#ifndef _HOST_AUDIO_PIPELINE_H_
+#define _HOST_AUDIO_PIPELINE_H_
+
+#include "audio_element.h"
+
+typedef struct audio_pipeline *audio_pipeline_handle_t;
+
+typedef struct {
+    int rb_size;
+} audio_pipeline_cfg_t;
+
+#define DEFAULT_PIPELINE_RINGBUF_SIZE   (8*1024)
+
+#define DEFAULT_AUDIO_PIPELINE_CONFIG() {       \
+    .rb_size = DEFAULT_PIPELINE_RINGBUF_SIZE,   \
+}
+
+audio_pipeline_handle_t audio_pipeline_init(audio_pipeline_cfg_t *config);
+esp_err_t audio_pipeline_deinit(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_register(audio_pipeline_handle_t pipeline, audio_element_handle_t el, const char *name);
+esp_err_t audio_pipeline_unregister(audio_pipeline_handle_t pipeline, audio_element_handle_t el);
+esp_err_t audio_pipeline_link(audio_pipeline_handle_t pipeline, const char *link_tag[], int link_num);
+esp_err_t audio_pipeline_unlink(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_breakup_elements(audio_pipeline_handle_t pipeline, audio_element_handle_t kept_ctx_el);
+esp_err_t audio_pipeline_relink(audio_pipeline_handle_t pipeline, const char *link_tag[], int link_num);
+audio_element_handle_t audio_pipeline_get_el_by_tag(audio_pipeline_handle_t pipeline, const char *tag);
+esp_err_t audio_pipeline_run(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_stop(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_wait_for_stop(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_wait_for_stop_with_ticks(audio_pipeline_handle_t pipeline, TickType_t ticks_to_wait);
+esp_err_t audio_pipeline_terminate(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_pause(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_resume(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_reset_items_state(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_reset_ringbuffer(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_reset_elements(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_set_listener(audio_pipeline_handle_t pipeline, audio_event_iface_handle_t listener);
+esp_err_t audio_pipeline_remove_listener(audio_pipeline_handle_t pipeline);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for ESP-TLS. There is no TLS on the host: connections are plain TCP, to the
+ * port set with host_net_redirect() when there is one (host_stub.h) */
+#ifndef _HOST_ESP_TLS_H_
+#define _HOST_ESP_TLS_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+#define ESP_TLS_ERR_SSL_WANT_READ   -0x6900
+#define ESP_TLS_ERR_SSL_WANT_WRITE  -0x6880
+
+typedef struct esp_tls_client_session {
+    int id;
+} esp_tls_client_session_t;
+
+typedef struct esp_tls {
+    int sockfd;
+} esp_tls_t;
+
+typedef struct {
+    const char                  **alpn_protos;
+    const unsigned char         *cacert_buf;
+    unsigned int                cacert_bytes;
+    int                         timeout_ms;
+    bool                        non_block;
+    bool                        skip_common_name;
+    const char                  *common_name;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    esp_tls_client_session_t    *client_session;
+} esp_tls_cfg_t;
+
+esp_tls_t *esp_tls_init(void);
+int esp_tls_conn_new_sync(const char *hostname, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_t *tls);
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen);
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen);
+int esp_tls_conn_destroy(esp_tls_t *tls);
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls, int *sockfd);
+esp_tls_client_session_t *esp_tls_get_client_session(esp_tls_t *tls);
+void esp_tls_free_client_session(esp_tls_client_session_t *client_session);
+
+#endif
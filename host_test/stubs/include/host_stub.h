@@ -0,0 +1,101 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Test-side controls of the host stand-ins */
+#ifndef _HOST_STUB_H_
+#define _HOST_STUB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Network: connections of the HTTP client and ESP-TLS stand-ins go to this port of 127.0.0.1
+ * whatever the host, 0 to resolve the host */
+void host_net_redirect(int port);
+
+/* ESP-TLS: a session ticket is resumed until the sessions are forgotten, any other connection is a
+ * full handshake that runs the certificate check */
+void host_tls_forget_sessions(void);
+int host_tls_full_handshakes(void);
+
+/* A server on 127.0.0.1, each connection is handled in its own thread */
+typedef struct host_server host_server_t;
+typedef void (*host_server_handler_t)(int fd, void *ctx);
+
+host_server_t *host_server_start(host_server_handler_t handler, void *ctx);
+int host_server_port(host_server_t *server);
+int host_server_connections(host_server_t *server);
+void host_server_stop(host_server_t *server);
+
+/* One HTTP/1.1 request as received: the raw bytes, and the body without the framing */
+typedef struct {
+    char    *raw;
+    int     raw_len;
+    int     head_len;       /* Request line and headers, the blank line included */
+    char    *body;
+    int     body_len;
+    bool    chunked;
+    int     content_length; /* -1 without Content-Length */
+    int     chunks;         /* Chunks of a chunked body, the last chunk not counted */
+} host_http_request_t;
+
+int host_http_read_request(int fd, host_http_request_t *req);
+bool host_http_header(const host_http_request_t *req, const char *name, char *value, int size);
+void host_http_request_free(host_http_request_t *req);
+int host_send_all(int fd, const void *buf, int len);
+/* Send `body` as a 200 response, chunked in pieces of `chunk` bytes, or with a length if 0 */
+int host_http_respond(int fd, const char *content_type, const void *body, int len, int chunk);
+
+/* I2S: the reader plays `pcm` then silence, the writer collects what is played. With `realtime`
+ * they run at the clock rate, else as fast as the pipeline goes */
+void host_i2s_set_capture(const int16_t *pcm, int samples, bool realtime);
+void host_i2s_set_playback_realtime(bool realtime);
+int host_i2s_playback(const int16_t **pcm);
+void host_i2s_reset_playback(void);
+void host_i2s_get_clk(int *rate, int *bits, int *ch);
+
+/* Decoders are pass-through, they report this stream info */
+void host_decoder_set_info(int sample_rate, int channels);
+
+/* Flash partitions, erased on creation */
+void host_partition_add(const char *label, uint32_t size);
+void host_partition_remove_all(void);
+
+/* HTTP/2: the scripted peer. Events are handed to the session in order, on its next receive, once
+ * their gate opens: at once, or once the request body has ended */
+typedef enum {
+    HOST_H2_NOW,
+    HOST_H2_AFTER_EOF,
+} host_h2_gate_t;
+
+void host_h2_reset(void);
+void host_h2_header(host_h2_gate_t gate, int32_t stream_id, const char *name, const char *value);
+void host_h2_data(host_h2_gate_t gate, int32_t stream_id, const void *data, int len);
+void host_h2_close(host_h2_gate_t gate, int32_t stream_id, uint32_t error_code);
+void host_h2_goaway(host_h2_gate_t gate);
+/* Request body written on the last submitted stream, and its header values */
+int host_h2_request_body(const uint8_t **data);
+const char *host_h2_request_header(const char *name);
+int host_h2_requests(void);
+
+#endif
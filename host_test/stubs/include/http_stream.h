@@ -0,0 +1,86 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF HTTP stream, it opens, writes and reads through the
+ * esp_http_client stand-in and calls the event hooks at the same points as the real one */
+#ifndef _HOST_HTTP_STREAM_H_
+#define _HOST_HTTP_STREAM_H_
+
+#include "audio_element.h"
+#include "audio_common.h"
+
+typedef enum {
+    HTTP_STREAM_PRE_REQUEST = 0x01,
+    HTTP_STREAM_ON_REQUEST,
+    HTTP_STREAM_ON_RESPONSE,
+    HTTP_STREAM_POST_REQUEST,
+    HTTP_STREAM_FINISH_REQUEST,
+    HTTP_STREAM_RESOLVE_ALL_TRACKS,
+    HTTP_STREAM_FINISH_TRACK,
+    HTTP_STREAM_FINISH_PLAYLIST,
+} http_stream_event_id_t;
+
+typedef struct {
+    http_stream_event_id_t  event_id;
+    void                    *http_client;
+    void                    *buffer;
+    int                     buffer_len;
+    void                    *user_data;
+    audio_element_handle_t  el;
+} http_stream_event_msg_t;
+
+typedef int (*http_stream_event_handle_t)(http_stream_event_msg_t *msg);
+
+typedef struct {
+    audio_stream_type_t         type;
+    int                         out_rb_size;
+    int                         task_stack;
+    int                         task_core;
+    int                         task_prio;
+    bool                        stack_in_ext;
+    http_stream_event_handle_t  event_handle;
+    void                        *user_data;
+    bool                        auto_connect_next_track;
+    bool                        enable_playlist_parser;
+    int                         multi_out_num;
+    const char                  *cert_pem;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+} http_stream_cfg_t;
+
+#define HTTP_STREAM_TASK_STACK          (6 * 1024)
+#define HTTP_STREAM_TASK_CORE           (0)
+#define HTTP_STREAM_TASK_PRIO           (4)
+#define HTTP_STREAM_RINGBUFFER_SIZE     (20 * 1024)
+
+#define HTTP_STREAM_CFG_DEFAULT() {                 \
+    .type = AUDIO_STREAM_READER,                    \
+    .out_rb_size = HTTP_STREAM_RINGBUFFER_SIZE,     \
+    .task_stack = HTTP_STREAM_TASK_STACK,           \
+    .task_core = HTTP_STREAM_TASK_CORE,             \
+    .task_prio = HTTP_STREAM_TASK_PRIO,             \
+}
+
+audio_element_handle_t http_stream_init(http_stream_cfg_t *config);
+
+#endif
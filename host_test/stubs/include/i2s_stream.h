@@ -0,0 +1,83 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF I2S stream: the reader plays back the capture set with
+ * host_i2s_set_capture(), the writer collects what is played (host_stub.h) */
+#ifndef _HOST_I2S_STREAM_H_
+#define _HOST_I2S_STREAM_H_
+
+#include "audio_element.h"
+#include "audio_common.h"
+
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT = 0,
+    I2S_CHANNEL_FMT_ALL_RIGHT,
+    I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT,
+    I2S_CHANNEL_FMT_ONLY_LEFT,
+} i2s_channel_fmt_t;
+
+typedef struct {
+    int                 sample_rate;
+    int                 bits_per_sample;
+    i2s_channel_fmt_t   channel_format;
+} i2s_config_t;
+
+typedef struct {
+    audio_stream_type_t type;
+    i2s_config_t        i2s_config;
+    int                 i2s_port;
+    bool                use_alc;
+    int                 volume;
+    int                 out_rb_size;
+    int                 task_stack;
+    int                 task_core;
+    int                 task_prio;
+    bool                stack_in_ext;
+    int                 buffer_len;
+} i2s_stream_cfg_t;
+
+#define I2S_STREAM_TASK_STACK           (3072)
+#define I2S_STREAM_BUF_SIZE             (2048)
+#define I2S_STREAM_TASK_PRIO            (23)
+#define I2S_STREAM_RINGBUFFER_SIZE      (8 * 1024)
+
+#define I2S_STREAM_CFG_DEFAULT() {                      \
+    .type = AUDIO_STREAM_WRITER,                        \
+    .i2s_config = {                                     \
+        .sample_rate = 44100,                           \
+        .bits_per_sample = 16,                          \
+        .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,   \
+    },                                                  \
+    .i2s_port = 0,                                      \
+    .out_rb_size = I2S_STREAM_RINGBUFFER_SIZE,          \
+    .task_stack = I2S_STREAM_TASK_STACK,                \
+    .task_prio = I2S_STREAM_TASK_PRIO,                  \
+    .buffer_len = I2S_STREAM_BUF_SIZE,                  \
+}
+
+audio_element_handle_t i2s_stream_init(i2s_stream_cfg_t *config);
+esp_err_t i2s_stream_set_clk(audio_element_handle_t i2s_stream, int rate, int bits, int ch);
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the nghttp2 client API. There is no HTTP/2 framing: the peer is scripted in
+ * process with host_h2_*() (host_stub.h), which queue the headers, DATA chunks and stream closes
+ * the session hands to the callbacks, with the stream ids and chunk boundaries the test picks.
+ * What the data providers produce is written to the socket as it is, and recorded */
+#ifndef _HOST_NGHTTP2_H_
+#define _HOST_NGHTTP2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define NGHTTP2_ERR_WOULDBLOCK          -504
+#define NGHTTP2_ERR_EOF                 -507
+#define NGHTTP2_ERR_DEFERRED            -508
+#define NGHTTP2_ERR_CALLBACK_FAILURE    -902
+
+#define NGHTTP2_DATA_FLAG_NONE          0x00
+#define NGHTTP2_DATA_FLAG_EOF           0x01
+
+#define NGHTTP2_FLAG_NONE               0x00
+#define NGHTTP2_FLAG_END_STREAM         0x01
+#define NGHTTP2_NV_FLAG_NONE            0x00
+
+typedef enum {
+    NGHTTP2_DATA = 0,
+    NGHTTP2_HEADERS = 0x01,
+} nghttp2_frame_type;
+
+typedef struct nghttp2_session nghttp2_session;
+typedef struct nghttp2_session_callbacks nghttp2_session_callbacks;
+
+typedef struct {
+    uint8_t *name;
+    uint8_t *value;
+    size_t  namelen;
+    size_t  valuelen;
+    uint8_t flags;
+} nghttp2_nv;
+
+typedef struct {
+    size_t  length;
+    int32_t stream_id;
+    uint8_t type;
+    uint8_t flags;
+    uint8_t reserved;
+} nghttp2_frame_hd;
+
+typedef union {
+    nghttp2_frame_hd hd;
+} nghttp2_frame;
+
+typedef struct {
+    int32_t     settings_id;
+    uint32_t    value;
+} nghttp2_settings_entry;
+
+typedef union {
+    int     fd;
+    void    *ptr;
+} nghttp2_data_source;
+
+typedef ssize_t (*nghttp2_data_source_read_callback)(nghttp2_session *session, int32_t stream_id, uint8_t *buf,
+        size_t length, uint32_t *data_flags, nghttp2_data_source *source, void *user_data);
+
+typedef struct {
+    nghttp2_data_source                 source;
+    nghttp2_data_source_read_callback   read_callback;
+} nghttp2_data_provider;
+
+typedef ssize_t (*nghttp2_send_callback)(nghttp2_session *session, const uint8_t *data, size_t length, int flags,
+        void *user_data);
+typedef ssize_t (*nghttp2_recv_callback)(nghttp2_session *session, uint8_t *buf, size_t length, int flags,
+        void *user_data);
+typedef int (*nghttp2_on_data_chunk_recv_callback)(nghttp2_session *session, uint8_t flags, int32_t stream_id,
+        const uint8_t *data, size_t len, void *user_data);
+typedef int (*nghttp2_on_header_callback)(nghttp2_session *session, const nghttp2_frame *frame, const uint8_t *name,
+        size_t namelen, const uint8_t *value, size_t valuelen, uint8_t flags, void *user_data);
+typedef int (*nghttp2_on_stream_close_callback)(nghttp2_session *session, int32_t stream_id, uint32_t error_code,
+        void *user_data);
+
+int nghttp2_session_callbacks_new(nghttp2_session_callbacks **callbacks_ptr);
+void nghttp2_session_callbacks_del(nghttp2_session_callbacks *callbacks);
+void nghttp2_session_callbacks_set_send_callback(nghttp2_session_callbacks *cbs, nghttp2_send_callback send_callback);
+void nghttp2_session_callbacks_set_recv_callback(nghttp2_session_callbacks *cbs, nghttp2_recv_callback recv_callback);
+void nghttp2_session_callbacks_set_on_data_chunk_recv_callback(nghttp2_session_callbacks *cbs,
+        nghttp2_on_data_chunk_recv_callback on_data_chunk_recv_callback);
+void nghttp2_session_callbacks_set_on_header_callback(nghttp2_session_callbacks *cbs,
+        nghttp2_on_header_callback on_header_callback);
+void nghttp2_session_callbacks_set_on_stream_close_callback(nghttp2_session_callbacks *cbs,
+        nghttp2_on_stream_close_callback on_stream_close_callback);
+
+int nghttp2_session_client_new(nghttp2_session **session_ptr, const nghttp2_session_callbacks *callbacks, void *user_data);
+void nghttp2_session_del(nghttp2_session *session);
+int nghttp2_session_set_user_data(nghttp2_session *session, void *user_data);
+int nghttp2_session_send(nghttp2_session *session);
+int nghttp2_session_recv(nghttp2_session *session);
+int nghttp2_session_resume_data(nghttp2_session *session, int32_t stream_id);
+int nghttp2_session_check_request_allowed(nghttp2_session *session);
+int nghttp2_submit_settings(nghttp2_session *session, uint8_t flags, const nghttp2_settings_entry *iv, size_t niv);
+int32_t nghttp2_submit_request(nghttp2_session *session, const void *pri_spec, const nghttp2_nv *nva, size_t nvlen,
+                               const nghttp2_data_provider *data_prd, void *stream_user_data);
+const char *nghttp2_strerror(int lib_error_code);
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF Opus decoder, a pass-through as the MP3 one */
+#ifndef _HOST_OPUS_DECODER_H_
+#define _HOST_OPUS_DECODER_H_
+
+#include "audio_element.h"
+
+typedef struct {
+    int     out_rb_size;
+    int     task_stack;
+    int     task_core;
+    int     task_prio;
+    bool    stack_in_ext;
+} opus_decoder_cfg_t;
+
+#define DEFAULT_OPUS_DECODER_CONFIG() { \
+    .out_rb_size = (8 * 1024),          \
+    .task_stack = (30 * 1024),          \
+    .task_core = 0,                     \
+    .task_prio = 5,                     \
+}
+
+audio_element_handle_t decoder_opus_init(opus_decoder_cfg_t *config);
+
+#endif
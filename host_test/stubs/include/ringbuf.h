@@ -0,0 +1,53 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF ring buffer: reads and writes block until the whole length is
+ * done, or the buffer is done, aborted or the wait times out */
+#ifndef _HOST_RINGBUF_H_
+#define _HOST_RINGBUF_H_
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#define RB_OK                       (ESP_OK)
+#define RB_FAIL                     (ESP_FAIL)
+#define RB_DONE                     (-2)
+#define RB_ABORT                    (-3)
+#define RB_TIMEOUT                  (-4)
+
+typedef struct ringbuf *ringbuf_handle_t;
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks);
+esp_err_t rb_destroy(ringbuf_handle_t rb);
+esp_err_t rb_abort(ringbuf_handle_t rb);
+esp_err_t rb_reset(ringbuf_handle_t rb);
+int rb_bytes_available(ringbuf_handle_t rb);
+int rb_bytes_filled(ringbuf_handle_t rb);
+int rb_get_size(ringbuf_handle_t rb);
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait);
+int rb_write(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait);
+esp_err_t rb_done_write(ringbuf_handle_t rb);
+esp_err_t rb_unblock_reader(ringbuf_handle_t rb);
+
+#endif
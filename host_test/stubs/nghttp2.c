@@ -0,0 +1,400 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the nghttp2 client session, talking to the scripted peer of host_stub.h */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nghttp2/nghttp2.h"
+#include "host_stub.h"
+
+#define H2_EVENT_MAX    256
+#define H2_HEADER_MAX   16
+#define H2_TX_CHUNK     4096
+
+typedef enum {
+    EV_HEADER,
+    EV_DATA,
+    EV_CLOSE,
+    EV_GOAWAY,
+} ev_type_t;
+
+typedef struct {
+    ev_type_t       type;
+    host_h2_gate_t  gate;
+    int32_t         stream_id;
+    char            *name;
+    uint8_t         *data;
+    int             len;
+    uint32_t        error_code;
+} h2_event_t;
+
+struct nghttp2_session_callbacks {
+    nghttp2_send_callback                send;
+    nghttp2_recv_callback                recv;
+    nghttp2_on_data_chunk_recv_callback  on_data_chunk_recv;
+    nghttp2_on_header_callback           on_header;
+    nghttp2_on_stream_close_callback     on_stream_close;
+};
+
+struct nghttp2_session {
+    nghttp2_session_callbacks   cbs;
+    void                        *user_data;
+    int32_t                     next_stream_id;
+    int32_t                     stream_id;      /* The request being sent, 0 when there is none */
+    nghttp2_data_provider       provider;
+    bool                        deferred;
+    bool                        eof;
+    bool                        goaway;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static h2_event_t s_events[H2_EVENT_MAX];
+static int s_event_num;
+static int s_event_next;
+static uint8_t *s_body;
+static int s_body_len;
+static char *s_hdr_name[H2_HEADER_MAX];
+static char *s_hdr_value[H2_HEADER_MAX];
+static int s_hdr_num;
+static int s_requests;
+
+void host_h2_reset(void)
+{
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < s_event_num; i++) {
+        free(s_events[i].name);
+        free(s_events[i].data);
+    }
+    s_event_num = 0;
+    s_event_next = 0;
+    free(s_body);
+    s_body = NULL;
+    s_body_len = 0;
+    for (int i = 0; i < s_hdr_num; i++) {
+        free(s_hdr_name[i]);
+        free(s_hdr_value[i]);
+    }
+    s_hdr_num = 0;
+    s_requests = 0;
+    pthread_mutex_unlock(&s_lock);
+}
+
+static h2_event_t *_add(ev_type_t type, host_h2_gate_t gate, int32_t stream_id)
+{
+    if (s_event_num == H2_EVENT_MAX) {
+        abort();
+    }
+    h2_event_t *ev = &s_events[s_event_num++];
+    memset(ev, 0, sizeof(*ev));
+    ev->type = type;
+    ev->gate = gate;
+    ev->stream_id = stream_id;
+    return ev;
+}
+
+void host_h2_header(host_h2_gate_t gate, int32_t stream_id, const char *name, const char *value)
+{
+    pthread_mutex_lock(&s_lock);
+    h2_event_t *ev = _add(EV_HEADER, gate, stream_id);
+    ev->name = strdup(name);
+    ev->data = (uint8_t *)strdup(value);
+    ev->len = strlen(value);
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_h2_data(host_h2_gate_t gate, int32_t stream_id, const void *data, int len)
+{
+    pthread_mutex_lock(&s_lock);
+    h2_event_t *ev = _add(EV_DATA, gate, stream_id);
+    ev->data = malloc(len > 0 ? len : 1);
+    memcpy(ev->data, data, len);
+    ev->len = len;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_h2_close(host_h2_gate_t gate, int32_t stream_id, uint32_t error_code)
+{
+    pthread_mutex_lock(&s_lock);
+    _add(EV_CLOSE, gate, stream_id)->error_code = error_code;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_h2_goaway(host_h2_gate_t gate)
+{
+    pthread_mutex_lock(&s_lock);
+    _add(EV_GOAWAY, gate, 0);
+    pthread_mutex_unlock(&s_lock);
+}
+
+int host_h2_request_body(const uint8_t **data)
+{
+    pthread_mutex_lock(&s_lock);
+    *data = s_body;
+    int len = s_body_len;
+    pthread_mutex_unlock(&s_lock);
+    return len;
+}
+
+const char *host_h2_request_header(const char *name)
+{
+    const char *value = NULL;
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < s_hdr_num; i++) {
+        if (strcmp(s_hdr_name[i], name) == 0) {
+            value = s_hdr_value[i];
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return value;
+}
+
+int host_h2_requests(void)
+{
+    pthread_mutex_lock(&s_lock);
+    int n = s_requests;
+    pthread_mutex_unlock(&s_lock);
+    return n;
+}
+
+int nghttp2_session_callbacks_new(nghttp2_session_callbacks **callbacks_ptr)
+{
+    *callbacks_ptr = calloc(1, sizeof(nghttp2_session_callbacks));
+    return *callbacks_ptr ? 0 : -1;
+}
+
+void nghttp2_session_callbacks_del(nghttp2_session_callbacks *callbacks)
+{
+    free(callbacks);
+}
+
+void nghttp2_session_callbacks_set_send_callback(nghttp2_session_callbacks *cbs, nghttp2_send_callback send_callback)
+{
+    cbs->send = send_callback;
+}
+
+void nghttp2_session_callbacks_set_recv_callback(nghttp2_session_callbacks *cbs, nghttp2_recv_callback recv_callback)
+{
+    cbs->recv = recv_callback;
+}
+
+void nghttp2_session_callbacks_set_on_data_chunk_recv_callback(nghttp2_session_callbacks *cbs,
+        nghttp2_on_data_chunk_recv_callback on_data_chunk_recv_callback)
+{
+    cbs->on_data_chunk_recv = on_data_chunk_recv_callback;
+}
+
+void nghttp2_session_callbacks_set_on_header_callback(nghttp2_session_callbacks *cbs,
+        nghttp2_on_header_callback on_header_callback)
+{
+    cbs->on_header = on_header_callback;
+}
+
+void nghttp2_session_callbacks_set_on_stream_close_callback(nghttp2_session_callbacks *cbs,
+        nghttp2_on_stream_close_callback on_stream_close_callback)
+{
+    cbs->on_stream_close = on_stream_close_callback;
+}
+
+int nghttp2_session_client_new(nghttp2_session **session_ptr, const nghttp2_session_callbacks *callbacks, void *user_data)
+{
+    nghttp2_session *session = calloc(1, sizeof(nghttp2_session));
+    if (session == NULL) {
+        return -1;
+    }
+    session->cbs = *callbacks;
+    session->user_data = user_data;
+    session->next_stream_id = 1;
+    *session_ptr = session;
+    return 0;
+}
+
+void nghttp2_session_del(nghttp2_session *session)
+{
+    free(session);
+}
+
+int nghttp2_session_set_user_data(nghttp2_session *session, void *user_data)
+{
+    session->user_data = user_data;
+    return 0;
+}
+
+static int _send_all(nghttp2_session *session, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = session->cbs.send(session, data, len, 0, session->user_data);
+        if (n == NGHTTP2_ERR_WOULDBLOCK) {
+            continue;
+        }
+        if (n < 0) {
+            return NGHTTP2_ERR_CALLBACK_FAILURE;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int nghttp2_session_send(nghttp2_session *session)
+{
+    uint8_t buf[H2_TX_CHUNK];
+    while (session->stream_id && !session->deferred && !session->eof) {
+        uint32_t flags = NGHTTP2_DATA_FLAG_NONE;
+        ssize_t n = session->provider.read_callback(session, session->stream_id, buf, sizeof(buf), &flags,
+                    &session->provider.source, session->user_data);
+        if (n == NGHTTP2_ERR_DEFERRED) {
+            session->deferred = true;
+            break;
+        }
+        if (n < 0) {
+            return NGHTTP2_ERR_CALLBACK_FAILURE;
+        }
+        if (n > 0) {
+            if (_send_all(session, buf, n) != 0) {
+                return NGHTTP2_ERR_CALLBACK_FAILURE;
+            }
+            pthread_mutex_lock(&s_lock);
+            s_body = realloc(s_body, s_body_len + n);
+            memcpy(s_body + s_body_len, buf, n);
+            s_body_len += n;
+            pthread_mutex_unlock(&s_lock);
+        }
+        if (flags & NGHTTP2_DATA_FLAG_EOF) {
+            session->eof = true;
+        }
+    }
+    return 0;
+}
+
+int nghttp2_session_recv(nghttp2_session *session)
+{
+    uint8_t buf[1024];
+    while (1) {
+        ssize_t n = session->cbs.recv(session, buf, sizeof(buf), 0, session->user_data);
+        if (n == NGHTTP2_ERR_WOULDBLOCK) {
+            break;
+        }
+        if (n < 0) {
+            return (int)n;
+        }
+    }
+    while (1) {
+        pthread_mutex_lock(&s_lock);
+        if (s_event_next == s_event_num) {
+            pthread_mutex_unlock(&s_lock);
+            break;
+        }
+        h2_event_t ev = s_events[s_event_next];
+        /* Nothing arrives on a stream before its request was sent */
+        if ((ev.gate == HOST_H2_AFTER_EOF && !session->eof) || ev.stream_id >= session->next_stream_id) {
+            pthread_mutex_unlock(&s_lock);
+            break;
+        }
+        s_event_next++;
+        pthread_mutex_unlock(&s_lock);
+        int ret = 0;
+        if (ev.type == EV_HEADER && session->cbs.on_header) {
+            nghttp2_frame frame = { .hd = { .stream_id = ev.stream_id, .type = NGHTTP2_HEADERS } };
+            ret = session->cbs.on_header(session, &frame, (const uint8_t *)ev.name, strlen(ev.name), ev.data, ev.len,
+                                         NGHTTP2_NV_FLAG_NONE, session->user_data);
+        } else if (ev.type == EV_DATA && session->cbs.on_data_chunk_recv) {
+            ret = session->cbs.on_data_chunk_recv(session, NGHTTP2_FLAG_NONE, ev.stream_id, ev.data, ev.len,
+                                                  session->user_data);
+        } else if (ev.type == EV_CLOSE) {
+            if (ev.stream_id == session->stream_id) {
+                session->stream_id = 0;
+            }
+            if (session->cbs.on_stream_close) {
+                ret = session->cbs.on_stream_close(session, ev.stream_id, ev.error_code, session->user_data);
+            }
+        } else if (ev.type == EV_GOAWAY) {
+            session->goaway = true;
+        }
+        if (ret != 0) {
+            return NGHTTP2_ERR_CALLBACK_FAILURE;
+        }
+    }
+    return 0;
+}
+
+int nghttp2_session_resume_data(nghttp2_session *session, int32_t stream_id)
+{
+    if (stream_id != session->stream_id) {
+        return -501;
+    }
+    session->deferred = false;
+    return 0;
+}
+
+int nghttp2_session_check_request_allowed(nghttp2_session *session)
+{
+    return !session->goaway;
+}
+
+int nghttp2_submit_settings(nghttp2_session *session, uint8_t flags, const nghttp2_settings_entry *iv, size_t niv)
+{
+    return 0;
+}
+
+int32_t nghttp2_submit_request(nghttp2_session *session, const void *pri_spec, const nghttp2_nv *nva, size_t nvlen,
+                               const nghttp2_data_provider *data_prd, void *stream_user_data)
+{
+    if (session->goaway) {
+        return -1;
+    }
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < s_hdr_num; i++) {
+        free(s_hdr_name[i]);
+        free(s_hdr_value[i]);
+    }
+    s_hdr_num = 0;
+    for (size_t i = 0; i < nvlen && s_hdr_num < H2_HEADER_MAX; i++, s_hdr_num++) {
+        s_hdr_name[s_hdr_num] = strndup((const char *)nva[i].name, nva[i].namelen);
+        s_hdr_value[s_hdr_num] = strndup((const char *)nva[i].value, nva[i].valuelen);
+    }
+    free(s_body);
+    s_body = NULL;
+    s_body_len = 0;
+    s_requests++;
+    pthread_mutex_unlock(&s_lock);
+    session->stream_id = session->next_stream_id;
+    session->next_stream_id += 2;
+    session->provider = *data_prd;
+    session->deferred = false;
+    session->eof = false;
+    return session->stream_id;
+}
+
+const char *nghttp2_strerror(int lib_error_code)
+{
+    switch (lib_error_code) {
+        case NGHTTP2_ERR_EOF:
+            return "EOF";
+        case NGHTTP2_ERR_CALLBACK_FAILURE:
+            return "Callback failure";
+        default:
+            return "Unknown error";
+    }
+}
@@ -0,0 +1,240 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-in for the ESP-ADF ring buffer */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ringbuf.h"
+
+struct ringbuf {
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;
+    char            *buf;
+    int             size;
+    int             rd;
+    int             fill;
+    bool            done_write;
+    bool            abort_read;
+    bool            abort_write;
+    bool            unblock_reader;
+};
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks)
+{
+    struct ringbuf *rb = calloc(1, sizeof(struct ringbuf));
+    if (rb == NULL) {
+        return NULL;
+    }
+    rb->size = block_size * n_blocks;
+    rb->buf = malloc(rb->size);
+    if (rb->buf == NULL) {
+        free(rb);
+        return NULL;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&rb->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&rb->lock, NULL);
+    return rb;
+}
+
+esp_err_t rb_destroy(ringbuf_handle_t rb)
+{
+    if (rb == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_cond_destroy(&rb->changed);
+    pthread_mutex_destroy(&rb->lock);
+    free(rb->buf);
+    free(rb);
+    return ESP_OK;
+}
+
+esp_err_t rb_abort(ringbuf_handle_t rb)
+{
+    if (rb == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&rb->lock);
+    rb->abort_read = true;
+    rb->abort_write = true;
+    pthread_cond_broadcast(&rb->changed);
+    pthread_mutex_unlock(&rb->lock);
+    return ESP_OK;
+}
+
+esp_err_t rb_reset(ringbuf_handle_t rb)
+{
+    if (rb == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&rb->lock);
+    rb->rd = rb->fill = 0;
+    rb->done_write = rb->abort_read = rb->abort_write = rb->unblock_reader = false;
+    pthread_cond_broadcast(&rb->changed);
+    pthread_mutex_unlock(&rb->lock);
+    return ESP_OK;
+}
+
+int rb_bytes_available(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock(&rb->lock);
+    int n = rb->size - rb->fill;
+    pthread_mutex_unlock(&rb->lock);
+    return n;
+}
+
+int rb_bytes_filled(ringbuf_handle_t rb)
+{
+    if (rb == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&rb->lock);
+    int n = rb->fill;
+    pthread_mutex_unlock(&rb->lock);
+    return n;
+}
+
+int rb_get_size(ringbuf_handle_t rb)
+{
+    return rb->size;
+}
+
+/* false once the wait timed out */
+static bool _wait(ringbuf_handle_t rb, TickType_t ticks, struct timespec *deadline, bool *armed)
+{
+    if (ticks == 0) {
+        return false;
+    }
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(&rb->changed, &rb->lock);
+        return true;
+    }
+    if (!*armed) {
+        clock_gettime(CLOCK_MONOTONIC, deadline);
+        uint64_t ns = (uint64_t)ticks * portTICK_PERIOD_MS * 1000000ULL + deadline->tv_nsec;
+        deadline->tv_sec += ns / 1000000000ULL;
+        deadline->tv_nsec = ns % 1000000000ULL;
+        *armed = true;
+    }
+    return pthread_cond_timedwait(&rb->changed, &rb->lock, deadline) != ETIMEDOUT;
+}
+
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    bool armed = false;
+    int total = 0;
+    int ret = RB_OK;
+    pthread_mutex_lock(&rb->lock);
+    while (total < len) {
+        if (rb->abort_read) {
+            ret = RB_ABORT;
+            break;
+        }
+        if (rb->fill == 0) {
+            if (rb->done_write) {
+                ret = RB_DONE;
+                break;
+            }
+            if (rb->unblock_reader && total > 0) {
+                rb->unblock_reader = false;
+                break;
+            }
+            if (!_wait(rb, ticks_to_wait, &deadline, &armed)) {
+                ret = RB_TIMEOUT;
+                break;
+            }
+            continue;
+        }
+        int n = len - total < rb->fill ? len - total : rb->fill;
+        int first = rb->size - rb->rd < n ? rb->size - rb->rd : n;
+        memcpy(buf + total, rb->buf + rb->rd, first);
+        memcpy(buf + total + first, rb->buf, n - first);
+        rb->rd = (rb->rd + n) % rb->size;
+        rb->fill -= n;
+        total += n;
+        pthread_cond_broadcast(&rb->changed);
+    }
+    pthread_mutex_unlock(&rb->lock);
+    return total > 0 ? total : ret;
+}
+
+int rb_write(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    bool armed = false;
+    int total = 0;
+    int ret = RB_OK;
+    pthread_mutex_lock(&rb->lock);
+    while (total < len) {
+        if (rb->abort_write) {
+            ret = RB_ABORT;
+            break;
+        }
+        if (rb->fill == rb->size) {
+            if (!_wait(rb, ticks_to_wait, &deadline, &armed)) {
+                ret = RB_TIMEOUT;
+                break;
+            }
+            continue;
+        }
+        int n = len - total < rb->size - rb->fill ? len - total : rb->size - rb->fill;
+        int wr = (rb->rd + rb->fill) % rb->size;
+        int first = rb->size - wr < n ? rb->size - wr : n;
+        memcpy(rb->buf + wr, buf + total, first);
+        memcpy(rb->buf, buf + total + first, n - first);
+        rb->fill += n;
+        total += n;
+        pthread_cond_broadcast(&rb->changed);
+    }
+    pthread_mutex_unlock(&rb->lock);
+    return total > 0 ? total : ret;
+}
+
+esp_err_t rb_done_write(ringbuf_handle_t rb)
+{
+    if (rb == NULL) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&rb->lock);
+    rb->done_write = true;
+    pthread_cond_broadcast(&rb->changed);
+    pthread_mutex_unlock(&rb->lock);
+    return ESP_OK;
+}
+
+esp_err_t rb_unblock_reader(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock(&rb->lock);
+    rb->unblock_reader = true;
+    pthread_cond_broadcast(&rb->changed);
+    pthread_mutex_unlock(&rb->lock);
+    return ESP_OK;
+}
@@ -0,0 +1,570 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Host stand-ins for the ESP-ADF streams and codecs. The HTTP stream calls its hooks at the points
+ * the real one does, I2S plays a test capture and collects the playback, codecs pass through */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "http_stream.h"
+#include "i2s_stream.h"
+#include "raw_stream.h"
+#include "mp3_decoder.h"
+#include "opus_decoder.h"
+#include "opus_encoder.h"
+#include "host_stub.h"
+
+static const char *TAG = "HOST_STREAM";
+
+static int64_t _now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void _sleep_until(int64_t due_us)
+{
+    int64_t wait = due_us - _now_us();
+    if (wait > 0) {
+        struct timespec ts = { .tv_sec = wait / 1000000, .tv_nsec = (wait % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+/* ---- HTTP stream ---- */
+
+typedef struct {
+    audio_stream_type_t         type;
+    http_stream_event_handle_t  hook;
+    void                        *user_data;
+    esp_http_client_handle_t    client;
+    bool                        is_open;
+} http_stream_t;
+
+static int _dispatch_hook(audio_element_handle_t self, http_stream_event_id_t type, void *buffer, int buffer_len)
+{
+    http_stream_t *http = (http_stream_t *)audio_element_getdata(self);
+    http_stream_event_msg_t msg = {
+        .event_id = type,
+        .http_client = http->client,
+        .buffer = buffer,
+        .buffer_len = buffer_len,
+        .user_data = http->user_data,
+        .el = self,
+    };
+    if (http->hook) {
+        return http->hook(&msg);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _http_open(audio_element_handle_t self)
+{
+    http_stream_t *http = (http_stream_t *)audio_element_getdata(self);
+    if (http->is_open) {
+        ESP_LOGE(TAG, "Already opened");
+        return ESP_FAIL;
+    }
+    char *uri = audio_element_get_uri(self);
+    if (uri == NULL) {
+        ESP_LOGE(TAG, "Error open connection, uri = NULL");
+        return ESP_FAIL;
+    }
+    if (http->client == NULL) {
+        esp_http_client_config_t http_cfg = {
+            .url = uri,
+            .user_data = self,
+            .timeout_ms = 30 * 1000,
+        };
+        http->client = esp_http_client_init(&http_cfg);
+        if (http->client == NULL) {
+            return ESP_FAIL;
+        }
+    } else {
+        esp_http_client_set_url(http->client, uri);
+    }
+    if (_dispatch_hook(self, HTTP_STREAM_PRE_REQUEST, NULL, 0) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to process user callback");
+        return ESP_FAIL;
+    }
+    if (http->type == AUDIO_STREAM_WRITER) {
+        if (esp_http_client_open(http->client, -1) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open http stream");
+            return ESP_FAIL;
+        }
+        http->is_open = true;
+        return ESP_OK;
+    }
+    char *buffer = NULL;
+    int post_len = esp_http_client_get_post_field(http->client, &buffer);
+    if (esp_http_client_open(http->client, post_len) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open http stream");
+        return ESP_FAIL;
+    }
+    int wrlen = _dispatch_hook(self, HTTP_STREAM_ON_REQUEST, buffer, post_len);
+    if (wrlen < 0) {
+        ESP_LOGE(TAG, "Failed to process user callback");
+        return ESP_FAIL;
+    }
+    if (post_len && buffer && wrlen == 0) {
+        if (esp_http_client_write(http->client, buffer, post_len) <= 0) {
+            ESP_LOGE(TAG, "Failed to write data to http stream");
+            return ESP_FAIL;
+        }
+    }
+    if (_dispatch_hook(self, HTTP_STREAM_POST_REQUEST, NULL, 0) < 0) {
+        esp_http_client_close(http->client);
+        return ESP_FAIL;
+    }
+    int64_t total = esp_http_client_fetch_headers(http->client);
+    int status_code = esp_http_client_get_status_code(http->client);
+    if (status_code != 200 && status_code != 206) {
+        ESP_LOGE(TAG, "Invalid HTTP stream, status code = %d", status_code);
+        return ESP_FAIL;
+    }
+    audio_element_set_total_bytes(self, total);
+    http->is_open = true;
+    return ESP_OK;
+}
+
+static esp_err_t _http_close(audio_element_handle_t self)
+{
+    http_stream_t *http = (http_stream_t *)audio_element_getdata(self);
+    if (http->is_open && http->type == AUDIO_STREAM_WRITER) {
+        if (_dispatch_hook(self, HTTP_STREAM_POST_REQUEST, NULL, 0) < 0) {
+            ESP_LOGE(TAG, "Failed to process user callback");
+        } else if (audio_element_get_state(self) != AEL_STATE_PAUSED) {
+            /* As the real one, the response head is read before the hook reads the body */
+            esp_http_client_fetch_headers(http->client);
+            if (_dispatch_hook(self, HTTP_STREAM_FINISH_REQUEST, NULL, 0) < 0) {
+                ESP_LOGE(TAG, "Failed to process user callback");
+            }
+        }
+    }
+    http->is_open = false;
+    if (http->client) {
+        esp_http_client_close(http->client);
+        esp_http_client_cleanup(http->client);
+        http->client = NULL;
+    }
+    audio_element_set_byte_pos(self, 0);
+    return ESP_OK;
+}
+
+static int _http_read(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    http_stream_t *http = (http_stream_t *)audio_element_getdata(self);
+    int rlen = _dispatch_hook(self, HTTP_STREAM_ON_RESPONSE, buffer, len);
+    if (rlen == 0) {
+        rlen = esp_http_client_read(http->client, buffer, len);
+    }
+    if (rlen <= 0) {
+        ESP_LOGD(TAG, "No more data, rlen = %d", rlen);
+        return ESP_OK;
+    }
+    audio_element_update_byte_pos(self, rlen);
+    return rlen;
+}
+
+static int _http_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    http_stream_t *http = (http_stream_t *)audio_element_getdata(self);
+    int wrlen = _dispatch_hook(self, HTTP_STREAM_ON_REQUEST, buffer, len);
+    if (wrlen < 0) {
+        ESP_LOGE(TAG, "Failed to process user callback");
+        return ESP_FAIL;
+    }
+    if (wrlen > 0) {
+        return wrlen;
+    }
+    if ((wrlen = esp_http_client_write(http->client, buffer, len)) <= 0) {
+        ESP_LOGE(TAG, "Failed to write data to http stream, wrlen=%d", wrlen);
+    }
+    return wrlen;
+}
+
+static int _http_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (audio_element_is_stopping(self)) {
+        return AEL_IO_ABORT;
+    }
+    if (r_size > 0) {
+        return audio_element_output(self, in_buffer, r_size);
+    }
+    return r_size;
+}
+
+static esp_err_t _http_destroy(audio_element_handle_t self)
+{
+    http_stream_t *http = (http_stream_t *)audio_element_getdata(self);
+    if (http->client) {
+        esp_http_client_cleanup(http->client);
+    }
+    free(http);
+    return ESP_OK;
+}
+
+audio_element_handle_t http_stream_init(http_stream_cfg_t *config)
+{
+    http_stream_t *http = calloc(1, sizeof(http_stream_t));
+    if (http == NULL) {
+        return NULL;
+    }
+    http->type = config->type;
+    http->hook = config->event_handle;
+    http->user_data = config->user_data;
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _http_open;
+    cfg.close = _http_close;
+    cfg.process = _http_process;
+    cfg.destroy = _http_destroy;
+    cfg.task_stack = config->task_stack;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.tag = "http";
+    if (config->type == AUDIO_STREAM_WRITER) {
+        cfg.write = _http_write;
+    } else {
+        cfg.read = _http_read;
+    }
+    audio_element_handle_t el = audio_element_init(&cfg);
+    if (el == NULL) {
+        free(http);
+        return NULL;
+    }
+    audio_element_setdata(el, http);
+    return el;
+}
+
+/* ---- I2S stream ---- */
+
+static pthread_mutex_t s_i2s_lock = PTHREAD_MUTEX_INITIALIZER;
+static const int16_t *s_capture;
+static int s_capture_samples;
+static bool s_capture_realtime;
+static int16_t *s_playback;
+static int s_playback_samples;
+static int s_playback_cap;
+static bool s_playback_realtime;
+static int s_clk_rate = 44100, s_clk_bits = 16, s_clk_ch = 2;
+
+typedef struct {
+    audio_stream_type_t type;
+    int                 rate;
+    int                 bits;
+    int                 ch;
+    int                 pos;        /* Capture samples played */
+    int64_t             start_us;
+    int64_t             samples;    /* Samples since start_us */
+} i2s_stream_t;
+
+void host_i2s_set_capture(const int16_t *pcm, int samples, bool realtime)
+{
+    pthread_mutex_lock(&s_i2s_lock);
+    s_capture = pcm;
+    s_capture_samples = samples;
+    s_capture_realtime = realtime;
+    pthread_mutex_unlock(&s_i2s_lock);
+}
+
+void host_i2s_set_playback_realtime(bool realtime)
+{
+    s_playback_realtime = realtime;
+}
+
+int host_i2s_playback(const int16_t **pcm)
+{
+    pthread_mutex_lock(&s_i2s_lock);
+    *pcm = s_playback;
+    int samples = s_playback_samples;
+    pthread_mutex_unlock(&s_i2s_lock);
+    return samples;
+}
+
+void host_i2s_reset_playback(void)
+{
+    pthread_mutex_lock(&s_i2s_lock);
+    free(s_playback);
+    s_playback = NULL;
+    s_playback_samples = 0;
+    s_playback_cap = 0;
+    pthread_mutex_unlock(&s_i2s_lock);
+}
+
+void host_i2s_get_clk(int *rate, int *bits, int *ch)
+{
+    pthread_mutex_lock(&s_i2s_lock);
+    *rate = s_clk_rate;
+    *bits = s_clk_bits;
+    *ch = s_clk_ch;
+    pthread_mutex_unlock(&s_i2s_lock);
+}
+
+static esp_err_t _i2s_open(audio_element_handle_t self)
+{
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(self);
+    i2s->pos = 0;
+    i2s->start_us = _now_us();
+    i2s->samples = 0;
+    return ESP_OK;
+}
+
+static void _i2s_pace(i2s_stream_t *i2s, int samples)
+{
+    int frames_per_s = i2s->rate * i2s->ch;
+    i2s->samples += samples;
+    _sleep_until(i2s->start_us + i2s->samples * 1000000 / (frames_per_s > 0 ? frames_per_s : 1));
+}
+
+static int _i2s_read_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(self);
+    int16_t *pcm = (int16_t *)in_buffer;
+    int want = in_len / sizeof(int16_t);
+    pthread_mutex_lock(&s_i2s_lock);
+    int n = s_capture_samples - i2s->pos;
+    if (n > want) {
+        n = want;
+    }
+    if (n > 0) {
+        memcpy(pcm, s_capture + i2s->pos, n * sizeof(int16_t));
+        i2s->pos += n;
+    } else {
+        n = want;
+        memset(pcm, 0, n * sizeof(int16_t));
+    }
+    bool realtime = s_capture_realtime || i2s->pos >= s_capture_samples;
+    pthread_mutex_unlock(&s_i2s_lock);
+    if (realtime) {
+        _i2s_pace(i2s, n);
+    } else {
+        i2s->start_us = _now_us();
+        i2s->samples = 0;
+    }
+    int ret = audio_element_output(self, in_buffer, n * sizeof(int16_t));
+    if (audio_element_is_stopping(self)) {
+        return AEL_IO_ABORT;
+    }
+    return ret;
+}
+
+static int _i2s_write_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(self);
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    int n = r_size / sizeof(int16_t);
+    pthread_mutex_lock(&s_i2s_lock);
+    if (s_playback_samples + n > s_playback_cap) {
+        int cap = s_playback_cap ? s_playback_cap * 2 : 16384;
+        while (cap < s_playback_samples + n) {
+            cap *= 2;
+        }
+        s_playback = realloc(s_playback, cap * sizeof(int16_t));
+        s_playback_cap = cap;
+    }
+    memcpy(s_playback + s_playback_samples, in_buffer, n * sizeof(int16_t));
+    s_playback_samples += n;
+    pthread_mutex_unlock(&s_i2s_lock);
+    if (s_playback_realtime) {
+        _i2s_pace(i2s, n);
+    }
+    return r_size;
+}
+
+static esp_err_t _i2s_destroy(audio_element_handle_t self)
+{
+    free(audio_element_getdata(self));
+    return ESP_OK;
+}
+
+audio_element_handle_t i2s_stream_init(i2s_stream_cfg_t *config)
+{
+    i2s_stream_t *i2s = calloc(1, sizeof(i2s_stream_t));
+    if (i2s == NULL) {
+        return NULL;
+    }
+    i2s->type = config->type;
+    i2s->rate = config->i2s_config.sample_rate;
+    i2s->bits = config->i2s_config.bits_per_sample;
+    i2s->ch = config->i2s_config.channel_format < I2S_CHANNEL_FMT_ONLY_RIGHT ? 2 : 1;
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _i2s_open;
+    cfg.process = config->type == AUDIO_STREAM_READER ? _i2s_read_process : _i2s_write_process;
+    cfg.destroy = _i2s_destroy;
+    cfg.task_stack = config->task_stack;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.buffer_len = config->buffer_len;
+    cfg.tag = "iis";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    if (el == NULL) {
+        free(i2s);
+        return NULL;
+    }
+    audio_element_setdata(el, i2s);
+    audio_element_set_music_info(el, i2s->rate, i2s->ch, i2s->bits);
+    return el;
+}
+
+esp_err_t i2s_stream_set_clk(audio_element_handle_t i2s_stream, int rate, int bits, int ch)
+{
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(i2s_stream);
+    i2s->rate = rate;
+    i2s->bits = bits;
+    i2s->ch = ch;
+    i2s->start_us = _now_us();
+    i2s->samples = 0;
+    audio_element_set_music_info(i2s_stream, rate, ch, bits);
+    if (i2s->type == AUDIO_STREAM_WRITER) {
+        pthread_mutex_lock(&s_i2s_lock);
+        s_clk_rate = rate;
+        s_clk_bits = bits;
+        s_clk_ch = ch;
+        pthread_mutex_unlock(&s_i2s_lock);
+    }
+    return ESP_OK;
+}
+
+/* ---- Raw stream ---- */
+
+audio_element_handle_t raw_stream_init(raw_stream_cfg_t *config)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.task_stack = -1;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.tag = "raw";
+    return audio_element_init(&cfg);
+}
+
+int raw_stream_read(audio_element_handle_t pipeline, char *buffer, int buf_size)
+{
+    int ret = audio_element_input(pipeline, buffer, buf_size);
+    if (ret > 0) {
+        audio_element_update_byte_pos(pipeline, ret);
+    }
+    return ret;
+}
+
+int raw_stream_write(audio_element_handle_t pipeline, char *buffer, int buf_size)
+{
+    int ret = audio_element_output(pipeline, buffer, buf_size);
+    if (ret > 0) {
+        audio_element_update_byte_pos(pipeline, ret);
+    }
+    return ret;
+}
+
+/* ---- Codecs ---- */
+
+static int s_decoder_rate = 16000;
+static int s_decoder_channels = 1;
+
+typedef struct {
+    bool    reported;
+    bool    decoder;
+} codec_t;
+
+void host_decoder_set_info(int sample_rate, int channels)
+{
+    s_decoder_rate = sample_rate;
+    s_decoder_channels = channels;
+}
+
+static esp_err_t _codec_open(audio_element_handle_t self)
+{
+    codec_t *codec = (codec_t *)audio_element_getdata(self);
+    codec->reported = false;
+    return ESP_OK;
+}
+
+static int _codec_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    codec_t *codec = (codec_t *)audio_element_getdata(self);
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    if (codec->decoder && !codec->reported) {
+        /* The real decoders report the stream info once the first frame is parsed */
+        codec->reported = true;
+        audio_element_set_music_info(self, s_decoder_rate, s_decoder_channels, 16);
+        audio_element_report_info(self);
+    }
+    return audio_element_output(self, in_buffer, r_size);
+}
+
+static esp_err_t _codec_destroy(audio_element_handle_t self)
+{
+    free(audio_element_getdata(self));
+    return ESP_OK;
+}
+
+static audio_element_handle_t _codec_init(bool decoder, int out_rb_size, int task_stack, const char *tag)
+{
+    codec_t *codec = calloc(1, sizeof(codec_t));
+    if (codec == NULL) {
+        return NULL;
+    }
+    codec->decoder = decoder;
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _codec_open;
+    cfg.process = _codec_process;
+    cfg.destroy = _codec_destroy;
+    cfg.out_rb_size = out_rb_size;
+    cfg.task_stack = task_stack;
+    cfg.tag = tag;
+    audio_element_handle_t el = audio_element_init(&cfg);
+    if (el == NULL) {
+        free(codec);
+        return NULL;
+    }
+    audio_element_setdata(el, codec);
+    return el;
+}
+
+audio_element_handle_t mp3_decoder_init(mp3_decoder_cfg_t *config)
+{
+    return _codec_init(true, config->out_rb_size, config->task_stack, "mp3");
+}
+
+audio_element_handle_t decoder_opus_init(opus_decoder_cfg_t *config)
+{
+    return _codec_init(true, config->out_rb_size, config->task_stack, "opus");
+}
+
+audio_element_handle_t encoder_opus_init(opus_encoder_cfg_t *config)
+{
+    audio_element_handle_t el = _codec_init(false, config->out_rb_size, config->task_stack, "opus");
+    if (el) {
+        audio_element_set_music_info(el, config->sample_rate, config->channel, 16);
+    }
+    return el;
+}
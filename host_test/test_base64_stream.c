@@ -0,0 +1,149 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* base64_stream: RFC 4648 vectors and streamed input split at every position */
+#include "base64_stream.h"
+#include "test_util.h"
+#ifdef TEST_HAVE_MBEDTLS
+#include "mbedtls/base64.h"
+#endif
+
+static int _encode(const uint8_t *src, int len, const int *splits, int num_splits, char *dst)
+{
+    base64_enc_t enc;
+    base64_enc_init(&enc);
+    int o = 0, pos = 0;
+    for (int i = 0; i <= num_splits; i++) {
+        int end = i < num_splits ? splits[i] : len;
+        o += base64_enc_update(&enc, src + pos, end - pos, dst + o);
+        pos = end;
+    }
+    o += base64_enc_finish(&enc, dst + o);
+    dst[o] = 0;
+    return o;
+}
+
+static void test_rfc4648_vectors(void)
+{
+    static const char *vectors[][2] = {
+        { "", "" },
+        { "f", "Zg==" },
+        { "fo", "Zm8=" },
+        { "foo", "Zm9v" },
+        { "foob", "Zm9vYg==" },
+        { "fooba", "Zm9vYmE=" },
+        { "foobar", "Zm9vYmFy" },
+    };
+    char out[32];
+    for (int i = 0; i < (int)(sizeof(vectors) / sizeof(vectors[0])); i++) {
+        int len = strlen(vectors[i][0]);
+        CHECK_EQ(_encode((const uint8_t *)vectors[i][0], len, NULL, 0, out), strlen(vectors[i][1]));
+        CHECK_STR(out, vectors[i][1]);
+    }
+}
+
+static void test_split_everywhere(void)
+{
+    uint8_t src[64];
+    char ref[128], out[128];
+    for (int i = 0; i < (int)sizeof(src); i++) {
+        src[i] = (uint8_t)test_rand();
+    }
+    for (int len = 0; len <= (int)sizeof(src); len++) {
+        int ref_len = test_base64_ref(src, len, ref);
+        for (int a = 0; a <= len; a++) {
+            for (int b = a; b <= len; b += 5) {
+                int splits[2] = { a, b };
+                CHECK_EQ(_encode(src, len, splits, 2, out), ref_len);
+                CHECK_MEM(out, ref, ref_len);
+            }
+        }
+    }
+}
+
+static void test_fuzz(void)
+{
+    /* Random lengths, random pieces and misaligned output against the reference encoder */
+    static uint8_t src[4096];
+    static char ref[BASE64_ENC_MAX_OUT(4096)], out[BASE64_ENC_MAX_OUT(4096) + 8];
+    test_srand(2024);
+    for (int iter = 0; iter < 3000; iter++) {
+        int len = test_rand() % sizeof(src);
+        for (int i = 0; i < len; i++) {
+            src[i] = (uint8_t)test_rand();
+        }
+        int splits[16];
+        int num_splits = test_rand() % 16;
+        for (int i = 0; i < num_splits; i++) {
+            splits[i] = len ? test_rand() % (len + 1) : 0;
+            for (int j = i; j > 0 && splits[j] < splits[j - 1]; j--) {
+                int t = splits[j];
+                splits[j] = splits[j - 1];
+                splits[j - 1] = t;
+            }
+        }
+        int offset = test_rand() % 4;
+        int ref_len = test_base64_ref(src, len, ref);
+        CHECK_EQ(_encode(src, len, splits, num_splits, out + offset), ref_len);
+        CHECK_MEM(out + offset, ref, ref_len);
+#ifdef TEST_HAVE_MBEDTLS
+        /* mbedtls terminates its output */
+        static unsigned char mbed[BASE64_ENC_MAX_OUT(4096) + 1];
+        size_t mbed_len = 0;
+        CHECK_EQ(mbedtls_base64_encode(mbed, sizeof(mbed), &mbed_len, src, len), 0);
+        CHECK_EQ(mbed_len, ref_len);
+        CHECK_MEM(out + offset, mbed, mbed_len);
+#endif
+    }
+#ifndef TEST_HAVE_MBEDTLS
+    printf("mbedtls not available, checked against the test reference only\n");
+#endif
+}
+
+static void test_max_out(void)
+{
+    /* The largest output of one update, plus the finish, fits BASE64_ENC_MAX_OUT */
+    uint8_t src[300];
+    char out[BASE64_ENC_MAX_OUT(300) + 4];
+    memset(src, 0xff, sizeof(src));
+    for (int carry = 0; carry < 3; carry++) {
+        for (int len = 0; len <= 297; len++) {
+            base64_enc_t enc;
+            base64_enc_init(&enc);
+            base64_enc_update(&enc, src, carry, out);
+            int n = base64_enc_update(&enc, src, len, out);
+            n += base64_enc_finish(&enc, out + n);
+            CHECK(n <= BASE64_ENC_MAX_OUT(len));
+        }
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(test_rfc4648_vectors);
+    TEST_RUN(test_split_everywhere);
+    TEST_RUN(test_fuzz);
+    TEST_RUN(test_max_out);
+    return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* conn_pool: warm connections, session resumption and a concurrent start against a stand-in server */
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include "conn_pool.h"
+#include "host_stub.h"
+#include "test_util.h"
+
+#define INIT_THREADS    (8)
+#define INIT_ROUNDS     (20)
+
+/* Answers each "ping\n" with "pong\n" until the connection is closed */
+static void _echo_handler(int fd, void *ctx)
+{
+    char buf[5];
+    while (recv(fd, buf, sizeof(buf), MSG_WAITALL) == sizeof(buf)) {
+        if (host_send_all(fd, "pong\n", 5) != 5) {
+            break;
+        }
+    }
+}
+
+/* One request and its answer on the connection */
+static void _ping(conn_pool_conn_t *conn)
+{
+    char buf[5];
+    int n;
+    if (conn->tls) {
+        CHECK_EQ(esp_tls_conn_write(conn->tls, "ping\n", 5), 5);
+        for (n = 0; n < 5;) {
+            int r = esp_tls_conn_read(conn->tls, buf + n, 5 - n);
+            CHECK(r > 0);
+            n += r;
+        }
+    } else {
+        CHECK_EQ(send(conn->sock, "ping\n", 5, 0), 5);
+        CHECK_EQ(recv(conn->sock, buf, 5, MSG_WAITALL), 5);
+    }
+    CHECK_MEM(buf, "pong\n", 5);
+}
+
+/* The second request takes the first connection back, with no new handshake */
+static void test_warm_connection(void)
+{
+    host_server_t *server = host_server_start(_echo_handler, NULL);
+    CHECK(server);
+    host_net_redirect(host_server_port(server));
+    conn_pool_target_t target = { .host = "speech.googleapis.com", .port = 443 };
+    int full = host_tls_full_handshakes();
+
+    conn_pool_conn_t *conn = conn_pool_get(&target, 0);
+    CHECK(conn && conn->tls && !conn->reused);
+    _ping(conn);
+    conn_pool_put(conn, true);
+    conn = conn_pool_get(&target, 0);
+    CHECK(conn && conn->reused);
+    _ping(conn);
+    conn_pool_put(conn, true);
+
+    conn_pool_stats_t stats;
+    conn_pool_get_stats(&stats);
+    CHECK_EQ(stats.handshakes, 1);
+    CHECK_EQ(stats.reused, 1);
+    CHECK_EQ(stats.resumed, 0);
+    CHECK_EQ(host_tls_full_handshakes() - full, 1);
+    CHECK_EQ(host_server_connections(server), 1);
+    conn_pool_deinit();
+    host_server_stop(server);
+    host_net_redirect(0);
+}
+
+/* A new connection offers the saved ticket: resumed while the server knows it, a full handshake after */
+static void test_session_resumption(void)
+{
+    host_server_t *server = host_server_start(_echo_handler, NULL);
+    CHECK(server);
+    host_net_redirect(host_server_port(server));
+    conn_pool_target_t target = { .host = "speech.googleapis.com", .port = 443 };
+    int full = host_tls_full_handshakes();
+    conn_pool_stats_t stats;
+
+    for (int i = 0; i < 2; i++) {
+        conn_pool_conn_t *conn = conn_pool_get(&target, 0);
+        CHECK(conn && !conn->reused);
+        _ping(conn);
+        conn_pool_put(conn, false);
+    }
+    conn_pool_get_stats(&stats);
+    CHECK_EQ(stats.handshakes, 2);
+    CHECK_EQ(stats.resumed, 1);
+    CHECK_EQ(host_tls_full_handshakes() - full, 1);
+
+    /* The ticket is offered again, but the server has forgotten it */
+    host_tls_forget_sessions();
+    conn_pool_conn_t *conn = conn_pool_connect(&target, 0);
+    CHECK(conn);
+    _ping(conn);
+    conn_pool_put(conn, false);
+    conn_pool_get_stats(&stats);
+    CHECK_EQ(stats.handshakes, 3);
+    CHECK_EQ(stats.resumed, 1);
+    CHECK_EQ(host_tls_full_handshakes() - full, 2);
+    CHECK_EQ(host_server_connections(server), 3);
+    conn_pool_deinit();
+    host_server_stop(server);
+    host_net_redirect(0);
+}
+
+static pthread_barrier_t s_start;
+
+static void *_get_thread(void *arg)
+{
+    pthread_barrier_wait(&s_start);
+    conn_pool_conn_t *conn = conn_pool_get((const conn_pool_target_t *)arg, 0);
+    CHECK(conn);
+    _ping(conn);
+    conn_pool_put(conn, false);
+    return NULL;
+}
+
+/* Tasks that use the pool first at the same time all count in the same one */
+static void test_concurrent_init(void)
+{
+    host_server_t *server = host_server_start(_echo_handler, NULL);
+    CHECK(server);
+    conn_pool_target_t target = { .host = "127.0.0.1", .port = host_server_port(server), .plain_text = true };
+    for (int round = 0; round < INIT_ROUNDS; round++) {
+        pthread_t threads[INIT_THREADS];
+        pthread_barrier_init(&s_start, NULL, INIT_THREADS);
+        for (int i = 0; i < INIT_THREADS; i++) {
+            CHECK_EQ(pthread_create(&threads[i], NULL, _get_thread, &target), 0);
+        }
+        for (int i = 0; i < INIT_THREADS; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        pthread_barrier_destroy(&s_start);
+        conn_pool_stats_t stats;
+        conn_pool_get_stats(&stats);
+        CHECK_EQ(stats.handshakes, INIT_THREADS);
+        conn_pool_deinit();
+    }
+    CHECK_EQ(host_server_connections(server), INIT_ROUNDS * INIT_THREADS);
+    host_server_stop(server);
+}
+
+int main(void)
+{
+    TEST_RUN(test_warm_connection);
+    TEST_RUN(test_session_resumption);
+    TEST_RUN(test_concurrent_init);
+    return 0;
+}
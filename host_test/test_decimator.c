@@ -0,0 +1,109 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* decimator: output length, passband gain and stopband rejection */
+#include <math.h>
+#include "decimator.h"
+#include "test_util.h"
+
+#define SECONDS     (1)
+
+static double _rms(const int16_t *x, int n)
+{
+    double s = 0;
+    for (int i = 0; i < n; i++) {
+        s += (double)x[i] * x[i];
+    }
+    return sqrt(s / n);
+}
+
+/* Output rms over input rms for a tone, the filter start up skipped */
+static double _gain_at(int src_rate, int dst_rate, float freq, int chunk)
+{
+    int n = src_rate * SECONDS;
+    int16_t *in = malloc(n * sizeof(int16_t));
+    for (int i = 0; i < n; i++) {
+        in[i] = (int16_t)lrint(10000 * sin(2 * M_PI * freq * i / src_rate));
+    }
+    decimator_cfg_t cfg = { .src_rate = src_rate, .dst_rate = dst_rate };
+    audio_element_handle_t el = decimator_init(&cfg);
+    CHECK(el);
+    uint8_t *out;
+    int out_len = test_element_run(el, in, n * sizeof(int16_t), chunk, &out);
+    CHECK_EQ(out_len, n / (src_rate / dst_rate) * (int)sizeof(int16_t));
+    int skip = 200;
+    double gain = _rms((int16_t *)out + skip, out_len / 2 - skip) / _rms(in, n);
+    free(out);
+    free(in);
+    return gain;
+}
+
+static double _gain(float freq, int chunk)
+{
+    return _gain_at(48000, 16000, freq, chunk);
+}
+
+static void test_rejects_non_integer_ratio(void)
+{
+    decimator_cfg_t cfg = { .src_rate = 44100, .dst_rate = 16000 };
+    CHECK(decimator_init(&cfg) == NULL);
+}
+
+static void test_passband(void)
+{
+    double g = _gain(1000, 4096);
+    CHECK(g > 0.98 && g < 1.02);
+    g = _gain(3000, 333);           /* Odd pieces split samples */
+    CHECK(g > 0.95 && g < 1.05);
+}
+
+static void test_stopband(void)
+{
+    /* Would alias to 4 kHz and 2 kHz */
+    CHECK(_gain(12000, 4096) < 0.002);
+    CHECK(_gain(18000, 1001) < 0.002);
+}
+
+static void test_narrowband(void)
+{
+    /* Down to 8 kHz from the wideband and the codec rate: the telephone band up to 3 kHz is kept */
+    const int src_rates[] = { 16000, 48000 };
+    for (int i = 0; i < 2; i++) {
+        double g = _gain_at(src_rates[i], 8000, 300, 1001);
+        CHECK(g > 0.98 && g < 1.02);
+        g = _gain_at(src_rates[i], 8000, 3000, 4096);
+        CHECK(g > 0.95 && g < 1.05);
+        CHECK(_gain_at(src_rates[i], 8000, 6000, 4096) < 0.002);
+    }
+    CHECK(_gain_at(48000, 8000, 13000, 777) < 0.002);
+}
+
+int main(void)
+{
+    TEST_RUN(test_rejects_non_integer_ratio);
+    TEST_RUN(test_passband);
+    TEST_RUN(test_stopband);
+    TEST_RUN(test_narrowband);
+    return 0;
+}
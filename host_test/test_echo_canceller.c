@@ -0,0 +1,194 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* echo_canceller: echo return loss enhancement on near-end/far-end pairs, double talk and delayed paths */
+#include <math.h>
+#include "echo_canceller.h"
+#include "test_util.h"
+
+#define RATE        (16000)
+#define FRAME       (ECHO_CANCELLER_FRAME_SAMPLES)
+#define SECONDS     (5)
+#define SAMPLES     (RATE * SECONDS / FRAME * FRAME)
+
+/* Voiced speech at a pitch that changes every 250 ms, with some breath noise */
+static void _speech(int16_t *x, int n, float base_pitch, float level, uint32_t seed)
+{
+    test_srand(seed);
+    double phase = 0;
+    for (int i = 0; i < n; i++) {
+        double pitch = base_pitch + 30 * ((i / (RATE / 4)) % 5);
+        phase += 2 * M_PI * pitch / RATE;
+        double v = (int)(test_rand() % 201) - 100;
+        for (int h = 1; h * pitch < 3500; h++) {
+            v += level / h * sin(h * phase);
+        }
+        x[i] = (int16_t)lrint(v);
+    }
+}
+
+/* The loudspeaker to microphone path: a delay, then a decaying response, about -8 dB */
+static void _echo(const int16_t *far, int16_t *mic, int n, int delay)
+{
+    static const float h[] = { 0.3f, -0.15f, 0.1f, 0.05f, -0.04f, 0.02f, 0.01f };
+    for (int i = 0; i < n; i++) {
+        float y = 0;
+        for (int k = 0; k < (int)(sizeof(h) / sizeof(h[0])); k++) {
+            int j = i - delay - k * 3;
+            y += j >= 0 ? h[k] * far[j] : 0;
+        }
+        mic[i] = (int16_t)lrintf(y);
+    }
+}
+
+static double _power(const int16_t *x, int n)
+{
+    double s = 0;
+    for (int i = 0; i < n; i++) {
+        s += (double)x[i] * x[i];
+    }
+    return s / n + 1;
+}
+
+/* Echo return loss enhancement from `from` to `to` seconds */
+static double _erle(const int16_t *mic, const int16_t *out, double from, double to)
+{
+    int a = from * RATE, n = to * RATE - a;
+    return 10 * log10(_power(mic + a, n) / _power(out + a, n));
+}
+
+/* Run the microphone through the canceller with all of the far end buffered in advance */
+static int16_t *_cancel(const int16_t *mic, const int16_t *far, int n, int ref_delay_ms)
+{
+    echo_canceller_cfg_t cfg = {
+        .sample_rate = RATE,
+        .ref_delay_ms = ref_delay_ms,
+        .ref_buffer_ms = SECONDS * 1000 + 100,
+    };
+    audio_element_handle_t el = echo_canceller_init(&cfg);
+    CHECK(el);
+    if (far) {
+        CHECK_EQ(echo_canceller_feed_reference(el, far, n * sizeof(int16_t)), ESP_OK);
+    }
+    uint8_t *out;
+    CHECK_EQ(test_element_run(el, mic, n * sizeof(int16_t), 1000, &out), n * (int)sizeof(int16_t));
+    return (int16_t *)out;
+}
+
+static void test_echo_only(void)
+{
+    int16_t *far = malloc(SAMPLES * sizeof(int16_t));
+    int16_t *mic = malloc(SAMPLES * sizeof(int16_t));
+    _speech(far, SAMPLES, 120, 6000, 1);
+    _echo(far, mic, SAMPLES, RATE * 4 / 1000);
+    int16_t *out = _cancel(mic, far, SAMPLES, 0);
+    /* After the first second of convergence */
+    double erle = _erle(mic, out, 1, SECONDS);
+    printf("ERLE %.1f dB\n", erle);
+    CHECK(erle > 20);
+    free(out);
+    free(mic);
+    free(far);
+}
+
+static void test_double_talk(void)
+{
+    /* The user talks over the answer from 3 s to 4 s */
+    int16_t *far = malloc(SAMPLES * sizeof(int16_t));
+    int16_t *mic = malloc(SAMPLES * sizeof(int16_t));
+    int16_t *near = calloc(SAMPLES, sizeof(int16_t));
+    _speech(far, SAMPLES, 120, 6000, 1);
+    _echo(far, mic, SAMPLES, RATE * 4 / 1000);
+    _speech(near + 3 * RATE, RATE, 210, 6000, 2);
+    for (int i = 0; i < SAMPLES; i++) {
+        mic[i] += near[i];
+    }
+    int16_t *out = _cancel(mic, far, SAMPLES, 0);
+    /* The near end comes through with the echo still removed */
+    int16_t *residual = malloc(RATE * sizeof(int16_t));
+    for (int i = 0; i < RATE; i++) {
+        residual[i] = out[3 * RATE + i] - near[3 * RATE + i];
+    }
+    double echo_db = 10 * log10(_power(residual, RATE) / _power(near + 3 * RATE, RATE));
+    printf("echo under double talk %.1f dB below the near end\n", -echo_db);
+    CHECK(echo_db < -20);
+    /*
+     * The Geigel detector adapts on the first near-end samples below its threshold,
+     * the filter must stay useful after the talk and reconverge within half a second
+     */
+    printf("ERLE by half second:");
+    for (int s = 2; s < 2 * SECONDS; s++) {
+        printf(" %.1f", _erle(mic, out, s / 2.0, (s + 1) / 2.0));
+    }
+    printf("\n");
+    CHECK(_erle(mic, out, 2.5, 3) > 20);
+    CHECK(_erle(mic, out, 4, 4.5) > 10);
+    CHECK(_erle(mic, out, 4.5, 5) > 20);
+    free(residual);
+    free(out);
+    free(near);
+    free(mic);
+    free(far);
+}
+
+static void test_delayed_path(void)
+{
+    /* 60 ms of playback path is longer than the tail, the reference delay covers it */
+    int16_t *far = malloc(SAMPLES * sizeof(int16_t));
+    int16_t *mic = malloc(SAMPLES * sizeof(int16_t));
+    _speech(far, SAMPLES, 140, 6000, 3);
+    _echo(far, mic, SAMPLES, RATE * 60 / 1000);
+    int16_t *out = _cancel(mic, far, SAMPLES, 50);
+    double erle = _erle(mic, out, 1, SECONDS);
+    free(out);
+    /* Without it only the periodicity of the voice lets the filter guess some of the echo */
+    out = _cancel(mic, far, SAMPLES, 0);
+    double erle_undelayed = _erle(mic, out, 1, SECONDS);
+    printf("ERLE %.1f dB with the reference delay, %.1f dB without\n", erle, erle_undelayed);
+    CHECK(erle > 20);
+    CHECK(erle_undelayed < erle - 10);
+    free(out);
+    free(mic);
+    free(far);
+}
+
+static void test_no_far_end(void)
+{
+    /* Nothing playing: the microphone passes unchanged */
+    int16_t *mic = malloc(SAMPLES * sizeof(int16_t));
+    _speech(mic, SAMPLES, 180, 4000, 4);
+    int16_t *out = _cancel(mic, NULL, SAMPLES, 0);
+    CHECK_MEM(out, mic, SAMPLES * sizeof(int16_t));
+    free(out);
+    free(mic);
+}
+
+int main(void)
+{
+    TEST_RUN(test_echo_only);
+    TEST_RUN(test_double_talk);
+    TEST_RUN(test_delayed_path);
+    TEST_RUN(test_no_far_end);
+    return 0;
+}
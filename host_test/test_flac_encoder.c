@@ -0,0 +1,256 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* flac_encoder: the stream decodes back to the input, with valid frame CRCs */
+#include <math.h>
+#include "flac_encoder.h"
+#include "test_util.h"
+
+typedef struct {
+    const uint8_t   *buf;
+    int             len;
+    int             bit;    /* Position in bits */
+} bit_reader_t;
+
+static uint32_t _bits(bit_reader_t *br, int n)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < n; i++, br->bit++) {
+        CHECK(br->bit / 8 < br->len);
+        v = (v << 1) | ((br->buf[br->bit / 8] >> (7 - br->bit % 8)) & 1);
+    }
+    return v;
+}
+
+static int32_t _sbits(bit_reader_t *br, int n)
+{
+    uint32_t v = _bits(br, n);
+    return (int32_t)(v << (32 - n)) >> (32 - n);
+}
+
+static uint8_t _crc8(const uint8_t *data, int len)
+{
+    uint8_t crc = 0;
+    for (int i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t _crc16(const uint8_t *data, int len)
+{
+    uint16_t crc = 0;
+    for (int i = 0; i < len; i++) {
+        crc ^= data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static const int32_t fixed_coef[5][4] = {
+    { 0 }, { 1 }, { 2, -1 }, { 3, -3, 1 }, { 4, -6, 4, -1 },
+};
+
+/* Decode the frame at the reader, returns the samples */
+static int _decode_frame(bit_reader_t *br, int16_t *x, uint32_t frame_number, int sample_rate_code)
+{
+    int start = br->bit / 8;
+    CHECK_EQ(_bits(br, 16), 0xFFF8);
+    CHECK_EQ(_bits(br, 4), 7);
+    CHECK_EQ(_bits(br, 4), sample_rate_code);
+    CHECK_EQ(_bits(br, 4), 0);
+    CHECK_EQ(_bits(br, 3), 4);
+    CHECK_EQ(_bits(br, 1), 0);
+    uint32_t lead = _bits(br, 8), num;
+    if (lead < 0x80) {
+        num = lead;
+    } else {
+        int extra = 0;
+        while (lead & (0x40 >> extra)) {
+            extra++;
+        }
+        num = lead & (0x3F >> extra);
+        for (int i = 0; i < extra; i++) {
+            uint32_t c = _bits(br, 8);
+            CHECK_EQ(c & 0xC0, 0x80);
+            num = (num << 6) | (c & 0x3F);
+        }
+    }
+    CHECK_EQ(num, frame_number);
+    int n = _bits(br, 16) + 1;
+    CHECK_EQ(_bits(br, 8), _crc8(br->buf + start, br->bit / 8 - 1 - start));
+
+    CHECK_EQ(_bits(br, 1), 0);
+    int type = _bits(br, 6);
+    CHECK_EQ(_bits(br, 1), 0);
+    if (type == 0) {
+        int16_t v = _sbits(br, 16);
+        for (int i = 0; i < n; i++) {
+            x[i] = v;
+        }
+    } else if (type == 1) {
+        for (int i = 0; i < n; i++) {
+            x[i] = _sbits(br, 16);
+        }
+    } else {
+        CHECK(type >= 8 && type <= 12);
+        int order = type - 8;
+        int32_t y[n];
+        for (int i = 0; i < order; i++) {
+            y[i] = _sbits(br, 16);
+        }
+        CHECK_EQ(_bits(br, 2), 0);
+        int porder = _bits(br, 4);
+        int part_len = n >> porder;
+        CHECK(part_len > order || porder == 0);
+        for (int p = 0, i = order; p < (1 << porder); p++) {
+            int k = _bits(br, 4);
+            CHECK(k < 15);
+            for (int end = (p + 1) * part_len; i < end; i++) {
+                uint32_t q = 0;
+                while (_bits(br, 1) == 0) {
+                    q++;
+                }
+                uint32_t u = (q << k) | (k ? _bits(br, k) : 0);
+                int32_t r = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+                int32_t pred = 0;
+                for (int j = 0; j < order; j++) {
+                    pred += fixed_coef[order][j] * y[i - 1 - j];
+                }
+                y[i] = pred + r;
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            CHECK(y[i] >= INT16_MIN && y[i] <= INT16_MAX);
+            x[i] = y[i];
+        }
+    }
+    br->bit = (br->bit + 7) & ~7;
+    int end = br->bit / 8;
+    CHECK_EQ(_bits(br, 16), _crc16(br->buf + start, end - start));
+    return n;
+}
+
+/* Encode `pcm` and decode the stream, which must give it back */
+static int _round_trip(const int16_t *pcm, int samples, int block_size, int chunk)
+{
+    flac_encoder_cfg_t cfg = { .sample_rate = 16000, .block_size = block_size };
+    audio_element_handle_t el = flac_encoder_init(&cfg);
+    CHECK(el);
+    uint8_t *out;
+    int out_len = test_element_run(el, pcm, samples * sizeof(int16_t), chunk, &out);
+    CHECK(out_len >= 42);
+    CHECK_MEM(out, "fLaC", 4);
+    bit_reader_t br = { .buf = out, .len = out_len, .bit = 32 };
+    CHECK_EQ(_bits(&br, 8), 0x80);
+    CHECK_EQ(_bits(&br, 24), 34);
+    CHECK_EQ(_bits(&br, 16), block_size);
+    CHECK_EQ(_bits(&br, 16), block_size);
+    br.bit += 48;
+    CHECK_EQ(_bits(&br, 20), 16000);
+    CHECK_EQ(_bits(&br, 3), 0);
+    CHECK_EQ(_bits(&br, 5), 15);
+    br.bit = 42 * 8;
+
+    int16_t *dec = malloc((samples + block_size) * sizeof(int16_t));
+    int got = 0;
+    for (uint32_t frame = 0; br.bit / 8 < out_len; frame++) {
+        int n = _decode_frame(&br, dec + got, frame, 5);
+        CHECK(n == block_size || (got + n == samples && n < block_size));
+        got += n;
+    }
+    CHECK_EQ(got, samples);
+    CHECK_MEM(dec, pcm, samples * sizeof(int16_t));
+    free(dec);
+    free(out);
+    return out_len;
+}
+
+static void test_random(void)
+{
+    int n = 5000;
+    int16_t *pcm = malloc(n * sizeof(int16_t));
+    test_srand(7);
+    for (int i = 0; i < n; i++) {
+        pcm[i] = (int16_t)test_rand();
+    }
+    /* White noise does not compress, the verbatim subframe bounds the size */
+    int len = _round_trip(pcm, n, 1024, 777);
+    CHECK(len < 42 + n * 2 + 5 * 32);
+    free(pcm);
+}
+
+static void test_sine(void)
+{
+    int n = 16000;
+    int16_t *pcm = malloc(n * sizeof(int16_t));
+    for (int i = 0; i < n; i++) {
+        pcm[i] = (int16_t)lrint(12000 * sin(2 * M_PI * 440 * i / 16000.0) + (int)(test_rand() % 9) - 4);
+    }
+    int len = _round_trip(pcm, n, 1024, 4096);
+    CHECK(len < n);     /* Well under half the PCM size */
+    free(pcm);
+}
+
+static void test_constant_and_extremes(void)
+{
+    int n = 4096 + 100;
+    int16_t *pcm = malloc(n * sizeof(int16_t));
+    for (int i = 0; i < n; i++) {
+        pcm[i] = i < 2048 ? -1234 : (i / 3) & 1 ? INT16_MAX : INT16_MIN;
+    }
+    _round_trip(pcm, n, 2048, 1000);
+    free(pcm);
+}
+
+static void test_short_last_block(void)
+{
+    int16_t pcm[1024 + 5];
+    for (int i = 0; i < 1029; i++) {
+        pcm[i] = (int16_t)(i * 37);
+    }
+    _round_trip(pcm, 1029, 1024, 64);
+    _round_trip(pcm, 3, 1024, 64);
+}
+
+static void test_invalid_block_size(void)
+{
+    flac_encoder_cfg_t cfg = { .sample_rate = 16000, .block_size = 1000 };
+    CHECK(flac_encoder_init(&cfg) == NULL);
+}
+
+int main(void)
+{
+    TEST_RUN(test_random);
+    TEST_RUN(test_sine);
+    TEST_RUN(test_constant_and_extremes);
+    TEST_RUN(test_short_last_block);
+    TEST_RUN(test_invalid_block_size);
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* google_sr: the session pool against a stand-in Speech-to-Text server that answers late */
+#include <pthread.h>
+#include <unistd.h>
+#include "google_sr.h"
+#include "json_b64_scanner.h"
+#include "host_stub.h"
+#include "test_util.h"
+
+#define SR_RATE         (16000)
+#define CAPTURE_SECONDS (10)
+#define UTTERANCE_MS    (400)
+#define RESPONSE_MS     (1000)
+#define MAX_REQUESTS    (8)
+
+static struct {
+    pthread_mutex_t     lock;
+    int                 requests;
+    int16_t             *audio[MAX_REQUESTS];   /* The audio of each request, in the order they ended */
+    int                 samples[MAX_REQUESTS];
+    int64_t             received_us[MAX_REQUESTS];
+    int64_t             answered_us[MAX_REQUESTS];
+} s_srv = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static int _decode_content(const host_http_request_t *req, int16_t **audio)
+{
+    json_b64_scanner_t scanner;
+    json_b64_scanner_init(&scanner, "content");
+    uint8_t *out = malloc(req->body_len);
+    int len = 0;
+    for (int pos = 0; pos < req->body_len; pos += 256) {
+        int n = req->body_len - pos < 256 ? req->body_len - pos : 256;
+        int ret = json_b64_scanner_feed(&scanner, req->body + pos, n, out + len, req->body_len - len);
+        CHECK(ret >= 0);
+        len += ret;
+    }
+    CHECK(json_b64_scanner_done(&scanner));
+    *audio = (int16_t *)out;
+    return len / sizeof(int16_t);
+}
+
+/* Takes the whole request, then answers RESPONSE_MS later with its number as the transcript */
+static void _sr_handler(int fd, void *ctx)
+{
+    host_http_request_t req;
+    if (host_http_read_request(fd, &req) != 0) {
+        return;
+    }
+    int16_t *audio;
+    int samples = _decode_content(&req, &audio);
+    host_http_request_free(&req);
+    pthread_mutex_lock(&s_srv.lock);
+    int n = s_srv.requests++;
+    CHECK(n < MAX_REQUESTS);
+    s_srv.audio[n] = audio;
+    s_srv.samples[n] = samples;
+    s_srv.received_us[n] = test_now_us();
+    pthread_mutex_unlock(&s_srv.lock);
+    usleep(RESPONSE_MS * 1000);
+    char json[128];
+    int len = snprintf(json, sizeof(json), "{\"results\": [{\"alternatives\": [{\"transcript\": \"utterance %d\"}]}]}", n);
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.answered_us[n] = test_now_us();
+    pthread_mutex_unlock(&s_srv.lock);
+    host_http_respond(fd, "application/json", json, len, 0);
+    char buf[512];
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* Samples of the capture count up, wrapping at 16 bits */
+static int16_t *_ramp(int samples)
+{
+    int16_t *pcm = malloc(samples * sizeof(int16_t));
+    for (int i = 0; i < samples; i++) {
+        pcm[i] = (int16_t)i;
+    }
+    return pcm;
+}
+
+/* Capture sample index of `sample`, the one nearest `near` */
+static int _ramp_index(int16_t sample, int near)
+{
+    return near + (int16_t)(sample - (int16_t)near);
+}
+
+typedef struct {
+    int     ids[MAX_REQUESTS];
+    char    transcripts[MAX_REQUESTS][32];
+    int     count;
+} sr_events_t;
+
+static void _poll_events(google_sr_handle_t sr, audio_event_iface_handle_t evt, sr_events_t *events, int ms)
+{
+    int64_t end = test_now_us() + ms * 1000;
+    audio_event_iface_msg_t msg;
+    google_sr_event_t event;
+    while (test_now_us() < end) {
+        if (audio_event_iface_listen(evt, &msg, pdMS_TO_TICKS(20)) == ESP_OK && google_sr_check_event(sr, &msg, &event)
+                && event == GOOGLE_SR_EVENT_FINAL_TRANSCRIPT && events->count < MAX_REQUESTS) {
+            int id = (int)(intptr_t)msg.data;
+            const google_sr_result_t *result = google_sr_get_session_result(sr, id);
+            CHECK(result && result->transcript);
+            events->ids[events->count] = id;
+            snprintf(events->transcripts[events->count], sizeof(events->transcripts[0]), "%s", result->transcript);
+            events->count++;
+        }
+    }
+}
+
+static void _reset_server(void)
+{
+    pthread_mutex_lock(&s_srv.lock);
+    for (int i = 0; i < s_srv.requests; i++) {
+        free(s_srv.audio[i]);
+    }
+    s_srv.requests = 0;
+    pthread_mutex_unlock(&s_srv.lock);
+}
+
+static void test_capture_during_requests(void)
+{
+    /* Three utterances back to back, each starting while the server still holds the earlier ones */
+    host_server_t *server = host_server_start(_sr_handler, NULL);
+    CHECK(server);
+    host_net_redirect(host_server_port(server));
+    int16_t *pcm = _ramp(SR_RATE * CAPTURE_SECONDS);
+    host_i2s_set_capture(pcm, SR_RATE * CAPTURE_SECONDS, true);
+    google_sr_config_t config = {
+        .api_key = "key",
+        .lang_code = "en-US",
+        .record_sample_rates = SR_RATE,
+        .encoding = ENCODING_LINEAR16,
+        .sessions = 3,
+    };
+    int64_t capture_start = test_now_us();
+    google_sr_handle_t sr = google_sr_init(&config);
+    CHECK(sr);
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    google_sr_set_listener(sr, evt);
+    sr_events_t events = { 0 };
+    /* Let the pre-roll fill */
+    _poll_events(sr, evt, &events, DEFAULT_SR_PREROLL_MS + 100);
+
+    int finished_at[3];
+    int64_t slowest_call = 0;
+    for (int i = 0; i < 3; i++) {
+        int64_t t = test_now_us();
+        CHECK_EQ(google_sr_start(sr), ESP_OK);
+        CHECK_EQ(google_sr_get_session(sr), i);
+        slowest_call = test_now_us() - t > slowest_call ? test_now_us() - t : slowest_call;
+        _poll_events(sr, evt, &events, UTTERANCE_MS);
+        t = test_now_us();
+        CHECK_EQ(google_sr_finish(sr), ESP_OK);
+        slowest_call = test_now_us() - t > slowest_call ? test_now_us() - t : slowest_call;
+        finished_at[i] = (t - capture_start) * SR_RATE / 1000000;
+    }
+    /* The pool is full until the first answer */
+    CHECK_EQ(google_sr_start(sr), ESP_FAIL);
+    CHECK_EQ(events.count, 0);
+    _poll_events(sr, evt, &events, RESPONSE_MS + 1000);
+    printf("start/finish at most %lld us with requests in flight\n", (long long)slowest_call);
+    CHECK(slowest_call < 50 * 1000);
+
+    /* Reported in order, each with its own answer */
+    CHECK_EQ(events.count, 3);
+    pthread_mutex_lock(&s_srv.lock);
+    CHECK_EQ(s_srv.requests, 3);
+    for (int i = 0; i < 3; i++) {
+        char expect[32];
+        snprintf(expect, sizeof(expect), "utterance %d", i);
+        CHECK_EQ(events.ids[i], i);
+        CHECK_STR(events.transcripts[i], expect);
+        /* Uploaded while the earlier requests were waiting for their answer */
+        if (i > 0) {
+            CHECK(s_srv.received_us[i] < s_srv.answered_us[i - 1]);
+        }
+        /* Every sample from the pre-roll to the finish, none dropped or held back */
+        int16_t *audio = s_srv.audio[i];
+        int samples = s_srv.samples[i];
+        int expect_samples = (DEFAULT_SR_PREROLL_MS + UTTERANCE_MS) * SR_RATE / 1000;
+        CHECK(samples > expect_samples * 9 / 10 && samples < expect_samples * 11 / 10);
+        for (int k = 1; k < samples; k++) {
+            CHECK_EQ((int16_t)(audio[k] - audio[k - 1]), 1);
+        }
+        int last = _ramp_index(audio[samples - 1], finished_at[i]);
+        printf("session %d: %d samples, the last captured %d ms before the finish\n",
+               i, samples, (finished_at[i] - last) * 1000 / SR_RATE);
+        CHECK(last <= finished_at[i] && last > finished_at[i] - SR_RATE / 10);
+    }
+    pthread_mutex_unlock(&s_srv.lock);
+
+    google_sr_destroy(sr);
+    audio_event_iface_destroy(evt);
+    host_server_stop(server);
+    host_net_redirect(0);
+    host_i2s_set_capture(NULL, 0, false);
+    _reset_server();
+    free(pcm);
+}
+
+static void test_single_session_waits(void)
+{
+    /* With one session the next utterance cannot start before the answer */
+    host_server_t *server = host_server_start(_sr_handler, NULL);
+    CHECK(server);
+    host_net_redirect(host_server_port(server));
+    google_sr_config_t config = {
+        .api_key = "key",
+        .lang_code = "en-US",
+        .record_sample_rates = SR_RATE,
+        .encoding = ENCODING_LINEAR16,
+        .sessions = 1,
+    };
+    google_sr_handle_t sr = google_sr_init(&config);
+    CHECK(sr);
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    google_sr_set_listener(sr, evt);
+    sr_events_t events = { 0 };
+    /* No session has an id yet, -1 as from google_sr_get_session finds none */
+    CHECK(google_sr_get_session_result(sr, -1) == NULL);
+    CHECK_EQ(google_sr_start(sr), ESP_OK);
+    _poll_events(sr, evt, &events, UTTERANCE_MS);
+    CHECK_EQ(google_sr_finish(sr), ESP_OK);
+    CHECK_EQ(google_sr_start(sr), ESP_FAIL);
+    _poll_events(sr, evt, &events, RESPONSE_MS + 1000);
+    CHECK_EQ(events.count, 1);
+    CHECK_EQ(google_sr_start(sr), ESP_OK);
+    CHECK_STR(google_sr_stop(sr), "utterance 1");
+
+    /* The end report of the run google_sr_stop collected is still queued when the session is
+     * used again, it does not end the new run */
+    CHECK_EQ(google_sr_start(sr), ESP_OK);
+    _poll_events(sr, evt, &events, UTTERANCE_MS);
+    CHECK_EQ(google_sr_finish(sr), ESP_OK);
+    _poll_events(sr, evt, &events, RESPONSE_MS + 1000);
+    CHECK_EQ(events.count, 2);
+    CHECK_EQ(events.ids[1], 2);
+    CHECK_STR(events.transcripts[1], "utterance 2");
+
+    google_sr_destroy(sr);
+    audio_event_iface_destroy(evt);
+    host_server_stop(server);
+    host_net_redirect(0);
+    _reset_server();
+}
+
+int main(void)
+{
+    TEST_RUN(test_capture_during_requests);
+    TEST_RUN(test_single_session_waits);
+    return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* google_sr_stream: gRPC response framing and stream filtering, against a scripted HTTP/2 peer */
+#include <unistd.h>
+#include "ringbuf.h"
+#include "conn_pool.h"
+#include "google_sr_stream.h"
+#include "host_stub.h"
+#include "test_util.h"
+
+typedef struct {
+    char    text[256];
+    int     results;
+    int     finals;
+} result_log_t;
+
+static void _on_result(void *ctx, const char *text, bool is_final)
+{
+    result_log_t *log = (result_log_t *)ctx;
+    snprintf(log->text, sizeof(log->text), "%s", text);
+    log->results++;
+    log->finals += is_final;
+}
+
+static void _drain(int fd, void *ctx)
+{
+    char buf[1024];
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* gRPC frame of a StreamingRecognizeResponse with one result */
+static int _response(uint8_t *out, const char *transcript, bool is_final)
+{
+    int tlen = strlen(transcript);
+    uint8_t *p = out + 5;
+    *p++ = 0x12;                        /* results */
+    *p++ = 2 + 2 + tlen + (is_final ? 2 : 0);
+    *p++ = 0x0A;                        /* alternatives */
+    *p++ = 2 + tlen;
+    *p++ = 0x0A;                        /* transcript */
+    *p++ = tlen;
+    memcpy(p, transcript, tlen);
+    p += tlen;
+    if (is_final) {
+        *p++ = 0x10;                    /* is_final */
+        *p++ = 1;
+    }
+    int msg_len = p - out - 5;
+    out[0] = 0;
+    out[1] = out[2] = out[3] = 0;
+    out[4] = msg_len;
+    return p - out;
+}
+
+/* Stream one second of audio through the element, returns its final state */
+static audio_element_state_t _run(host_server_t *server, result_log_t *log, audio_element_handle_t *el_out)
+{
+    sr_stream_cfg_t cfg = {
+        .host = "127.0.0.1",
+        .port = host_server_port(server),
+        .plain_text = true,
+        .api_key = "key",
+        .lang_code = "en-US",
+        .sample_rate = 16000,
+        .encoding = ENCODING_LINEAR16,
+        .on_result = _on_result,
+        .user_ctx = log,
+    };
+    audio_element_handle_t el = sr_stream_init(&cfg);
+    CHECK(el);
+    ringbuf_handle_t rb = rb_create(1024, 8);
+    audio_element_set_input_ringbuf(el, rb);
+    audio_element_run(el);
+    audio_element_resume(el, 0, 0);
+    static int16_t pcm[16000];
+    for (int pos = 0; pos < (int)sizeof(pcm); pos += 1000) {
+        if (rb_write(rb, (char *)pcm + pos, 1000, pdMS_TO_TICKS(1000)) <= 0) {
+            break;              /* The element failed */
+        }
+    }
+    rb_done_write(rb);
+    audio_element_state_t state;
+    for (int i = 0; i < 500; i++) {
+        state = audio_element_get_state(el);
+        if (state == AEL_STATE_FINISHED || state == AEL_STATE_ERROR) {
+            break;
+        }
+        usleep(10 * 1000);
+    }
+    audio_element_stop(el);
+    audio_element_wait_for_stop(el);
+    *el_out = el;
+    rb_destroy(rb);
+    return state;
+}
+
+static void _ok_trailers(int32_t stream_id)
+{
+    host_h2_header(HOST_H2_AFTER_EOF, stream_id, "grpc-status", "0");
+    host_h2_close(HOST_H2_AFTER_EOF, stream_id, 0);
+}
+
+static void test_results_split_across_frames(void)
+{
+    host_h2_reset();
+    host_h2_header(HOST_H2_NOW, 1, ":status", "200");
+    uint8_t buf[64];
+    int len = _response(buf, "hello", false);
+    host_h2_data(HOST_H2_NOW, 1, buf, len);
+    len = _response(buf, "hello world", true);
+    for (int i = 0; i < len; i += 3) {
+        host_h2_data(HOST_H2_AFTER_EOF, 1, buf + i, len - i < 3 ? len - i : 3);
+    }
+    _ok_trailers(1);
+
+    host_server_t *server = host_server_start(_drain, NULL);
+    result_log_t log = { 0 };
+    audio_element_handle_t el;
+    CHECK_EQ(_run(server, &log, &el), AEL_STATE_FINISHED);
+    CHECK_EQ(log.results, 2);
+    CHECK_EQ(log.finals, 1);
+    CHECK_STR(sr_stream_get_transcript(el), "hello world");
+    CHECK_STR(host_h2_request_header("content-type"), "application/grpc");
+    const uint8_t *body;
+    CHECK(host_h2_request_body(&body) > 32000);
+    CHECK_EQ(body[0], 0);
+    CHECK_EQ(body[5], 0x0A);            /* streaming_config first */
+    audio_element_deinit(el);
+    conn_pool_deinit();
+    host_server_stop(server);
+}
+
+static void test_ignores_other_streams(void)
+{
+    /* A first request on stream 1 leaves the connection and its session warm */
+    host_h2_reset();
+    host_h2_header(HOST_H2_NOW, 1, ":status", "200");
+    uint8_t buf[64];
+    int len = _response(buf, "first", true);
+    host_h2_data(HOST_H2_AFTER_EOF, 1, buf, len);
+    _ok_trailers(1);
+    host_server_t *server = host_server_start(_drain, NULL);
+    result_log_t log = { 0 };
+    audio_element_handle_t el;
+    CHECK_EQ(_run(server, &log, &el), AEL_STATE_FINISHED);
+    CHECK_STR(sr_stream_get_transcript(el), "first");
+    audio_element_deinit(el);
+
+    /* Late frames of stream 1 come before and during the next request, on stream 3 */
+    host_h2_reset();
+    len = _response(buf, "stale", true);
+    host_h2_data(HOST_H2_NOW, 1, buf, len);
+    host_h2_header(HOST_H2_NOW, 1, "grpc-status", "13");
+    host_h2_header(HOST_H2_NOW, 3, ":status", "200");
+    host_h2_data(HOST_H2_NOW, 1, buf, 3);
+    host_h2_header(HOST_H2_NOW, 1, ":status", "500");
+    len = _response(buf, "second", true);
+    host_h2_data(HOST_H2_AFTER_EOF, 3, buf, len);
+    _ok_trailers(3);
+    memset(&log, 0, sizeof(log));
+    CHECK_EQ(_run(server, &log, &el), AEL_STATE_FINISHED);
+    CHECK_EQ(host_h2_requests(), 1);
+    CHECK_EQ(log.results, 1);
+    CHECK_STR(sr_stream_get_transcript(el), "second");
+    audio_element_deinit(el);
+    conn_pool_deinit();
+    host_server_stop(server);
+}
+
+static void _check_rejects_length(uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4)
+{
+    host_h2_reset();
+    host_h2_header(HOST_H2_NOW, 1, ":status", "200");
+    uint8_t hdr[5] = { 0, b1, b2, b3, b4 };
+    host_h2_data(HOST_H2_NOW, 1, hdr, sizeof(hdr));
+    uint8_t junk[512];
+    memset(junk, 0x41, sizeof(junk));
+    host_h2_data(HOST_H2_NOW, 1, junk, sizeof(junk));
+    _ok_trailers(1);
+
+    host_server_t *server = host_server_start(_drain, NULL);
+    result_log_t log = { 0 };
+    audio_element_handle_t el;
+    CHECK_EQ(_run(server, &log, &el), AEL_STATE_ERROR);
+    CHECK_EQ(log.results, 0);
+    CHECK(sr_stream_get_transcript(el) == NULL);
+    audio_element_deinit(el);
+    conn_pool_deinit();
+    host_server_stop(server);
+}
+
+static void test_rejects_oversized_messages(void)
+{
+    uint32_t too_long = GOOGLE_SR_STREAM_RX_SIZE + 1;
+    _check_rejects_length(too_long >> 16, too_long >> 8, too_long, 0);
+    _check_rejects_length(too_long >> 24, too_long >> 16, too_long >> 8, too_long);
+    /* Negative as a signed 32-bit length */
+    _check_rejects_length(0x80, 0, 0, 0x10);
+    _check_rejects_length(0xFF, 0xFF, 0xFF, 0xFF);
+}
+
+int main(void)
+{
+    TEST_RUN(test_results_split_across_frames);
+    TEST_RUN(test_ignores_other_streams);
+    TEST_RUN(test_rejects_oversized_messages);
+    return 0;
+}
@@ -0,0 +1,360 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* google_translate: requests, the warm connection and the phrase cache against a stand-in server */
+#include <pthread.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "google_translate.h"
+#include "conn_pool.h"
+#include "host_stub.h"
+#include "test_util.h"
+
+#define SERVER_DELAY_MS (100)
+
+static struct {
+    pthread_mutex_t     lock;
+    int                 delay_ms;       /* Before each answer */
+    int                 status;
+    const char          *reply;         /* The body of every answer, NULL for a translation of `q` */
+    int                 chunk;          /* Chunked answers in pieces of this size, 0 for Content-Length */
+    bool                close;          /* Close the connection after the answer */
+    int                 requests;
+    char                last_head[512];
+    char                last_body[512];
+} s_srv = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* The JSON string value of `key` in `body`, as is */
+static int _member(const char *body, const char *key, char *out, int size)
+{
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char *p = strstr(body, pattern);
+    CHECK(p);
+    p += strlen(pattern);
+    int n = 0;
+    while (p[n] != '"' || p[n - 1] == '\\') {
+        n++;
+    }
+    CHECK(n < size);
+    memcpy(out, p, n);
+    out[n] = '\0';
+    return n;
+}
+
+/* Answers every request of the connection, the translation of "q" is "<target>: q" */
+static void _tr_handler(int fd, void *ctx)
+{
+    /* The answer goes out in pieces, none of them waits for the previous one to be acknowledged */
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    host_http_request_t req;
+    while (host_http_read_request(fd, &req) == 0) {
+        pthread_mutex_lock(&s_srv.lock);
+        s_srv.requests++;
+        snprintf(s_srv.last_head, sizeof(s_srv.last_head), "%.*s", req.head_len, req.raw);
+        snprintf(s_srv.last_body, sizeof(s_srv.last_body), "%.*s", req.body_len, req.body);
+        int delay_ms = s_srv.delay_ms, status = s_srv.status, chunk = s_srv.chunk;
+        bool close = s_srv.close;
+        char body[1024];
+        if (s_srv.reply) {
+            snprintf(body, sizeof(body), "%s", s_srv.reply);
+        } else {
+            char q[512], target[16];
+            _member(s_srv.last_body, "q", q, sizeof(q));
+            _member(s_srv.last_body, "target", target, sizeof(target));
+            snprintf(body, sizeof(body), "{\n  \"data\": {\n    \"translations\": [\n      {\n"
+                     "        \"translatedText\": \"%s: %s\"\n      }\n    ]\n  }\n}\n", target, q);
+        }
+        pthread_mutex_unlock(&s_srv.lock);
+        host_http_request_free(&req);
+        usleep(delay_ms * 1000);
+
+        int len = strlen(body);
+        char head[256];
+        int n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: application/json; charset=UTF-8\r\n%s",
+                         status, status == 200 ? "OK" : "Error", close ? "Connection: close\r\n" : "");
+        if (chunk > 0) {
+            n += snprintf(head + n, sizeof(head) - n, "Transfer-Encoding: chunked\r\n\r\n");
+            host_send_all(fd, head, n);
+            for (int pos = 0; pos < len; pos += chunk) {
+                int size = len - pos < chunk ? len - pos : chunk;
+                n = snprintf(head, sizeof(head), "%x\r\n", size);
+                host_send_all(fd, head, n);
+                host_send_all(fd, body + pos, size);
+                host_send_all(fd, "\r\n", 2);
+            }
+            host_send_all(fd, "0\r\n\r\n", 5);
+        } else {
+            n += snprintf(head + n, sizeof(head) - n, "Content-Length: %d\r\n\r\n", len);
+            host_send_all(fd, head, n);
+            host_send_all(fd, body, len);
+        }
+        if (close) {
+            break;
+        }
+    }
+}
+
+typedef struct {
+    host_server_t               *server;
+    google_translate_handle_t   tr;
+    audio_event_iface_handle_t  evt;
+} tr_env_t;
+
+static void _env_init(tr_env_t *env, google_translate_config_t *config)
+{
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.delay_ms = SERVER_DELAY_MS;
+    s_srv.status = 200;
+    s_srv.reply = NULL;
+    s_srv.chunk = 0;
+    s_srv.close = false;
+    s_srv.requests = 0;
+    pthread_mutex_unlock(&s_srv.lock);
+    env->server = host_server_start(_tr_handler, NULL);
+    CHECK(env->server);
+    config->api_key = "key";
+    config->host = "127.0.0.1";
+    config->port = host_server_port(env->server);
+    config->plain_text = true;
+    env->tr = google_translate_init(config);
+    CHECK(env->tr);
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    env->evt = audio_event_iface_init(&evt_cfg);
+    google_translate_set_listener(env->tr, env->evt);
+}
+
+static void _env_deinit(tr_env_t *env)
+{
+    google_translate_destroy(env->tr);
+    audio_event_iface_destroy(env->evt);
+    /* The warm connections end the server handlers */
+    conn_pool_deinit();
+    host_server_stop(env->server);
+}
+
+/* The next event of the Translation context, its request id in `*id` */
+static google_translate_event_t _wait_event(tr_env_t *env, int *id)
+{
+    audio_event_iface_msg_t msg;
+    google_translate_event_t event;
+    for (int i = 0; i < 200; i++) {
+        if (audio_event_iface_listen(env->evt, &msg, pdMS_TO_TICKS(50)) == ESP_OK
+                && google_translate_check_event(env->tr, &msg, &event)) {
+            *id = (int)(intptr_t)msg.data;
+            return event;
+        }
+    }
+    CHECK(!"No translation event");
+    return 0;
+}
+
+/* Translate and wait, returns the translation or NULL */
+static const char *_translate(tr_env_t *env, const char *text, const char *source, const char *target)
+{
+    int id = google_translate_start(env->tr, text, source, target), done;
+    CHECK(id >= 0);
+    google_translate_event_t event = _wait_event(env, &done);
+    CHECK_EQ(done, id);
+    return event == GOOGLE_TRANSLATE_EVENT_DONE ? google_translate_get_result(env->tr, id) : NULL;
+}
+
+static int _requests(void)
+{
+    pthread_mutex_lock(&s_srv.lock);
+    int n = s_srv.requests;
+    pthread_mutex_unlock(&s_srv.lock);
+    return n;
+}
+
+static void test_request(void)
+{
+    tr_env_t env;
+    google_translate_config_t config = { 0 };
+    _env_init(&env, &config);
+    CHECK_STR(_translate(&env, "Where is the \"station\"?\n", "en", "es"), "es: Where is the \"station\"?\n");
+    pthread_mutex_lock(&s_srv.lock);
+    CHECK(strncmp(s_srv.last_head, "POST /language/translate/v2?key=key HTTP/1.1\r\n", 46) == 0);
+    CHECK(strstr(s_srv.last_head, "Content-Type: application/json"));
+    CHECK_STR(s_srv.last_body, "{\"source\":\"en\",\"target\":\"es\",\"format\":\"text\",\"q\":\"Where is the \\\"station\\\"?\\n\"}");
+    pthread_mutex_unlock(&s_srv.lock);
+    google_translate_stats_t stats;
+    google_translate_get_stats(env.tr, &stats);
+    CHECK_EQ(stats.requests, 1);
+    CHECK_EQ(stats.failures, 0);
+    CHECK(stats.last_response_ms >= SERVER_DELAY_MS);
+    CHECK(stats.last_total_ms >= stats.last_response_ms);
+    _env_deinit(&env);
+}
+
+static void test_warm_connection(void)
+{
+    /* Every request after the first goes on the same connection */
+    tr_env_t env;
+    google_translate_config_t config = { 0 };
+    _env_init(&env, &config);
+    CHECK_STR(_translate(&env, "one", "en", "fr"), "fr: one");
+    CHECK_STR(_translate(&env, "two", "en", "fr"), "fr: two");
+    CHECK_STR(_translate(&env, "three", "en", "fr"), "fr: three");
+    google_translate_stats_t stats;
+    google_translate_get_stats(env.tr, &stats);
+    CHECK_EQ(host_server_connections(env.server), 1);
+    CHECK_EQ(stats.reused, 2);
+    printf("warm request: connect %u ms, response %u ms, total %u ms\n", (unsigned)stats.last_connect_ms,
+           (unsigned)stats.last_response_ms, (unsigned)stats.last_total_ms);
+    CHECK(stats.last_connect_ms < 5);
+
+    /* The server closes the connection: the answer is read to the end and the next request reconnects */
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.close = true;
+    s_srv.chunk = 7;
+    pthread_mutex_unlock(&s_srv.lock);
+    CHECK_STR(_translate(&env, "four", "en", "fr"), "fr: four");
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.close = false;
+    pthread_mutex_unlock(&s_srv.lock);
+    CHECK_STR(_translate(&env, "five", "en", "fr"), "fr: five");
+    CHECK_EQ(host_server_connections(env.server), 2);
+    _env_deinit(&env);
+}
+
+static void test_pipelined(void)
+{
+    /* Requests started at once are answered one after the other, in order */
+    tr_env_t env;
+    google_translate_config_t config = { 0 };
+    _env_init(&env, &config);
+    static const char *texts[] = { "a", "b", "c", "d" };
+    int ids[GOOGLE_TRANSLATE_REQUESTS];
+    for (int i = 0; i < GOOGLE_TRANSLATE_REQUESTS; i++) {
+        ids[i] = google_translate_start(env.tr, texts[i], "en", "de");
+        CHECK(ids[i] >= 0);
+    }
+    /* No room until one is done */
+    CHECK_EQ(google_translate_start(env.tr, "e", "en", "de"), -1);
+    for (int i = 0; i < GOOGLE_TRANSLATE_REQUESTS; i++) {
+        int id;
+        CHECK_EQ(_wait_event(&env, &id), GOOGLE_TRANSLATE_EVENT_DONE);
+        CHECK_EQ(id, ids[i]);
+        char expect[16];
+        snprintf(expect, sizeof(expect), "de: %s", texts[i]);
+        CHECK_STR(google_translate_get_result(env.tr, id), expect);
+    }
+    google_translate_stats_t stats;
+    google_translate_get_stats(env.tr, &stats);
+    printf("last of %d queued: waited %u ms, total %u ms\n", GOOGLE_TRANSLATE_REQUESTS,
+           (unsigned)stats.last_queue_ms, (unsigned)stats.last_total_ms);
+    CHECK(stats.last_queue_ms >= (GOOGLE_TRANSLATE_REQUESTS - 1) * SERVER_DELAY_MS);
+    _env_deinit(&env);
+}
+
+static void test_cache(void)
+{
+    tr_env_t env;
+    google_translate_config_t config = { .cache_enable = true, .cache_entries = 2 };
+    _env_init(&env, &config);
+    CHECK_STR(_translate(&env, "good morning", "en", "es"), "es: good morning");
+    google_translate_stats_t stats;
+    google_translate_get_stats(env.tr, &stats);
+    uint32_t network_ms = stats.last_total_ms;
+
+    /* A repeated phrase is answered without the server */
+    CHECK_STR(_translate(&env, "good morning", "en", "es"), "es: good morning");
+    CHECK_EQ(_requests(), 1);
+    google_translate_get_stats(env.tr, &stats);
+    printf("network %u ms, cache hit %u ms\n", (unsigned)network_ms, (unsigned)stats.last_total_ms);
+    CHECK_EQ(stats.cache_hits, 1);
+    CHECK(stats.last_total_ms < SERVER_DELAY_MS / 4);
+    CHECK_EQ(stats.cache_entries, 1);
+
+    /* The language pair is part of the key */
+    CHECK_STR(_translate(&env, "good morning", "en", "it"), "it: good morning");
+    CHECK_STR(_translate(&env, "good morning", "es", "en"), "en: good morning");
+    CHECK_EQ(_requests(), 3);
+    /* Two entries: the Spanish one was used longest ago and is gone */
+    CHECK_STR(_translate(&env, "good morning", "es", "en"), "en: good morning");
+    CHECK_STR(_translate(&env, "good morning", "en", "es"), "es: good morning");
+    CHECK_EQ(_requests(), 4);
+    google_translate_get_stats(env.tr, &stats);
+    CHECK_EQ(stats.cache_hits, 2);
+    CHECK_EQ(stats.cache_entries, 2);
+    CHECK_EQ(stats.requests, 6);
+
+    /* Failures are not cached */
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.status = 500;
+    s_srv.reply = "{\"error\": {\"code\": 500, \"message\": \"translatedText\"}}";
+    pthread_mutex_unlock(&s_srv.lock);
+    CHECK(_translate(&env, "good night", "en", "es") == NULL);
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.status = 200;
+    s_srv.reply = NULL;
+    pthread_mutex_unlock(&s_srv.lock);
+    CHECK_STR(_translate(&env, "good night", "en", "es"), "es: good night");
+    CHECK_EQ(_requests(), 6);
+    google_translate_get_stats(env.tr, &stats);
+    CHECK_EQ(stats.failures, 1);
+    /* The error answer was read to its end, the connection stayed up */
+    CHECK_EQ(host_server_connections(env.server), 1);
+    _env_deinit(&env);
+}
+
+static void test_response_text(void)
+{
+    /* Escapes, surrogate pairs, a lone surrogate and a look-alike key before the real one */
+    tr_env_t env;
+    google_translate_config_t config = { .text_max = 16 };
+    _env_init(&env, &config);
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.reply = "{\"note\": \"translatedText\", \"translatedText\" : \"\\u00e9\\ud83d\\ude00\\t\\ud800x\\/\"}";
+    s_srv.chunk = 3;
+    pthread_mutex_unlock(&s_srv.lock);
+    CHECK_STR(_translate(&env, "x", "en", "fr"), "\xc3\xa9\xf0\x9f\x98\x80\t\xef\xbf\xbdx/");
+
+    /* Longer than text_max */
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.reply = "{\"translatedText\": \"0123456789abcdefg\"}";
+    pthread_mutex_unlock(&s_srv.lock);
+    CHECK(_translate(&env, "x", "en", "fr") == NULL);
+    /* No translation at all */
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.reply = "{\"data\": {}}";
+    pthread_mutex_unlock(&s_srv.lock);
+    CHECK(_translate(&env, "x", "en", "fr") == NULL);
+    CHECK_EQ(google_translate_start(env.tr, "0123456789abcdefg", "en", "fr"), -1);
+    _env_deinit(&env);
+}
+
+int main(void)
+{
+    TEST_RUN(test_request);
+    TEST_RUN(test_warm_connection);
+    TEST_RUN(test_pipelined);
+    TEST_RUN(test_cache);
+    TEST_RUN(test_response_text);
+    return 0;
+}
@@ -0,0 +1,751 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* google_tts: requests and playback against a stand-in Text-to-Speech server */
+#include <pthread.h>
+#include <unistd.h>
+#include "base64_stream.h"
+#include "google_tts.h"
+#include "host_stub.h"
+#include "test_util.h"
+
+#define TTS_RATE    (16000)
+#define MAX_TEXTS   (64)
+
+static struct {
+    pthread_mutex_t     lock;
+    char                *response;      /* The JSON answer to every request */
+    int                 response_len;
+    int                 chunk;          /* Chunked response pieces, 0 for Content-Length */
+    host_http_request_t req;            /* The last request */
+    int                 requests;
+    char                texts[MAX_TEXTS][GOOGLE_TTS_SEGMENT_MAX + 1];  /* Text of each request, if plain */
+    const char          *fail_text;     /* Requests with this in their text get no answer */
+} s_srv = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* The text of a request body, when it has no escapes and is at most a segment long */
+static void _body_text(const host_http_request_t *req, char *text)
+{
+    static const char head_end[] = "\"text\" : \"";
+    text[0] = '\0';
+    const char *start = req->body ? strstr(req->body, head_end) : NULL;
+    if (start == NULL) {
+        return;
+    }
+    start += strlen(head_end);
+    const char *end = strchr(start, '"');
+    if (end && end - start <= GOOGLE_TTS_SEGMENT_MAX && memchr(start, '\\', end - start) == NULL) {
+        memcpy(text, start, end - start);
+        text[end - start] = '\0';
+    }
+}
+
+static void _tts_handler(int fd, void *ctx)
+{
+    host_http_request_t req;
+    if (host_http_read_request(fd, &req) != 0) {
+        return;
+    }
+    char text[GOOGLE_TTS_SEGMENT_MAX + 1];
+    _body_text(&req, text);
+    pthread_mutex_lock(&s_srv.lock);
+    host_http_request_free(&s_srv.req);
+    s_srv.req = req;
+    if (s_srv.requests < MAX_TEXTS) {
+        strcpy(s_srv.texts[s_srv.requests], text);
+    }
+    s_srv.requests++;
+    char *response = s_srv.response;
+    int len = s_srv.response_len, chunk = s_srv.chunk;
+    bool fail = s_srv.fail_text && strstr(text, s_srv.fail_text);
+    pthread_mutex_unlock(&s_srv.lock);
+    if (fail) {
+        return;
+    }
+    host_http_respond(fd, "application/json", response, len, chunk);
+    /* Read whatever else the client sends, until it closes */
+    char buf[512];
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* Serve `audio` as audioContent, between other members */
+static void _serve_audio(const void *audio, int len, int chunk)
+{
+    char *json = malloc(BASE64_ENC_MAX_OUT(len) + 256);
+    int n = sprintf(json, "{\n  \"note\": \"no audioContent here\",\n  \"audioContent\": \"");
+    base64_enc_t enc;
+    base64_enc_init(&enc);
+    n += base64_enc_update(&enc, audio, len, json + n);
+    n += base64_enc_finish(&enc, json + n);
+    n += sprintf(json + n, "\",\n  \"audioConfig\": { \"audioEncoding\": \"X\" }\n}\n");
+    pthread_mutex_lock(&s_srv.lock);
+    free(s_srv.response);
+    s_srv.response = json;
+    s_srv.response_len = n;
+    s_srv.chunk = chunk;
+    pthread_mutex_unlock(&s_srv.lock);
+}
+
+/* A LINEAR16 answer: a WAV file with an extra chunk before the samples */
+static int _wav(const int16_t *pcm, int samples, uint8_t *out)
+{
+    static const uint8_t head[] = {
+        'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0, 0x80, 0x3E, 0, 0, 0, 0x7D, 0, 0, 2, 0, 16, 0,
+        'L', 'I', 'S', 'T', 5, 0, 0, 0, 'x', 'x', 'x', 'x', 'x', 0,
+    };
+    memcpy(out, head, sizeof(head));
+    int n = sizeof(head);
+    uint32_t size = samples * 2;
+    memcpy(out + n, "data", 4);
+    out[n + 4] = size;
+    out[n + 5] = size >> 8;
+    out[n + 6] = size >> 16;
+    out[n + 7] = size >> 24;
+    memcpy(out + n + 8, pcm, size);
+    return n + 8 + size;
+}
+
+static int16_t *_pcm(int samples)
+{
+    int16_t *pcm = malloc(samples * sizeof(int16_t));
+    for (int i = 0; i < samples; i++) {
+        pcm[i] = (int16_t)test_rand();
+    }
+    return pcm;
+}
+
+typedef struct {
+    host_server_t               *server;
+    google_tts_handle_t         tts;
+    audio_event_iface_handle_t  evt;
+} tts_env_t;
+
+static void _env_init(tts_env_t *env, google_tts_config_t *config)
+{
+    env->server = host_server_start(_tts_handler, NULL);
+    CHECK(env->server);
+    host_net_redirect(host_server_port(env->server));
+    config->api_key = "key";
+    config->lang_code = "en-US";
+    config->playback_sample_rate = TTS_RATE;
+    env->tts = google_tts_init(config);
+    CHECK(env->tts);
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    env->evt = audio_event_iface_init(&evt_cfg);
+    google_tts_set_listener(env->tts, env->evt);
+    host_decoder_set_info(TTS_RATE, 1);
+}
+
+static void _env_deinit(tts_env_t *env)
+{
+    google_tts_destroy(env->tts);
+    audio_event_iface_destroy(env->evt);
+    host_server_stop(env->server);
+    host_net_redirect(0);
+    pthread_mutex_lock(&s_srv.lock);
+    host_http_request_free(&s_srv.req);
+    memset(&s_srv.req, 0, sizeof(s_srv.req));
+    s_srv.requests = 0;
+    s_srv.fail_text = NULL;
+    pthread_mutex_unlock(&s_srv.lock);
+}
+
+/* Wait for the end of playback, false after `timeout_ms` */
+static bool _wait_finish(tts_env_t *env, int timeout_ms)
+{
+    int64_t end = test_now_us() + timeout_ms * 1000LL;
+    while (test_now_us() < end) {
+        audio_event_iface_msg_t msg;
+        if (audio_event_iface_listen(env->evt, &msg, pdMS_TO_TICKS(10)) == ESP_OK
+                && google_tts_check_event_finish(env->tts, &msg)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Speak `text` and return the samples played */
+static int _speak(tts_env_t *env, const char *text, const int16_t **played)
+{
+    host_i2s_reset_playback();
+    CHECK_EQ(google_tts_start(env->tts, text, "en-US"), ESP_OK);
+    CHECK(_wait_finish(env, 10000));
+    return host_i2s_playback(played);
+}
+
+static void test_linear16_split_responses(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16 };
+    _env_init(&env, &cfg);
+    int samples = 5000;
+    int16_t *pcm = _pcm(samples);
+    uint8_t *wav = malloc(samples * 2 + 64);
+    int wav_len = _wav(pcm, samples, wav);
+    const int chunks[] = { 0, 1, 7, 333, 4096 };
+    for (int i = 0; i < (int)(sizeof(chunks) / sizeof(chunks[0])); i++) {
+        _serve_audio(wav, wav_len, chunks[i]);
+        const int16_t *played;
+        CHECK_EQ(_speak(&env, "Hello", &played), samples);
+        CHECK_MEM(played, pcm, samples * 2);
+    }
+    free(wav);
+    free(pcm);
+    _env_deinit(&env);
+}
+
+static void test_mp3_through_decoder(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_MP3 };
+    _env_init(&env, &cfg);
+    /* The stand-in decoder passes the bytes through */
+    int16_t *mp3 = _pcm(3001);
+    _serve_audio(mp3, 3001 * 2, 100);
+    const int16_t *played;
+    CHECK_EQ(_speak(&env, "Hello", &played), 3001);
+    CHECK_MEM(played, mp3, 3001 * 2);
+    free(mp3);
+    _env_deinit(&env);
+}
+
+static void test_no_audio_content(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16 };
+    _env_init(&env, &cfg);
+    static const char error[] = "{ \"error\": { \"message\": \"no \\\"audioContent\\\": here\" } }";
+    pthread_mutex_lock(&s_srv.lock);
+    free(s_srv.response);
+    s_srv.response = strdup(error);
+    s_srv.response_len = strlen(error);
+    s_srv.chunk = 5;
+    pthread_mutex_unlock(&s_srv.lock);
+    const int16_t *played;
+    CHECK_EQ(_speak(&env, "Hello", &played), 0);
+    _env_deinit(&env);
+}
+
+/* The last request must be a chunked POST of the synthesis JSON for `text_json` */
+static void _check_request(const char *text_json, int min_chunks)
+{
+    char expect[512], value[64];
+    snprintf(expect, sizeof(expect),
+             "{\"audioConfig\": { \"audioEncoding\" : \"LINEAR16\", \"sampleRateHertz\": %d },"
+             "\"voice\": { \"languageCode\" : \"en-US\" },"
+             "\"input\": { \"text\" : \"%s\" }}", TTS_RATE, text_json);
+    pthread_mutex_lock(&s_srv.lock);
+    host_http_request_t *req = &s_srv.req;
+    const char *request_line = "POST /v1beta1/text:synthesize?key=key HTTP/1.1\r\n";
+    CHECK(req->raw && strncmp(req->raw, request_line, strlen(request_line)) == 0);
+    CHECK(req->chunked);
+    CHECK_EQ(req->content_length, -1);
+    CHECK(req->chunks >= min_chunks);
+    CHECK(host_http_header(req, "Content-Type", value, sizeof(value)));
+    CHECK_STR(value, "application/json");
+    CHECK_EQ(req->body_len, strlen(expect));
+    CHECK_MEM(req->body, expect, req->body_len);
+    pthread_mutex_unlock(&s_srv.lock);
+}
+
+static void test_request_body(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16, .text_max = GOOGLE_TTS_SEGMENT_MAX };
+    _env_init(&env, &cfg);
+    int16_t *pcm = _pcm(100);
+    uint8_t wav[512];
+    _serve_audio(wav, _wav(pcm, 100, wav), 0);
+    const int16_t *played;
+    CHECK_EQ(_speak(&env, "Say \"hi\"\n", &played), 100);
+    _check_request("Say \\\"hi\\\"\\n", 1);
+
+    /* An armed request sends the head first, then the text */
+    CHECK_EQ(google_tts_arm(env.tts, "en-US"), ESP_OK);
+    usleep(100 * 1000);
+    CHECK_EQ(_speak(&env, "Armed", &played), 100);
+    CHECK_EQ(s_srv.requests, 2);
+    _check_request("Armed", 2);
+
+    /* A text longer than `text_max` drops the armed request and is spoken in segments */
+    CHECK_EQ(google_tts_arm(env.tts, "en-US"), ESP_OK);
+    usleep(100 * 1000);
+    char text[2 * GOOGLE_TTS_SEGMENT_MAX];
+    memset(text, 'a', GOOGLE_TTS_SEGMENT_MAX);
+    strcpy(text + GOOGLE_TTS_SEGMENT_MAX / 2, ". ");
+    memset(text + strlen(text), 'b', GOOGLE_TTS_SEGMENT_MAX / 2);
+    strcpy(text + GOOGLE_TTS_SEGMENT_MAX + 2, ".");
+    CHECK(strlen(text) > GOOGLE_TTS_SEGMENT_MAX);
+    host_i2s_reset_playback();
+    CHECK_EQ(google_tts_start(env.tts, text, "en-US"), ESP_OK);
+    /* Stopping the armed request reports a stop first */
+    for (int i = 0; i < 2 && host_i2s_playback(&played) < 200; i++) {
+        CHECK(_wait_finish(&env, 10000));
+    }
+    CHECK_EQ(host_i2s_playback(&played), 200);
+    CHECK_EQ(s_srv.requests, 4);
+    CHECK_EQ(strlen(s_srv.texts[2]), GOOGLE_TTS_SEGMENT_MAX / 2 + 1);
+    CHECK_EQ(strlen(s_srv.texts[3]), GOOGLE_TTS_SEGMENT_MAX / 2 + 1);
+    CHECK(s_srv.texts[2][0] == 'a' && s_srv.texts[3][0] == 'b');
+    CHECK_EQ(_speak(&env, "Again", &played), 100);
+    _check_request("Again", 1);
+
+    /* Ogg/Opus streams are not chained, there the text must fit one request */
+    google_tts_destroy(env.tts);
+    cfg.encoding = TTS_ENCODING_OGG_OPUS;
+    env.tts = google_tts_init(&cfg);
+    CHECK(env.tts);
+    google_tts_set_listener(env.tts, env.evt);
+    CHECK_EQ(google_tts_start(env.tts, text, "en-US"), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(s_srv.requests, 5);
+    free(pcm);
+    _env_deinit(&env);
+}
+
+/* An armed request that failed to connect is not handed the text, a new request speaks it */
+static void test_armed_request_failed(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16 };
+    _env_init(&env, &cfg);
+    int16_t *pcm = _pcm(100);
+    uint8_t wav[512];
+    _serve_audio(wav, _wav(pcm, 100, wav), 0);
+    /* Nothing listens there */
+    host_net_redirect(1);
+    CHECK_EQ(google_tts_arm(env.tts, "en-US"), ESP_OK);
+    usleep(200 * 1000);
+    host_net_redirect(host_server_port(env.server));
+    host_i2s_reset_playback();
+    CHECK_EQ(google_tts_start(env.tts, "Recovered", "en-US"), ESP_OK);
+    /* Stopping the failed request reports a stop first */
+    const int16_t *played;
+    for (int i = 0; i < 2 && host_i2s_playback(&played) == 0; i++) {
+        CHECK(_wait_finish(&env, 10000));
+    }
+    CHECK_EQ(host_i2s_playback(&played), 100);
+    CHECK_EQ(s_srv.requests, 1);
+    _check_request("Recovered", 1);
+    free(pcm);
+    _env_deinit(&env);
+}
+
+/* Decode the JSON string starting at `in`, up to its closing quote. Returns the decoded length, -1 if
+ * it is not a valid JSON string; `*end` is set after the closing quote */
+static int _json_string(const char *in, int len, char *out, const char **end)
+{
+    int o = 0;
+    for (int i = 0; i < len; i++) {
+        uint8_t c = in[i];
+        if (c == '"') {
+            *end = in + i + 1;
+            return o;
+        }
+        if (c < 0x20) {
+            return -1;
+        }
+        if (c != '\\') {
+            out[o++] = c;
+            continue;
+        }
+        if (++i >= len) {
+            return -1;
+        }
+        static const char escapes[] = "\"\\/bfnrt";
+        const char *simple = in[i] ? strchr(escapes, in[i]) : NULL;
+        if (simple) {
+            out[o++] = "\"\\/\b\f\n\r\t"[simple - escapes];
+            continue;
+        }
+        unsigned int u;
+        if (in[i] != 'u' || i + 4 >= len || sscanf(in + i + 1, "%4x", &u) != 1) {
+            return -1;
+        }
+        i += 4;
+        /* The escaper only emits \uXXXX for control characters and U+FFFD */
+        if (u < 0x80) {
+            out[o++] = u;
+        } else if (u < 0x800) {
+            out[o++] = 0xC0 | (u >> 6);
+            out[o++] = 0x80 | (u & 0x3F);
+        } else {
+            out[o++] = 0xE0 | (u >> 12);
+            out[o++] = 0x80 | ((u >> 6) & 0x3F);
+            out[o++] = 0x80 | (u & 0x3F);
+        }
+    }
+    return -1;
+}
+
+/* Random text of `len` bytes at most: ASCII, characters JSON escapes, and 2 to 4 byte sequences */
+static int _random_utf8(char *text, int max)
+{
+    int len = 0;
+    int target = test_rand() % (max + 1);
+    while (len < target) {
+        uint32_t cp;
+        switch (test_rand() % 6) {
+        case 0:
+            cp = "\"\\\n\r\t\b\f/"[test_rand() % 8];
+            break;
+        case 1:
+            cp = 1 + test_rand() % 0x1F;
+            break;
+        case 2:
+            cp = 0x80 + test_rand() % (0x800 - 0x80);
+            break;
+        case 3:
+            cp = 0x800 + test_rand() % (0x10000 - 0x800);
+            if (cp >= 0xD800 && cp < 0xE000) {
+                cp = 0xFFFD;
+            }
+            break;
+        case 4:
+            cp = 0x10000 + test_rand() % (0x110000 - 0x10000);
+            break;
+        default:
+            cp = 0x20 + test_rand() % 0x5F;
+            break;
+        }
+        char enc[4];
+        int n;
+        if (cp < 0x80) {
+            enc[0] = cp;
+            n = 1;
+        } else if (cp < 0x800) {
+            enc[0] = 0xC0 | (cp >> 6);
+            enc[1] = 0x80 | (cp & 0x3F);
+            n = 2;
+        } else if (cp < 0x10000) {
+            enc[0] = 0xE0 | (cp >> 12);
+            enc[1] = 0x80 | ((cp >> 6) & 0x3F);
+            enc[2] = 0x80 | (cp & 0x3F);
+            n = 3;
+        } else {
+            enc[0] = 0xF0 | (cp >> 18);
+            enc[1] = 0x80 | ((cp >> 12) & 0x3F);
+            enc[2] = 0x80 | ((cp >> 6) & 0x3F);
+            enc[3] = 0x80 | (cp & 0x3F);
+            n = 4;
+        }
+        if (len + n > max) {
+            break;
+        }
+        memcpy(text + len, enc, n);
+        len += n;
+    }
+    text[len] = '\0';
+    return len;
+}
+
+/* The text of the last request body, which must be valid JSON around it */
+static int _request_text(char *text)
+{
+    static const char head_end[] = "\"input\": { \"text\" : \"";
+    pthread_mutex_lock(&s_srv.lock);
+    const char *body = s_srv.req.body, *end = NULL;
+    CHECK(body && s_srv.req.chunked);
+    const char *start = strstr(body, head_end);
+    CHECK(start);
+    start += strlen(head_end);
+    int len = _json_string(start, s_srv.req.body_len - (start - body), text, &end);
+    CHECK(len >= 0);
+    CHECK_EQ(s_srv.req.body + s_srv.req.body_len - end, 3);
+    CHECK_MEM(end, " }}", 3);
+    pthread_mutex_unlock(&s_srv.lock);
+    text[len] = '\0';
+    return len;
+}
+
+static void test_request_fuzz(void)
+{
+    tts_env_t env;
+    /* A small buffer spreads the body over many chunks */
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16, .buffer_size = 256, .text_max = 600 };
+    _env_init(&env, &cfg);
+    int16_t *pcm = _pcm(10);
+    uint8_t wav[256];
+    _serve_audio(wav, _wav(pcm, 10, wav), 0);
+    char text[601], got[601 * 2];
+    const int16_t *played;
+    test_srand(14);
+    for (int i = 0; i < 200; i++) {
+        int len = _random_utf8(text, 600);
+        if (len == 0) {
+            continue;
+        }
+        CHECK_EQ(_speak(&env, text, &played), 10);
+        CHECK_EQ(_request_text(got), len);
+        CHECK_STR(got, text);
+    }
+
+    /* Arbitrary bytes: the body stays valid JSON, invalid sequences become U+FFFD */
+    for (int i = 0; i < 100; i++) {
+        int len = 1 + test_rand() % 600;
+        for (int k = 0; k < len; k++) {
+            text[k] = 1 + test_rand() % 255;
+        }
+        text[len] = '\0';
+        CHECK_EQ(_speak(&env, text, &played), 10);
+        int got_len = _request_text(got);
+        CHECK(got_len >= len);
+    }
+    free(pcm);
+    _env_deinit(&env);
+}
+
+/* Drop the events already posted, such as the stop of the previous playback */
+static void _drain_events(tts_env_t *env)
+{
+    audio_event_iface_msg_t msg;
+    while (audio_event_iface_listen(env->evt, &msg, 0) == ESP_OK) {
+    }
+}
+
+static void test_cache_hit_during_playback(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16, .cache_enable = true };
+    _env_init(&env, &cfg);
+    int samples = TTS_RATE * 2;
+    int16_t *pcm = _pcm(samples);
+    uint8_t *wav = malloc(samples * 2 + 64);
+    _serve_audio(wav, _wav(pcm, samples, wav), 4096);
+    const int16_t *played;
+    CHECK_EQ(_speak(&env, "Hello", &played), samples);
+    CHECK_EQ(s_srv.requests, 1);
+
+    /* The same text again while its cached audio is playing starts over from the beginning */
+    host_i2s_set_playback_realtime(true);
+    host_i2s_reset_playback();
+    CHECK_EQ(google_tts_start(env.tts, "Hello", "en-US"), ESP_OK);
+    usleep(200 * 1000);
+    host_i2s_reset_playback();
+    CHECK_EQ(google_tts_start(env.tts, "Hello", "en-US"), ESP_OK);
+    _drain_events(&env);
+    CHECK(_wait_finish(&env, 10000));
+    CHECK_EQ(host_i2s_playback(&played), samples);
+    CHECK_MEM(played, pcm, samples * 2);
+    host_i2s_set_playback_realtime(false);
+
+    tts_cache_stats_t stats;
+    CHECK_EQ(google_tts_get_cache_stats(env.tts, &stats), ESP_OK);
+    CHECK_EQ(stats.mem_hits, 2);
+    CHECK_EQ(s_srv.requests, 1);
+    free(wav);
+    free(pcm);
+    _env_deinit(&env);
+}
+
+typedef struct {
+    google_tts_event_t  event[MAX_TEXTS + 1];
+    int                 segment[MAX_TEXTS + 1];
+    int                 count;
+} longform_events_t;
+
+/* Collect the long-form events until playback finishes, false after `timeout_ms` */
+static bool _wait_longform(tts_env_t *env, longform_events_t *events, int timeout_ms)
+{
+    memset(events, 0, sizeof(*events));
+    int64_t end = test_now_us() + timeout_ms * 1000LL;
+    while (test_now_us() < end) {
+        audio_event_iface_msg_t msg;
+        google_tts_event_t event;
+        if (audio_event_iface_listen(env->evt, &msg, pdMS_TO_TICKS(10)) != ESP_OK) {
+            continue;
+        }
+        if (google_tts_check_event(env->tts, &msg, &event)) {
+            CHECK(events->count <= MAX_TEXTS);
+            events->event[events->count] = event;
+            events->segment[events->count] = (int)(intptr_t)msg.data;
+            events->count++;
+        } else if (google_tts_check_event_finish(env->tts, &msg)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Sentences, a sentence too long for one request and the events of each segment, in order */
+static void test_enqueue_segments(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16 };
+    _env_init(&env, &cfg);
+    int16_t *pcm = _pcm(100);
+    uint8_t wav[512];
+    _serve_audio(wav, _wav(pcm, 100, wav), 0);
+
+    char longest[512] = "";
+    for (int i = 0; i < 8; i++) {
+        sprintf(longest + strlen(longest), "clause %d of a sentence that goes on and on and on, ", i);
+    }
+    strcpy(longest + strlen(longest) - 2, ".");
+    CHECK(strlen(longest) > GOOGLE_TTS_SEGMENT_MAX);
+    char text[1024];
+    snprintf(text, sizeof(text), "First sentence. Second one!  Third?\n%s Last.", longest);
+    host_i2s_reset_playback();
+    CHECK_EQ(google_tts_enqueue(env.tts, text, "en-US"), ESP_OK);
+    longform_events_t events;
+    CHECK(_wait_longform(&env, &events, 10000));
+
+    pthread_mutex_lock(&s_srv.lock);
+    int requests = s_srv.requests;
+    CHECK(requests >= 6 && requests <= MAX_TEXTS);
+    CHECK_STR(s_srv.texts[0], "First sentence.");
+    CHECK_STR(s_srv.texts[1], "Second one!");
+    CHECK_STR(s_srv.texts[2], "Third?");
+    CHECK_STR(s_srv.texts[requests - 1], "Last.");
+    /* The long sentence is split after clauses, each piece fits a request */
+    char joined[1024] = "";
+    for (int i = 3; i < requests - 1; i++) {
+        CHECK(strlen(s_srv.texts[i]) <= GOOGLE_TTS_SEGMENT_MAX);
+        CHECK(i == requests - 2 || s_srv.texts[i][strlen(s_srv.texts[i]) - 1] == ',');
+        sprintf(joined + strlen(joined), "%s%s", i > 3 ? " " : "", s_srv.texts[i]);
+    }
+    CHECK_STR(joined, longest);
+    pthread_mutex_unlock(&s_srv.lock);
+
+    /* Every segment done in order, then the end of the queue, then playback finished */
+    CHECK_EQ(events.count, requests + 1);
+    for (int i = 0; i < requests; i++) {
+        CHECK_EQ(events.event[i], GOOGLE_TTS_EVENT_SEGMENT_DONE);
+        CHECK_EQ(events.segment[i], i);
+    }
+    CHECK_EQ(events.event[requests], GOOGLE_TTS_EVENT_QUEUE_DONE);
+    CHECK_EQ(events.segment[requests], requests);
+    const int16_t *played;
+    CHECK_EQ(host_i2s_playback(&played), 100 * requests);
+    for (int i = 0; i < requests; i++) {
+        CHECK_MEM(played + 100 * i, pcm, sizeof(int16_t) * 100);
+    }
+    free(pcm);
+    _env_deinit(&env);
+}
+
+/* A segment the server does not answer is reported and skipped, the stream goes on */
+static void test_enqueue_failed_segment(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16 };
+    _env_init(&env, &cfg);
+    int16_t *pcm = _pcm(100);
+    uint8_t wav[512];
+    _serve_audio(wav, _wav(pcm, 100, wav), 0);
+    s_srv.fail_text = "Broken";
+    host_i2s_reset_playback();
+    CHECK_EQ(google_tts_enqueue(env.tts, "One. Broken two. Three.", "en-US"), ESP_OK);
+    longform_events_t events;
+    CHECK(_wait_longform(&env, &events, 10000));
+    static const google_tts_event_t expect[] = {
+        GOOGLE_TTS_EVENT_SEGMENT_DONE, GOOGLE_TTS_EVENT_SEGMENT_FAILED, GOOGLE_TTS_EVENT_SEGMENT_DONE,
+        GOOGLE_TTS_EVENT_QUEUE_DONE,
+    };
+    CHECK_EQ(events.count, 4);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ(events.event[i], expect[i]);
+        CHECK_EQ(events.segment[i], i);
+    }
+    CHECK_EQ(s_srv.requests, 3);
+    const int16_t *played;
+    CHECK_EQ(host_i2s_playback(&played), 200);
+    free(pcm);
+    _env_deinit(&env);
+}
+
+/* Text beyond the segment queue is dropped and reported, what fits is spoken */
+static void test_enqueue_queue_full(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16 };
+    _env_init(&env, &cfg);
+    int16_t *pcm = _pcm(100);
+    uint8_t wav[512];
+    _serve_audio(wav, _wav(pcm, 100, wav), 0);
+    char text[1024] = "";
+    for (int i = 0; i < MAX_TEXTS; i++) {
+        sprintf(text + strlen(text), "Sentence %d. ", i);
+    }
+    host_i2s_reset_playback();
+    CHECK_EQ(google_tts_enqueue(env.tts, text, "en-US"), ESP_FAIL);
+    longform_events_t events;
+    CHECK(_wait_longform(&env, &events, 10000));
+    int queued = s_srv.requests;
+    CHECK(queued > 0 && queued < MAX_TEXTS);
+    for (int i = 0; i < queued; i++) {
+        char expect[32];
+        sprintf(expect, "Sentence %d.", i);
+        CHECK_STR(s_srv.texts[i], expect);
+    }
+    CHECK_EQ(events.count, queued + 1);
+    CHECK_EQ(events.event[queued], GOOGLE_TTS_EVENT_QUEUE_DONE);
+    const int16_t *played;
+    CHECK_EQ(host_i2s_playback(&played), 100 * queued);
+
+    /* The slots are free again */
+    host_i2s_reset_playback();
+    CHECK_EQ(google_tts_enqueue(env.tts, "Again.", "en-US"), ESP_OK);
+    CHECK(_wait_longform(&env, &events, 10000));
+    CHECK_EQ(host_i2s_playback(&played), 100);
+    free(pcm);
+    _env_deinit(&env);
+}
+
+/* Bad arguments are refused before anything runs, playback goes on as before */
+static void test_enqueue_bad_lang_code(void)
+{
+    tts_env_t env;
+    google_tts_config_t cfg = { .encoding = TTS_ENCODING_LINEAR16 };
+    _env_init(&env, &cfg);
+    int16_t *pcm = _pcm(100);
+    uint8_t wav[512];
+    _serve_audio(wav, _wav(pcm, 100, wav), 0);
+    char lang_code[GOOGLE_TTS_LANG_MAX + 1];
+    memset(lang_code, 'x', GOOGLE_TTS_LANG_MAX);
+    lang_code[GOOGLE_TTS_LANG_MAX] = '\0';
+    CHECK_EQ(google_tts_enqueue(env.tts, "Hello.", lang_code), ESP_ERR_INVALID_SIZE);
+    const int16_t *played;
+    CHECK_EQ(_speak(&env, "Hello", &played), 100);
+    CHECK_EQ(s_srv.requests, 1);
+    free(pcm);
+    _env_deinit(&env);
+}
+
+int main(void)
+{
+    TEST_RUN(test_request_body);
+    TEST_RUN(test_armed_request_failed);
+    TEST_RUN(test_request_fuzz);
+    TEST_RUN(test_linear16_split_responses);
+    TEST_RUN(test_mp3_through_decoder);
+    TEST_RUN(test_no_audio_content);
+    TEST_RUN(test_cache_hit_during_playback);
+    TEST_RUN(test_enqueue_segments);
+    TEST_RUN(test_enqueue_failed_segment);
+    TEST_RUN(test_enqueue_queue_full);
+    TEST_RUN(test_enqueue_bad_lang_code);
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* http_chunk_writer: chunk framing, gathering and the flush deadline, checked on the wire */
+#include <pthread.h>
+#include <unistd.h>
+#include "esp_http_client.h"
+#include "http_chunk_writer.h"
+#include "host_stub.h"
+#include "test_util.h"
+
+typedef struct {
+    host_http_request_t req;
+    int                 ret;
+} server_ctx_t;
+
+static void _handler(int fd, void *pv)
+{
+    server_ctx_t *ctx = (server_ctx_t *)pv;
+    ctx->ret = host_http_read_request(fd, &ctx->req);
+    host_http_respond(fd, "text/plain", "ok", 2, 0);
+}
+
+static esp_http_client_handle_t _open(host_server_t **server, server_ctx_t *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    *server = host_server_start(_handler, ctx);
+    CHECK(*server);
+    host_net_redirect(host_server_port(*server));
+    esp_http_client_config_t cfg = { .url = "http://speech.example.com/v1/speech:recognize" };
+    esp_http_client_handle_t http = esp_http_client_init(&cfg);
+    CHECK_EQ(esp_http_client_open(http, -1), ESP_OK);
+    return http;
+}
+
+static void _close(host_server_t *server, esp_http_client_handle_t http)
+{
+    CHECK(esp_http_client_fetch_headers(http) >= 0);
+    CHECK_EQ(esp_http_client_get_status_code(http), 200);
+    esp_http_client_cleanup(http);
+    host_server_stop(server);
+    host_net_redirect(0);
+}
+
+static void test_gathers_to_flush_size(void)
+{
+    host_server_t *server;
+    server_ctx_t ctx;
+    esp_http_client_handle_t http = _open(&server, &ctx);
+    char buffer[HTTP_CHUNK_BUFFER_SIZE(1024)];
+    http_chunk_writer_t writer;
+    http_chunk_writer_init(&writer, http, buffer, sizeof(buffer), 256, 0);
+    char expect[4096];
+    int expect_len = 0;
+    for (int i = 0; i < 100; i++) {
+        int n = 1 + test_rand() % 40;
+        CHECK(n <= http_chunk_writer_room(&writer));
+        for (int k = 0; k < n; k++) {
+            http_chunk_writer_tail(&writer)[k] = expect[expect_len++] = 'a' + test_rand() % 26;
+        }
+        CHECK_EQ(http_chunk_writer_commit(&writer, n), ESP_OK);
+        CHECK_EQ(http_chunk_writer_poll(&writer), ESP_OK);
+    }
+    CHECK_EQ(http_chunk_writer_end(&writer, 0), ESP_OK);
+    _close(server, http);
+
+    CHECK_EQ(ctx.ret, 0);
+    CHECK(ctx.req.chunked);
+    CHECK_EQ(ctx.req.body_len, expect_len);
+    CHECK_MEM(ctx.req.body, expect, expect_len);
+    /* Every chunk but the last reached the flush size */
+    CHECK_EQ(ctx.req.chunks, (int)writer.writes);
+    CHECK(ctx.req.chunks <= expect_len / 256 + 1);
+    CHECK_EQ(writer.payload_bytes, expect_len);
+    CHECK_EQ(writer.wire_bytes, ctx.req.raw_len - ctx.req.head_len);
+    host_http_request_free(&ctx.req);
+}
+
+static void test_end_in_one_write(void)
+{
+    host_server_t *server;
+    server_ctx_t ctx;
+    esp_http_client_handle_t http = _open(&server, &ctx);
+    char buffer[HTTP_CHUNK_BUFFER_SIZE(64)];
+    http_chunk_writer_t writer;
+    http_chunk_writer_init(&writer, http, buffer, sizeof(buffer), 64, 0);
+    memcpy(http_chunk_writer_tail(&writer), "tail", 4);
+    CHECK_EQ(http_chunk_writer_end(&writer, 4), ESP_OK);
+    CHECK_EQ(writer.writes, 1);
+    _close(server, http);
+    CHECK_EQ(ctx.req.body_len, 4);
+    CHECK_EQ(ctx.req.chunks, 1);
+    CHECK_MEM(ctx.req.raw + ctx.req.head_len, "4\r\ntail\r\n0\r\n\r\n", 14);
+    host_http_request_free(&ctx.req);
+}
+
+static void test_flush_deadline(void)
+{
+    host_server_t *server;
+    server_ctx_t ctx;
+    esp_http_client_handle_t http = _open(&server, &ctx);
+    char buffer[HTTP_CHUNK_BUFFER_SIZE(1024)];
+    http_chunk_writer_t writer;
+    http_chunk_writer_init(&writer, http, buffer, sizeof(buffer), 1024, 20);
+    memcpy(http_chunk_writer_tail(&writer), "x", 1);
+    CHECK_EQ(http_chunk_writer_commit(&writer, 1), ESP_OK);
+    CHECK_EQ(http_chunk_writer_poll(&writer), ESP_OK);
+    CHECK_EQ(writer.writes, 0);
+    usleep(25 * 1000);
+    CHECK_EQ(http_chunk_writer_poll(&writer), ESP_OK);
+    CHECK_EQ(writer.writes, 1);
+    CHECK_EQ(http_chunk_writer_end(&writer, 0), ESP_OK);
+    _close(server, http);
+    CHECK_EQ(ctx.req.body_len, 1);
+    host_http_request_free(&ctx.req);
+}
+
+int main(void)
+{
+    TEST_RUN(test_gathers_to_flush_size);
+    TEST_RUN(test_end_in_one_write);
+    TEST_RUN(test_flush_deadline);
+    return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* jitter_buffer: prebuffer, underrun fill and the estimates carried to the next stream, fed by a
+ * simulated network and drained by a sink that takes a frame every 10 ms, like I2S */
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "audio_pipeline.h"
+#include "jitter_buffer.h"
+#include "raw_stream.h"
+#include "test_util.h"
+
+#define RATE            (16000)
+#define FRAME_BYTES     (RATE * JITTER_BUFFER_FRAME_MS / 1000 * 2)
+#define PACKET_MS       (20)                    /* Audio in each network packet */
+#define PACKET_BYTES    (RATE * PACKET_MS / 1000 * 2)
+
+/* Network delivery of the audio: a packet every `gap_ms`, and every `stall_every` packets a
+ * stall of `stall_min_ms` to `stall_max_ms` */
+typedef struct {
+    int gap_ms;
+    int stall_every;
+    int stall_min_ms;
+    int stall_max_ms;
+} network_t;
+
+typedef struct {
+    audio_element_handle_t  raw_in;
+    const int16_t           *pcm;
+    int                     len;
+    network_t               net;
+    int64_t                 first_us;
+} source_t;
+
+/* What the sink saw of one stream */
+typedef struct {
+    uint8_t     *out;
+    int         out_len;
+    int         late;                           /* Frames that came a frame or more after they were due */
+    int         startup_ms;                     /* From the first packet sent to the first frame played */
+    int         max_step;                       /* Largest step between consecutive samples */
+    jitter_buffer_stats_t stats;
+} playback_t;
+
+static int16_t pcm[RATE * 4];
+
+static void _tone(int16_t *out, int samples)
+{
+    for (int i = 0; i < samples; i++) {
+        out[i] = (int16_t)lrint(8000 * sin(2 * M_PI * 200 * i / RATE));
+    }
+}
+
+static void *_source_task(void *pv)
+{
+    source_t *src = (source_t *)pv;
+    int64_t due = test_now_us();
+    src->first_us = due;
+    for (int pos = 0, packet = 0; pos < src->len; pos += PACKET_BYTES, packet++) {
+        int64_t now = test_now_us();
+        if (due > now) {
+            usleep(due - now);
+        }
+        int n = src->len - pos < PACKET_BYTES ? src->len - pos : PACKET_BYTES;
+        if (raw_stream_write(src->raw_in, (char *)src->pcm + pos, n) != n) {
+            break;
+        }
+        /* A full buffer holds the source back, as TCP would */
+        due = test_now_us() > due ? test_now_us() : due;
+        due += src->net.gap_ms * 1000;
+        if (src->net.stall_every && packet % src->net.stall_every == src->net.stall_every - 1) {
+            due += (src->net.stall_min_ms + test_rand() % (src->net.stall_max_ms - src->net.stall_min_ms + 1)) * 1000;
+        }
+    }
+    audio_element_set_ringbuf_done(src->raw_in);
+    return NULL;
+}
+
+/* Stream `len` bytes of pcm through the pipeline once, the sink playing in real time */
+static void _play(audio_pipeline_handle_t pipeline, audio_element_handle_t jitter, const int16_t *in, int len,
+                  const network_t *net, playback_t *play)
+{
+    audio_element_handle_t raw_in = audio_pipeline_get_el_by_tag(pipeline, "test_in");
+    audio_element_handle_t raw_out = audio_pipeline_get_el_by_tag(pipeline, "test_out");
+    audio_pipeline_reset_items_state(pipeline);
+    audio_pipeline_reset_ringbuffer(pipeline);
+    CHECK_EQ(audio_pipeline_run(pipeline), ESP_OK);
+
+    source_t src = { .raw_in = raw_in, .pcm = in, .len = len, .net = *net };
+    pthread_t thread;
+    pthread_create(&thread, NULL, _source_task, &src);
+
+    memset(play, 0, sizeof(*play));
+    int cap = len * 2 + RATE * 2 * 4;
+    play->out = malloc(cap);
+    int64_t due = 0;
+    while (play->out_len + FRAME_BYTES <= cap) {
+        int n = raw_stream_read(raw_out, (char *)play->out + play->out_len, FRAME_BYTES);
+        if (n <= 0) {
+            break;
+        }
+        int64_t now = test_now_us();
+        if (play->out_len == 0) {
+            play->startup_ms = (int)((now - src.first_us) / 1000);
+            due = now;
+        } else if (now >= due + JITTER_BUFFER_FRAME_MS * 1000) {
+            /* The output ran dry, the DMA played a gap */
+            play->late++;
+            due = now;
+        }
+        play->out_len += n;
+        due += JITTER_BUFFER_FRAME_MS * 1000;
+        now = test_now_us();
+        if (due > now) {
+            usleep(due - now);
+        }
+    }
+    pthread_join(thread, NULL);
+    audio_pipeline_stop(pipeline);
+    audio_pipeline_wait_for_stop(pipeline);
+    CHECK_EQ(jitter_buffer_get_stats(jitter, &play->stats), ESP_OK);
+    int16_t *s = (int16_t *)play->out;
+    for (int i = 1; i < play->out_len / 2; i++) {
+        int step = abs(s[i] - s[i - 1]);
+        play->max_step = step > play->max_step ? step : play->max_step;
+    }
+}
+
+static void _report(const char *name, const playback_t *play)
+{
+    printf("%-10s startup %4d ms (sink %4d ms), target %4d ms, underruns %2u (%4u ms), depth %4d..%4d ms, "
+           "rate %4d‰, stall %3d ms, late frames %d\n", name, play->stats.startup_ms, play->startup_ms,
+           play->stats.target_ms, play->stats.underruns, play->stats.underrun_ms, play->stats.min_depth_ms,
+           play->stats.max_depth_ms, play->stats.rate_permille, play->stats.stall_ms, play->late);
+}
+
+static audio_pipeline_handle_t _pipeline(audio_element_handle_t *jitter)
+{
+    jitter_buffer_cfg_t cfg = { .sample_rate = RATE };
+    *jitter = jitter_buffer_init(&cfg);
+    CHECK(*jitter);
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    audio_pipeline_handle_t pipeline = audio_pipeline_init(&pipeline_cfg);
+    raw_stream_cfg_t raw_cfg = RAW_STREAM_CFG_DEFAULT();
+    audio_pipeline_register(pipeline, raw_stream_init(&raw_cfg), "test_in");
+    audio_pipeline_register(pipeline, *jitter, "test_jitter");
+    audio_pipeline_register(pipeline, raw_stream_init(&raw_cfg), "test_out");
+    const char *tags[] = { "test_in", "test_jitter", "test_out" };
+    CHECK_EQ(audio_pipeline_link(pipeline, tags, 3), ESP_OK);
+    return pipeline;
+}
+
+/* Output of a stream with underruns: the input, with silence spliced in and ramps around it */
+static void _check_output(const playback_t *play, int in_len)
+{
+    int silence = play->out_len - in_len;
+    CHECK(silence >= 0);
+    CHECK(abs(silence - (int)play->stats.underrun_ms * RATE / 1000 * 2) <= (int)play->stats.underruns * RATE / 1000 * 2);
+    /* A 200 Hz tone of 8000 steps up to 630 a sample, a click would step up to 8000 */
+    CHECK(play->max_step < 800);
+}
+
+/* A download twice as fast as playback, in small packets: a short prebuffer and the audio untouched */
+static void test_steady(void)
+{
+    audio_element_handle_t jitter;
+    audio_pipeline_handle_t pipeline = _pipeline(&jitter);
+    network_t net = { .gap_ms = PACKET_MS / 2 };
+    int len = RATE * 2 * 2;
+    playback_t play;
+    _play(pipeline, jitter, pcm, len, &net, &play);
+    _report("steady", &play);
+    CHECK_EQ(play.out_len, len);
+    CHECK_MEM(play.out, pcm, len);
+    CHECK_EQ(play.stats.underruns, 0);
+    CHECK_EQ(play.late, 0);
+    /* The smallest prebuffer, plus the gaps between packets */
+    CHECK(play.stats.target_ms <= JITTER_BUFFER_MIN_MS + PACKET_MS);
+    CHECK(play.stats.startup_ms <= JITTER_BUFFER_MIN_MS);
+    CHECK(play.stats.rate_permille > 1500);
+    free(play.out);
+    audio_pipeline_deinit(pipeline);
+}
+
+/* Fast bursts with stalls of 150 to 350 ms every 600 ms of audio. The first stream starts on the
+ * smallest prebuffer and runs dry, the next one prebuffers for the stalls it has seen */
+static void test_bursty(void)
+{
+    test_srand(25);
+    audio_element_handle_t jitter;
+    audio_pipeline_handle_t pipeline = _pipeline(&jitter);
+    network_t net = { .gap_ms = 12, .stall_every = 30, .stall_min_ms = 150, .stall_max_ms = 350 };
+    int len = RATE * 3 * 2;
+    playback_t first, second;
+    _play(pipeline, jitter, pcm, len, &net, &first);
+    _report("bursty 1", &first);
+    _play(pipeline, jitter, pcm, len, &net, &second);
+    _report("bursty 2", &second);
+
+    CHECK(first.stats.underruns > 0);
+    _check_output(&first, len);
+    _check_output(&second, len);
+    /* Underruns were filled, the sink was never starved */
+    CHECK_EQ(first.late, 0);
+    CHECK_EQ(second.late, 0);
+    CHECK(second.stats.target_ms >= JITTER_BUFFER_MIN_MS + 100);
+    CHECK(second.stats.startup_ms > first.stats.startup_ms);
+    CHECK(second.stats.underruns < first.stats.underruns);
+    CHECK(second.stats.underrun_ms < first.stats.underrun_ms);
+    free(first.out);
+    free(second.out);
+    audio_pipeline_deinit(pipeline);
+}
+
+/* A download at 80% of the playback speed: measured, and prebuffered for on the next stream */
+static void test_slow_download(void)
+{
+    audio_element_handle_t jitter;
+    audio_pipeline_handle_t pipeline = _pipeline(&jitter);
+    network_t net = { .gap_ms = PACKET_MS * 5 / 4 };
+    int len = RATE * 2 * 2;
+    playback_t first, second;
+    _play(pipeline, jitter, pcm, len, &net, &first);
+    _report("slow 1", &first);
+    _play(pipeline, jitter, pcm, len, &net, &second);
+    _report("slow 2", &second);
+
+    CHECK(first.stats.underruns > 0);
+    CHECK(first.stats.rate_permille > 700 && first.stats.rate_permille < 900);
+    _check_output(&first, len);
+    /* 60 ms, plus the 400 ms lost over 2 s of playback */
+    CHECK(second.stats.target_ms >= 400);
+    CHECK_EQ(second.stats.underruns, 0);
+    CHECK_EQ(second.out_len, len);
+    CHECK_MEM(second.out, pcm, len);
+    CHECK_EQ(second.late, 0);
+    free(first.out);
+    free(second.out);
+    audio_pipeline_deinit(pipeline);
+}
+
+static void test_config(void)
+{
+    jitter_buffer_cfg_t cfg = { .sample_rate = 96000 };
+    CHECK(jitter_buffer_init(&cfg) == NULL);
+    cfg.sample_rate = RATE;
+    cfg.channels = 3;
+    CHECK(jitter_buffer_init(&cfg) == NULL);
+    cfg.channels = 0;
+    audio_element_handle_t jitter = jitter_buffer_init(&cfg);
+    CHECK(jitter);
+    CHECK_EQ(jitter_buffer_set_format(jitter, 0, 1), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(jitter_buffer_set_format(jitter, RATE, 3), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(jitter_buffer_set_format(jitter, 22050, 2), ESP_OK);
+    CHECK_EQ(jitter_buffer_get_stats(jitter, NULL), ESP_ERR_INVALID_ARG);
+    jitter_buffer_stats_t stats;
+    CHECK_EQ(jitter_buffer_get_stats(NULL, &stats), ESP_ERR_INVALID_ARG);
+    audio_element_deinit(jitter);
+}
+
+int main(void)
+{
+    _tone(pcm, sizeof(pcm) / sizeof(pcm[0]));
+    TEST_RUN(test_steady);
+    TEST_RUN(test_bursty);
+    TEST_RUN(test_slow_download);
+    TEST_RUN(test_config);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* json_b64_scanner: finds the member by key and decodes it whatever the chunk boundaries */
+#include "json_b64_scanner.h"
+#include "test_util.h"
+
+/* Scan `doc` in pieces of `piece` bytes, returns the decoded length or -1 */
+static int _scan(const char *doc, int piece, uint8_t *out, int out_size, bool *done)
+{
+    json_b64_scanner_t scanner;
+    json_b64_scanner_init(&scanner, "audioContent");
+    int len = strlen(doc), total = 0;
+    for (int pos = 0; pos < len; pos += piece) {
+        int n = len - pos < piece ? len - pos : piece;
+        int ret = json_b64_scanner_feed(&scanner, doc + pos, n, out + total, out_size - total);
+        if (ret < 0) {
+            return -1;
+        }
+        total += ret;
+    }
+    *done = json_b64_scanner_done(&scanner);
+    return total;
+}
+
+static void test_decode_any_split(void)
+{
+    uint8_t audio[200], out[256];
+    char b64[300], doc[512];
+    for (int i = 0; i < (int)sizeof(audio); i++) {
+        audio[i] = (uint8_t)test_rand();
+    }
+    for (int len = 0; len <= (int)sizeof(audio); len += 7) {
+        int b64_len = test_base64_ref(audio, len, b64);
+        snprintf(doc, sizeof(doc), "{\n  \"timepointInfo\": [{\"a\": \"audioContent\"}],\n"
+                 "  \"audioContent\" : \"%.*s\",\n  \"audioConfig\": {}\n}", b64_len, b64);
+        for (int piece = 1; piece <= 64; piece += 9) {
+            bool done = false;
+            CHECK_EQ(_scan(doc, piece, out, sizeof(out), &done), len);
+            CHECK(done);
+            CHECK_MEM(out, audio, len);
+        }
+    }
+}
+
+static void test_unpadded_and_escaped(void)
+{
+    uint8_t out[16];
+    bool done;
+    /* "foob" unpadded, then with an escaped slash in the alphabet */
+    CHECK_EQ(_scan("{\"audioContent\":\"Zm9vYg\"}", 3, out, sizeof(out), &done), 4);
+    CHECK_MEM(out, "foob", 4);
+    CHECK_EQ(_scan("{\"audioContent\":\"\\/w==\"}", 2, out, sizeof(out), &done), 1);
+    CHECK_EQ(out[0], 0xff);
+    CHECK(done);
+}
+
+static void test_key_lookalikes(void)
+{
+    uint8_t out[16];
+    bool done;
+    /* An escaped key, a longer key and a value equal to the key are not the member */
+    CHECK_EQ(_scan("{\"audio\\u0043ontent\":\"AAAA\",\"audioContentX\":\"AAAA\",\"k\":\"audioContent\","
+                   "\"audioContent\":\"Zm9v\"}", 5, out, sizeof(out), &done), 3);
+    CHECK_MEM(out, "foo", 3);
+    CHECK(done);
+    CHECK_EQ(_scan("{\"other\":\"Zm9v\"}", 4, out, sizeof(out), &done), 0);
+    CHECK(!done);
+}
+
+static void test_malformed(void)
+{
+    uint8_t out[16];
+    bool done;
+    CHECK_EQ(_scan("{\"audioContent\":\"Zm9v*\"}", 4, out, sizeof(out), &done), -1);
+    CHECK_EQ(_scan("{\"audioContent\":\"Zg==Zg==\"}", 4, out, sizeof(out), &done), -1);
+}
+
+int main(void)
+{
+    TEST_RUN(test_decode_any_split);
+    TEST_RUN(test_unpadded_and_escaped);
+    TEST_RUN(test_key_lookalikes);
+    TEST_RUN(test_malformed);
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* json_escape: escapes, UTF-8 validation and output limits */
+#include "json_escape.h"
+#include "test_util.h"
+
+static const char *_escape(const char *in, int in_len, int out_size, int *consumed)
+{
+    static char out[256];
+    int out_len = 0;
+    *consumed = json_escape(in, in_len, out, out_size, &out_len);
+    out[out_len] = 0;
+    return out;
+}
+
+static void test_escapes(void)
+{
+    int consumed;
+    const char in[] = "a\"b\\c\n\r\t\b\f\x01\x1f/";
+    CHECK_STR(_escape(in, sizeof(in) - 1, 256, &consumed), "a\\\"b\\\\c\\n\\r\\t\\b\\f\\u0001\\u001F/");
+    CHECK_EQ(consumed, sizeof(in) - 1);
+}
+
+static void test_utf8(void)
+{
+    int consumed;
+    /* Valid 2, 3 and 4 byte sequences pass */
+    const char valid[] = "\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80";
+    CHECK_STR(_escape(valid, sizeof(valid) - 1, 256, &consumed), valid);
+    /* Overlong, surrogate, out of range, lone continuation and truncated sequences are replaced */
+    CHECK_STR(_escape("\xc0\xaf", 2, 256, &consumed), "\\uFFFD\\uFFFD");
+    CHECK_STR(_escape("\xed\xa0\x80", 3, 256, &consumed), "\\uFFFD\\uFFFD\\uFFFD");
+    CHECK_STR(_escape("\xf4\x90\x80\x80", 4, 256, &consumed), "\\uFFFD\\uFFFD\\uFFFD\\uFFFD");
+    CHECK_STR(_escape("a\x80" "b", 3, 256, &consumed), "a\\uFFFDb");
+    CHECK_STR(_escape("\xe4\xb8", 2, 256, &consumed), "\\uFFFD\\uFFFD");
+}
+
+static void test_never_splits(void)
+{
+    int consumed;
+    /* A character or escape that does not fit is left for the next call */
+    CHECK_STR(_escape("ab\"c", 4, 3, &consumed), "ab");
+    CHECK_EQ(consumed, 2);
+    CHECK_STR(_escape("a\xe4\xb8\xad", 4, 3, &consumed), "a");
+    CHECK_EQ(consumed, 1);
+    CHECK_STR(_escape("\x01", 1, JSON_ESCAPE_MAX_OUT_CHAR - 1, &consumed), "");
+    CHECK_EQ(consumed, 0);
+}
+
+static void test_resume(void)
+{
+    /* Escaping in small steps gives the same result as in one */
+    char in[400], whole[2048], step[2048];
+    for (int i = 0; i < (int)sizeof(in); i++) {
+        in[i] = (char)test_rand();
+    }
+    int whole_len = 0;
+    CHECK_EQ(json_escape(in, sizeof(in), whole, sizeof(whole), &whole_len), sizeof(in));
+    for (int out_size = JSON_ESCAPE_MAX_OUT_CHAR; out_size < 20; out_size++) {
+        int pos = 0, len = 0;
+        while (pos < (int)sizeof(in)) {
+            int out_len;
+            pos += json_escape(in + pos, sizeof(in) - pos, step + len, out_size, &out_len);
+            CHECK(out_len > 0);
+            len += out_len;
+        }
+        CHECK_EQ(len, whole_len);
+        CHECK_MEM(step, whole, len);
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(test_escapes);
+    TEST_RUN(test_utf8);
+    TEST_RUN(test_never_splits);
+    TEST_RUN(test_resume);
+    return 0;
+}
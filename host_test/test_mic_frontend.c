@@ -0,0 +1,220 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* mic_frontend: high-pass response, AGC level and limit, and noise suppression on noisy recordings */
+#include <math.h>
+#include "mic_frontend.h"
+#include "test_util.h"
+
+#define RATE        (16000)
+#define HOP         (MIC_FRONTEND_FFT_SIZE / 2)
+#define SAMPLES     (RATE * 2 / HOP * HOP)
+
+static double _rms(const int16_t *x, int n)
+{
+    double s = 0;
+    for (int i = 0; i < n; i++) {
+        s += (double)x[i] * x[i];
+    }
+    return sqrt(s / n);
+}
+
+static int16_t *_run(mic_frontend_cfg_t *cfg, const int16_t *in, int n, int chunk)
+{
+    cfg->sample_rate = RATE;
+    audio_element_handle_t el = mic_frontend_init(cfg);
+    CHECK(el);
+    uint8_t *out;
+    CHECK_EQ(test_element_run(el, in, n * sizeof(int16_t), chunk, &out), n * (int)sizeof(int16_t));
+    return (int16_t *)out;
+}
+
+static int16_t *_tone(float freq, float amplitude, int dc)
+{
+    int16_t *x = malloc(SAMPLES * sizeof(int16_t));
+    for (int i = 0; i < SAMPLES; i++) {
+        x[i] = (int16_t)lrint(dc + amplitude * sin(2 * M_PI * freq * i / RATE));
+    }
+    return x;
+}
+
+/* Output rms over input rms of a tone through the filters alone, the settling skipped */
+static double _filter_gain(float freq, int highpass_hz)
+{
+    int16_t *in = _tone(freq, 8000, 0);
+    mic_frontend_cfg_t cfg = { .highpass_hz = highpass_hz };
+    int16_t *out = _run(&cfg, in, SAMPLES, 1000);
+    double gain = _rms(out + RATE / 2, SAMPLES - RATE / 2) / _rms(in, SAMPLES);
+    free(out);
+    free(in);
+    return gain;
+}
+
+static void test_dc_removal(void)
+{
+    int16_t *in = _tone(1000, 4000, 6000);
+    mic_frontend_cfg_t cfg = { .highpass_hz = -1 };
+    int16_t *out = _run(&cfg, in, SAMPLES, 4096);
+    double mean = 0;
+    for (int i = RATE; i < SAMPLES; i++) {
+        mean += out[i];
+    }
+    mean /= SAMPLES - RATE;
+    CHECK(fabs(mean) < 50);
+    double g = _rms(out + RATE, SAMPLES - RATE) / (4000 / sqrt(2));
+    CHECK(g > 0.97 && g < 1.03);
+    free(out);
+    free(in);
+}
+
+static void test_highpass(void)
+{
+    CHECK(_filter_gain(1000, 0) > 0.97 && _filter_gain(1000, 0) < 1.03);
+    CHECK(_filter_gain(MIC_FRONTEND_HIGHPASS_HZ, 0) > 0.6 && _filter_gain(MIC_FRONTEND_HIGHPASS_HZ, 0) < 0.8);
+    CHECK(_filter_gain(30, 0) < 0.15);
+    CHECK(_filter_gain(100, 300) < 0.2);
+}
+
+static void test_agc(void)
+{
+    /* A quiet talker is brought towards the target level */
+    int16_t *in = _tone(300, 600, 0);
+    mic_frontend_cfg_t cfg = { .agc_enable = true };
+    int16_t *out = _run(&cfg, in, SAMPLES, 4096);
+    double dbfs = 20 * log10(_rms(out + RATE, SAMPLES - RATE) / 32768);
+    CHECK(dbfs > MIC_FRONTEND_AGC_TARGET_DBFS - 3 && dbfs < MIC_FRONTEND_AGC_TARGET_DBFS + 3);
+    free(out);
+    free(in);
+
+    /* A shout is turned down, and never clips on the way */
+    in = _tone(300, 32000, 0);
+    out = _run(&cfg, in, SAMPLES, 4096);
+    for (int i = 0; i < SAMPLES; i++) {
+        CHECK(out[i] > -32768 && out[i] < 32767);
+    }
+    dbfs = 20 * log10(_rms(out + RATE, SAMPLES - RATE) / 32768);
+    CHECK(dbfs > MIC_FRONTEND_AGC_TARGET_DBFS - 3 && dbfs < MIC_FRONTEND_AGC_TARGET_DBFS + 3);
+    free(out);
+    free(in);
+
+    /* The boost is limited */
+    in = calloc(SAMPLES, sizeof(int16_t));
+    for (int i = 0; i < SAMPLES; i++) {
+        in[i] = (int16_t)lrint(20 * sin(2 * M_PI * 300 * i / RATE));
+    }
+    out = _run(&cfg, in, SAMPLES, 4096);
+    double gain_db = 20 * log10(_rms(out + RATE, SAMPLES - RATE) / _rms(in + RATE, SAMPLES - RATE));
+    CHECK(gain_db < MIC_FRONTEND_AGC_MAX_GAIN_DB + 1);
+    free(out);
+    free(in);
+}
+
+/* Voiced 200 ms syllables at changing pitch, 100 ms apart, from `from` on */
+static bool _voiced(int i, int from)
+{
+    return i >= from && (i - from) % (RATE * 3 / 10) < RATE / 5;
+}
+
+static void test_noise_suppression(void)
+{
+    /* Fan noise throughout, speech in the second half */
+    int16_t *in = malloc(SAMPLES * sizeof(int16_t));
+    test_srand(19);
+    double phase = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        double v = (int)(test_rand() % 2001) - 1000;
+        if (_voiced(i, SAMPLES / 2)) {
+            double pitch = 120 + 25 * ((i - SAMPLES / 2) / (RATE * 3 / 10) % 4);
+            phase += 2 * M_PI * pitch / RATE;
+            for (int h = 1; h * pitch < 2000; h++) {
+                v += 4000.0 / h * sin(h * phase);
+            }
+        }
+        in[i] = (int16_t)lrint(v);
+    }
+    mic_frontend_cfg_t cfg = { .ns_enable = true };
+    int16_t *out = _run(&cfg, in, SAMPLES, 4096);
+    mic_frontend_cfg_t off = { 0 };
+    int16_t *ref = _run(&off, in, SAMPLES, 4096);
+    /* The noise-only part is pushed down by at least 6 dB, the syllables keep most of their level.
+     * Suppression delays by a hop */
+    int quarter = SAMPLES / 4;
+    double noise_db = 20 * log10(_rms(out + quarter, quarter) / _rms(ref + quarter, quarter));
+    CHECK(noise_db < -6);
+    double speech_out = 0, speech_ref = 0;
+    for (int i = SAMPLES / 2; i < SAMPLES - HOP; i++) {
+        if (_voiced(i, SAMPLES / 2)) {
+            speech_out += (double)out[i + HOP] * out[i + HOP];
+            speech_ref += (double)ref[i] * ref[i];
+        }
+    }
+    double speech = sqrt(speech_out / speech_ref);
+    CHECK(speech > 0.8 && speech < 1.1);
+    free(ref);
+    free(out);
+    free(in);
+}
+
+static void test_noise_step(void)
+{
+    /* The fan speeds up 12 dB: the estimate rises slowly while the band looks like speech, but
+     * still learns the new level within a few seconds */
+    int n = RATE * 6 / HOP * HOP;
+    int16_t *in = malloc(n * sizeof(int16_t));
+    test_srand(20);
+    for (int i = 0; i < n; i++) {
+        int amplitude = i < RATE ? 250 : 1000;
+        in[i] = (int)(test_rand() % (2 * amplitude + 1)) - amplitude;
+    }
+    mic_frontend_cfg_t cfg = { .ns_enable = true };
+    int16_t *out = _run(&cfg, in, n, 4096);
+    double noise_db = 20 * log10(_rms(out + n - RATE, RATE) / _rms(in + n - RATE, RATE));
+    CHECK(noise_db < -6);
+    free(out);
+    free(in);
+}
+
+static void test_any_split(void)
+{
+    /* Pieces that split samples and hops give the same output */
+    int16_t *in = _tone(440, 3000, 100);
+    mic_frontend_cfg_t cfg = { .agc_enable = true, .ns_enable = true };
+    int16_t *whole = _run(&cfg, in, SAMPLES, SAMPLES * 2);
+    int16_t *split = _run(&cfg, in, SAMPLES, 333);
+    CHECK_MEM(whole, split, SAMPLES * sizeof(int16_t));
+    free(split);
+    free(whole);
+    free(in);
+}
+
+int main(void)
+{
+    TEST_RUN(test_dc_removal);
+    TEST_RUN(test_highpass);
+    TEST_RUN(test_agc);
+    TEST_RUN(test_noise_suppression);
+    TEST_RUN(test_noise_step);
+    TEST_RUN(test_any_split);
+    return 0;
+}
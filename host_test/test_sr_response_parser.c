@@ -0,0 +1,182 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* sr_response_parser: speech:recognize responses parsed in pieces of any size */
+#include "sr_response_parser.h"
+#include "test_util.h"
+
+static const char *RESPONSE =
+    "{\n"
+    "  \"results\": [\n"
+    "    {\n"
+    "      \"alternatives\": [\n"
+    "        { \"transcript\": \"how old is\", \"confidence\": 0.92, \"words\": [{\"word\": \"how\"}] },\n"
+    "        { \"transcript\": \"who old is\" }\n"
+    "      ],\n"
+    "      \"resultEndTime\": \"1.500s\",\n"
+    "      \"languageCode\": \"en-us\"\n"
+    "    },\n"
+    "    {\n"
+    "      \"alternatives\": [ { \"confidence\": 0.5, \"transcript\": \" the Brooklyn Bridge\" } ],\n"
+    "      \"resultEndTime\": \"3.250s\"\n"
+    "    }\n"
+    "  ],\n"
+    "  \"totalBilledTime\": \"4s\",\n"
+    "  \"requestId\": \"123\"\n"
+    "}\n";
+
+static esp_err_t _parse(const char *body, int piece, google_sr_result_t *result, char *arena, int arena_size)
+{
+    sr_response_parser_t parser;
+    sr_response_parser_init(&parser, result, arena, arena_size);
+    int len = strlen(body);
+    for (int pos = 0; pos < len; pos += piece) {
+        int n = len - pos < piece ? len - pos : piece;
+        if (sr_response_parser_feed(&parser, body + pos, n) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    return sr_response_parser_finish(&parser);
+}
+
+static void test_segments_any_split(void)
+{
+    for (int piece = 1; piece < 80; piece += 3) {
+        google_sr_result_t result;
+        char arena[256];
+        CHECK_EQ(_parse(RESPONSE, piece, &result, arena, sizeof(arena)), ESP_OK);
+        CHECK_EQ(result.num_segments, 2);
+        CHECK(!result.truncated);
+        CHECK_EQ(result.segments[0].num_alternatives, 2);
+        CHECK_STR(result.segments[0].alternatives[0].transcript, "how old is");
+        CHECK(result.segments[0].alternatives[0].confidence > 0.919f && result.segments[0].alternatives[0].confidence < 0.921f);
+        CHECK_STR(result.segments[0].alternatives[1].transcript, "who old is");
+        CHECK_EQ(result.segments[0].alternatives[1].confidence, 0);
+        CHECK_EQ(result.segments[0].result_end_time_ms, 1500);
+        CHECK_EQ(result.segments[1].num_alternatives, 1);
+        CHECK_STR(result.segments[1].alternatives[0].transcript, " the Brooklyn Bridge");
+        CHECK_EQ(result.segments[1].result_end_time_ms, 3250);
+        CHECK_STR(result.transcript, "how old is the Brooklyn Bridge");
+    }
+}
+
+static void test_escapes(void)
+{
+    google_sr_result_t result;
+    char arena[128];
+    const char *body = "{\"results\":[{\"alternatives\":[{\"transcript\":\"a\\\"b\\\\c\\/\\u00e9\\u4e2d\\ud83d\\ude00\"}]}]}";
+    CHECK_EQ(_parse(body, 1, &result, arena, sizeof(arena)), ESP_OK);
+    CHECK_STR(result.transcript, "a\"b\\c/\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80");
+}
+
+static void _check_transcript(const char *escaped, const char *expect)
+{
+    char body[256];
+    snprintf(body, sizeof(body), "{\"results\":[{\"alternatives\":[{\"transcript\":\"%s\"}]}]}", escaped);
+    google_sr_result_t result;
+    char arena[128];
+    for (int piece = 1; piece <= 8; piece++) {
+        CHECK_EQ(_parse(body, piece, &result, arena, sizeof(arena)), ESP_OK);
+        CHECK_STR(result.transcript, expect);
+    }
+}
+
+static void test_lone_surrogates(void)
+{
+    _check_transcript("x\\ud83d", "x\xef\xbf\xbd");
+    _check_transcript("\\ud83dy", "\xef\xbf\xbdy");
+    _check_transcript("\\ud83d\\n", "\xef\xbf\xbd\n");
+    _check_transcript("\\ud83d\\u0041", "\xef\xbf\xbd" "A");
+    _check_transcript("\\ude00z", "\xef\xbf\xbdz");
+    _check_transcript("\\ud83d\\ud83d\\ude00", "\xef\xbf\xbd\xf0\x9f\x98\x80");
+}
+
+static void test_empty_and_malformed(void)
+{
+    google_sr_result_t result;
+    char arena[64];
+    CHECK_EQ(_parse("{}", 1, &result, arena, sizeof(arena)), ESP_OK);
+    CHECK_EQ(result.num_segments, 0);
+    CHECK(result.transcript == NULL);
+    CHECK_EQ(_parse("{\"results\":[{\"alternatives\":[{\"transcript\":\"cut", 4, &result, arena, sizeof(arena)), ESP_FAIL);
+    CHECK_EQ(_parse("{\"results\":[}", 4, &result, arena, sizeof(arena)), ESP_FAIL);
+}
+
+static void test_too_many_segments(void)
+{
+    char body[2048];
+    int len = snprintf(body, sizeof(body), "{\"results\":[");
+    for (int i = 0; i < GOOGLE_SR_MAX_SEGMENTS + 2; i++) {
+        len += snprintf(body + len, sizeof(body) - len, "%s{\"alternatives\":[{\"transcript\":\"s%d\"}]}", i ? "," : "", i);
+    }
+    snprintf(body + len, sizeof(body) - len, "]}");
+    google_sr_result_t result;
+    char arena[256];
+    CHECK_EQ(_parse(body, 7, &result, arena, sizeof(arena)), ESP_OK);
+    CHECK_EQ(result.num_segments, GOOGLE_SR_MAX_SEGMENTS);
+    CHECK(result.truncated);
+    CHECK_STR(result.transcript, "s0 s1 s2 s3 s4 s5 s6 s7");
+}
+
+static void test_small_arena(void)
+{
+    google_sr_result_t result;
+    char arena[30];
+    /* The strings themselves fill the arena, the first segment stands for the transcript */
+    for (int piece = 1; piece < 16; piece++) {
+        CHECK_EQ(_parse(RESPONSE, piece, &result, arena, sizeof(arena)), ESP_OK);
+        CHECK_EQ(result.num_segments, 2);
+        CHECK(result.truncated);
+        CHECK_STR(result.transcript, "how old is");
+    }
+
+    /* Room for the strings and part of the join */
+    const char *body = "{\"results\":["
+                       "{\"alternatives\":[{\"transcript\":\"ab\"}]},"
+                       "{\"alternatives\":[{\"transcript\":\"cd\"}]},"
+                       "{\"alternatives\":[{\"transcript\":\"ef\"}]}]}";
+    char arena2[9 + 6];
+    CHECK_EQ(_parse(body, 3, &result, arena2, sizeof(arena2)), ESP_OK);
+    CHECK(result.truncated);
+    CHECK_STR(result.transcript, "ab cd");
+
+    /* A single segment is not copied */
+    const char *one = "{\"results\":[{\"alternatives\":[{\"transcript\":\"0123456789\"}]}]}";
+    char arena3[11];
+    CHECK_EQ(_parse(one, 5, &result, arena3, sizeof(arena3)), ESP_OK);
+    CHECK(!result.truncated);
+    CHECK(result.transcript == arena3);
+    CHECK_STR(result.transcript, "0123456789");
+}
+
+int main(void)
+{
+    TEST_RUN(test_segments_any_split);
+    TEST_RUN(test_escapes);
+    TEST_RUN(test_lone_surrogates);
+    TEST_RUN(test_empty_and_malformed);
+    TEST_RUN(test_too_many_segments);
+    TEST_RUN(test_small_arena);
+    return 0;
+}
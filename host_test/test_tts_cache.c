@@ -0,0 +1,285 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* tts_cache: the PSRAM LRU, write-back to the flash log, its wrap-around and rebuild after a
+ * restart, on a RAM-backed partition */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_partition.h"
+#include "tts_cache.h"
+#include "host_stub.h"
+#include "test_util.h"
+
+#define SECTOR          (4096)
+#define SMALL_LEN       (1000)
+#define LARGE_LEN       (5000)                  /* Two sectors with the record header */
+#define RECORD_HDR_LEN  (32)
+
+/* Audio of `key`, no byte is 0 so that any write over it changes it */
+static void _audio(uint64_t key, uint8_t *out, int len)
+{
+    for (int i = 0; i < len; i++) {
+        out[i] = (uint8_t)(key * 31 + i * 7) | 1;
+    }
+}
+
+static void _put(tts_cache_handle_t cache, uint64_t key, int len)
+{
+    uint8_t *audio = malloc(len);
+    CHECK(audio);
+    _audio(key, audio, len);
+    tts_cache_put_begin(cache, key);
+    tts_cache_put_data(cache, audio, len / 3);
+    tts_cache_put_data(cache, audio + len / 3, len - len / 3);
+    tts_cache_put_end(cache, true);
+    free(audio);
+}
+
+/* Open `key` and check all of its audio, false if it is not cached */
+static bool _lookup(tts_cache_handle_t cache, uint64_t key, int len)
+{
+    if (tts_cache_open(cache, key) != ESP_OK) {
+        return false;
+    }
+    uint8_t *expect = malloc(len), *audio = malloc(len + 1);
+    CHECK(expect && audio);
+    _audio(key, expect, len);
+    int n = 0, r;
+    while ((r = tts_cache_read(cache, audio + n, len + 1 - n)) > 0) {
+        n += r;
+    }
+    CHECK_EQ(n, len);
+    CHECK_MEM(audio, expect, len);
+    tts_cache_close(cache);
+    free(expect);
+    free(audio);
+    return true;
+}
+
+static tts_cache_handle_t _init(int mem_size)
+{
+    tts_cache_cfg_t cfg = { .mem_size = mem_size };
+    tts_cache_handle_t cache = tts_cache_init(&cfg);
+    CHECK(cache);
+    return cache;
+}
+
+static tts_cache_stats_t _stats(tts_cache_handle_t cache)
+{
+    tts_cache_stats_t stats;
+    tts_cache_get_stats(cache, &stats);
+    return stats;
+}
+
+/* The least recently used entry goes first, a lookup counts as a use */
+static void test_lru_order(void)
+{
+    tts_cache_handle_t cache = _init(3 * SMALL_LEN);
+    for (int key = 1; key <= 3; key++) {
+        _put(cache, key, SMALL_LEN);
+    }
+    CHECK(_lookup(cache, 1, SMALL_LEN));
+    _put(cache, 4, SMALL_LEN);
+    CHECK(!_lookup(cache, 2, SMALL_LEN));
+    CHECK(_lookup(cache, 1, SMALL_LEN));
+    CHECK(_lookup(cache, 3, SMALL_LEN));
+    CHECK(_lookup(cache, 4, SMALL_LEN));
+    /* Now 1 is the oldest */
+    _put(cache, 5, SMALL_LEN);
+    CHECK(!_lookup(cache, 1, SMALL_LEN));
+    tts_cache_stats_t stats = _stats(cache);
+    CHECK_EQ(stats.evictions, 2);
+    CHECK_EQ(stats.mem_entries, 3);
+    CHECK_EQ(stats.mem_used, 3 * SMALL_LEN);
+    tts_cache_destroy(cache);
+}
+
+/* The open entry is read while newer ones push everything else out */
+static void test_pinned_entry(void)
+{
+    tts_cache_handle_t cache = _init(3 * SMALL_LEN);
+    for (int key = 1; key <= 3; key++) {
+        _put(cache, key, SMALL_LEN);
+    }
+    CHECK_EQ(tts_cache_open(cache, 1), ESP_OK);
+    for (int key = 4; key <= 6; key++) {
+        _put(cache, key, SMALL_LEN);
+    }
+    uint8_t audio[SMALL_LEN], expect[SMALL_LEN];
+    _audio(1, expect, SMALL_LEN);
+    CHECK_EQ(tts_cache_read(cache, audio, SMALL_LEN), SMALL_LEN);
+    CHECK_MEM(audio, expect, SMALL_LEN);
+    tts_cache_close(cache);
+    CHECK_EQ(_stats(cache).evictions, 3);
+    CHECK(!_lookup(cache, 4, SMALL_LEN));
+    /* Closed, it is the oldest again */
+    _put(cache, 7, SMALL_LEN);
+    CHECK(!_lookup(cache, 1, SMALL_LEN));
+    CHECK(_lookup(cache, 5, SMALL_LEN));
+    tts_cache_destroy(cache);
+}
+
+/* An entry evicted before it was synced is written to flash by the next write-back */
+static void test_evicted_dirty_entry(void)
+{
+    host_partition_add(TTS_CACHE_PARTITION_LABEL, 16 * SECTOR);
+    tts_cache_handle_t cache = _init(2 * SMALL_LEN);
+    for (int key = 1; key <= 3; key++) {
+        _put(cache, key, SMALL_LEN);
+    }
+    tts_cache_stats_t stats = _stats(cache);
+    CHECK_EQ(stats.evictions, 1);
+    CHECK_EQ(stats.flash_writes, 0);
+    CHECK_EQ(stats.mem_entries, 2);
+    CHECK(!_lookup(cache, 1, SMALL_LEN));
+    CHECK_EQ(tts_cache_sync(cache), ESP_OK);
+    CHECK_EQ(_stats(cache).flash_writes, 3);
+    CHECK(_lookup(cache, 1, SMALL_LEN));
+    CHECK_EQ(_stats(cache).flash_hits, 1);
+
+    /* The same on the cache task */
+    _put(cache, 4, SMALL_LEN);
+    _put(cache, 5, SMALL_LEN);
+    tts_cache_sync_start(cache);
+    int64_t end = test_now_us() + 2000 * 1000LL;
+    while (_stats(cache).flash_writes < 5 && test_now_us() < end) {
+        usleep(1000);
+    }
+    stats = _stats(cache);
+    CHECK_EQ(stats.flash_writes, 5);
+    CHECK_EQ(stats.flash_entries, 5);
+    tts_cache_destroy(cache);
+    host_partition_remove_all();
+}
+
+/* Six records of two sectors in eight: the log wraps over the two oldest, the next goes over 3 */
+static void _fill_log(tts_cache_handle_t cache)
+{
+    for (int key = 1; key <= 6; key++) {
+        _put(cache, key, LARGE_LEN);
+        CHECK_EQ(tts_cache_sync(cache), ESP_OK);
+    }
+}
+
+static void test_log_wrap(void)
+{
+    host_partition_add(TTS_CACHE_PARTITION_LABEL, 8 * SECTOR);
+    tts_cache_handle_t cache = _init(LARGE_LEN);
+    _fill_log(cache);
+    tts_cache_stats_t stats = _stats(cache);
+    CHECK_EQ(stats.flash_writes, 6);
+    CHECK_EQ(stats.flash_evictions, 2);
+    CHECK_EQ(stats.flash_entries, 4);
+    CHECK(!_lookup(cache, 1, LARGE_LEN));
+    CHECK(!_lookup(cache, 2, LARGE_LEN));
+    for (int key = 3; key <= 6; key++) {
+        CHECK(_lookup(cache, key, LARGE_LEN));
+    }
+    stats = _stats(cache);
+    CHECK_EQ(stats.flash_hits, 3);
+    CHECK_EQ(stats.mem_hits, 1);
+
+    /* The next record goes over 3, not while 3 is being read */
+    CHECK_EQ(tts_cache_open(cache, 3), ESP_OK);
+    _put(cache, 7, SMALL_LEN);
+    CHECK_EQ(tts_cache_sync(cache), ESP_ERR_INVALID_STATE);
+    uint8_t *audio = malloc(LARGE_LEN), *expect = malloc(LARGE_LEN);
+    CHECK(audio && expect);
+    _audio(3, expect, LARGE_LEN);
+    CHECK_EQ(tts_cache_read(cache, audio, LARGE_LEN), LARGE_LEN);
+    CHECK_MEM(audio, expect, LARGE_LEN);
+    free(audio);
+    free(expect);
+    tts_cache_close(cache);
+    CHECK_EQ(tts_cache_sync(cache), ESP_OK);
+    CHECK(!_lookup(cache, 3, LARGE_LEN));
+    tts_cache_destroy(cache);
+    host_partition_remove_all();
+}
+
+/* After a restart the index is scanned back and the log goes on from its newest record */
+static void test_rebuild(void)
+{
+    host_partition_add(TTS_CACHE_PARTITION_LABEL, 8 * SECTOR);
+    tts_cache_handle_t cache = _init(LARGE_LEN);
+    _fill_log(cache);
+    tts_cache_destroy(cache);
+
+    cache = _init(LARGE_LEN);
+    CHECK_EQ(_stats(cache).flash_entries, 4);
+    for (int key = 3; key <= 6; key++) {
+        CHECK(_lookup(cache, key, LARGE_LEN));
+    }
+    CHECK_EQ(_stats(cache).flash_hits, 4);
+    /* The next record takes the place of the oldest, 3 */
+    _put(cache, 7, LARGE_LEN);
+    CHECK_EQ(tts_cache_sync(cache), ESP_OK);
+    _put(cache, 8, SMALL_LEN);
+    CHECK(!_lookup(cache, 3, LARGE_LEN));
+    for (int key = 4; key <= 7; key++) {
+        CHECK(_lookup(cache, key, LARGE_LEN));
+    }
+    CHECK_EQ(_stats(cache).flash_entries, 4);
+    tts_cache_destroy(cache);
+    host_partition_remove_all();
+}
+
+/* A record whose audio no longer matches its CRC is dropped on lookup */
+static void test_corrupt_record(void)
+{
+    host_partition_add(TTS_CACHE_PARTITION_LABEL, 8 * SECTOR);
+    tts_cache_handle_t cache = _init(SMALL_LEN);
+    _put(cache, 1, SMALL_LEN);
+    CHECK_EQ(tts_cache_sync(cache), ESP_OK);
+    _put(cache, 2, SMALL_LEN);
+    CHECK_EQ(tts_cache_sync(cache), ESP_OK);
+    CHECK_EQ(_stats(cache).flash_entries, 2);
+
+    /* The first record is at the start of the partition */
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           TTS_CACHE_PARTITION_LABEL);
+    CHECK(part);
+    uint8_t zero = 0;
+    CHECK_EQ(esp_partition_write(part, RECORD_HDR_LEN + 100, &zero, 1), ESP_OK);
+    CHECK(!_lookup(cache, 1, SMALL_LEN));
+    tts_cache_stats_t stats = _stats(cache);
+    CHECK_EQ(stats.flash_entries, 1);
+    CHECK_EQ(stats.misses, 1);
+    CHECK(_lookup(cache, 2, SMALL_LEN));
+    tts_cache_destroy(cache);
+    host_partition_remove_all();
+}
+
+int main(void)
+{
+    host_partition_remove_all();
+    TEST_RUN(test_lru_order);
+    TEST_RUN(test_pinned_entry);
+    TEST_RUN(test_evicted_dirty_entry);
+    TEST_RUN(test_log_wrap);
+    TEST_RUN(test_rebuild);
+    TEST_RUN(test_corrupt_record);
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Checks and helpers shared by the host tests */
+#include <pthread.h>
+#include <time.h>
+#include "audio_pipeline.h"
+#include "raw_stream.h"
+#include "test_util.h"
+
+static uint32_t s_rand = 0x12345678;
+
+uint32_t test_rand(void)
+{
+    /* xorshift32 */
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+void test_srand(uint32_t seed)
+{
+    s_rand = seed ? seed : 1;
+}
+
+int64_t test_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct {
+    audio_element_handle_t  raw_in;
+    const uint8_t           *in;
+    int                     in_len;
+    int                     chunk;
+} feeder_t;
+
+static void *_feed_task(void *pv)
+{
+    feeder_t *feeder = (feeder_t *)pv;
+    for (int pos = 0; pos < feeder->in_len; pos += feeder->chunk) {
+        int n = feeder->in_len - pos < feeder->chunk ? feeder->in_len - pos : feeder->chunk;
+        if (raw_stream_write(feeder->raw_in, (char *)feeder->in + pos, n) != n) {
+            break;
+        }
+    }
+    audio_element_set_ringbuf_done(feeder->raw_in);
+    return NULL;
+}
+
+int test_element_run(audio_element_handle_t el, const void *in, int in_len, int chunk, uint8_t **out)
+{
+    return test_element_run_inspect(el, in, in_len, chunk, out, NULL, NULL);
+}
+
+int test_element_run_inspect(audio_element_handle_t el, const void *in, int in_len, int chunk, uint8_t **out,
+                             void (*inspect)(audio_element_handle_t el, void *ctx), void *ctx)
+{
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    audio_pipeline_handle_t pipeline = audio_pipeline_init(&pipeline_cfg);
+    raw_stream_cfg_t raw_cfg = RAW_STREAM_CFG_DEFAULT();
+    audio_element_handle_t raw_in = raw_stream_init(&raw_cfg);
+    audio_element_handle_t raw_out = raw_stream_init(&raw_cfg);
+    audio_pipeline_register(pipeline, raw_in, "test_in");
+    audio_pipeline_register(pipeline, el, "test_el");
+    audio_pipeline_register(pipeline, raw_out, "test_out");
+    const char *tags[] = { "test_in", "test_el", "test_out" };
+    CHECK_EQ(audio_pipeline_link(pipeline, tags, 3), ESP_OK);
+    CHECK_EQ(audio_pipeline_run(pipeline), ESP_OK);
+
+    feeder_t feeder = { .raw_in = raw_in, .in = in, .in_len = in_len, .chunk = chunk > 0 ? chunk : in_len };
+    pthread_t thread;
+    pthread_create(&thread, NULL, _feed_task, &feeder);
+
+    int cap = 4096, len = 0;
+    uint8_t *buf = malloc(cap);
+    while (1) {
+        if (cap - len < 1024) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+        }
+        int n = raw_stream_read(raw_out, (char *)buf + len, cap - len);
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+    }
+    /* An element that finished before its input ended no longer drains it */
+    rb_abort(audio_element_get_output_ringbuf(raw_in));
+    pthread_join(thread, NULL);
+    audio_pipeline_stop(pipeline);
+    audio_pipeline_wait_for_stop(pipeline);
+    if (inspect) {
+        inspect(el, ctx);
+    }
+    audio_pipeline_deinit(pipeline);
+    *out = buf;
+    return len;
+}
+
+int test_base64_ref(const uint8_t *src, int len, char *dst)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    int o = 0;
+    for (int i = 0; i < len; i += 3) {
+        uint32_t v = src[i] << 16;
+        if (i + 1 < len) {
+            v |= src[i + 1] << 8;
+        }
+        if (i + 2 < len) {
+            v |= src[i + 2];
+        }
+        dst[o++] = alphabet[(v >> 18) & 0x3f];
+        dst[o++] = alphabet[(v >> 12) & 0x3f];
+        dst[o++] = i + 1 < len ? alphabet[(v >> 6) & 0x3f] : '=';
+        dst[o++] = i + 2 < len ? alphabet[v & 0x3f] : '=';
+    }
+    return o;
+}
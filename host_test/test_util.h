@@ -0,0 +1,90 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Checks and helpers shared by the host tests */
+#ifndef _TEST_UTIL_H_
+#define _TEST_UTIL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_element.h"
+
+#define CHECK(cond) do {                                                                \
+        if (!(cond)) {                                                                  \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);    \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_EQ(a, b) do {                                                             \
+        long long _a = (long long)(a), _b = (long long)(b);                             \
+        if (_a != _b) {                                                                 \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",           \
+                    __FILE__, __LINE__, #a, #b, _a, _b);                                \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_STR(a, b) do {                                                            \
+        const char *_a = (a), *_b = (b);                                                \
+        if (_a == NULL || _b == NULL || strcmp(_a, _b) != 0) {                          \
+            fprintf(stderr, "%s:%d: CHECK_STR(%s, %s) failed: \"%s\" != \"%s\"\n",      \
+                    __FILE__, __LINE__, #a, #b, _a ? _a : "(null)", _b ? _b : "(null)"); \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_MEM(a, b, len) CHECK(memcmp((a), (b), (len)) == 0)
+
+#define TEST_RUN(fn) do {                                                               \
+        printf("[ RUN ] %s\n", #fn);                                                    \
+        fn();                                                                           \
+        printf("[  OK ] %s\n", #fn);                                                    \
+    } while (0)
+
+/* Deterministic pseudo random numbers */
+uint32_t test_rand(void);
+void test_srand(uint32_t seed);
+
+/* Monotonic time in microseconds */
+int64_t test_now_us(void);
+
+/**
+ * Run `el` alone in a pipeline: `in` is written in pieces of `chunk` bytes, then the input ends.
+ * Returns the output length, the output in `*out` to be freed. The element is deinitialized.
+ * Input left over when the element finishes early is dropped
+ */
+int test_element_run(audio_element_handle_t el, const void *in, int in_len, int chunk, uint8_t **out);
+
+/* The same, `inspect` is called on the stopped element before it is deinitialized */
+int test_element_run_inspect(audio_element_handle_t el, const void *in, int in_len, int chunk, uint8_t **out,
+                             void (*inspect)(audio_element_handle_t el, void *ctx), void *ctx);
+
+/* Reference base64 with padding, returns the output length */
+int test_base64_ref(const uint8_t *src, int len, char *dst);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* vad_filter: silence trimmed around speech, events and auto stop over synthetic recordings */
+#include <math.h>
+#include "vad_filter.h"
+#include "test_util.h"
+
+#define RATE        (16000)
+#define FRAME       (RATE * VAD_FILTER_FRAME_MS / 1000)
+#define MS(ms)      ((ms) * RATE / 1000)
+
+typedef struct {
+    bool    speech;
+    int     ms;
+} fixture_part_t;
+
+typedef struct {
+    int     starts;
+    int     ends;
+} vad_events_t;
+
+/* Room noise, with vowel-like voiced stretches: harmonics of 140 Hz up to 1 kHz */
+static int16_t *_fixture(const fixture_part_t *parts, int num_parts, int *samples)
+{
+    int n = 0;
+    for (int i = 0; i < num_parts; i++) {
+        n += MS(parts[i].ms);
+    }
+    int16_t *pcm = malloc(n * sizeof(int16_t));
+    int pos = 0;
+    test_srand(7);
+    for (int i = 0; i < num_parts; i++) {
+        for (int k = 0; k < MS(parts[i].ms); k++, pos++) {
+            double v = (int)(test_rand() % 601) - 300;
+            if (parts[i].speech) {
+                for (int h = 1; h * 140 < 1000; h++) {
+                    v += 3000.0 / h * sin(2 * M_PI * 140 * h * pos / RATE);
+                }
+            }
+            pcm[pos] = (int16_t)lrint(v);
+        }
+    }
+    *samples = n;
+    return pcm;
+}
+
+static void _on_event(vad_filter_event_t event, void *ctx)
+{
+    vad_events_t *events = (vad_events_t *)ctx;
+    if (event == VAD_FILTER_SPEECH_START) {
+        events->starts++;
+    } else {
+        events->ends++;
+    }
+}
+
+static int _run(const int16_t *pcm, int samples, bool auto_stop, int chunk, vad_events_t *events, int16_t **out)
+{
+    memset(events, 0, sizeof(*events));
+    vad_filter_cfg_t cfg = {
+        .sample_rate = RATE,
+        .auto_stop = auto_stop,
+        .on_event = _on_event,
+        .user_ctx = events,
+    };
+    audio_element_handle_t el = vad_filter_init(&cfg);
+    CHECK(el);
+    return test_element_run(el, pcm, samples * sizeof(int16_t), chunk, (uint8_t **)out) / sizeof(int16_t);
+}
+
+/* The lookback before the onset, the speech, then the hangover */
+static int _kept(int speech_ms)
+{
+    return MS(VAD_FILTER_PRE_SPEECH_MS + speech_ms + VAD_FILTER_HANGOVER_MS);
+}
+
+static void test_trims_silence(void)
+{
+    fixture_part_t parts[] = { { false, 1000 }, { true, 1000 }, { false, 1500 } };
+    int samples;
+    int16_t *pcm = _fixture(parts, 3, &samples);
+    int chunks[] = { 4096, 333 };
+    for (int i = 0; i < 2; i++) {
+        vad_events_t events;
+        int16_t *out;
+        int n = _run(pcm, samples, false, chunks[i], &events, &out);
+        CHECK_EQ(events.starts, 1);
+        CHECK_EQ(events.ends, 1);
+        CHECK_EQ(n, _kept(1000));
+        CHECK_MEM(out, pcm + MS(1000 - VAD_FILTER_PRE_SPEECH_MS), n * sizeof(int16_t));
+        free(out);
+    }
+    free(pcm);
+}
+
+static void test_two_utterances(void)
+{
+    fixture_part_t parts[] = { { false, 600 }, { true, 400 }, { false, 1500 }, { true, 800 }, { false, 1000 } };
+    int samples;
+    int16_t *pcm = _fixture(parts, 5, &samples);
+    vad_events_t events;
+    int16_t *out;
+    int n = _run(pcm, samples, false, 1024, &events, &out);
+    CHECK_EQ(events.starts, 2);
+    CHECK_EQ(events.ends, 2);
+    CHECK_EQ(n, _kept(400) + _kept(800));
+    CHECK_MEM(out, pcm + MS(600 - VAD_FILTER_PRE_SPEECH_MS), _kept(400) * sizeof(int16_t));
+    CHECK_MEM(out + _kept(400), pcm + MS(2500 - VAD_FILTER_PRE_SPEECH_MS), _kept(800) * sizeof(int16_t));
+    free(out);
+    free(pcm);
+}
+
+static void test_auto_stop(void)
+{
+    /* The second utterance comes after the end of speech and is not kept */
+    fixture_part_t parts[] = { { false, 500 }, { true, 700 }, { false, 1000 }, { true, 500 }, { false, 300 } };
+    int samples;
+    int16_t *pcm = _fixture(parts, 5, &samples);
+    vad_events_t events;
+    int16_t *out;
+    int n = _run(pcm, samples, true, 2048, &events, &out);
+    CHECK_EQ(events.starts, 1);
+    CHECK_EQ(events.ends, 1);
+    CHECK_EQ(n, _kept(700));
+    CHECK_MEM(out, pcm + MS(500 - VAD_FILTER_PRE_SPEECH_MS), n * sizeof(int16_t));
+    free(out);
+    free(pcm);
+}
+
+static void test_silence_only(void)
+{
+    fixture_part_t parts[] = { { false, 2000 } };
+    int samples;
+    int16_t *pcm = _fixture(parts, 1, &samples);
+    vad_events_t events;
+    int16_t *out;
+    CHECK_EQ(_run(pcm, samples, false, 4096, &events, &out), 0);
+    CHECK_EQ(events.starts, 0);
+    CHECK_EQ(events.ends, 0);
+    free(out);
+    free(pcm);
+}
+
+static void test_speech_until_end(void)
+{
+    /* Input ending mid speech still reports the end of speech */
+    fixture_part_t parts[] = { { false, 400 }, { true, 600 } };
+    int samples;
+    int16_t *pcm = _fixture(parts, 2, &samples);
+    vad_events_t events;
+    int16_t *out;
+    int n = _run(pcm, samples, false, 4096, &events, &out);
+    CHECK_EQ(events.starts, 1);
+    CHECK_EQ(events.ends, 1);
+    CHECK_EQ(n, MS(VAD_FILTER_PRE_SPEECH_MS + 600));
+    free(out);
+    free(pcm);
+}
+
+int main(void)
+{
+    TEST_RUN(test_trims_silence);
+    TEST_RUN(test_two_utterances);
+    TEST_RUN(test_auto_stop);
+    TEST_RUN(test_silence_only);
+    TEST_RUN(test_speech_until_end);
+    return 0;
+}
@@ -0,0 +1,541 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* wake_word: a keyword model built on the host from reference features, false accepts and rejects */
+#include <math.h>
+#include "wake_word.h"
+#include "test_util.h"
+
+#define RATE            (WAKE_WORD_SAMPLE_RATE)
+#define HOP             (RATE * WAKE_WORD_FRAME_MS / 1000)
+#define FFT_N           (WAKE_WORD_FFT_SIZE)
+#define BINS            (FFT_N / 2 + 1)
+#define NUM_MFCC        (10)
+#define KEYWORD_MS      (520)
+#define NUM_FRAMES      (KEYWORD_MS / WAKE_WORD_FRAME_MS)
+#define IN_DIM          (NUM_FRAMES * NUM_MFCC)
+#define NUM_FILLERS     (WAKE_WORD_MAX_UNITS - 1)
+#define VARIANTS        (32)
+#define TRAINING_MIN    (2)
+#define POSITIVES       (200)
+#define NEGATIVE_MIN    (20)
+
+/* ---- Reference features: the documented MFCC in floating point ---- */
+
+static float _mel(float hz)
+{
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float _hz(float mel)
+{
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+typedef struct {
+    float   win[FFT_N];
+    float   cos_tab[FFT_N];
+    float   mel_w[WAKE_WORD_MEL_BANDS][BINS];
+    float   dct[NUM_MFCC][WAKE_WORD_MEL_BANDS];
+} ref_mfcc_t;
+
+static void _ref_init(ref_mfcc_t *ref)
+{
+    for (int i = 0; i < FFT_N; i++) {
+        ref->win[i] = 0.5f - 0.5f * cosf(2 * M_PI * i / FFT_N);
+        ref->cos_tab[i] = cosf(2 * M_PI * i / FFT_N);
+    }
+    float lo = _mel(20.0f), hi = _mel(7600.0f), bin_hz = (float)RATE / FFT_N;
+    memset(ref->mel_w, 0, sizeof(ref->mel_w));
+    for (int m = 0; m < WAKE_WORD_MEL_BANDS; m++) {
+        float left = _hz(lo + (hi - lo) * m / (WAKE_WORD_MEL_BANDS + 1)) / bin_hz;
+        float center = _hz(lo + (hi - lo) * (m + 1) / (WAKE_WORD_MEL_BANDS + 1)) / bin_hz;
+        float right = _hz(lo + (hi - lo) * (m + 2) / (WAKE_WORD_MEL_BANDS + 1)) / bin_hz;
+        int first = (int)ceilf(left), end = (int)ceilf(right);
+        if (end <= first) {
+            ref->mel_w[m][(int)lrintf(center)] = 1.0f;
+            continue;
+        }
+        for (int k = first; k < end; k++) {
+            float w = k <= center ? (k - left) / (center - left) : (right - k) / (right - center);
+            ref->mel_w[m][k] = fmaxf(w, 1.0f / 64);
+        }
+    }
+    for (int k = 0; k < NUM_MFCC; k++) {
+        for (int m = 0; m < WAKE_WORD_MEL_BANDS; m++) {
+            ref->dct[k][m] = cosf(M_PI * (k + 1) * (m + 0.5f) / WAKE_WORD_MEL_BANDS);
+        }
+    }
+}
+
+/* Coefficients of every hop of `pcm`, before the shift to int8 */
+static int _ref_features(const ref_mfcc_t *ref, const int16_t *pcm, int samples, float *out)
+{
+    float *ana = calloc(FFT_N, sizeof(float));
+    float last = 0;
+    int frames = 0;
+    for (int pos = 0; pos + HOP <= samples; pos += HOP) {
+        memmove(ana, ana + HOP, (FFT_N - HOP) * sizeof(float));
+        for (int i = 0; i < HOP; i++) {
+            ana[FFT_N - HOP + i] = pcm[pos + i] - roundf(last * 0.97f);
+            last = pcm[pos + i];
+        }
+        float logmel[WAKE_WORD_MEL_BANDS];
+        float power[BINS];
+        for (int k = 0; k < BINS; k++) {
+            double re = 0, im = 0;
+            for (int n = 0; n < FFT_N; n++) {
+                float x = ana[n] * ref->win[n];
+                re += x * ref->cos_tab[(k * n) % FFT_N];
+                im -= x * ref->cos_tab[(k * n + FFT_N * 3 / 4) % FFT_N];
+            }
+            power[k] = (re * re + im * im) / 65536;
+        }
+        for (int m = 0; m < WAKE_WORD_MEL_BANDS; m++) {
+            double sum = 0;
+            for (int k = 0; k < BINS; k++) {
+                sum += power[k] * ref->mel_w[m][k];
+            }
+            logmel[m] = 256 * log2(sum + 1);
+        }
+        for (int k = 0; k < NUM_MFCC; k++) {
+            float c = 0;
+            for (int m = 0; m < WAKE_WORD_MEL_BANDS; m++) {
+                c += logmel[m] * ref->dct[k][m];
+            }
+            out[frames * NUM_MFCC + k] = c;
+        }
+        frames++;
+    }
+    free(ana);
+    return frames;
+}
+
+/* ---- Synthetic sounds ---- */
+
+typedef struct {
+    float   level;      /* Peak amplitude */
+    float   pitch;      /* Frequency scale */
+    float   tempo;      /* Duration scale */
+} keyword_var_t;
+
+/*
+ * The keyword: a hum at 700 Hz, a glide up to 1.8 kHz and a tone at 1.2 kHz, with two
+ * harmonics, like a sung "hey-ya-ho". Returns the samples written
+ */
+static int _keyword(int16_t *out, keyword_var_t v)
+{
+    static const struct {
+        int     ms;
+        float   from, to;
+    } parts[] = { { 150, 700, 700 }, { 200, 700, 1800 }, { 170, 1200, 1200 } };
+    int n = 0;
+    double phase = 0;
+    for (int p = 0; p < 3; p++) {
+        int len = parts[p].ms * v.tempo * RATE / 1000;
+        for (int i = 0; i < len; i++, n++) {
+            float f = (parts[p].from + (parts[p].to - parts[p].from) * i / len) * v.pitch;
+            phase += 2 * M_PI * f / RATE;
+            /* 10 ms fades at the ends of each part */
+            float env = fminf(1.0f, fminf(i, len - i) / (RATE / 100.0f));
+            out[n] = (int16_t)lrintf(v.level * env * (0.6f * sin(phase) + 0.3f * sin(2 * phase) + 0.1f * sin(3 * phase)));
+        }
+    }
+    return n;
+}
+
+static void _noise(int16_t *x, int n, float rms)
+{
+    for (int i = 0; i < n; i++) {
+        /* Sum of uniforms, close enough to Gaussian */
+        float g = 0;
+        for (int k = 0; k < 4; k++) {
+            g += (int)(test_rand() % 2001) - 1000;
+        }
+        x[i] = (int16_t)lrintf(fmaxf(-32768, fminf(32767, x[i] + g * rms / 1155)));
+    }
+}
+
+/* Something that is not the keyword, `kind` picks the sound */
+static int _other(int16_t *out, int kind, float level)
+{
+    int n = 0;
+    if (kind == 0) {
+        /* Babble: voiced sounds at varying pitch and vowel */
+        int syllables = 3 + test_rand() % 6;
+        double phase = 0;
+        for (int s = 0; s < syllables; s++) {
+            int len = (100 + test_rand() % 200) * RATE / 1000;
+            float pitch = 90 + test_rand() % 200;
+            float formant = 300 + test_rand() % 2500;
+            for (int i = 0; i < len; i++, n++) {
+                phase += 2 * M_PI * pitch / RATE;
+                float v = 0;
+                for (int h = 1; h * pitch < 4000; h++) {
+                    float d = (h * pitch - formant) / 400;
+                    v += expf(-d * d) * sin(h * phase);
+                }
+                float env = fminf(1.0f, fminf(i, len - i) / (RATE / 100.0f));
+                out[n] = (int16_t)lrintf(level * 0.5f * env * v);
+            }
+        }
+    } else if (kind == 1) {
+        /* Whistles: glides between random frequencies */
+        int parts = 1 + test_rand() % 4;
+        double phase = 0;
+        for (int p = 0; p < parts; p++) {
+            int len = (80 + test_rand() % 300) * RATE / 1000;
+            float from = 300 + test_rand() % 2700, to = 300 + test_rand() % 2700;
+            for (int i = 0; i < len; i++, n++) {
+                phase += 2 * M_PI * (from + (to - from) * i / len) / RATE;
+                float env = fminf(1.0f, fminf(i, len - i) / (RATE / 100.0f));
+                out[n] = (int16_t)lrintf(level * env * (0.6f * sin(phase) + 0.3f * sin(2 * phase) + 0.1f * sin(3 * phase)));
+            }
+        }
+    } else if (kind == 2) {
+        /* The keyword parts in the wrong order */
+        int16_t *kw = malloc(RATE * sizeof(int16_t));
+        keyword_var_t v = { level, 1, 1 };
+        int len = _keyword(kw, v);
+        int third = len / 3;
+        for (int p = 2; p >= 0; p--) {
+            memcpy(out + n, kw + p * third, third * sizeof(int16_t));
+            n += third;
+        }
+        free(kw);
+    } else {
+        /* A noise burst */
+        n = (100 + test_rand() % 500) * RATE / 1000;
+        memset(out, 0, n * sizeof(int16_t));
+        _noise(out, n, level / 3);
+    }
+    return n;
+}
+
+/* ---- The model ---- */
+
+static float _uniform(float lo, float hi)
+{
+    return lo + (hi - lo) * (test_rand() % 10001) / 10000.0f;
+}
+
+typedef struct {
+    int8_t              weights[(1 + NUM_FILLERS) * IN_DIM];
+    int32_t             bias[1 + NUM_FILLERS];
+    wake_word_layer_t   layer;
+    wake_word_model_t   model;
+} template_model_t;
+
+static inline int8_t _to_int8(float c, int shift)
+{
+    float q = roundf(c / (1 << shift));
+    return q > 127 ? 127 : q < -128 ? -128 : (int8_t)q;
+}
+
+/* Template `j` from the coefficients of a window, the bias is half its squared norm */
+static void _set_template(template_model_t *tm, int j, const float *coef, int shift)
+{
+    int32_t norm = 0;
+    for (int i = 0; i < IN_DIM; i++) {
+        int8_t w = _to_int8(coef[i], shift);
+        tm->weights[j * IN_DIM + i] = w;
+        norm += w * w;
+    }
+    tm->bias[j] = -norm / 2;
+}
+
+static int32_t _output(const template_model_t *tm, int j, const int8_t *x)
+{
+    const int8_t *w = tm->weights + j * IN_DIM;
+    int32_t acc = tm->bias[j];
+    for (int i = 0; i < IN_DIM; i++) {
+        acc += w[i] * x[i];
+    }
+    return acc;
+}
+
+/* Coefficients of the window of the last NUM_FRAMES hops of the keyword variant `v` */
+static void _keyword_window(const ref_mfcc_t *ref, keyword_var_t v, float *window)
+{
+    int16_t *pcm = calloc(FFT_N + RATE, sizeof(int16_t));
+    float *coef = malloc((FFT_N + RATE) / HOP * NUM_MFCC * sizeof(float));
+    int len = _keyword(pcm + FFT_N, v);
+    _noise(pcm, FFT_N + len, v.level * 0.4f * powf(10, -_uniform(15, 30) / 20));
+    int frames = _ref_features(ref, pcm, FFT_N + len, coef);
+    memcpy(window, coef + (frames - NUM_FRAMES) * NUM_MFCC, IN_DIM * sizeof(float));
+    free(coef);
+    free(pcm);
+}
+
+/*
+ * A nearest template model: output j is `t_j . x - |t_j|^2 / 2`, so the score is half the
+ * difference of the squared distances of the features to the nearest filler and to the keyword.
+ * The keyword template is the mean of variants like those it has to be spotted in. The fillers
+ * are quiet, then the windows of other sounds the model confuses most with the keyword, picked
+ * one at a time from training sounds that are not the test sets
+ */
+static void _build_model(template_model_t *tm, const ref_mfcc_t *ref)
+{
+    test_srand(100);
+    float *mean = calloc(IN_DIM, sizeof(float));
+    float *window = malloc(IN_DIM * sizeof(float));
+    for (int t = 0; t < VARIANTS; t++) {
+        keyword_var_t v = { _uniform(2000, 16000), _uniform(0.97f, 1.03f), _uniform(0.93f, 1.07f) };
+        _keyword_window(ref, v, window);
+        for (int i = 0; i < IN_DIM; i++) {
+            mean[i] += window[i] / VARIANTS;
+        }
+    }
+    /* The smallest shift that keeps the keyword in int8 */
+    float peak = 0;
+    for (int i = 0; i < IN_DIM; i++) {
+        peak = fmaxf(peak, fabsf(mean[i]));
+    }
+    int shift = 0;
+    while (peak / (1 << shift) > 127) {
+        shift++;
+    }
+    _set_template(tm, 0, mean, shift);
+    memset(window, 0, IN_DIM * sizeof(float));
+    _set_template(tm, 1, window, shift);
+
+    int samples = TRAINING_MIN * 60 * RATE;
+    int16_t *pcm = calloc(samples + 4 * RATE, sizeof(int16_t));
+    for (int n = 0; n < samples;) {
+        n += _other(pcm + n, test_rand() % 4, _uniform(1000, 16000));
+        n += (test_rand() % 500) * RATE / 1000;
+    }
+    _noise(pcm, samples, 100);
+    float *coef = malloc(samples / HOP * NUM_MFCC * sizeof(float));
+    int windows = _ref_features(ref, pcm, samples, coef) - NUM_FRAMES + 1;
+    int8_t *x = malloc(windows * IN_DIM);
+    int32_t *keyword = malloc(windows * sizeof(int32_t));
+    int32_t *filler = malloc(windows * sizeof(int32_t));
+    for (int w = 0; w < windows; w++) {
+        for (int i = 0; i < IN_DIM; i++) {
+            x[w * IN_DIM + i] = _to_int8(coef[w * NUM_MFCC + i], shift);
+        }
+        keyword[w] = _output(tm, 0, x + w * IN_DIM);
+        filler[w] = _output(tm, 1, x + w * IN_DIM);
+    }
+    for (int j = 2; j <= NUM_FILLERS; j++) {
+        int worst = 0;
+        for (int w = 1; w < windows; w++) {
+            worst = keyword[w] - filler[w] > keyword[worst] - filler[worst] ? w : worst;
+        }
+        _set_template(tm, j, coef + worst * NUM_MFCC, shift);
+        for (int w = 0; w < windows; w++) {
+            int32_t out = _output(tm, j, x + w * IN_DIM);
+            filler[w] = out > filler[w] ? out : filler[w];
+        }
+    }
+    free(filler);
+    free(keyword);
+    free(x);
+    free(coef);
+    free(pcm);
+    free(window);
+    free(mean);
+
+    tm->layer = (wake_word_layer_t) {
+        .in_dim = IN_DIM,
+        .out_dim = 1 + NUM_FILLERS,
+        .weights = tm->weights,
+        .bias = tm->bias,
+    };
+    tm->model = (wake_word_model_t) {
+        .num_frames = NUM_FRAMES,
+        .num_mfcc = NUM_MFCC,
+        .input_shift = shift,
+        .layers = &tm->layer,
+        .num_layers = 1,
+        .keyword_index = 0,
+        /* Squared distances to the nearest filler and to the keyword differ by a twentieth of its squared norm */
+        .threshold = -tm->bias[0] / 20,
+    };
+}
+
+/* ---- Runs ---- */
+
+typedef struct {
+    audio_element_handle_t  el;
+    int                     at[1024];       /* Sample of each detection */
+    int                     count;
+    wake_word_stats_t       stats;
+} detect_log_t;
+
+static void _on_detect(void *ctx)
+{
+    detect_log_t *log = (detect_log_t *)ctx;
+    wake_word_stats_t stats;
+    wake_word_get_stats(log->el, &stats);
+    if (log->count < (int)(sizeof(log->at) / sizeof(log->at[0]))) {
+        log->at[log->count] = stats.frames * HOP;
+    }
+    log->count++;
+}
+
+static void _inspect(audio_element_handle_t el, void *ctx)
+{
+    wake_word_get_stats(el, &((detect_log_t *)ctx)->stats);
+}
+
+static void _run(const wake_word_model_t *model, const int16_t *pcm, int samples, bool active, detect_log_t *log)
+{
+    memset(log, 0, sizeof(*log));
+    wake_word_cfg_t cfg = {
+        .model = model,
+        .on_detect = _on_detect,
+        .user_ctx = log,
+    };
+    log->el = wake_word_init(&cfg);
+    CHECK(log->el);
+    wake_word_set_active(log->el, active);
+    uint8_t *out;
+    CHECK_EQ(test_element_run_inspect(log->el, pcm, samples * sizeof(int16_t), 1280, &out, _inspect, log),
+             samples * (int)sizeof(int16_t));
+    /* The audio passes unchanged */
+    CHECK_MEM(out, pcm, samples * sizeof(int16_t));
+    free(out);
+}
+
+static template_model_t s_tm;
+
+/* Clips of 2 s, the keyword ends at `ends[i]`, in noise 15 to 30 dB below it */
+static int16_t *_positives(int *samples, int *ends)
+{
+    int clip = 2 * RATE;
+    int16_t *pcm = calloc(POSITIVES * clip, sizeof(int16_t));
+    test_srand(200);
+    for (int c = 0; c < POSITIVES; c++) {
+        keyword_var_t v = { _uniform(2000, 16000), _uniform(0.97f, 1.03f), _uniform(0.93f, 1.07f) };
+        int start = c * clip + (300 + test_rand() % 400) * RATE / 1000;
+        ends[c] = start + _keyword(pcm + start, v);
+        _noise(pcm + c * clip, clip, v.level * 0.4f * powf(10, -_uniform(15, 30) / 20));
+    }
+    *samples = POSITIVES * clip;
+    return pcm;
+}
+
+static void test_rates(void)
+{
+    /* Misses among the keyword clips */
+    int samples, ends[POSITIVES];
+    int16_t *pcm = _positives(&samples, ends);
+    detect_log_t *log = malloc(sizeof(detect_log_t));
+    _run(&s_tm.model, pcm, samples, true, log);
+    int hits = 0, stray = 0;
+    for (int d = 0, c = 0; d < log->count; d++) {
+        while (c < POSITIVES && ends[c] + RATE / 2 < log->at[d]) {
+            c++;
+        }
+        /* Fires once the keyword has ended, within the last frames of the window */
+        if (c < POSITIVES && log->at[d] > ends[c] - 5 * HOP && log->at[d] <= ends[c] + RATE / 2) {
+            hits++;
+            c++;
+        } else {
+            stray++;
+        }
+    }
+    float fr = 100.0f * (POSITIVES - hits) / POSITIVES;
+    printf("false rejects %.1f %% (%d of %d), %d stray detections\n", fr, POSITIVES - hits, POSITIVES, stray);
+    CHECK(fr <= 5);
+    CHECK_EQ(stray, 0);
+    free(pcm);
+
+    /* False accepts in minutes of other sounds */
+    samples = NEGATIVE_MIN * 60 * RATE;
+    pcm = calloc(samples + 4 * RATE, sizeof(int16_t));
+    test_srand(300);
+    for (int n = 0; n < samples;) {
+        float level = _uniform(1000, 16000);
+        n += _other(pcm + n, test_rand() % 4, level);
+        n += (test_rand() % 500) * RATE / 1000;
+    }
+    _noise(pcm, samples, 100);
+    _run(&s_tm.model, pcm, samples, true, log);
+    float fa_per_hour = log->count * 60.0f / NEGATIVE_MIN;
+    printf("false accepts %.1f per hour (%d in %d min)\n", fa_per_hour, log->count, NEGATIVE_MIN);
+    printf("frame cost %u us on average, %u us at most, %d inputs\n",
+           (unsigned)log->stats.avg_us, (unsigned)log->stats.max_us, IN_DIM);
+    CHECK(fa_per_hour <= 6);
+    CHECK_EQ(log->stats.frames, (uint32_t)(samples / HOP));
+    free(pcm);
+    free(log);
+}
+
+static void test_inactive(void)
+{
+    /* Nothing is computed while paused */
+    int samples, ends[POSITIVES];
+    int16_t *pcm = _positives(&samples, ends);
+    detect_log_t *log = malloc(sizeof(detect_log_t));
+    _run(&s_tm.model, pcm, 20 * RATE, false, log);
+    CHECK_EQ(log->count, 0);
+    CHECK_EQ(log->stats.frames, 0);
+    free(log);
+    free(pcm);
+}
+
+static void test_refractory(void)
+{
+    /* The keyword twice within WAKE_WORD_REFRACTORY_MS fires once */
+    int16_t *pcm = calloc(3 * RATE, sizeof(int16_t));
+    keyword_var_t v = { 8000, 1, 1 };
+    int end = RATE / 4 + _keyword(pcm + RATE / 4, v);
+    _keyword(pcm + end + RATE / 10, v);
+    _noise(pcm, 3 * RATE, 30);
+    detect_log_t *log = malloc(sizeof(detect_log_t));
+    _run(&s_tm.model, pcm, 3 * RATE, true, log);
+    CHECK_EQ(log->count, 1);
+    free(log);
+    free(pcm);
+}
+
+static void test_model_limits(void)
+{
+    wake_word_model_t model = s_tm.model;
+    wake_word_cfg_t cfg = { .model = &model };
+    model.num_frames = WAKE_WORD_MAX_FRAMES + 1;
+    CHECK(wake_word_init(&cfg) == NULL);
+    model = s_tm.model;
+    model.keyword_index = 1 + NUM_FILLERS;
+    CHECK(wake_word_init(&cfg) == NULL);
+    model = s_tm.model;
+    model.num_mfcc = NUM_MFCC + 1;
+    CHECK(wake_word_init(&cfg) == NULL);
+}
+
+int main(void)
+{
+    ref_mfcc_t *ref = malloc(sizeof(ref_mfcc_t));
+    _ref_init(ref);
+    _build_model(&s_tm, ref);
+    free(ref);
+    TEST_RUN(test_rates);
+    TEST_RUN(test_inactive);
+    TEST_RUN(test_refractory);
+    TEST_RUN(test_model_limits);
+    return 0;
+}
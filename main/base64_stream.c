@@ -0,0 +1,103 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "base64_stream.h"
+
+static const char base64_alphabet[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void base64_enc_init(base64_enc_t *enc)
+{
+    enc->carry_len = 0;
+}
+
+/* The 64-entry table stays in DRAM next to the code, where a 12-bit pair table would take 8 KB */
+static inline void _put_group(char *dst, uint32_t v)
+{
+    char group[4] = {
+        base64_alphabet[v >> 18],
+        base64_alphabet[(v >> 12) & 0x3f],
+        base64_alphabet[(v >> 6) & 0x3f],
+        base64_alphabet[v & 0x3f],
+    };
+    memcpy(dst, group, 4);
+}
+
+size_t base64_enc_update(base64_enc_t *enc, const uint8_t *src, size_t len, char *dst)
+{
+    char *out = dst;
+
+    if (enc->carry_len > 0) {
+        while (enc->carry_len < 3 && len > 0) {
+            enc->carry[enc->carry_len++] = *src++;
+            len--;
+        }
+        if (enc->carry_len < 3) {
+            return 0;
+        }
+        _put_group(out, (enc->carry[0] << 16) | (enc->carry[1] << 8) | enc->carry[2]);
+        out += 4;
+        enc->carry_len = 0;
+    }
+
+    /* Two groups per iteration keep the loads, lookups and stores back to back */
+    while (len >= 6) {
+        uint32_t a = (src[0] << 16) | (src[1] << 8) | src[2];
+        uint32_t b = (src[3] << 16) | (src[4] << 8) | src[5];
+        _put_group(out, a);
+        _put_group(out + 4, b);
+        out += 8;
+        src += 6;
+        len -= 6;
+    }
+    if (len >= 3) {
+        _put_group(out, (src[0] << 16) | (src[1] << 8) | src[2]);
+        out += 4;
+        src += 3;
+        len -= 3;
+    }
+    while (len > 0) {
+        enc->carry[enc->carry_len++] = *src++;
+        len--;
+    }
+    return out - dst;
+}
+
+size_t base64_enc_finish(base64_enc_t *enc, char *dst)
+{
+    if (enc->carry_len == 0) {
+        return 0;
+    }
+    uint32_t v = enc->carry[0] << 16;
+    if (enc->carry_len > 1) {
+        v |= enc->carry[1] << 8;
+    }
+    dst[0] = base64_alphabet[(v >> 18) & 0x3f];
+    dst[1] = base64_alphabet[(v >> 12) & 0x3f];
+    dst[2] = enc->carry_len > 1 ? base64_alphabet[(v >> 6) & 0x3f] : '=';
+    dst[3] = '=';
+    enc->carry_len = 0;
+    return 4;
+}
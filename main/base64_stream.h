@@ -0,0 +1,81 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _BASE64_STREAM_H_
+#define _BASE64_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Worst case output of base64_enc_update() for `len` input bytes (including the carried bytes)
+ */
+#define BASE64_ENC_MAX_OUT(len)     ((((len) + 2) / 3 + 1) * 4)
+
+/**
+ * Streaming base64 encoder state, carries the 0-2 input bytes that did not make a full group
+ */
+typedef struct {
+    uint8_t carry[3];
+    int     carry_len;
+} base64_enc_t;
+
+/**
+ * @brief      Reset the encoder state
+ *
+ * @param      enc   The encoder
+ */
+void base64_enc_init(base64_enc_t *enc);
+
+/**
+ * @brief      Encode the next part of the stream, keeping the incomplete group for the next call
+ *
+ * @param      enc   The encoder
+ * @param[in]  src   The input data
+ * @param[in]  len   The input length
+ * @param      dst   The output, at least BASE64_ENC_MAX_OUT(len) bytes
+ *
+ * @return     Number of characters written to `dst`
+ */
+size_t base64_enc_update(base64_enc_t *enc, const uint8_t *src, size_t len, char *dst);
+
+/**
+ * @brief      Flush the carried bytes with padding
+ *
+ * @param      enc   The encoder
+ * @param      dst   The output, at least 4 bytes
+ *
+ * @return     Number of characters written to `dst` (0 or 4)
+ */
+size_t base64_enc_finish(base64_enc_t *enc, char *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
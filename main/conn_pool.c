@@ -0,0 +1,514 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "esp_crt_bundle.h"
+#include "sdkconfig.h"
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+#include "mbedtls/ssl.h"
+#endif
+#include "audio_error.h"
+#include "audio_mem.h"
+#include "conn_pool.h"
+
+static const char *TAG = "CONN_POOL";
+
+#define CONN_POOL_QUEUE_LEN     (4)
+#define CONN_POOL_CHECK_MS      (5000)
+
+typedef struct {
+    conn_pool_target_t  target;
+    char                host[CONN_POOL_HOST_MAX];
+    bool                quit;
+} conn_pool_req_t;
+
+typedef struct {
+    char                        host[CONN_POOL_HOST_MAX];
+    int                         port;
+    esp_tls_client_session_t    *session;
+} conn_pool_session_t;
+
+typedef struct {
+    SemaphoreHandle_t   lock;
+    SemaphoreHandle_t   handshake_lock; /* One handshake at a time, it also guards the sessions */
+    SemaphoreHandle_t   task_exit;
+    QueueHandle_t       queue;
+    int                 idle_timeout_ms;
+    conn_pool_conn_t    *idle[CONN_POOL_MAX_IDLE];
+    conn_pool_session_t sessions[CONN_POOL_MAX_SESSIONS];
+    int                 next_session;   /* Slot replaced when the table is full */
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    int                 (*bundle_verify)(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags);
+    bool                cert_verified;  /* The last handshake checked the server certificate */
+#endif
+    conn_pool_stats_t   stats;
+} conn_pool_t;
+
+static conn_pool_t *s_pool;
+static SemaphoreHandle_t s_init_lock;
+
+static bool _conn_alive(conn_pool_conn_t *conn)
+{
+    char c;
+    int ret = recv(conn->sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (ret == 0) {
+        return false;
+    }
+    return ret > 0 || errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+static void _conn_close(conn_pool_conn_t *conn)
+{
+    if (conn->user_free && conn->user_data) {
+        conn->user_free(conn->user_data);
+    }
+    if (conn->tls) {
+        esp_tls_conn_destroy(conn->tls);
+    } else if (conn->sock >= 0) {
+        close(conn->sock);
+    }
+    audio_free(conn);
+}
+
+static bool _conn_matches(conn_pool_conn_t *conn, const conn_pool_target_t *target)
+{
+    return conn->port == target->port && conn->plain_text == target->plain_text
+           && strncmp(conn->host, target->host, CONN_POOL_HOST_MAX) == 0;
+}
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+static conn_pool_session_t *_session_find(const char *host, int port)
+{
+    for (int i = 0; i < CONN_POOL_MAX_SESSIONS; i++) {
+        conn_pool_session_t *s = &s_pool->sessions[i];
+        if (s->session && s->port == port && strncmp(s->host, host, CONN_POOL_HOST_MAX) == 0) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static void _session_save(conn_pool_conn_t *conn)
+{
+    esp_tls_client_session_t *session = esp_tls_get_client_session(conn->tls);
+    if (session == NULL) {
+        return;
+    }
+    conn_pool_session_t *s = _session_find(conn->host, conn->port);
+    if (s == NULL) {
+        s = &s_pool->sessions[s_pool->next_session];
+        s_pool->next_session = (s_pool->next_session + 1) % CONN_POOL_MAX_SESSIONS;
+    }
+    if (s->session) {
+        esp_tls_free_client_session(s->session);
+    }
+    snprintf(s->host, CONN_POOL_HOST_MAX, "%s", conn->host);
+    s->port = conn->port;
+    s->session = session;
+}
+
+/*
+ * ESP-TLS does not say whether the server took the ticket. A resumed handshake skips the server
+ * certificate, so the verify callback of the bundle is wrapped to see the full ones. Both run under
+ * the handshake lock.
+ */
+static int _verify_cert(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    s_pool->cert_verified = true;
+    return s_pool->bundle_verify ? s_pool->bundle_verify(ctx, crt, depth, flags) : 0;
+}
+
+static esp_err_t _crt_bundle_attach(void *conf)
+{
+    mbedtls_ssl_config *ssl_conf = (mbedtls_ssl_config *)conf;
+    esp_err_t ret = esp_crt_bundle_attach(conf);
+    if (ret == ESP_OK) {
+        s_pool->bundle_verify = ssl_conf->MBEDTLS_PRIVATE(f_vrfy);
+        mbedtls_ssl_conf_verify(ssl_conf, _verify_cert, ssl_conf->MBEDTLS_PRIVATE(p_vrfy));
+    }
+    return ret;
+}
+#endif
+
+static esp_err_t _open_plain(conn_pool_conn_t *conn)
+{
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    char port[8];
+    snprintf(port, sizeof(port), "%d", conn->port);
+    if (getaddrinfo(conn->host, port, &hints, &res) != 0 || res == NULL) {
+        ESP_LOGE(TAG, "Failed to resolve %s", conn->host);
+        return ESP_FAIL;
+    }
+    conn->sock = socket(res->ai_family, res->ai_socktype, 0);
+    int ret = conn->sock < 0 ? -1 : connect(conn->sock, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    return ret == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t _open_tls(conn_pool_conn_t *conn, const conn_pool_target_t *target, int timeout_ms, bool *resumed)
+{
+    esp_tls_cfg_t tls_cfg = {
+        .alpn_protos = target->alpn_protos,
+        .timeout_ms = timeout_ms,
+        .skip_common_name = target->skip_common_name,
+    };
+    if (target->cacert_pem) {
+        tls_cfg.cacert_buf = (const unsigned char *)target->cacert_pem;
+        tls_cfg.cacert_bytes = strlen(target->cacert_pem) + 1;
+    } else {
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        tls_cfg.crt_bundle_attach = _crt_bundle_attach;
+#else
+        tls_cfg.crt_bundle_attach = esp_crt_bundle_attach;
+#endif
+    }
+    conn->tls = esp_tls_init();
+    AUDIO_MEM_CHECK(TAG, conn->tls, return ESP_FAIL);
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(s_pool->handshake_lock, portMAX_DELAY);
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    conn_pool_session_t *s = _session_find(conn->host, conn->port);
+    tls_cfg.client_session = s ? s->session : NULL;
+    s_pool->cert_verified = false;
+#endif
+    if (esp_tls_conn_new_sync(conn->host, strlen(conn->host), conn->port, &tls_cfg, conn->tls) != 1) {
+        ret = ESP_FAIL;
+    } else {
+        esp_tls_get_conn_sockfd(conn->tls, &conn->sock);
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        /* Not known with a PEM CA, whose check is not wrapped */
+        *resumed = s != NULL && target->cacert_pem == NULL && !s_pool->cert_verified;
+        _session_save(conn);
+#endif
+    }
+    xSemaphoreGive(s_pool->handshake_lock);
+    return ret;
+}
+
+static conn_pool_conn_t *_open(const conn_pool_target_t *target, int timeout_ms)
+{
+    conn_pool_conn_t *conn = audio_calloc(1, sizeof(conn_pool_conn_t));
+    AUDIO_MEM_CHECK(TAG, conn, return NULL);
+    snprintf(conn->host, CONN_POOL_HOST_MAX, "%s", target->host);
+    conn->port = target->port;
+    conn->plain_text = target->plain_text;
+    conn->sock = -1;
+
+    bool resumed = false;
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = target->plain_text ? _open_plain(conn)
+                    : _open_tls(conn, target, timeout_ms > 0 ? timeout_ms : CONN_POOL_CONNECT_TIMEOUT_MS, &resumed);
+    uint32_t elapsed_ms = (esp_timer_get_time() - start) / 1000;
+
+    xSemaphoreTake(s_pool->lock, portMAX_DELAY);
+    if (ret == ESP_OK) {
+        s_pool->stats.handshakes++;
+        s_pool->stats.resumed += resumed;
+        s_pool->stats.last_handshake_ms = elapsed_ms;
+        s_pool->stats.total_handshake_ms += elapsed_ms;
+    } else {
+        s_pool->stats.failures++;
+    }
+    xSemaphoreGive(s_pool->lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d", conn->host, conn->port);
+        _conn_close(conn);
+        return NULL;
+    }
+    ESP_LOGI(TAG, "Connected to %s:%d in %d ms%s", conn->host, conn->port, (int)elapsed_ms, resumed ? " (resumed)" : "");
+    return conn;
+}
+
+static conn_pool_conn_t *_take_idle(const conn_pool_target_t *target)
+{
+    conn_pool_conn_t *conn = NULL;
+    xSemaphoreTake(s_pool->lock, portMAX_DELAY);
+    for (int i = 0; i < CONN_POOL_MAX_IDLE; i++) {
+        if (s_pool->idle[i] && _conn_matches(s_pool->idle[i], target)) {
+            conn = s_pool->idle[i];
+            s_pool->idle[i] = NULL;
+            break;
+        }
+    }
+    xSemaphoreGive(s_pool->lock);
+    return conn;
+}
+
+static bool _has_idle(const conn_pool_target_t *target)
+{
+    bool found = false;
+    xSemaphoreTake(s_pool->lock, portMAX_DELAY);
+    for (int i = 0; i < CONN_POOL_MAX_IDLE && !found; i++) {
+        found = s_pool->idle[i] && _conn_matches(s_pool->idle[i], target);
+    }
+    xSemaphoreGive(s_pool->lock);
+    return found;
+}
+
+static void _prune(void)
+{
+    conn_pool_conn_t *expired[CONN_POOL_MAX_IDLE];
+    int num_expired = 0;
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_pool->lock, portMAX_DELAY);
+    for (int i = 0; i < CONN_POOL_MAX_IDLE; i++) {
+        conn_pool_conn_t *conn = s_pool->idle[i];
+        if (conn && (now - conn->idle_since > (int64_t)s_pool->idle_timeout_ms * 1000 || !_conn_alive(conn))) {
+            expired[num_expired++] = conn;
+            s_pool->idle[i] = NULL;
+            s_pool->stats.dropped++;
+        }
+    }
+    xSemaphoreGive(s_pool->lock);
+    for (int i = 0; i < num_expired; i++) {
+        ESP_LOGD(TAG, "Closing idle connection to %s", expired[i]->host);
+        _conn_close(expired[i]);
+    }
+}
+
+static void _conn_pool_task(void *pv)
+{
+    conn_pool_req_t req;
+    while (1) {
+        if (xQueueReceive(s_pool->queue, &req, pdMS_TO_TICKS(CONN_POOL_CHECK_MS)) == pdTRUE) {
+            if (req.quit) {
+                break;
+            }
+            req.target.host = req.host;
+            if (!_has_idle(&req.target)) {
+                conn_pool_conn_t *conn = _open(&req.target, 0);
+                if (conn) {
+                    xSemaphoreTake(s_pool->lock, portMAX_DELAY);
+                    s_pool->stats.preconnects++;
+                    xSemaphoreGive(s_pool->lock);
+                    conn_pool_put(conn, true);
+                }
+            }
+        }
+        _prune();
+    }
+    xSemaphoreGive(s_pool->task_exit);
+    vTaskDelete(NULL);
+}
+
+/* Created on first use, the pool may be started by several tasks at once */
+static SemaphoreHandle_t _init_lock(void)
+{
+    SemaphoreHandle_t lock = __atomic_load_n(&s_init_lock, __ATOMIC_ACQUIRE);
+    if (lock == NULL) {
+        SemaphoreHandle_t created = xSemaphoreCreateMutex();
+        AUDIO_MEM_CHECK(TAG, created, return NULL);
+        if (__atomic_compare_exchange_n(&s_init_lock, &lock, created, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            lock = created;
+        } else {
+            vSemaphoreDelete(created);
+        }
+    }
+    return lock;
+}
+
+static esp_err_t _pool_create(conn_pool_cfg_t *config)
+{
+    conn_pool_t *pool = audio_calloc(1, sizeof(conn_pool_t));
+    AUDIO_MEM_CHECK(TAG, pool, return ESP_FAIL);
+    pool->idle_timeout_ms = config && config->idle_timeout_ms > 0 ? config->idle_timeout_ms : CONN_POOL_IDLE_TIMEOUT_MS;
+    pool->lock = xSemaphoreCreateMutex();
+    pool->handshake_lock = xSemaphoreCreateMutex();
+    pool->task_exit = xSemaphoreCreateBinary();
+    pool->queue = xQueueCreate(CONN_POOL_QUEUE_LEN, sizeof(conn_pool_req_t));
+    AUDIO_MEM_CHECK(TAG, pool->lock && pool->handshake_lock && pool->task_exit && pool->queue, goto _pool_init_exit);
+    __atomic_store_n(&s_pool, pool, __ATOMIC_RELEASE);
+    int task_stack = config && config->task_stack > 0 ? config->task_stack : CONN_POOL_TASK_STACK;
+    if (xTaskCreate(_conn_pool_task, "conn_pool", task_stack, NULL, 3, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Error create conn_pool task");
+        __atomic_store_n(&s_pool, NULL, __ATOMIC_RELEASE);
+        goto _pool_init_exit;
+    }
+    return ESP_OK;
+_pool_init_exit:
+    if (pool->lock) {
+        vSemaphoreDelete(pool->lock);
+    }
+    if (pool->handshake_lock) {
+        vSemaphoreDelete(pool->handshake_lock);
+    }
+    if (pool->task_exit) {
+        vSemaphoreDelete(pool->task_exit);
+    }
+    if (pool->queue) {
+        vQueueDelete(pool->queue);
+    }
+    audio_free(pool);
+    return ESP_FAIL;
+}
+
+esp_err_t conn_pool_init(conn_pool_cfg_t *config)
+{
+    if (__atomic_load_n(&s_pool, __ATOMIC_ACQUIRE)) {
+        return ESP_OK;
+    }
+    SemaphoreHandle_t init_lock = _init_lock();
+    if (init_lock == NULL) {
+        return ESP_FAIL;
+    }
+    xSemaphoreTake(init_lock, portMAX_DELAY);
+    esp_err_t ret = s_pool ? ESP_OK : _pool_create(config);
+    xSemaphoreGive(init_lock);
+    return ret;
+}
+
+void conn_pool_deinit(void)
+{
+    SemaphoreHandle_t init_lock = _init_lock();
+    if (init_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(init_lock, portMAX_DELAY);
+    if (s_pool == NULL) {
+        xSemaphoreGive(init_lock);
+        return;
+    }
+    conn_pool_req_t req = { .quit = true };
+    xQueueSend(s_pool->queue, &req, portMAX_DELAY);
+    xSemaphoreTake(s_pool->task_exit, portMAX_DELAY);
+    for (int i = 0; i < CONN_POOL_MAX_IDLE; i++) {
+        if (s_pool->idle[i]) {
+            _conn_close(s_pool->idle[i]);
+        }
+    }
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    for (int i = 0; i < CONN_POOL_MAX_SESSIONS; i++) {
+        if (s_pool->sessions[i].session) {
+            esp_tls_free_client_session(s_pool->sessions[i].session);
+        }
+    }
+#endif
+    vSemaphoreDelete(s_pool->lock);
+    vSemaphoreDelete(s_pool->handshake_lock);
+    vSemaphoreDelete(s_pool->task_exit);
+    vQueueDelete(s_pool->queue);
+    audio_free(s_pool);
+    __atomic_store_n(&s_pool, NULL, __ATOMIC_RELEASE);
+    xSemaphoreGive(init_lock);
+}
+
+conn_pool_conn_t *conn_pool_connect(const conn_pool_target_t *target, int timeout_ms)
+{
+    if (conn_pool_init(NULL) != ESP_OK) {
+        return NULL;
+    }
+    return _open(target, timeout_ms);
+}
+
+conn_pool_conn_t *conn_pool_get(const conn_pool_target_t *target, int timeout_ms)
+{
+    conn_pool_conn_t *conn;
+    if (conn_pool_init(NULL) != ESP_OK) {
+        return NULL;
+    }
+    while ((conn = _take_idle(target)) != NULL) {
+        bool alive = _conn_alive(conn);
+        xSemaphoreTake(s_pool->lock, portMAX_DELAY);
+        if (alive) {
+            s_pool->stats.reused++;
+        } else {
+            s_pool->stats.dropped++;
+        }
+        xSemaphoreGive(s_pool->lock);
+        if (alive) {
+            conn->reused = true;
+            return conn;
+        }
+        _conn_close(conn);
+    }
+    return _open(target, timeout_ms);
+}
+
+void conn_pool_put(conn_pool_conn_t *conn, bool reusable)
+{
+    if (conn == NULL) {
+        return;
+    }
+    if (!reusable || s_pool == NULL || !_conn_alive(conn)) {
+        _conn_close(conn);
+        return;
+    }
+    conn_pool_conn_t *oldest = NULL;
+    int slot = -1;
+    conn->idle_since = esp_timer_get_time();
+    conn->reused = false;
+    xSemaphoreTake(s_pool->lock, portMAX_DELAY);
+    for (int i = 0; i < CONN_POOL_MAX_IDLE; i++) {
+        if (s_pool->idle[i] == NULL) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 || s_pool->idle[i]->idle_since < s_pool->idle[slot]->idle_since) {
+            slot = i;
+        }
+    }
+    oldest = s_pool->idle[slot];
+    s_pool->idle[slot] = conn;
+    xSemaphoreGive(s_pool->lock);
+    if (oldest) {
+        _conn_close(oldest);
+    }
+}
+
+esp_err_t conn_pool_preconnect(const conn_pool_target_t *target)
+{
+    if (conn_pool_init(NULL) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    conn_pool_req_t req = {
+        .target = *target,
+    };
+    snprintf(req.host, CONN_POOL_HOST_MAX, "%s", target->host);
+    return xQueueSend(s_pool->queue, &req, 0) == pdTRUE ? ESP_OK : ESP_FAIL;
+}
+
+void conn_pool_get_stats(conn_pool_stats_t *stats)
+{
+    if (s_pool == NULL) {
+        memset(stats, 0, sizeof(conn_pool_stats_t));
+        return;
+    }
+    xSemaphoreTake(s_pool->lock, portMAX_DELAY);
+    *stats = s_pool->stats;
+    xSemaphoreGive(s_pool->lock);
+}
@@ -0,0 +1,160 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _CONN_POOL_H_
+#define _CONN_POOL_H_
+
+#include "esp_err.h"
+#include "esp_tls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONN_POOL_HOST_MAX          (64)
+#define CONN_POOL_MAX_IDLE          (4)
+#define CONN_POOL_MAX_SESSIONS      (4)
+#define CONN_POOL_IDLE_TIMEOUT_MS   (120*1000)
+#define CONN_POOL_CONNECT_TIMEOUT_MS (10*1000)
+#define CONN_POOL_TASK_STACK        (6*1024)
+
+/**
+ * Server a connection is made to. Pointers other than `host` must stay valid while the
+ * pool may connect to the target (including preconnects).
+ */
+typedef struct {
+    const char  *host;              /*!< Server host */
+    int         port;               /*!< Server port */
+    bool        plain_text;         /*!< TCP without TLS (local stand-in servers only) */
+    const char  **alpn_protos;      /*!< ALPN protocols, NULL for none */
+    const char  *cacert_pem;        /*!< CA of a local stand-in server, NULL for the certificate bundle */
+    bool        skip_common_name;   /*!< Do not check the server name (local stand-in servers only) */
+} conn_pool_target_t;
+
+/**
+ * A pooled connection
+ */
+typedef struct {
+    esp_tls_t   *tls;               /*!< TLS connection, NULL for plain text */
+    int         sock;               /*!< Socket */
+    bool        reused;             /*!< Taken warm from the pool */
+    void        *user_data;         /*!< Protocol state kept with the connection while idle, e.g. an HTTP/2 session */
+    void        (*user_free)(void *user_data); /*!< Frees `user_data` when the connection is closed */
+    char        host[CONN_POOL_HOST_MAX];
+    int         port;
+    bool        plain_text;
+    int64_t     idle_since;
+} conn_pool_conn_t;
+
+/**
+ * Connection pool configurations
+ */
+typedef struct {
+    int idle_timeout_ms;            /*!< Idle connections are closed after this, 0 for CONN_POOL_IDLE_TIMEOUT_MS */
+    int task_stack;                 /*!< Preconnect task stack size, 0 for CONN_POOL_TASK_STACK */
+} conn_pool_cfg_t;
+
+/**
+ * Connection pool counters
+ */
+typedef struct {
+    uint32_t handshakes;            /*!< New connections */
+    uint32_t resumed;               /*!< New TLS connections the server resumed from a saved session ticket (not told apart with `cacert_pem`) */
+    uint32_t reused;                /*!< Connections taken warm from the pool */
+    uint32_t preconnects;           /*!< Connections opened ahead of time */
+    uint32_t dropped;               /*!< Idle connections closed by the server or expired */
+    uint32_t failures;              /*!< Failed connection attempts */
+    uint32_t last_handshake_ms;     /*!< Duration of the last connection setup */
+    uint32_t total_handshake_ms;    /*!< Sum of all connection setups */
+} conn_pool_stats_t;
+
+/**
+ * @brief      Start the connection pool, it is also started with defaults by the first
+ *             conn_pool_get. Only the first of concurrent calls creates it.
+ *
+ * @param      config  The configuration, NULL for defaults
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t conn_pool_init(conn_pool_cfg_t *config);
+
+/**
+ * @brief      Close all idle connections, forget the sessions and stop the pool
+ */
+void conn_pool_deinit(void);
+
+/**
+ * @brief      Get a connection to the target
+ *
+ *             A live idle connection is returned if there is one, otherwise a new one is
+ *             made, resuming the last TLS session with the host when a ticket was saved.
+ *
+ * @param[in]  target      The target
+ * @param[in]  timeout_ms  Connect timeout, 0 for CONN_POOL_CONNECT_TIMEOUT_MS
+ *
+ * @return     The connection, NULL on failure
+ */
+conn_pool_conn_t *conn_pool_get(const conn_pool_target_t *target, int timeout_ms);
+
+/**
+ * @brief      Make a new connection to the target, never reusing an idle one
+ */
+conn_pool_conn_t *conn_pool_connect(const conn_pool_target_t *target, int timeout_ms);
+
+/**
+ * @brief      Give a connection back
+ *
+ * @param      conn      The connection
+ * @param[in]  reusable  Keep it for the next request, otherwise (or when the pool is full)
+ *                       it is closed
+ */
+void conn_pool_put(conn_pool_conn_t *conn, bool reusable);
+
+/**
+ * @brief      Open a connection to the target in the background if there is no idle one,
+ *             call it while the device is idle
+ *
+ * @param[in]  target  The target, `host` is copied
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t conn_pool_preconnect(const conn_pool_target_t *target);
+
+/**
+ * @brief      Get the pool counters
+ *
+ * @param[out] stats  The counters
+ */
+void conn_pool_get_stats(conn_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <math.h>
+#include <string.h>
+#include "esp_log.h"
+#include "audio_element.h"
+#include "audio_common.h"
+#include "audio_mem.h"
+#include "decimator.h"
+
+static const char *TAG = "DECIMATOR";
+
+/* Input samples taken per process call */
+#define DECIMATOR_BLOCK_SAMPLES     (512)
+
+typedef struct decimator {
+    int         factor;
+    int         taps;           /* Even, the coefficients are symmetric */
+    int16_t     *coef;          /* First half only, Q15 */
+    int16_t     *buf;           /* taps - 1 samples of history, then the new block */
+    int         fill;           /* Bytes of new input after the history */
+    int         next;           /* Index in buf of the newest sample of the next output */
+    int16_t     *out;
+} decimator_t;
+
+static float _bessel_i0(float x)
+{
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+        if (term < sum * 1e-7f) {
+            break;
+        }
+    }
+    return sum;
+}
+
+static void _design(decimator_t *dec)
+{
+    int n = dec->taps;
+    float fc = DECIMATOR_PASSBAND_RATIO / dec->factor;    /* Cutoff in cycles per input sample */
+    float center = (n - 1) / 2.0f;
+    float i0_beta = _bessel_i0(DECIMATOR_KAISER_BETA);
+    float h[n / 2];
+    float sum = 0;
+    for (int k = 0; k < n / 2; k++) {
+        float t = k - center;
+        float r = t / center;
+        float window = _bessel_i0(DECIMATOR_KAISER_BETA * sqrtf(1.0f - r * r)) / i0_beta;
+        h[k] = 2 * fc * sinf(2 * M_PI * fc * t) / (2 * M_PI * fc * t) * window;
+        sum += 2 * h[k];
+    }
+    /* Unity gain at DC */
+    for (int k = 0; k < n / 2; k++) {
+        dec->coef[k] = (int16_t)lrintf(h[k] / sum * 32768.0f);
+    }
+}
+
+static esp_err_t _decimator_open(audio_element_handle_t self)
+{
+    decimator_t *dec = (decimator_t *)audio_element_getdata(self);
+    memset(dec->buf, 0, (dec->taps - 1) * sizeof(int16_t));
+    dec->fill = 0;
+    dec->next = dec->taps - 1;
+    return ESP_OK;
+}
+
+static audio_element_err_t _decimator_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    decimator_t *dec = (decimator_t *)audio_element_getdata(self);
+    int hist = dec->taps - 1;
+    int half = dec->taps / 2;
+    char *in = (char *)(dec->buf + hist) + dec->fill;
+    int r_size = audio_element_input(self, in, DECIMATOR_BLOCK_SAMPLES * sizeof(int16_t) - dec->fill);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    dec->fill += r_size;
+    int avail = hist + dec->fill / 2;
+    int out_n = 0;
+    int pos = dec->next;
+    for (; pos < avail; pos += dec->factor) {
+        /* x[pos - k] and x[pos - taps + 1 + k] share coef[k] */
+        const int16_t *a = dec->buf + pos;
+        const int16_t *b = dec->buf + pos - dec->taps + 1;
+        int32_t acc = 1 << 14;
+        for (int k = 0; k < half; k++) {
+            acc += dec->coef[k] * (a[-k] + b[k]);
+        }
+        acc >>= 15;
+        dec->out[out_n++] = acc > INT16_MAX ? INT16_MAX : acc < INT16_MIN ? INT16_MIN : acc;
+    }
+    /* Keep the history and a trailing odd byte */
+    int keep_from = avail - hist;
+    memmove(dec->buf, dec->buf + keep_from, hist * sizeof(int16_t) + (dec->fill & 1));
+    dec->next = pos - keep_from;
+    dec->fill &= 1;
+    if (out_n > 0) {
+        int w_size = audio_element_output(self, (char *)dec->out, out_n * sizeof(int16_t));
+        if (w_size < 0) {
+            return w_size;
+        }
+    }
+    return r_size;
+}
+
+static esp_err_t _decimator_destroy(audio_element_handle_t self)
+{
+    decimator_t *dec = (decimator_t *)audio_element_getdata(self);
+    audio_free(dec->coef);
+    audio_free(dec->buf);
+    audio_free(dec->out);
+    audio_free(dec);
+    return ESP_OK;
+}
+
+audio_element_handle_t decimator_init(decimator_cfg_t *config)
+{
+    if (config->dst_rate <= 0 || config->src_rate <= config->dst_rate || config->src_rate % config->dst_rate) {
+        ESP_LOGE(TAG, "Cannot decimate %d Hz to %d Hz", config->src_rate, config->dst_rate);
+        return NULL;
+    }
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    audio_element_handle_t el;
+    decimator_t *dec = audio_calloc(1, sizeof(decimator_t));
+    AUDIO_MEM_CHECK(TAG, dec, return NULL);
+    dec->factor = config->src_rate / config->dst_rate;
+    dec->taps = DECIMATOR_TAPS_PER_PHASE * dec->factor;
+    dec->coef = audio_malloc(dec->taps / 2 * sizeof(int16_t));
+    dec->buf = audio_malloc((dec->taps - 1 + DECIMATOR_BLOCK_SAMPLES) * sizeof(int16_t));
+    dec->out = audio_malloc((DECIMATOR_BLOCK_SAMPLES / dec->factor + 1) * sizeof(int16_t));
+    AUDIO_MEM_CHECK(TAG, dec->coef && dec->buf && dec->out, goto _decimator_init_exit);
+    _design(dec);
+
+    cfg.open = _decimator_open;
+    cfg.process = _decimator_process;
+    cfg.destroy = _decimator_destroy;
+    cfg.task_stack = config->task_stack > 0 ? config->task_stack : DECIMATOR_TASK_STACK;
+    cfg.tag = "decimator";
+    el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, goto _decimator_init_exit);
+    audio_element_setdata(el, dec);
+    return el;
+_decimator_init_exit:
+    audio_free(dec->coef);
+    audio_free(dec->buf);
+    audio_free(dec->out);
+    audio_free(dec);
+    return NULL;
+}
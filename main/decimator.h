@@ -0,0 +1,66 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _DECIMATOR_H_
+#define _DECIMATOR_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DECIMATOR_TAPS_PER_PHASE    (32)    /*!< Filter length is this times the decimation factor */
+#define DECIMATOR_PASSBAND_RATIO    (0.45f) /*!< Cutoff, as a fraction of the output rate */
+#define DECIMATOR_KAISER_BETA       (6.0f)  /*!< About 60 dB stopband attenuation */
+#define DECIMATOR_TASK_STACK        (3*1024)
+
+/**
+ * Decimator configurations
+ */
+typedef struct {
+    int src_rate;       /*!< Input sample rate, 16-bit mono */
+    int dst_rate;       /*!< Output sample rate, `src_rate` must be a multiple of it */
+    int task_stack;     /*!< Element task stack size, 0 for default */
+} decimator_cfg_t;
+
+/**
+ * @brief      Create an audio element that lowers the sample rate by an integer factor
+ *
+ *             A Kaiser-windowed linear phase FIR low-pass in Q15 is evaluated only at the
+ *             kept output samples, using its symmetry to halve the multiplications.
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle, NULL if the rates are not an integer ratio
+ */
+audio_element_handle_t decimator_init(decimator_cfg_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
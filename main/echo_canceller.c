@@ -0,0 +1,239 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <math.h>
+#include <string.h>
+#include "esp_log.h"
+#include "audio_element.h"
+#include "audio_common.h"
+#include "audio_mem.h"
+#include "ringbuf.h"
+#include "echo_canceller.h"
+
+static const char *TAG = "ECHO_CANCELLER";
+
+/* NLMS step size and regularization per tap (in squared 16-bit sample units) */
+#define AEC_MU                  (0.5f)
+#define AEC_DELTA_PER_TAP       (100.0f)
+/* Geigel double-talk detector: near end louder than this share of the far-end peak */
+#define AEC_GEIGEL_THRESHOLD    (0.5f)
+/* Far-end mean square below this (about -60 dBFS) counts as silence */
+#define AEC_FAR_END_MIN_POWER   (1000.0f)
+/* ERLE power smoothing per frame */
+#define AEC_ERLE_SMOOTH         (0.05f)
+
+typedef struct echo_canceller {
+    int                 sample_rate;
+    int                 taps;
+    int                 delay;
+    int                 hist_len;       /* delay + taps + 1 */
+    float               *w;
+    float               *hist;          /* Far-end history, twice, newest first from `pos` */
+    int                 pos;
+    ringbuf_handle_t    ref_rb;
+    int16_t             mic[ECHO_CANCELLER_FRAME_SAMPLES];
+    int16_t             ref[ECHO_CANCELLER_FRAME_SAMPLES];
+    int                 fill;
+    int                 hold;           /* Samples left with adaptation frozen */
+    float               pd;             /* Smoothed microphone and residual power */
+    float               pe;
+    echo_canceller_stats_t stats;
+} echo_canceller_t;
+
+static void _push_far_end(echo_canceller_t *aec, float x)
+{
+    aec->pos = aec->pos ? aec->pos - 1 : aec->hist_len - 1;
+    aec->hist[aec->pos] = x;
+    aec->hist[aec->pos + aec->hist_len] = x;
+}
+
+static void _process_frame(echo_canceller_t *aec)
+{
+    int n = ECHO_CANCELLER_FRAME_SAMPLES;
+    int taps = aec->taps;
+    /* Far-end energy and peak over the filter window, updated per sample below */
+    float energy = 0, peak = 0;
+    const float *x = aec->hist + aec->pos + aec->delay;
+    for (int k = 0; k < taps; k++) {
+        energy += x[k] * x[k];
+        peak = fabsf(x[k]) > peak ? fabsf(x[k]) : peak;
+    }
+    float frame_d = 0, frame_e = 0;
+    bool active = false;
+    for (int i = 0; i < n; i++) {
+        _push_far_end(aec, aec->ref[i]);
+        x = aec->hist + aec->pos + aec->delay;
+        energy += x[0] * x[0] - x[taps] * x[taps];
+        energy = energy > 0 ? energy : 0;
+        peak = fabsf(x[0]) > peak ? fabsf(x[0]) : peak;
+
+        float d = aec->mic[i];
+        /* Four partial sums keep the FPU pipeline busy, taps is a multiple of 4 */
+        float y0 = 0, y1 = 0, y2 = 0, y3 = 0;
+        for (int k = 0; k < taps; k += 4) {
+            y0 += aec->w[k] * x[k];
+            y1 += aec->w[k + 1] * x[k + 1];
+            y2 += aec->w[k + 2] * x[k + 2];
+            y3 += aec->w[k + 3] * x[k + 3];
+        }
+        float e = d - ((y0 + y1) + (y2 + y3));
+        bool far_end = energy > AEC_FAR_END_MIN_POWER * taps;
+        active |= far_end;
+        if (far_end && fabsf(d) > AEC_GEIGEL_THRESHOLD * peak) {
+            aec->hold = taps;
+        }
+        if (aec->hold > 0) {
+            aec->hold--;
+        } else if (far_end) {
+            float g = AEC_MU * e / (energy + AEC_DELTA_PER_TAP * taps);
+            for (int k = 0; k < taps; k++) {
+                aec->w[k] += g * x[k];
+            }
+        }
+        frame_d += d * d;
+        frame_e += e * e;
+        aec->mic[i] = e > INT16_MAX ? INT16_MAX : e < INT16_MIN ? INT16_MIN : (int16_t)lrintf(e);
+    }
+    aec->stats.far_end_active = active;
+    aec->stats.double_talk = aec->hold > 0;
+    if (active && aec->hold == 0) {
+        aec->pd += AEC_ERLE_SMOOTH * (frame_d - aec->pd);
+        aec->pe += AEC_ERLE_SMOOTH * (frame_e - aec->pe);
+        aec->stats.erle_db = 10 * log10f((aec->pd + 1) / (aec->pe + 1));
+    }
+}
+
+static esp_err_t _aec_open(audio_element_handle_t self)
+{
+    echo_canceller_t *aec = (echo_canceller_t *)audio_element_getdata(self);
+    aec->fill = 0;
+    aec->hold = 0;
+    return ESP_OK;
+}
+
+static audio_element_err_t _aec_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    echo_canceller_t *aec = (echo_canceller_t *)audio_element_getdata(self);
+    int r_size = audio_element_input(self, (char *)aec->mic + aec->fill, sizeof(aec->mic) - aec->fill);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    aec->fill += r_size;
+    if (aec->fill < (int)sizeof(aec->mic)) {
+        return r_size;
+    }
+    aec->fill = 0;
+
+    /* The far end is consumed in step with the microphone, silence when nothing plays */
+    int ref_len = rb_bytes_filled(aec->ref_rb) & ~1;
+    ref_len = ref_len < (int)sizeof(aec->ref) ? ref_len : (int)sizeof(aec->ref);
+    if (ref_len <= 0 || rb_read(aec->ref_rb, (char *)aec->ref, ref_len, 0) != ref_len) {
+        ref_len = 0;
+    }
+    memset((char *)aec->ref + ref_len, 0, sizeof(aec->ref) - ref_len);
+    _process_frame(aec);
+
+    int w_size = audio_element_output(self, (char *)aec->mic, sizeof(aec->mic));
+    return w_size < 0 ? w_size : r_size;
+}
+
+static esp_err_t _aec_destroy(audio_element_handle_t self)
+{
+    echo_canceller_t *aec = (echo_canceller_t *)audio_element_getdata(self);
+    if (aec->ref_rb) {
+        rb_destroy(aec->ref_rb);
+    }
+    audio_free(aec->w);
+    audio_free(aec->hist);
+    audio_free(aec);
+    return ESP_OK;
+}
+
+esp_err_t echo_canceller_feed_reference(audio_element_handle_t self, const void *buf, int len)
+{
+    echo_canceller_t *aec = (echo_canceller_t *)audio_element_getdata(self);
+    if (rb_bytes_available(aec->ref_rb) < len || rb_write(aec->ref_rb, (char *)buf, len, 0) != len) {
+        aec->stats.ref_dropped += len;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t echo_canceller_get_stats(audio_element_handle_t self, echo_canceller_stats_t *stats)
+{
+    echo_canceller_t *aec = self ? (echo_canceller_t *)audio_element_getdata(self) : NULL;
+    if (aec == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int peak = 0;
+    for (int k = 1; k < aec->taps; k++) {
+        if (fabsf(aec->w[k]) > fabsf(aec->w[peak])) {
+            peak = k;
+        }
+    }
+    *stats = aec->stats;
+    stats->peak_ms = (aec->delay + peak) * 1000 / aec->sample_rate;
+    return ESP_OK;
+}
+
+audio_element_handle_t echo_canceller_init(echo_canceller_cfg_t *config)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    audio_element_handle_t el;
+    echo_canceller_t *aec = audio_calloc(1, sizeof(echo_canceller_t));
+    AUDIO_MEM_CHECK(TAG, aec, return NULL);
+    aec->sample_rate = config->sample_rate > 0 ? config->sample_rate : 16000;
+    int tail_ms = config->tail_ms > 0 ? config->tail_ms : ECHO_CANCELLER_TAIL_MS;
+    int ref_buffer_ms = config->ref_buffer_ms > 0 ? config->ref_buffer_ms : ECHO_CANCELLER_REF_BUFFER_MS;
+    aec->taps = (aec->sample_rate * tail_ms / 1000 + 3) & ~3;
+    aec->delay = config->ref_delay_ms > 0 ? aec->sample_rate * config->ref_delay_ms / 1000 : 0;
+    aec->hist_len = aec->delay + aec->taps + 1;
+    aec->w = audio_calloc(aec->taps, sizeof(float));
+    aec->hist = audio_calloc(2 * aec->hist_len, sizeof(float));
+    aec->ref_rb = rb_create(aec->sample_rate * 2 * ref_buffer_ms / 1000, 1);
+    AUDIO_MEM_CHECK(TAG, aec->w && aec->hist && aec->ref_rb, goto _aec_init_exit);
+
+    cfg.open = _aec_open;
+    cfg.process = _aec_process;
+    cfg.destroy = _aec_destroy;
+    cfg.task_stack = config->task_stack > 0 ? config->task_stack : ECHO_CANCELLER_TASK_STACK;
+    if (config->task_prio > 0) {
+        cfg.task_prio = config->task_prio;
+    }
+    cfg.tag = "aec";
+    el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, goto _aec_init_exit);
+    audio_element_setdata(el, aec);
+    ESP_LOGD(TAG, "%d taps, far end delayed by %d samples", aec->taps, aec->delay);
+    return el;
+_aec_init_exit:
+    if (aec->ref_rb) {
+        rb_destroy(aec->ref_rb);
+    }
+    audio_free(aec->w);
+    audio_free(aec->hist);
+    audio_free(aec);
+    return NULL;
+}
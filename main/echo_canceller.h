@@ -0,0 +1,107 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _ECHO_CANCELLER_H_
+#define _ECHO_CANCELLER_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ECHO_CANCELLER_TAIL_MS          (32)    /*!< Echo path covered by the adaptive filter */
+#define ECHO_CANCELLER_REF_BUFFER_MS    (250)   /*!< Far-end audio buffered ahead of the microphone */
+#define ECHO_CANCELLER_FRAME_SAMPLES    (64)
+#define ECHO_CANCELLER_TASK_STACK       (3*1024)
+
+/**
+ * Echo canceller configurations, microphone and far-end are 16-bit mono at the same rate
+ */
+typedef struct {
+    int     sample_rate;        /*!< Sample rate */
+    int     tail_ms;            /*!< Adaptive filter length, 0 for ECHO_CANCELLER_TAIL_MS */
+    int     ref_delay_ms;       /*!< Far-end delay before the filter, for playback paths longer than the tail */
+    int     ref_buffer_ms;      /*!< Far-end buffer, 0 for ECHO_CANCELLER_REF_BUFFER_MS */
+    int     task_stack;         /*!< Element task stack size, 0 for default */
+    int     task_prio;          /*!< Element task priority, 0 for default */
+} echo_canceller_cfg_t;
+
+/**
+ * Echo canceller state
+ */
+typedef struct {
+    float       erle_db;        /*!< Echo return loss enhancement, smoothed over the far-end activity */
+    bool        far_end_active; /*!< The last frame had far-end audio */
+    bool        double_talk;    /*!< Adaptation is frozen because the near end talks */
+    int         peak_ms;        /*!< Position of the strongest filter tap, the measured echo delay
+                                     within the tail, see `ref_delay_ms` */
+    uint32_t    ref_dropped;    /*!< Far-end bytes dropped because the buffer was full */
+} echo_canceller_stats_t;
+
+/**
+ * @brief      Create an audio element removing the echo of the far-end audio from the microphone
+ *
+ *             A normalized LMS filter models the loudspeaker to microphone path. Adaptation
+ *             stops while the Geigel detector sees the near end talking. The far-end audio is
+ *             read in step with the microphone; without it the input passes unchanged.
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle
+ */
+audio_element_handle_t echo_canceller_init(echo_canceller_cfg_t *config);
+
+/**
+ * @brief      Give the canceller the audio being played, from the playback task
+ *
+ * @param      self  The echo canceller element
+ * @param[in]  buf   16-bit mono samples
+ * @param[in]  len   Length in bytes
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL  The buffer was full, the audio is dropped
+ */
+esp_err_t echo_canceller_feed_reference(audio_element_handle_t self, const void *buf, int len);
+
+/**
+ * @brief      Get the echo canceller state
+ *
+ * @param      self   The echo canceller element
+ * @param[out] stats  The stats
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t echo_canceller_get_stats(audio_element_handle_t self, echo_canceller_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
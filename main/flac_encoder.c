@@ -0,0 +1,422 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_element.h"
+#include "audio_common.h"
+#include "audio_mem.h"
+#include "flac_encoder.h"
+
+static const char *TAG = "FLAC_ENCODER";
+
+#define FLAC_MAX_FIXED_ORDER        (4)
+#define FLAC_MAX_PARTITION_ORDER    (6)
+#define FLAC_MAX_RICE_PARAM         (14)    /* 15 is the escape code */
+#define FLAC_FRAME_OVERHEAD         (32)
+
+typedef struct {
+    uint8_t     *buf;
+    int         pos;
+    uint64_t    acc;
+    int         acc_bits;
+} bit_writer_t;
+
+typedef struct flac_encoder {
+    int         sample_rate;
+    int         block_size;
+    int16_t     *pcm;
+    int         pcm_fill;           /* Bytes of the current block */
+    int32_t     *residual;
+    uint8_t     *out;
+    uint32_t    frame_number;
+    bool        header_pending;
+} flac_encoder_t;
+
+static uint16_t crc16_table[256];
+
+static void _crc16_table_init()
+{
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = i << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1;
+        }
+        crc16_table[i] = crc;
+    }
+}
+
+static uint16_t _crc16(const uint8_t *data, int len)
+{
+    uint16_t crc = 0;
+    for (int i = 0; i < len; i++) {
+        crc = (crc << 8) ^ crc16_table[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+static uint8_t _crc8(const uint8_t *data, int len)
+{
+    uint8_t crc = 0;
+    for (int i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static inline void _put_bits(bit_writer_t *bw, uint32_t value, int bits)
+{
+    bw->acc = (bw->acc << bits) | (value & (uint32_t)((1ULL << bits) - 1));
+    bw->acc_bits += bits;
+    while (bw->acc_bits >= 8) {
+        bw->acc_bits -= 8;
+        bw->buf[bw->pos++] = (uint8_t)(bw->acc >> bw->acc_bits);
+    }
+}
+
+static inline void _put_rice(bit_writer_t *bw, uint32_t u, int k)
+{
+    uint32_t q = u >> k;
+    if (q + 1 + k <= 32) {
+        _put_bits(bw, (1u << k) | (u & ((1u << k) - 1)), q + 1 + k);
+        return;
+    }
+    for (; q >= 32; q -= 32) {
+        _put_bits(bw, 0, 32);
+    }
+    _put_bits(bw, 1, q + 1);
+    if (k) {
+        _put_bits(bw, u, k);
+    }
+}
+
+static void _align(bit_writer_t *bw)
+{
+    if (bw->acc_bits) {
+        _put_bits(bw, 0, 8 - bw->acc_bits);
+    }
+}
+
+static void _put_utf8(bit_writer_t *bw, uint32_t v)
+{
+    if (v < 0x80) {
+        _put_bits(bw, v, 8);
+        return;
+    }
+    int extra = v < 0x800 ? 1 : v < 0x10000 ? 2 : v < 0x200000 ? 3 : v < 0x4000000 ? 4 : 5;
+    /* Leading byte: extra + 1 ones, a zero, then the top bits of the value */
+    _put_bits(bw, ((1u << (extra + 1)) - 1) << 1, extra + 2);
+    _put_bits(bw, v >> (6 * extra), 8 - (extra + 2));
+    for (int i = extra - 1; i >= 0; i--) {
+        _put_bits(bw, 0x80 | ((v >> (6 * i)) & 0x3F), 8);
+    }
+}
+
+static int _sample_rate_code(int sample_rate)
+{
+    switch (sample_rate) {
+        case 8000:  return 4;
+        case 16000: return 5;
+        case 22050: return 6;
+        case 24000: return 7;
+        case 32000: return 8;
+        case 44100: return 9;
+        case 48000: return 10;
+        default:    return 0;   /* From STREAMINFO */
+    }
+}
+
+static int _write_stream_header(flac_encoder_t *enc, uint8_t *out)
+{
+    bit_writer_t bw = { .buf = out };
+    memcpy(out, "fLaC", 4);
+    bw.pos = 4;
+    _put_bits(&bw, 0x80, 8);                    /* Last metadata block, STREAMINFO */
+    _put_bits(&bw, 34, 24);
+    _put_bits(&bw, enc->block_size, 16);        /* Min block size */
+    _put_bits(&bw, enc->block_size, 16);        /* Max block size */
+    _put_bits(&bw, 0, 24);                      /* Min frame size, unknown */
+    _put_bits(&bw, 0, 24);                      /* Max frame size, unknown */
+    _put_bits(&bw, enc->sample_rate, 20);
+    _put_bits(&bw, 0, 3);                       /* Mono */
+    _put_bits(&bw, 15, 5);                      /* 16 bits per sample */
+    _put_bits(&bw, 0, 4);                       /* Total samples, unknown */
+    _put_bits(&bw, 0, 32);
+    memset(bw.buf + bw.pos, 0, 16);             /* MD5 not computed */
+    return bw.pos + 16;
+}
+
+static int _best_fixed_order(const int16_t *x, int n)
+{
+    uint64_t sum[FLAC_MAX_FIXED_ORDER + 1] = { 0 };
+    for (int i = FLAC_MAX_FIXED_ORDER; i < n; i++) {
+        int32_t e0 = x[i];
+        int32_t e1 = e0 - x[i - 1];
+        int32_t e2 = e1 - (x[i - 1] - x[i - 2]);
+        int32_t e3 = e2 - (x[i - 1] - 2 * x[i - 2] + x[i - 3]);
+        int32_t e4 = e3 - (x[i - 1] - 3 * x[i - 2] + 3 * x[i - 3] - x[i - 4]);
+        sum[0] += e0 < 0 ? -e0 : e0;
+        sum[1] += e1 < 0 ? -e1 : e1;
+        sum[2] += e2 < 0 ? -e2 : e2;
+        sum[3] += e3 < 0 ? -e3 : e3;
+        sum[4] += e4 < 0 ? -e4 : e4;
+    }
+    int order = 0;
+    for (int o = 1; o <= FLAC_MAX_FIXED_ORDER; o++) {
+        if (sum[o] < sum[order]) {
+            order = o;
+        }
+    }
+    return order;
+}
+
+static void _fixed_residual(const int16_t *x, int n, int order, int32_t *res)
+{
+    for (int i = order; i < n; i++) {
+        switch (order) {
+            case 0: res[i] = x[i]; break;
+            case 1: res[i] = x[i] - x[i - 1]; break;
+            case 2: res[i] = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+            case 3: res[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+            default: res[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+        }
+        /* Zigzag, so the Rice coder only sees unsigned values */
+        res[i] = (res[i] << 1) ^ (res[i] >> 31);
+    }
+}
+
+static uint32_t _rice_cost(int count, uint64_t sum, int *param)
+{
+    uint64_t best = UINT64_MAX;
+    for (int k = 0; k <= FLAC_MAX_RICE_PARAM; k++) {
+        uint64_t cost = (uint64_t)count * (k + 1) + (sum >> k);
+        if (cost < best) {
+            best = cost;
+            *param = k;
+        }
+    }
+    return best > UINT32_MAX ? UINT32_MAX : (uint32_t)best;
+}
+
+/* Returns the estimated residual size in bits, an upper bound of the real size */
+static uint32_t _best_partitions(const uint32_t *u, int n, int order, int *porder, int *params)
+{
+    uint64_t sums[1 << FLAC_MAX_PARTITION_ORDER];
+    int max_order = 0;
+    while (max_order < FLAC_MAX_PARTITION_ORDER && (n % (2 << max_order)) == 0
+            && (n >> (max_order + 1)) > order) {
+        max_order++;
+    }
+    int parts = 1 << max_order;
+    int part_len = n >> max_order;
+    for (int p = 0; p < parts; p++) {
+        uint64_t s = 0;
+        for (int i = p == 0 ? order : p * part_len; i < (p + 1) * part_len; i++) {
+            s += u[i];
+        }
+        sums[p] = s;
+    }
+
+    uint32_t best = UINT32_MAX;
+    int tmp[1 << FLAC_MAX_PARTITION_ORDER];
+    for (int po = max_order; po >= 0; po--) {
+        parts = 1 << po;
+        part_len = n >> po;
+        uint32_t bits = 0;
+        for (int p = 0; p < parts; p++) {
+            bits += 4 + _rice_cost(part_len - (p == 0 ? order : 0), sums[p], &tmp[p]);
+        }
+        if (bits < best) {
+            best = bits;
+            *porder = po;
+            memcpy(params, tmp, parts * sizeof(int));
+        }
+        for (int p = 0; p < parts / 2; p++) {
+            sums[p] = sums[2 * p] + sums[2 * p + 1];
+        }
+    }
+    return best;
+}
+
+static int _encode_frame(flac_encoder_t *enc, const int16_t *x, int n)
+{
+    bit_writer_t bw = { .buf = enc->out };
+
+    _put_bits(&bw, 0xFFF8, 16);                 /* Sync code, fixed block size */
+    _put_bits(&bw, 7, 4);                       /* Block size - 1 follows as 16 bits */
+    _put_bits(&bw, _sample_rate_code(enc->sample_rate), 4);
+    _put_bits(&bw, 0, 4);                       /* Mono */
+    _put_bits(&bw, 4, 3);                       /* 16 bits per sample */
+    _put_bits(&bw, 0, 1);
+    _put_utf8(&bw, enc->frame_number++);
+    _put_bits(&bw, n - 1, 16);
+    _put_bits(&bw, _crc8(bw.buf, bw.pos), 8);
+
+    bool constant = true;
+    for (int i = 1; i < n && constant; i++) {
+        constant = x[i] == x[0];
+    }
+    if (constant) {
+        _put_bits(&bw, 0x00, 8);                /* Pad bit, SUBFRAME_CONSTANT, no wasted bits */
+        _put_bits(&bw, (uint16_t)x[0], 16);
+    } else {
+        int order = n > FLAC_MAX_FIXED_ORDER * 2 ? _best_fixed_order(x, n) : -1;
+        int porder = 0;
+        int params[1 << FLAC_MAX_PARTITION_ORDER];
+        uint32_t bits = UINT32_MAX;
+        if (order >= 0) {
+            _fixed_residual(x, n, order, enc->residual);
+            bits = 6 + 16 * order + _best_partitions((uint32_t *)enc->residual, n, order, &porder, params);
+        }
+        if (bits >= (uint32_t)(16 * n)) {
+            _put_bits(&bw, 0x02, 8);            /* SUBFRAME_VERBATIM */
+            for (int i = 0; i < n; i++) {
+                _put_bits(&bw, (uint16_t)x[i], 16);
+            }
+        } else {
+            _put_bits(&bw, (0x08 | order) << 1, 8); /* SUBFRAME_FIXED */
+            for (int i = 0; i < order; i++) {
+                _put_bits(&bw, (uint16_t)x[i], 16);
+            }
+            _put_bits(&bw, 0, 2);               /* Rice coding, 4-bit parameters */
+            _put_bits(&bw, porder, 4);
+            const uint32_t *u = (const uint32_t *)enc->residual;
+            int part_len = n >> porder;
+            for (int p = 0; p < (1 << porder); p++) {
+                int k = params[p];
+                _put_bits(&bw, k, 4);
+                for (int i = p == 0 ? order : p * part_len; i < (p + 1) * part_len; i++) {
+                    _put_rice(&bw, u[i], k);
+                }
+            }
+        }
+    }
+    _align(&bw);
+    _put_bits(&bw, _crc16(bw.buf, bw.pos), 16);
+    return bw.pos;
+}
+
+static int _flac_output_block(audio_element_handle_t self, flac_encoder_t *enc, int samples)
+{
+    if (enc->header_pending) {
+        int len = _write_stream_header(enc, enc->out);
+        int ret = audio_element_output(self, (char *)enc->out, len);
+        if (ret < 0) {
+            return ret;
+        }
+        enc->header_pending = false;
+    }
+    int len = _encode_frame(enc, enc->pcm, samples);
+    return audio_element_output(self, (char *)enc->out, len);
+}
+
+static esp_err_t _flac_open(audio_element_handle_t self)
+{
+    flac_encoder_t *enc = (flac_encoder_t *)audio_element_getdata(self);
+    enc->pcm_fill = 0;
+    enc->frame_number = 0;
+    enc->header_pending = true;
+    return ESP_OK;
+}
+
+static esp_err_t _flac_close(audio_element_handle_t self)
+{
+    return ESP_OK;
+}
+
+static audio_element_err_t _flac_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    flac_encoder_t *enc = (flac_encoder_t *)audio_element_getdata(self);
+    int block_bytes = enc->block_size * sizeof(int16_t);
+    int r_size = audio_element_input(self, (char *)enc->pcm + enc->pcm_fill, block_bytes - enc->pcm_fill);
+    if (r_size <= 0) {
+        /* Flush the last, shorter block at the end of the stream */
+        if (r_size == AEL_IO_DONE && enc->pcm_fill >= (int)sizeof(int16_t)) {
+            int ret = _flac_output_block(self, enc, enc->pcm_fill / sizeof(int16_t));
+            enc->pcm_fill = 0;
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        return r_size;
+    }
+    enc->pcm_fill += r_size;
+    if (enc->pcm_fill < block_bytes) {
+        return r_size;
+    }
+    enc->pcm_fill = 0;
+    int ret = _flac_output_block(self, enc, enc->block_size);
+    return ret < 0 ? ret : r_size;
+}
+
+static esp_err_t _flac_destroy(audio_element_handle_t self)
+{
+    flac_encoder_t *enc = (flac_encoder_t *)audio_element_getdata(self);
+    audio_free(enc->pcm);
+    audio_free(enc->residual);
+    audio_free(enc->out);
+    audio_free(enc);
+    return ESP_OK;
+}
+
+audio_element_handle_t flac_encoder_init(flac_encoder_cfg_t *config)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    audio_element_handle_t el;
+    flac_encoder_t *enc = audio_calloc(1, sizeof(flac_encoder_t));
+    AUDIO_MEM_CHECK(TAG, enc, return NULL);
+
+    enc->sample_rate = config->sample_rate > 0 ? config->sample_rate : 16000;
+    enc->block_size = config->block_size > 0 ? config->block_size : FLAC_ENCODER_BLOCK_SIZE;
+    if (enc->block_size % 16 || enc->block_size > FLAC_ENCODER_MAX_BLOCK_SIZE) {
+        ESP_LOGE(TAG, "Invalid block size %d", enc->block_size);
+        audio_free(enc);
+        return NULL;
+    }
+    enc->pcm = audio_malloc(enc->block_size * sizeof(int16_t));
+    enc->residual = audio_malloc(enc->block_size * sizeof(int32_t));
+    enc->out = audio_malloc(enc->block_size * sizeof(int16_t) + FLAC_FRAME_OVERHEAD);
+    AUDIO_MEM_CHECK(TAG, enc->pcm && enc->residual && enc->out, goto _flac_init_exit);
+    _crc16_table_init();
+
+    cfg.open = _flac_open;
+    cfg.close = _flac_close;
+    cfg.process = _flac_process;
+    cfg.destroy = _flac_destroy;
+    cfg.task_stack = config->task_stack > 0 ? config->task_stack : FLAC_ENCODER_TASK_STACK;
+    cfg.tag = "flac";
+    el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, goto _flac_init_exit);
+    audio_element_setdata(el, enc);
+    return el;
+_flac_init_exit:
+    audio_free(enc->pcm);
+    audio_free(enc->residual);
+    audio_free(enc->out);
+    audio_free(enc);
+    return NULL;
+}
@@ -0,0 +1,68 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _FLAC_ENCODER_H_
+#define _FLAC_ENCODER_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLAC_ENCODER_BLOCK_SIZE     (1024)
+#define FLAC_ENCODER_MAX_BLOCK_SIZE (4096)
+#define FLAC_ENCODER_TASK_STACK     (3*1024)
+
+/**
+ * FLAC encoder configurations
+ */
+typedef struct {
+    int sample_rate;    /*!< Sample rate of the 16-bit mono input */
+    int block_size;     /*!< Samples per frame, a multiple of 16 up to FLAC_ENCODER_MAX_BLOCK_SIZE, 0 for default */
+    int task_stack;     /*!< Element task stack size */
+} flac_encoder_cfg_t;
+
+/**
+ * @brief      Create an audio element encoding 16-bit mono PCM to a FLAC stream
+ *
+ *             Each frame uses the best of the fixed linear predictors (order 0 to 4) with
+ *             partitioned Rice coding of the residual, or a constant/verbatim subframe when
+ *             that is smaller. The stream header is written when the element opens and
+ *             leaves the total sample count and MD5 unset, as the length is not known in
+ *             advance.
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle
+ */
+audio_element_handle_t flac_encoder_init(flac_encoder_cfg_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -25,10 +25,10 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
-#include "mbedtls/base64.h"
 
 #include "esp_http_client.h"
 #include "sdkconfig.h"
@@ -38,96 +38,136 @@
 #include "audio_common.h"
 #include "audio_hal.h"
 #include "http_stream.h"
+#include "ringbuf.h"
+#include "audio_mem.h"
 #include "i2s_stream.h"
 #include "mp3_decoder.h"
 #include "google_sr.h"
-#include "wav_encoder.h"
-#include "json_utils.h"
+#include "google_sr_stream.h"
+#include "base64_stream.h"
+#include "http_chunk_writer.h"
+#include "flac_encoder.h"
+#include "opus_encoder.h"
+#include "sr_response_parser.h"
+#include "vad_filter.h"
+#include "decimator.h"
+#include "mic_frontend.h"
+#include "echo_canceller.h"
+#include "wake_word.h"
+#include "mem_arena.h"
+#include "voice_trace.h"
 
 static const char *TAG = "GOOGLE_SR";
 
 #define GOOGLE_SR_ENDPOINT  "https://speech.googleapis.com/v1/speech:recognize?key=%s"
 
-#define GOOGLE_SR_CONFIG           "{\"encoding\":\"LINEAR16\",\"sampleRateHertz\":16000,\"languageCode\":\"en-US\"}"
-#define GOOGLE_SR_BEGIN            "{\"config\": " GOOGLE_SR_CONFIG ", \"audio\": {\"content\":\""
+#define GOOGLE_SR_SAMPLE_RATE      (16000)
+#define GOOGLE_SR_CONFIG           "{\"encoding\":\"%s\",\"sampleRateHertz\":%d,\"languageCode\":\"%s\"}"
+#define GOOGLE_SR_BEGIN_CONFIG     "{\"config\": " GOOGLE_SR_CONFIG ","
+#define GOOGLE_SR_BEGIN_AUDIO      " \"audio\": {\"content\":\""
 #define GOOGLE_SR_END              "\"}}"
 #define GOOGLE_SR_TASK_STACK (8*1024)
-
-typedef struct {
-    const char* transcript;
-    double confidence;
-} alternative_t;
-
-typedef struct {
-    alternative_t alternative;
-    const char* result_end_time;
-    const char* language_code;
-} result_t;
-
-typedef struct {
-    result_t result;
-    const char* total_billed_time;
-    int request_id;
-} google_sr_response_t;
-
-char response_text[512]; // Assuming a maximum length for the JSON string
+#define GOOGLE_SR_CAPTURE_TASK_PRIO (6)
+/* Live audio buffered while the connection is still opening */
+#define GOOGLE_SR_CONNECT_BUFFER_MS (2000)
+#define GOOGLE_SR_DRAIN_TIMEOUT_MS  (10*1000)
+/* The base64 chunk holds at least a few encoder groups */
+#define GOOGLE_SR_BUFFER_MIN        (256)
+/* Internal event, sent to the listener behind the reports of a collected run */
+#define SR_EVENT_RUN_COLLECTED      (0x100)
 
 static const char* encoding_map[] = {
-    "LINEAR16"
+    [ENCODING_LINEAR16] = "LINEAR16",
+    [ENCODING_FLAC] = "FLAC",
+    [ENCODING_OGG_OPUS] = "OGG_OPUS",
 };
 
-typedef struct google_sr {
+typedef enum {
+    SR_SESSION_IDLE = 0,
+    SR_SESSION_BUSY,        /* The request is running */
+    SR_SESSION_DONE,        /* The result is ready, waiting for the earlier sessions to be reported */
+} sr_session_state_t;
+
+/* One request: its pipeline, upload buffer and result. Sessions are used round robin, so a
+ * new utterance is captured while the previous ones still upload and wait for the response */
+typedef struct sr_session {
+    struct google_sr*       sr;
+    int                     id;
+    sr_session_state_t      state;
+    bool                    report;         /* Report the final transcript, false once google_sr_stop returned it */
+    uint32_t                runs_collected; /* Runs collected, each followed by a SR_EVENT_RUN_COLLECTED marker */
+    uint32_t                runs_drained;   /* Markers received back: the reports of those runs are all consumed */
     audio_pipeline_handle_t pipeline;
-    int                     remain_len;
-    int                     sr_total_write;
+    ringbuf_handle_t        upload_rb;      /* Captured audio waiting for the request */
+    bool                    upload_overrun;
+    base64_enc_t            b64_enc;
     bool                    is_begin;
     char*                   buffer;
-    char*                   b64_buffer;
-    audio_element_handle_t  i2s_reader;
+    char*                   b64_buffer;     /* Chunks of the upload are gathered here */
+    http_chunk_writer_t     upload;
     audio_element_handle_t  encoder;
+    audio_element_handle_t  vad;
+    audio_element_handle_t  decimator;
     audio_element_handle_t  http_stream_writer;
+    char*                   result_arena;
+    google_sr_result_t      result;
+    sr_response_parser_t    parser;
+} sr_session_t;
+
+typedef struct google_sr {
+    audio_pipeline_handle_t capture;
+    SemaphoreHandle_t       capture_lock;
+    char*                   preroll;        /* Ring of the latest captured audio */
+    int                     preroll_size;
+    int                     preroll_pos;
+    int                     preroll_filled;
+    int                     upload_rb_size;
+    sr_session_t*           capturing;      /* The session live audio goes to, NULL when none */
+    sr_session_t            sessions[GOOGLE_SR_MAX_SESSIONS];
+    int                     num_sessions;
+    int                     next_id;
+    int                     next_report;    /* Results are reported in the order the sessions started */
+    sr_session_t*           latest;         /* The last started session */
+    sr_session_t*           last_result;    /* The session of google_sr_get_result */
+    audio_element_handle_t  i2s_reader;
+    audio_element_handle_t  frontend;
+    audio_element_handle_t  aec;
+    audio_element_handle_t  wake_word;
+    audio_event_iface_handle_t evt;
     char*                   lang_code;
     char*                   api_key;
-    int                     sample_rates;
+    int                     sample_rates;   /* Sample rate sent to the server */
+    int                     capture_rate;
+    int                     capture_bytes_per_ms;
     int                     buffer_size;
+    int                     upload_flush_size;
+    int                     upload_flush_ms;
+    int                     result_arena_size;
     google_sr_encoding_t    encoding;
-    char*                   response_text;
     google_sr_event_handle_t on_begin;
+    bool                    streaming;
+    bool                    vad_auto_stop;
+    google_sr_result_handle_t on_result;
+    mem_arena_handle_t      mem;
 } google_sr_t;
 
 
-static int _http_write_chunk(esp_http_client_handle_t http, const char *buffer, int len)
-{
-    char header_chunk_buffer[16];
-    int header_chunk_len = sprintf(header_chunk_buffer, "%x\r\n", len);
-    if (esp_http_client_write(http, header_chunk_buffer, header_chunk_len) <= 0) {
-        return ESP_FAIL;
-    }
-    int write_len = esp_http_client_write(http, buffer, len);
-    if (write_len <= 0) {
-        ESP_LOGE(TAG, "Error write chunked content");
-        return ESP_FAIL;
-    }
-    if (esp_http_client_write(http, "\r\n", 2) <= 0) {
-        return ESP_FAIL;
-    }
-    return write_len;
-}
-
 static esp_err_t _http_stream_writer_event_handle(http_stream_event_msg_t* msg)
 {
     esp_http_client_handle_t http = (esp_http_client_handle_t)msg->http_client;
-    google_sr_t* sr = (google_sr_t*)msg->user_data;
+    sr_session_t* session = (sr_session_t*)msg->user_data;
+    google_sr_t* sr = session->sr;
 
-    int write_len;
+    int read_len;
     size_t need_write = 0;
 
     if (msg->event_id == HTTP_STREAM_PRE_REQUEST) {
         // set header
-        ESP_LOGI(TAG, "[ + ] HTTP client HTTP_STREAM_PRE_REQUEST, lenght=%d", msg->buffer_len);
-        sr->sr_total_write = 0;
-        sr->is_begin = true;
-        sr->remain_len = 0;
+        ESP_LOGI(TAG, "[ + ] HTTP client HTTP_STREAM_PRE_REQUEST, session=%d", session->id);
+        session->is_begin = true;
+        base64_enc_init(&session->b64_enc);
+        http_chunk_writer_init(&session->upload, http, session->b64_buffer, sr->buffer_size,
+                               sr->upload_flush_size, sr->upload_flush_ms);
         esp_http_client_set_method(http, HTTP_METHOD_POST);
         esp_http_client_set_post_field(http, NULL, -1); // Chunk content
         esp_http_client_set_header(http, "Content-Type", "application/json");
@@ -135,146 +175,532 @@ static esp_err_t _http_stream_writer_event_handle(http_stream_event_msg_t* msg)
     }
 
     if (msg->event_id == HTTP_STREAM_ON_REQUEST) {
-        // ESP_LOGI(TAG, "[ + ] HTTP client HTTP_STREAM_ON_REQUEST, lenght=%d, begin=%d", msg->buffer_len, sr->is_begin);
-        /* Write first chunk */
-        if (sr->is_begin) {
-            sr->is_begin = false;
-            //int sr_begin_len = snprintf(sr->buffer, sr->buffer_size, GOOGLE_SR_BEGIN, sr->lang_code, encoding_map[sr->encoding], sr->sample_rates);
-            int sr_begin_len = snprintf(sr->buffer, sr->buffer_size, GOOGLE_SR_BEGIN);
-            ESP_LOGI(TAG, GOOGLE_SR_BEGIN);
+        http_chunk_writer_t *upload = &session->upload;
+        if (session->is_begin) {
+            session->is_begin = false;
+            /* The request head goes out with the first audio. Spaces pad it to a multiple of 4,
+             * so the audio behind it is still encoded a word at a time */
+            char *head = http_chunk_writer_tail(upload);
+            int head_max = http_chunk_writer_room(upload);
+            int audio_len = strlen(GOOGLE_SR_BEGIN_AUDIO);
+            int head_len = snprintf(head, head_max, GOOGLE_SR_BEGIN_CONFIG, encoding_map[sr->encoding], sr->sample_rates, sr->lang_code);
+            int pad = (4 - (head_len + audio_len) % 4) % 4;
+            if (head_len + pad + audio_len >= head_max) {
+                ESP_LOGE(TAG, "Please use SR Buffer size greater than %d", HTTP_CHUNK_BUFFER_SIZE(head_len + pad + audio_len));
+                return ESP_FAIL;
+            }
+            memset(head + head_len, ' ', pad);
+            memcpy(head + head_len + pad, GOOGLE_SR_BEGIN_AUDIO, audio_len);
+            head_len += pad + audio_len;
+            ESP_LOGI(TAG, "%.*s", head_len, head);
+            VOICE_TRACE_MARK(VOICE_TRACE_SR_CONNECTED, 0);
             if (sr->on_begin) {
                 sr->on_begin(sr);
             }
-            return _http_write_chunk(http, sr->buffer, sr_begin_len);
+            if (http_chunk_writer_commit(upload, head_len) != ESP_OK) {
+                return ESP_FAIL;
+            }
         }
 
-        if (msg->buffer_len > sr->buffer_size * 3 / 2) {
-            ESP_LOGE(TAG, "Please use SR Buffer size greeter than %d", msg->buffer_len * 3 / 2);
-            return ESP_FAIL;
+        /* The audio is encoded straight from the pipeline buffer behind the gathered payload, the
+         * incomplete group is carried by the encoder. Inputs larger than the room left are split */
+        for (int pos = 0; pos < msg->buffer_len;) {
+            int in_max = (http_chunk_writer_room(upload) / 4 - 1) * 3;
+            if (in_max <= 0) {
+                if (http_chunk_writer_flush(upload, false) != ESP_OK) {
+                    return ESP_FAIL;
+                }
+                continue;
+            }
+            int in_len = msg->buffer_len - pos < in_max ? msg->buffer_len - pos : in_max;
+            need_write = base64_enc_update(&session->b64_enc, (const uint8_t *)msg->buffer + pos, in_len, http_chunk_writer_tail(upload));
+            pos += in_len;
+            if (http_chunk_writer_commit(upload, need_write) != ESP_OK) {
+                return ESP_FAIL;
+            }
         }
-
-        /* Write b64 audio data */
-        memcpy(sr->buffer + sr->remain_len, msg->buffer, msg->buffer_len);
-        sr->remain_len += msg->buffer_len;
-        int keep_next_time = sr->remain_len % 3;
-
-        sr->remain_len -= keep_next_time;
-        if (mbedtls_base64_encode((unsigned char *)sr->b64_buffer, sr->buffer_size,  &need_write, (unsigned char *)sr->buffer, sr->remain_len) != 0) {
-            ESP_LOGE(TAG, "Error encode b64");
+        /* Small reads are batched, but not held back longer than the flush deadline */
+        if (http_chunk_writer_poll(upload) != ESP_OK) {
             return ESP_FAIL;
         }
-        if (keep_next_time > 0) {
-            memcpy(sr->buffer, sr->buffer + sr->remain_len, keep_next_time);
+        if (upload->writes > 0) {
+            VOICE_TRACE_MARK_ONCE(VOICE_TRACE_SR_FIRST_CHUNK, 0);
         }
-        sr->remain_len = keep_next_time;
-        ESP_LOGI(TAG, "\033[A\33[2K\rTotal bytes written: %d", sr->sr_total_write);
-
-        write_len = _http_write_chunk(http, (const char *)sr->b64_buffer, need_write);
-        if (write_len <= 0) {
-            return write_len;
-        }
-        sr->sr_total_write += write_len;
-        return write_len;
+        return msg->buffer_len;
     }
 
     /* Write End chunk */
     if (msg->event_id == HTTP_STREAM_POST_REQUEST) {
         ESP_LOGI(TAG, "[ + ] HTTP client HTTP_STREAM_POST_REQUEST, write end chunked marker");
-        need_write = 0;
-        if (sr->remain_len) {
-            if (mbedtls_base64_encode((unsigned char *)sr->b64_buffer, sr->buffer_size,  &need_write, (unsigned char *)sr->buffer, sr->remain_len) != 0) {
-                ESP_LOGE(TAG, "Error encode b64");
-                return ESP_FAIL;
-            }
-            write_len = _http_write_chunk(http, (const char *)sr->b64_buffer, need_write);
-            if (write_len <= 0) {
-                return write_len;
-            }
-        }
-        write_len = _http_write_chunk(http, GOOGLE_SR_END, strlen(GOOGLE_SR_END));
-
-        if (write_len <= 0) {
+        http_chunk_writer_t *upload = &session->upload;
+        /* Gathered audio, the last audio group, the JSON end and the end of the chunked body in one write */
+        int end_len = strlen(GOOGLE_SR_END);
+        if (http_chunk_writer_room(upload) < 4 + end_len && http_chunk_writer_flush(upload, false) != ESP_OK) {
             return ESP_FAIL;
         }
-        /* Finish chunked */
-        if (esp_http_client_write(http, "0\r\n\r\n", 5) <= 0) {
+        need_write = base64_enc_finish(&session->b64_enc, http_chunk_writer_tail(upload));
+        memcpy(http_chunk_writer_tail(upload) + need_write, GOOGLE_SR_END, end_len);
+        need_write += end_len;
+        if (http_chunk_writer_end(upload, need_write) != ESP_OK) {
             return ESP_FAIL;
         }
-        return write_len;
+        VOICE_TRACE_MARK(VOICE_TRACE_SR_LAST_CHUNK, upload->payload_bytes / 1024);
+        ESP_LOGI(TAG, "Upload: %u payload bytes, %u bytes in %u writes",
+                 upload->payload_bytes, upload->wire_bytes, upload->writes);
+        return need_write;
     }
 
     if (msg->event_id == HTTP_STREAM_FINISH_REQUEST) {
-        int read_len = esp_http_client_read(http, (char*)sr->buffer, sr->buffer_size);
-        ESP_LOGI(TAG, "[ + ] HTTP client HTTP_STREAM_FINISH_REQUEST, read_len=%d", read_len);
-        if (read_len <= 0) {
+        /* The response can be larger than the scratch buffer, parse it as it arrives */
+        int total_read = 0;
+        sr_response_parser_init(&session->parser, &session->result, session->result_arena, sr->result_arena_size);
+        while ((read_len = esp_http_client_read(http, session->buffer, sr->buffer_size)) > 0) {
+            VOICE_TRACE_MARK_ONCE(VOICE_TRACE_SR_FIRST_RESPONSE, 0);
+            total_read += read_len;
+            if (sr_response_parser_feed(&session->parser, session->buffer, read_len) != ESP_OK) {
+                ESP_LOGE(TAG, "Invalid response at byte %d", total_read);
+                break;
+            }
+        }
+        ESP_LOGI(TAG, "[ + ] HTTP client HTTP_STREAM_FINISH_REQUEST, session=%d, read_len=%d", session->id, total_read);
+        if (total_read <= 0) {
             return ESP_FAIL;
         }
-        if (read_len > sr->buffer_size - 1) {
-            read_len = sr->buffer_size - 1;
+        if (sr_response_parser_finish(&session->parser) != ESP_OK) {
+            ESP_LOGW(TAG, "Incomplete response, %d segment(s) parsed", session->result.num_segments);
         }
-        sr->buffer[read_len] = 0;
-        //ESP_LOGI(TAG, "Got HTTP Response = %s", (char*)sr->buffer);
-        if (sr->response_text) {
-            free(sr->response_text);
+        if (session->result.truncated) {
+            ESP_LOGW(TAG, "Result truncated, consider a larger result_arena_size");
         }
-        sr->response_text = json_get_token_value(sr->buffer, "results");
-        sr->response_text = json_get_token_value(sr->buffer, "alternatives");
-        sr->response_text = json_get_token_value(sr->buffer, "transcript");
         return ESP_OK;
     }
     return ESP_OK;
 }
 
+static void _sr_stream_on_open(void *ctx)
+{
+    google_sr_t* sr = ((sr_session_t*)ctx)->sr;
+    VOICE_TRACE_MARK(VOICE_TRACE_SR_CONNECTED, 0);
+    if (sr->on_begin) {
+        sr->on_begin(sr);
+    }
+}
+
+static void _sr_stream_on_result(void *ctx, const char *text, bool is_final)
+{
+    google_sr_t* sr = ((sr_session_t*)ctx)->sr;
+    ESP_LOGD(TAG, "%s: %s", is_final ? "Final" : "Interim", text);
+    if (sr->on_result) {
+        sr->on_result(sr, text, is_final);
+    }
+}
+
+static void _sr_preroll_write(google_sr_t* sr, const char *buffer, int len)
+{
+    if (len >= sr->preroll_size) {
+        buffer += len - sr->preroll_size;
+        len = sr->preroll_size;
+    }
+    int first = sr->preroll_size - sr->preroll_pos;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(sr->preroll + sr->preroll_pos, buffer, first);
+    memcpy(sr->preroll, buffer + first, len - first);
+    sr->preroll_pos = (sr->preroll_pos + len) % sr->preroll_size;
+    sr->preroll_filled = sr->preroll_filled + len > sr->preroll_size ? sr->preroll_size : sr->preroll_filled + len;
+}
+
+static audio_element_err_t _sr_capture_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    google_sr_t* sr = (google_sr_t*)context;
+    xSemaphoreTake(sr->capture_lock, portMAX_DELAY);
+    sr_session_t *session = sr->capturing;
+    /* Never waits for the request, a slow upload only overruns its own buffer */
+    if (session) {
+        VOICE_TRACE_MARK_ONCE(VOICE_TRACE_SR_FIRST_FRAME, 0);
+        if (rb_write(session->upload_rb, buffer, len, 0) < len && !session->upload_overrun) {
+            session->upload_overrun = true;
+            ESP_LOGW(TAG, "Upload buffer of session %d full, dropping audio", session->id);
+        }
+    }
+    if (sr->preroll_size > 0) {
+        _sr_preroll_write(sr, buffer, len);
+    }
+    xSemaphoreGive(sr->capture_lock);
+    return len;
+}
+
+static void _sr_upload_begin(sr_session_t* session)
+{
+    google_sr_t* sr = session->sr;
+    xSemaphoreTake(sr->capture_lock, portMAX_DELAY);
+    rb_reset(session->upload_rb);
+    /* Oldest pre-roll audio first, then live audio follows from the capture callback */
+    int start = (sr->preroll_pos - sr->preroll_filled + sr->preroll_size) % (sr->preroll_size ? sr->preroll_size : 1);
+    int first = sr->preroll_size - start;
+    if (first > sr->preroll_filled) {
+        first = sr->preroll_filled;
+    }
+    if (first > 0) {
+        rb_write(session->upload_rb, sr->preroll + start, first, 0);
+    }
+    if (sr->preroll_filled > first) {
+        rb_write(session->upload_rb, sr->preroll, sr->preroll_filled - first, 0);
+    }
+    ESP_LOGD(TAG, "Session %d, pre-roll %d ms", session->id, sr->preroll_filled / sr->capture_bytes_per_ms);
+    session->upload_overrun = false;
+    sr->capturing = session;
+    xSemaphoreGive(sr->capture_lock);
+    if (sr->wake_word) {
+        /* Nothing to listen for while capturing */
+        wake_word_set_active(sr->wake_word, false);
+    }
+}
+
+static void _sr_upload_end(sr_session_t* session)
+{
+    google_sr_t* sr = session->sr;
+    xSemaphoreTake(sr->capture_lock, portMAX_DELAY);
+    bool was_capturing = sr->capturing == session;
+    if (was_capturing) {
+        sr->capturing = NULL;
+    }
+    rb_done_write(session->upload_rb);
+    xSemaphoreGive(sr->capture_lock);
+    if (was_capturing && sr->wake_word) {
+        wake_word_set_active(sr->wake_word, true);
+    }
+}
+
+static void _sr_send_event(google_sr_t* sr, int session_id, google_sr_event_t event)
+{
+    audio_event_iface_msg_t msg = {
+        .cmd = event,
+        .data = (void *)(intptr_t)session_id,
+        .source = sr,
+        .source_type = GOOGLE_SR_EVENT_SOURCE_TYPE,
+    };
+    if (audio_event_iface_sendout(sr->evt, &msg) != ESP_OK) {
+        ESP_LOGW(TAG, "Event %d of session %d lost", event, session_id);
+    }
+}
+
+static void _sr_vad_on_event(vad_filter_event_t event, void *ctx)
+{
+    sr_session_t* session = (sr_session_t*)ctx;
+    google_sr_t* sr = session->sr;
+    if (event == VAD_FILTER_SPEECH_END && sr->vad_auto_stop) {
+        /* The request is closing, the next utterance can be captured right away */
+        _sr_upload_end(session);
+    }
+    _sr_send_event(sr, session->id, event == VAD_FILTER_SPEECH_START ? GOOGLE_SR_EVENT_SPEECH_START : GOOGLE_SR_EVENT_SPEECH_END);
+}
+
+static void _sr_wake_word_on_detect(void *ctx)
+{
+    /* Runs in the capture task, the request is started from google_sr_check_event */
+    _sr_send_event((google_sr_t*)ctx, -1, GOOGLE_SR_EVENT_WAKE_WORD);
+}
+
+static sr_session_t *_sr_session_find(google_sr_t *sr, int id)
+{
+    /* Sessions never used have no id */
+    if (id < 0) {
+        return NULL;
+    }
+    for (int i = 0; i < sr->num_sessions; i++) {
+        if (sr->sessions[i].id == id) {
+            return &sr->sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/* The idle session used longest ago, so the latest results stay readable */
+static sr_session_t *_sr_session_pick(google_sr_t *sr)
+{
+    sr_session_t *pick = NULL;
+    for (int i = 0; i < sr->num_sessions; i++) {
+        sr_session_t *session = &sr->sessions[i];
+        if (session->state == SR_SESSION_IDLE && (pick == NULL || session->id < pick->id)) {
+            pick = session;
+        }
+    }
+    return pick;
+}
+
+/* The request has ended or is given `drain` to send what is still buffered, collect its pipeline */
+static void _sr_session_collect(sr_session_t *session, bool drain)
+{
+    google_sr_t *sr = session->sr;
+    _sr_upload_end(session);
+    if (!drain || audio_pipeline_wait_for_stop_with_ticks(session->pipeline, pdMS_TO_TICKS(GOOGLE_SR_DRAIN_TIMEOUT_MS)) != ESP_OK) {
+        audio_pipeline_stop(session->pipeline);
+        audio_pipeline_wait_for_stop(session->pipeline);
+    }
+    if (sr->streaming) {
+        session->result.transcript = sr_stream_get_transcript(session->http_stream_writer);
+    }
+    VOICE_TRACE_MARK(VOICE_TRACE_SR_TRANSCRIPT, session->result.transcript != NULL);
+    ESP_LOGD(TAG, "Session %d transcript: %s", session->id, session->result.transcript ? session->result.transcript : "(none)");
+    session->state = SR_SESSION_DONE;
+    /* Status reports of this run may still be queued at the listener, the marker goes in behind
+     * them: until it comes back, reports of the element are not taken for the next run's end */
+    session->runs_collected++;
+    audio_event_iface_msg_t msg = {
+        .cmd = SR_EVENT_RUN_COLLECTED,
+        .data = session,
+        .data_len = (int)session->runs_collected,
+        .source = sr,
+        .source_type = GOOGLE_SR_EVENT_SOURCE_TYPE,
+    };
+    if (audio_event_iface_sendout(sr->evt, &msg) != ESP_OK) {
+        ESP_LOGW(TAG, "Session %d marker lost, a late report may end its next run", session->id);
+        session->runs_drained = session->runs_collected;
+    }
+}
+
+/* Report the finished sessions in the order they started, a later one waits for the earlier */
+static void _sr_report_done(google_sr_t *sr)
+{
+    while (sr->next_report < sr->next_id) {
+        sr_session_t *session = _sr_session_find(sr, sr->next_report);
+        if (session == NULL || session->state != SR_SESSION_DONE) {
+            break;
+        }
+        session->state = SR_SESSION_IDLE;
+        sr->next_report++;
+        if (session->report) {
+            sr->last_result = session;
+            _sr_send_event(sr, session->id, GOOGLE_SR_EVENT_FINAL_TRANSCRIPT);
+        }
+    }
+}
+
+static esp_err_t _sr_session_init(google_sr_t *sr, sr_session_t *session, google_sr_config_t *config)
+{
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    session->sr = sr;
+    session->id = -1;
+    session->buffer = mem_arena_alloc(sr->mem, sr->buffer_size);
+    session->b64_buffer = mem_arena_alloc(sr->mem, sr->buffer_size);
+    session->result_arena = mem_arena_alloc(sr->mem, sr->result_arena_size);
+    session->upload_rb = rb_create(sr->upload_rb_size, 1);
+    AUDIO_MEM_CHECK(TAG, session->upload_rb, return ESP_FAIL);
+    session->pipeline = audio_pipeline_init(&pipeline_cfg);
+    AUDIO_MEM_CHECK(TAG, session->pipeline, return ESP_FAIL);
+
+    const char* link_tag[4];
+    int link_num = 0;
+    if (sr->sample_rates != sr->capture_rate) {
+        decimator_cfg_t dec_cfg = {
+            .src_rate = sr->capture_rate,
+            .dst_rate = sr->sample_rates,
+        };
+        session->decimator = decimator_init(&dec_cfg);
+        AUDIO_MEM_CHECK(TAG, session->decimator, return ESP_FAIL);
+        audio_pipeline_register(session->pipeline, session->decimator, "sr_decimator");
+        link_tag[link_num++] = "sr_decimator";
+    }
+    if (config->vad_enable) {
+        vad_filter_cfg_t vad_cfg = {
+            .sample_rate = sr->sample_rates,
+            .hangover_ms = config->vad_hangover_ms,
+            .auto_stop = config->vad_auto_stop,
+            .on_event = _sr_vad_on_event,
+            .user_ctx = session,
+        };
+        session->vad = vad_filter_init(&vad_cfg);
+        AUDIO_MEM_CHECK(TAG, session->vad, return ESP_FAIL);
+        audio_pipeline_register(session->pipeline, session->vad, "sr_vad");
+        link_tag[link_num++] = "sr_vad";
+    }
+    if (sr->encoding == ENCODING_FLAC) {
+        flac_encoder_cfg_t flac_cfg = {
+            .sample_rate = sr->sample_rates,
+        };
+        session->encoder = flac_encoder_init(&flac_cfg);
+    } else if (sr->encoding == ENCODING_OGG_OPUS) {
+        opus_encoder_cfg_t opus_cfg = DEFAULT_OPUS_ENCODER_CONFIG();
+        opus_cfg.sample_rate = sr->sample_rates;
+        opus_cfg.channel = 1;
+        opus_cfg.bitrate = GOOGLE_SR_OPUS_BITRATE;
+        session->encoder = encoder_opus_init(&opus_cfg);
+    }
+    if (sr->encoding != ENCODING_LINEAR16) {
+        AUDIO_MEM_CHECK(TAG, session->encoder, return ESP_FAIL);
+        audio_pipeline_register(session->pipeline, session->encoder, "sr_encoder");
+        link_tag[link_num++] = "sr_encoder";
+    }
+
+    if (sr->streaming) {
+        sr_stream_cfg_t stream_cfg = {
+            .api_key = sr->api_key,
+            .lang_code = sr->lang_code,
+            .sample_rate = sr->sample_rates,
+            .encoding = sr->encoding,
+            .interim_results = sr->on_result != NULL,
+            .task_stack = GOOGLE_SR_TASK_STACK,
+            .on_open = _sr_stream_on_open,
+            .on_result = _sr_stream_on_result,
+            .user_ctx = session,
+        };
+        session->http_stream_writer = sr_stream_init(&stream_cfg);
+    } else {
+        http_stream_cfg_t http_cfg = {
+            .type = AUDIO_STREAM_WRITER,
+            .event_handle = _http_stream_writer_event_handle,
+            .user_data = session,
+            .task_stack = GOOGLE_SR_TASK_STACK,
+        };
+        session->http_stream_writer = http_stream_init(&http_cfg);
+    }
+    AUDIO_MEM_CHECK(TAG, session->http_stream_writer, return ESP_FAIL);
+    audio_pipeline_register(session->pipeline, session->http_stream_writer, "sr_http");
+    link_tag[link_num++] = "sr_http";
+    audio_pipeline_link(session->pipeline, &link_tag[0], link_num);
+    audio_element_set_input_ringbuf(audio_pipeline_get_el_by_tag(session->pipeline, link_tag[0]), session->upload_rb);
+    return ESP_OK;
+}
+
 google_sr_handle_t google_sr_init(google_sr_config_t* config)
 {
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     google_sr_t* sr = calloc(1, sizeof(google_sr_t));
     AUDIO_MEM_CHECK(TAG, sr, return NULL);
-    sr->pipeline = audio_pipeline_init(&pipeline_cfg);
 
     sr->buffer_size = config->buffer_size;
     if (sr->buffer_size <= 0) {
         sr->buffer_size = DEFAULT_SR_BUFFER_SIZE;
+    } else if (sr->buffer_size < GOOGLE_SR_BUFFER_MIN) {
+        sr->buffer_size = GOOGLE_SR_BUFFER_MIN;
+    }
+    sr->upload_flush_size = config->upload_flush_size == 0 ? DEFAULT_SR_UPLOAD_FLUSH_SIZE
+                            : config->upload_flush_size < 0 ? 0 : config->upload_flush_size;
+    sr->upload_flush_ms = config->upload_flush_ms == 0 ? DEFAULT_SR_UPLOAD_FLUSH_MS
+                          : config->upload_flush_ms < 0 ? 0 : config->upload_flush_ms;
+
+    sr->result_arena_size = config->result_arena_size;
+    if (sr->result_arena_size <= 0) {
+        sr->result_arena_size = DEFAULT_SR_RESULT_ARENA_SIZE;
     }
+    sr->num_sessions = config->sessions > 0 ? config->sessions : DEFAULT_SR_SESSIONS;
+    if (sr->num_sessions > GOOGLE_SR_MAX_SESSIONS) {
+        sr->num_sessions = GOOGLE_SR_MAX_SESSIONS;
+    }
+    sr->last_result = &sr->sessions[0];
 
-    sr->buffer = malloc(sr->buffer_size);
-    AUDIO_MEM_CHECK(TAG, sr->buffer, goto exit_sr_init);
-    sr->b64_buffer = malloc(sr->buffer_size);
-    AUDIO_MEM_CHECK(TAG, sr->b64_buffer, goto exit_sr_init);
-    sr->lang_code = strdup(config->lang_code);
-    AUDIO_MEM_CHECK(TAG, sr->lang_code, goto exit_sr_init);
-    sr->api_key = strdup(config->api_key);
-    AUDIO_MEM_CHECK(TAG, sr->api_key, goto exit_sr_init);
+    sr->capture_rate = config->record_sample_rates > 0 ? config->record_sample_rates : GOOGLE_SR_SAMPLE_RATE;
+    sr->capture_bytes_per_ms = sr->capture_rate * 2 / 1000;
+    sr->sample_rates = config->narrowband ? GOOGLE_SR_NARROWBAND_RATE : sr->capture_rate;
 
+    int preroll_ms = config->preroll_ms;
+    if (preroll_ms <= 0) {
+        /* The keyword itself has to be in the pre-roll */
+        preroll_ms = config->wake_word_model ? GOOGLE_SR_PREROLL_MAX_MS : DEFAULT_SR_PREROLL_MS;
+    }
+    if (preroll_ms < GOOGLE_SR_PREROLL_MIN_MS) {
+        preroll_ms = GOOGLE_SR_PREROLL_MIN_MS;
+    } else if (preroll_ms > GOOGLE_SR_PREROLL_MAX_MS) {
+        preroll_ms = GOOGLE_SR_PREROLL_MAX_MS;
+    }
+    sr->preroll_size = preroll_ms * sr->capture_bytes_per_ms;
+    sr->upload_rb_size = (preroll_ms + GOOGLE_SR_CONNECT_BUFFER_MS) * sr->capture_bytes_per_ms;
+
+    /* Everything the context keeps is carved from one PSRAM block, none of it is used for DMA */
+    sr->mem = mem_arena_create(sr->num_sessions * (2 * MEM_ARENA_SIZE(sr->buffer_size) + MEM_ARENA_SIZE(sr->result_arena_size))
+                               + MEM_ARENA_SIZE(sr->preroll_size) + MEM_ARENA_SIZE(strlen(config->lang_code) + 1)
+                               + MEM_ARENA_SIZE(strlen(config->api_key) + 1), MEM_ARENA_PREFER_SPIRAM);
+    AUDIO_MEM_CHECK(TAG, sr->mem, goto exit_sr_init);
+    sr->preroll = mem_arena_alloc(sr->mem, sr->preroll_size);
+    sr->lang_code = mem_arena_strdup(sr->mem, config->lang_code);
+    sr->api_key = mem_arena_strdup(sr->mem, config->api_key);
+    sr->capture_lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, sr->capture_lock, goto exit_sr_init);
+
+    /* The microphone is always captured, into the pre-roll ring and the upload buffer of the capturing session */
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.type = AUDIO_STREAM_READER;
     i2s_cfg.i2s_port = 1;
     i2s_cfg.i2s_config.channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT;
+    i2s_cfg.task_prio = GOOGLE_SR_CAPTURE_TASK_PRIO;
     sr->i2s_reader = i2s_stream_init(&i2s_cfg);
-    
-    wav_encoder_cfg_t wav_cfg = DEFAULT_WAV_ENCODER_CONFIG();
-    sr->encoder = wav_encoder_init(&wav_cfg);
-
-    http_stream_cfg_t http_cfg = {
-        .type = AUDIO_STREAM_WRITER,
-        .event_handle = _http_stream_writer_event_handle,
-        .user_data = sr,
-        .task_stack = GOOGLE_SR_TASK_STACK,
-    };
-    sr->http_stream_writer = http_stream_init(&http_cfg);
-    sr->sample_rates = config->record_sample_rates;
+    AUDIO_MEM_CHECK(TAG, sr->i2s_reader, goto exit_sr_init);
+    sr->capture = audio_pipeline_init(&pipeline_cfg);
+    AUDIO_MEM_CHECK(TAG, sr->capture, goto exit_sr_init);
+    audio_pipeline_register(sr->capture, sr->i2s_reader, "sr_i2s");
+    const char *capture_tag[4] = {"sr_i2s"};
+    int capture_num = 1;
+    if (config->aec_enable) {
+        /* Ahead of the front-end, whose AGC and noise suppression would change the echo path */
+        echo_canceller_cfg_t aec_cfg = {
+            .sample_rate = sr->capture_rate,
+            .tail_ms = config->aec_tail_ms,
+            .ref_delay_ms = config->aec_ref_delay_ms,
+            .task_prio = GOOGLE_SR_CAPTURE_TASK_PRIO,
+        };
+        sr->aec = echo_canceller_init(&aec_cfg);
+        AUDIO_MEM_CHECK(TAG, sr->aec, goto exit_sr_init);
+        audio_pipeline_register(sr->capture, sr->aec, "sr_aec");
+        capture_tag[capture_num++] = "sr_aec";
+    }
+    if (config->frontend_enable) {
+        mic_frontend_cfg_t frontend_cfg = {
+            .sample_rate = sr->capture_rate,
+            .highpass_hz = config->frontend_highpass_hz,
+            .agc_enable = config->frontend_agc,
+            .ns_enable = config->frontend_ns,
+            .task_prio = GOOGLE_SR_CAPTURE_TASK_PRIO,
+        };
+        sr->frontend = mic_frontend_init(&frontend_cfg);
+        AUDIO_MEM_CHECK(TAG, sr->frontend, goto exit_sr_init);
+        audio_pipeline_register(sr->capture, sr->frontend, "sr_frontend");
+        capture_tag[capture_num++] = "sr_frontend";
+    }
+    if (config->wake_word_model) {
+        /* Listens to the same conditioned audio that is sent */
+        if (sr->capture_rate != WAKE_WORD_SAMPLE_RATE) {
+            ESP_LOGE(TAG, "The wake word needs %d Hz audio", WAKE_WORD_SAMPLE_RATE);
+            goto exit_sr_init;
+        }
+        wake_word_cfg_t wake_word_cfg = {
+            .model = config->wake_word_model,
+            .threshold = config->wake_word_threshold,
+            .on_detect = _sr_wake_word_on_detect,
+            .user_ctx = sr,
+            .task_prio = GOOGLE_SR_CAPTURE_TASK_PRIO,
+        };
+        sr->wake_word = wake_word_init(&wake_word_cfg);
+        AUDIO_MEM_CHECK(TAG, sr->wake_word, goto exit_sr_init);
+        audio_pipeline_register(sr->capture, sr->wake_word, "sr_kws");
+        capture_tag[capture_num++] = "sr_kws";
+    }
+    audio_pipeline_link(sr->capture, &capture_tag[0], capture_num);
+    /* Conditioned audio, if enabled, feeds the pre-roll and the upload */
+    audio_element_set_write_cb(audio_pipeline_get_el_by_tag(sr->capture, capture_tag[capture_num - 1]), _sr_capture_write, sr);
+
     sr->encoding = config->encoding;
+    if (sr->encoding != ENCODING_LINEAR16 && sr->encoding != ENCODING_FLAC && sr->encoding != ENCODING_OGG_OPUS) {
+        ESP_LOGE(TAG, "Unsupported encoding %d", sr->encoding);
+        goto exit_sr_init;
+    }
     sr->on_begin = config->on_begin;
+    sr->streaming = config->streaming;
+    sr->on_result = config->on_result;
+    sr->vad_auto_stop = config->vad_enable && config->vad_auto_stop;
+
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    sr->evt = audio_event_iface_init(&evt_cfg);
+    AUDIO_MEM_CHECK(TAG, sr->evt, goto exit_sr_init);
 
-    audio_pipeline_register(sr->pipeline, sr->i2s_reader, "sr_i2s");
-    //audio_pipeline_register(sr->pipeline, sr->encoder, "sr_encoder");
-    audio_pipeline_register(sr->pipeline, sr->http_stream_writer, "sr_http");
-    
-    //const char* link_tag[3] = {"sr_i2s", "sr_encoder", "sr_http"};
-    //audio_pipeline_link(sr->pipeline, &link_tag[0], 3);
-    const char* link_tag[2] = {"sr_i2s", "sr_http"};
-    audio_pipeline_link(sr->pipeline, &link_tag[0], 2);
-    ESP_ERROR_CHECK(i2s_stream_set_clk(sr->i2s_reader, 16000, 16, 1));
+    for (int i = 0; i < sr->num_sessions; i++) {
+        if (_sr_session_init(sr, &sr->sessions[i], config) != ESP_OK) {
+            goto exit_sr_init;
+        }
+    }
+    ESP_ERROR_CHECK(i2s_stream_set_clk(sr->i2s_reader, sr->capture_rate, 16, 1));
+    audio_pipeline_run(sr->capture);
 
     return sr;
 exit_sr_init:
@@ -287,15 +713,34 @@ esp_err_t google_sr_destroy(google_sr_handle_t sr)
     if (sr == NULL) {
         return ESP_FAIL;
     }
-    audio_pipeline_stop(sr->pipeline);
-    audio_pipeline_wait_for_stop(sr->pipeline);
-    audio_pipeline_terminate(sr->pipeline);
-    audio_pipeline_remove_listener(sr->pipeline);
-    audio_pipeline_deinit(sr->pipeline);
-    free(sr->buffer);
-    free(sr->b64_buffer);
-    free(sr->lang_code);
-    free(sr->api_key);
+    for (int i = 0; i < sr->num_sessions; i++) {
+        sr_session_t *session = &sr->sessions[i];
+        if (session->pipeline) {
+            audio_pipeline_stop(session->pipeline);
+            audio_pipeline_wait_for_stop(session->pipeline);
+            audio_pipeline_terminate(session->pipeline);
+            audio_pipeline_remove_listener(session->pipeline);
+            audio_pipeline_deinit(session->pipeline);
+        }
+    }
+    if (sr->capture) {
+        audio_pipeline_stop(sr->capture);
+        audio_pipeline_wait_for_stop(sr->capture);
+        audio_pipeline_terminate(sr->capture);
+        audio_pipeline_deinit(sr->capture);
+    }
+    for (int i = 0; i < sr->num_sessions; i++) {
+        if (sr->sessions[i].upload_rb) {
+            rb_destroy(sr->sessions[i].upload_rb);
+        }
+    }
+    if (sr->capture_lock) {
+        vSemaphoreDelete(sr->capture_lock);
+    }
+    mem_arena_destroy(sr->mem);
+    if (sr->evt) {
+        audio_event_iface_destroy(sr->evt);
+    }
     free(sr);
     return ESP_OK;
 }
@@ -303,24 +748,166 @@ esp_err_t google_sr_destroy(google_sr_handle_t sr)
 esp_err_t google_sr_set_listener(google_sr_handle_t sr, audio_event_iface_handle_t listener)
 {
     if (listener) {
-        audio_pipeline_set_listener(sr->pipeline, listener);
+        for (int i = 0; i < sr->num_sessions; i++) {
+            audio_pipeline_set_listener(sr->sessions[i].pipeline, listener);
+        }
+        audio_event_iface_set_listener(sr->evt, listener);
     }
     return ESP_OK;
 }
 
+static sr_session_t *_sr_request_ended(google_sr_t *sr, audio_event_iface_msg_t *msg)
+{
+    if (msg->source_type != AUDIO_ELEMENT_TYPE_ELEMENT || msg->cmd != AEL_MSG_CMD_REPORT_STATUS) {
+        return NULL;
+    }
+    int status = (int)(intptr_t)msg->data;
+    if (status != AEL_STATUS_STATE_FINISHED && status != AEL_STATUS_STATE_STOPPED
+            && (status < AEL_STATUS_ERROR_OPEN || status > AEL_STATUS_ERROR_UNKNOWN)) {
+        return NULL;
+    }
+    for (int i = 0; i < sr->num_sessions; i++) {
+        sr_session_t *session = &sr->sessions[i];
+        if (session->state == SR_SESSION_BUSY && msg->source == (void*)session->http_stream_writer
+                && session->runs_drained == session->runs_collected) {
+            return session;
+        }
+    }
+    return NULL;
+}
+
+bool google_sr_check_event(google_sr_handle_t sr, audio_event_iface_msg_t *msg, google_sr_event_t *event)
+{
+    sr_session_t *session = _sr_request_ended(sr, msg);
+    if (session) {
+        /* The last element is done, the rest of the pipeline only has to be collected */
+        _sr_session_collect(session, false);
+        _sr_report_done(sr);
+        return false;
+    }
+    if (msg->source_type != GOOGLE_SR_EVENT_SOURCE_TYPE || msg->source != (void*)sr) {
+        return false;
+    }
+    if (msg->cmd == SR_EVENT_RUN_COLLECTED) {
+        ((sr_session_t *)msg->data)->runs_drained = (uint32_t)msg->data_len;
+        return false;
+    }
+    if (msg->cmd == GOOGLE_SR_EVENT_WAKE_WORD) {
+        /* The keyword has just ended, it is at the end of the pre-roll. It stands in for the button
+         * press, which is marked before the first frame is captured */
+        VOICE_TRACE_MARK(VOICE_TRACE_BUTTON_PRESS, 0);
+        msg->data = (void *)(intptr_t)(google_sr_start(sr) == ESP_OK ? sr->latest->id : -1);
+    }
+    if (event) {
+        *event = (google_sr_event_t)msg->cmd;
+    }
+    return true;
+}
+
 esp_err_t google_sr_start(google_sr_handle_t sr)
 {
-    snprintf(sr->buffer, sr->buffer_size, GOOGLE_SR_ENDPOINT, sr->api_key);
-    audio_element_set_uri(sr->http_stream_writer, sr->buffer);
-    audio_pipeline_reset_items_state(sr->pipeline);
-    audio_pipeline_reset_ringbuffer(sr->pipeline);
-    audio_pipeline_run(sr->pipeline);
+    if (sr->capturing) {
+        ESP_LOGW(TAG, "Speech-to-Text already started");
+        return ESP_FAIL;
+    }
+    sr_session_t *session = _sr_session_pick(sr);
+    if (session == NULL) {
+        ESP_LOGW(TAG, "All %d sessions are waiting for the server", sr->num_sessions);
+        return ESP_FAIL;
+    }
+    memset(&session->result, 0, sizeof(session->result));
+    session->id = sr->next_id++;
+    session->state = SR_SESSION_BUSY;
+    session->report = true;
+    if (!sr->streaming) {
+        snprintf(session->buffer, sr->buffer_size, GOOGLE_SR_ENDPOINT, sr->api_key);
+        audio_element_set_uri(session->http_stream_writer, session->buffer);
+    }
+    audio_pipeline_reset_items_state(session->pipeline);
+    audio_pipeline_reset_ringbuffer(session->pipeline);
+    /* Audio from before the press goes first, live audio is buffered until the connection is up */
+    _sr_upload_begin(session);
+    sr->latest = session;
+    audio_pipeline_run(session->pipeline);
+    return ESP_OK;
+}
+
+esp_err_t google_sr_finish(google_sr_handle_t sr)
+{
+    sr_session_t *session = sr->capturing;
+    if (session == NULL) {
+        return ESP_FAIL;
+    }
+    /* No more audio, the request completes in the background */
+    _sr_upload_end(session);
     return ESP_OK;
 }
 
 char* google_sr_stop(google_sr_handle_t sr)
 {
-    audio_pipeline_stop(sr->pipeline);
-    audio_pipeline_wait_for_stop(sr->pipeline);
-    return sr->response_text;
-}
\ No newline at end of file
+    sr_session_t *session = sr->latest;
+    if (session == NULL) {
+        return NULL;
+    }
+    /* Let the request send what is still buffered, then finish on its own. The transcript
+     * is returned here instead of reported */
+    session->report = false;
+    if (session->state == SR_SESSION_BUSY) {
+        _sr_session_collect(session, true);
+    }
+    _sr_report_done(sr);
+    sr->last_result = session;
+    return (char*)session->result.transcript;
+}
+
+esp_err_t google_sr_preconnect(google_sr_handle_t sr)
+{
+    if (!sr->streaming) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    /* The connection goes to the shared pool, any session can use it */
+    return sr_stream_preconnect(sr->sessions[0].http_stream_writer);
+}
+
+int google_sr_get_session(google_sr_handle_t sr)
+{
+    sr_session_t *session = sr->capturing;
+    return session ? session->id : -1;
+}
+
+const google_sr_result_t *google_sr_get_result(google_sr_handle_t sr)
+{
+    return &sr->last_result->result;
+}
+
+const google_sr_result_t *google_sr_get_session_result(google_sr_handle_t sr, int session_id)
+{
+    sr_session_t *session = _sr_session_find(sr, session_id);
+    if (session == NULL || session->state == SR_SESSION_BUSY) {
+        return NULL;
+    }
+    return &session->result;
+}
+
+esp_err_t google_sr_get_mem_stats(google_sr_handle_t sr, mem_arena_stats_t *stats)
+{
+    return mem_arena_get_stats(sr->mem, stats);
+}
+
+esp_err_t google_sr_feed_reference(google_sr_handle_t sr, const void *buf, int len)
+{
+    if (sr->aec == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return echo_canceller_feed_reference(sr->aec, buf, len);
+}
+
+esp_err_t google_sr_get_aec_stats(google_sr_handle_t sr, echo_canceller_stats_t *stats)
+{
+    return echo_canceller_get_stats(sr->aec, stats);
+}
+
+esp_err_t google_sr_get_wake_word_stats(google_sr_handle_t sr, wake_word_stats_t *stats)
+{
+    return wake_word_get_stats(sr->wake_word, stats);
+}
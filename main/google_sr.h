@@ -27,22 +27,87 @@
 
 #include "esp_err.h"
 #include "audio_event_iface.h"
+#include "audio_common.h"
+#include "mem_arena.h"
+#include "mic_frontend.h"
+#include "echo_canceller.h"
+#include "wake_word.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define DEFAULT_SR_BUFFER_SIZE (6144)
+#define DEFAULT_SR_RESULT_ARENA_SIZE (2048)
+#define DEFAULT_SR_PREROLL_MS       (500)
+#define GOOGLE_SR_PREROLL_MIN_MS    (300)
+#define GOOGLE_SR_PREROLL_MAX_MS    (1000)
+#define GOOGLE_SR_OPUS_BITRATE      (24000)
+#define GOOGLE_SR_MAX_SEGMENTS      (8)
+#define GOOGLE_SR_MAX_ALTERNATIVES  (3)
+#define GOOGLE_SR_NARROWBAND_RATE   (8000)
+#define DEFAULT_SR_SESSIONS         (2)
+#define GOOGLE_SR_MAX_SESSIONS      (4)
+#define DEFAULT_SR_UPLOAD_FLUSH_SIZE (4096)
+#define DEFAULT_SR_UPLOAD_FLUSH_MS  (100)
 
 /**
  * Google Cloud Speech-to-Text audio encoding
  */
 typedef enum {
     ENCODING_LINEAR16 = 0,  /*!< Google Cloud Speech-to-Text audio encoding PCM 16-bit mono */
+    ENCODING_FLAC,          /*!< Lossless FLAC, about half the size of LINEAR16 for speech */
+    ENCODING_OGG_OPUS,      /*!< Opus in an Ogg container, GOOGLE_SR_OPUS_BITRATE */
 } google_sr_encoding_t;
 
+/**
+ * One recognition hypothesis of a result segment
+ */
+typedef struct {
+    const char *transcript;             /*!< Transcript text */
+    float confidence;                   /*!< Confidence, 0 when the server did not report it */
+} google_sr_alternative_t;
+
+/**
+ * One consecutive portion of the audio, as reported in `results[]`
+ */
+typedef struct {
+    google_sr_alternative_t alternatives[GOOGLE_SR_MAX_ALTERNATIVES]; /*!< Alternatives, most likely first */
+    int num_alternatives;               /*!< Number of valid alternatives */
+    int result_end_time_ms;             /*!< `resultEndTime` in milliseconds, -1 if absent */
+} google_sr_segment_t;
+
+/**
+ * Google Cloud Speech-to-Text structured result, all strings live in the result arena
+ */
+typedef struct {
+    const char *transcript;             /*!< Most likely alternative of every segment joined, NULL if none */
+    google_sr_segment_t segments[GOOGLE_SR_MAX_SEGMENTS]; /*!< Result segments */
+    int num_segments;                   /*!< Number of valid segments */
+    bool truncated;                     /*!< Segments, alternatives or text did not fit and were dropped */
+} google_sr_result_t;
+
+/**
+ * Google Cloud Speech-to-Text events sent to the listener, `msg.source_type` is
+ * GOOGLE_SR_EVENT_SOURCE_TYPE, `msg.source` is the Speech-to-Text context, `msg.cmd`
+ * is one of these and `(int)msg.data` is the session id, see google_sr_get_session
+ */
+typedef enum {
+    GOOGLE_SR_EVENT_SPEECH_START = 1,   /*!< Voice activity detected */
+    GOOGLE_SR_EVENT_SPEECH_END,         /*!< End of speech, the request is closed if `vad_auto_stop` is set
+                                             and the next one can start */
+    GOOGLE_SR_EVENT_FINAL_TRANSCRIPT,   /*!< The request is complete, see google_sr_get_session_result, the
+                                             transcript is NULL if nothing was recognized or the request failed.
+                                             Reported in the order the sessions started */
+    GOOGLE_SR_EVENT_WAKE_WORD,          /*!< The wake word was heard and google_sr_check_event started a request,
+                                             the session id is -1 if it could not start */
+} google_sr_event_t;
+
+#define GOOGLE_SR_EVENT_SOURCE_TYPE (AUDIO_ELEMENT_TYPE_SERVICE)
+
 typedef struct google_sr* google_sr_handle_t;
 typedef void (*google_sr_event_handle_t)(google_sr_handle_t sr);
+typedef void (*google_sr_result_handle_t)(google_sr_handle_t sr, const char *text, bool is_final);
 
 /**
  * Google Cloud Speech-to-Text configurations
@@ -50,10 +115,37 @@ typedef void (*google_sr_event_handle_t)(google_sr_handle_t sr);
 typedef struct {
     const char *api_key;                /*!< API Key */
     const char *lang_code;              /*!< Speech-to-Text language code */
-    int record_sample_rates;            /*!< Audio recording sample rate */
+    int record_sample_rates;            /*!< Audio recording sample rate, 0 for 16000 */
     google_sr_encoding_t encoding;      /*!< Audio encoding */
-    int buffer_size;                    /*!< Processing buffer size */
+    int buffer_size;                    /*!< Processing buffer size, also the largest upload chunk */
     google_sr_event_handle_t on_begin;  /*!< Begin send audio data to server */
+    bool streaming;                     /*!< Use StreamingRecognize over HTTP/2 and send audio while recording */
+    google_sr_result_handle_t on_result;/*!< Interim and final transcripts (streaming mode only) */
+    int result_arena_size;              /*!< Size of the arena holding the result strings */
+    bool vad_enable;                    /*!< Drop silence before and after speech */
+    bool vad_auto_stop;                 /*!< Close the request automatically at the end of speech */
+    int vad_hangover_ms;                /*!< Silence that ends speech, 0 for default */
+    int preroll_ms;                     /*!< Audio from before google_sr_start sent ahead of live audio,
+                                             GOOGLE_SR_PREROLL_MIN_MS to GOOGLE_SR_PREROLL_MAX_MS, 0 for default */
+    bool narrowband;                    /*!< Send GOOGLE_SR_NARROWBAND_RATE audio, decimated from `record_sample_rates`,
+                                             which must be a multiple of it */
+    bool frontend_enable;               /*!< Condition the microphone audio: DC removal and high-pass */
+    int frontend_highpass_hz;           /*!< High-pass corner, 0 for MIC_FRONTEND_HIGHPASS_HZ */
+    bool frontend_agc;                  /*!< Also automatic gain control with a limiter */
+    bool frontend_ns;                   /*!< Also spectral subtraction noise suppression */
+    bool aec_enable;                    /*!< Cancel the echo of the audio given to google_sr_feed_reference */
+    int aec_tail_ms;                    /*!< Echo path length covered, 0 for ECHO_CANCELLER_TAIL_MS */
+    int aec_ref_delay_ms;               /*!< Playback latency not covered by the tail, see echo_canceller_stats_t */
+    int sessions;                       /*!< Requests that can be in progress at once, each with its own pipeline
+                                             and buffers, up to GOOGLE_SR_MAX_SESSIONS, 0 for DEFAULT_SR_SESSIONS */
+    const wake_word_model_t *wake_word_model;   /*!< Start a request when this keyword is heard, NULL for none.
+                                             Needs a `record_sample_rates` of WAKE_WORD_SAMPLE_RATE, the keyword
+                                             is sent in the pre-roll, which then defaults to GOOGLE_SR_PREROLL_MAX_MS */
+    int wake_word_threshold;            /*!< Detection threshold, 0 for the one of the model */
+    int upload_flush_size;              /*!< Encoded audio gathered into one upload chunk, capped by `buffer_size`,
+                                             0 for DEFAULT_SR_UPLOAD_FLUSH_SIZE, -1 to send every read */
+    int upload_flush_ms;                /*!< Longest time audio waits to be sent, 0 for DEFAULT_SR_UPLOAD_FLUSH_MS,
+                                             -1 for no deadline */
 } google_sr_config_t;
 
 
@@ -69,25 +161,155 @@ typedef struct {
 google_sr_handle_t google_sr_init(google_sr_config_t *config);
 
 /**
- * @brief      Start recording and sending audio to Google Cloud Speech-to-Text
+ * @brief      Start sending audio to Google Cloud Speech-to-Text
+ *
+ *             The microphone is captured all the time after google_sr_init. The last
+ *             `preroll_ms` of audio before this call are sent first, and live audio is
+ *             buffered while the connection opens.
+ *
+ *             Each call starts a new session. It can start as soon as the previous one has
+ *             stopped capturing (google_sr_finish, or the end of speech with `vad_auto_stop`),
+ *             while that one still uploads and waits for its response.
  *
  * @param[in]  sr   The Speech-to-Text context
  *
  * @return
  *     - ESP_OK
- *     - ESP_FAIL
+ *     - ESP_FAIL  Already capturing, or all `sessions` are waiting for the server
  */
 esp_err_t google_sr_start(google_sr_handle_t sr);
 
 /**
  * @brief      Stop sending audio to Google Cloud Speech-to-Text and get the result text
  *
+ *             Waits for the response of the last started session, which is then not
+ *             reported with GOOGLE_SR_EVENT_FINAL_TRANSCRIPT. In streaming mode the audio
+ *             has already been sent, so this only waits for the final results of the stream.
+ *
  * @param[in]  sr   The Speech-to-Text context
  *
  * @return     Google Cloud Speech-to-Text server response
  */
 char* google_sr_stop(google_sr_handle_t sr);
 
+/**
+ * @brief      Stop sending audio without waiting for the result
+ *
+ *             The request completes in the background, GOOGLE_SR_EVENT_FINAL_TRANSCRIPT is
+ *             reported through google_sr_check_event when the result is ready. The next
+ *             google_sr_start can follow right away.
+ *
+ * @param[in]  sr   The Speech-to-Text context
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL  Not capturing
+ */
+esp_err_t google_sr_finish(google_sr_handle_t sr);
+
+/**
+ * @brief      Connect to the server ahead of the next request, call it while idle
+ *
+ *             Only StreamingRecognize keeps connections; with the REST API every request
+ *             makes a new connection.
+ *
+ * @param[in]  sr   The Speech-to-Text context
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NOT_SUPPORTED  Not in streaming mode
+ *     - ESP_FAIL
+ */
+esp_err_t google_sr_preconnect(google_sr_handle_t sr);
+
+/**
+ * @brief      Get the id of the session capturing audio
+ *
+ * @param[in]  sr   The Speech-to-Text context
+ *
+ * @return     The session id of the last google_sr_start, -1 when not capturing
+ */
+int google_sr_get_session(google_sr_handle_t sr);
+
+/**
+ * @brief      Get the structured result of the last reported request
+ *
+ *             Valid until the next google_sr_start. The plain text returned by
+ *             google_sr_stop is `result->transcript`. In streaming mode only the
+ *             joined transcript is filled in.
+ *
+ * @param[in]  sr   The Speech-to-Text context
+ *
+ * @return     The result
+ */
+const google_sr_result_t *google_sr_get_result(google_sr_handle_t sr);
+
+/**
+ * @brief      Get the structured result of a session, as given by GOOGLE_SR_EVENT_FINAL_TRANSCRIPT
+ *
+ *             Valid until the next google_sr_start, see google_sr_get_result.
+ *
+ * @param[in]  sr          The Speech-to-Text context
+ * @param[in]  session_id  The session id
+ *
+ * @return     The result, NULL if the request is still running or the session was reused
+ */
+const google_sr_result_t *google_sr_get_session_result(google_sr_handle_t sr, int session_id);
+
+/**
+ * @brief      Get the usage of the memory arena holding the context buffers
+ *
+ *             See mem_arena_get_heap_stats for the heap figures.
+ *
+ * @param[in]  sr     The Speech-to-Text context
+ * @param[out] stats  The stats
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t google_sr_get_mem_stats(google_sr_handle_t sr, mem_arena_stats_t *stats);
+
+/**
+ * @brief      Give the echo canceller the audio being played, e.g. from a TTS playback tap
+ *
+ *             With `aec_enable`, recording can run during playback and the user can talk over it.
+ *
+ * @param[in]  sr   The Speech-to-Text context
+ * @param[in]  buf  16-bit mono samples at `record_sample_rates`
+ * @param[in]  len  Length in bytes
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_STATE  `aec_enable` is not set
+ *     - ESP_FAIL  The far-end buffer is full, the audio is dropped
+ */
+esp_err_t google_sr_feed_reference(google_sr_handle_t sr, const void *buf, int len);
+
+/**
+ * @brief      Get the echo canceller state, including the echo return loss enhancement
+ *
+ * @param[in]  sr     The Speech-to-Text context
+ * @param[out] stats  The stats
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG  `aec_enable` is not set
+ */
+esp_err_t google_sr_get_aec_stats(google_sr_handle_t sr, echo_canceller_stats_t *stats);
+
+/**
+ * @brief      Get the cost and the detections of the wake word detector
+ *
+ * @param[in]  sr     The Speech-to-Text context
+ * @param[out] stats  The stats
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG  No `wake_word_model`
+ */
+esp_err_t google_sr_get_wake_word_stats(google_sr_handle_t sr, wake_word_stats_t *stats);
+
 /**
  * @brief      Cleanup the Speech-to-Text object
  *
@@ -111,6 +333,24 @@ esp_err_t google_sr_destroy(google_sr_handle_t sr);
  */
 esp_err_t google_sr_set_listener(google_sr_handle_t sr, audio_event_iface_handle_t listener);
 
+/**
+ * @brief      Check if the message is a Speech-to-Text event
+ *
+ *             Also collects the end of the requests, which are then reported in order as
+ *             GOOGLE_SR_EVENT_FINAL_TRANSCRIPT, so all pipeline messages should be passed
+ *             here while a request is running. With a `wake_word_model`, the request of
+ *             GOOGLE_SR_EVENT_WAKE_WORD is started here, before the event is returned.
+ *
+ * @param[in]  sr     The Speech-to-Text context
+ * @param      msg    The message
+ * @param[out] event  The event, may be NULL
+ *
+ * @return
+ *  - true
+ *  - false
+ */
+bool google_sr_check_event(google_sr_handle_t sr, audio_event_iface_msg_t *msg, google_sr_event_t *event);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,762 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_tls.h"
+#include "nghttp2/nghttp2.h"
+
+#include "audio_element.h"
+#include "audio_common.h"
+#include "audio_mem.h"
+#include "conn_pool.h"
+#include "voice_trace.h"
+#include "google_sr_stream.h"
+
+static const char *TAG = "GOOGLE_SR_STREAM";
+
+#define GOOGLE_SR_STREAM_PATH       "/google.cloud.speech.v1.Speech/StreamingRecognize"
+#define GRPC_FRAME_HEADER_LEN       (5)
+#define GRPC_AUDIO_PIECE_MAX        (GOOGLE_SR_STREAM_TX_SIZE / 2)
+
+/* Protobuf wire types */
+#define PB_VARINT   (0)
+#define PB_FIXED64  (1)
+#define PB_LEN      (2)
+#define PB_FIXED32  (5)
+
+/* google.cloud.speech.v1.RecognitionConfig.AudioEncoding */
+static const uint8_t pb_encoding_map[] = {
+    [ENCODING_LINEAR16] = 1,
+    [ENCODING_FLAC] = 2,
+    [ENCODING_OGG_OPUS] = 6,
+};
+
+typedef struct sr_stream {
+    conn_pool_conn_t        *conn;
+    esp_tls_t               *tls;
+    int                     sock;
+    nghttp2_session         *h2;
+    int32_t                 stream_id;
+    bool                    is_open;
+    bool                    eof;
+    bool                    closed;
+    bool                    failed;
+    char                    *host;
+    int                     port;
+    bool                    plain_text;
+    const char              *cacert_pem;
+    char                    *api_key;
+    char                    *lang_code;
+    int                     sample_rate;
+    google_sr_encoding_t    encoding;
+    bool                    interim_results;
+    sr_stream_open_cb       on_open;
+    sr_stream_result_cb     on_result;
+    void                    *user_ctx;
+    uint8_t                 *tx_buf;
+    int                     tx_rd;
+    int                     tx_wr;
+    uint8_t                 *rx_buf;
+    uint8_t                 rx_hdr[GRPC_FRAME_HEADER_LEN];
+    int                     rx_hdr_len;
+    int                     rx_need;
+    int                     rx_len;
+    char                    *transcript;
+    int                     transcript_len;
+} sr_stream_t;
+
+static int pb_put_varint(uint8_t *p, uint32_t v)
+{
+    int n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static int pb_put_tag(uint8_t *p, int field, int wire_type)
+{
+    return pb_put_varint(p, (uint32_t)(field << 3 | wire_type));
+}
+
+static int pb_put_bytes(uint8_t *p, int field, const void *data, int len)
+{
+    int n = pb_put_tag(p, field, PB_LEN);
+    n += pb_put_varint(p + n, len);
+    memcpy(p + n, data, len);
+    return n + len;
+}
+
+static bool pb_get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v)
+{
+    uint64_t result = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uint8_t b = *(*p)++;
+        result |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Read the next field of a protobuf message. Length-delimited values are returned through
+ * `data`/`len`, scalars through `value`.
+ */
+static bool pb_next(const uint8_t **p, const uint8_t *end, int *field, int *wire_type,
+                    uint64_t *value, const uint8_t **data, int *len)
+{
+    uint64_t key;
+    if (*p >= end || !pb_get_varint(p, end, &key)) {
+        return false;
+    }
+    *field = (int)(key >> 3);
+    *wire_type = (int)(key & 0x07);
+    switch (*wire_type) {
+        case PB_VARINT:
+            return pb_get_varint(p, end, value);
+        case PB_FIXED64:
+            if (end - *p < 8) {
+                return false;
+            }
+            *p += 8;
+            return true;
+        case PB_FIXED32:
+            if (end - *p < 4) {
+                return false;
+            }
+            memcpy(value, *p, 4);
+            *p += 4;
+            return true;
+        case PB_LEN:
+            if (!pb_get_varint(p, end, value) || *value > (uint64_t)(end - *p)) {
+                return false;
+            }
+            *data = *p;
+            *len = (int)*value;
+            *p += *len;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static int _tx_free(sr_stream_t *stream)
+{
+    if (stream->tx_rd == stream->tx_wr) {
+        stream->tx_rd = stream->tx_wr = 0;
+    }
+    if (stream->tx_rd > 0 && GOOGLE_SR_STREAM_TX_SIZE - stream->tx_wr < GRPC_AUDIO_PIECE_MAX + 16) {
+        memmove(stream->tx_buf, stream->tx_buf + stream->tx_rd, stream->tx_wr - stream->tx_rd);
+        stream->tx_wr -= stream->tx_rd;
+        stream->tx_rd = 0;
+    }
+    return GOOGLE_SR_STREAM_TX_SIZE - stream->tx_wr;
+}
+
+/**
+ * Queue one gRPC length-prefixed StreamingRecognizeRequest carrying `len` bytes of `field`.
+ * The caller must have checked that the frame fits.
+ */
+static void _tx_put_message(sr_stream_t *stream, int field, const void *data, int len)
+{
+    uint8_t *frame = stream->tx_buf + stream->tx_wr;
+    int msg_len = pb_put_bytes(frame + GRPC_FRAME_HEADER_LEN, field, data, len);
+    frame[0] = 0; /* Not compressed */
+    frame[1] = (uint8_t)(msg_len >> 24);
+    frame[2] = (uint8_t)(msg_len >> 16);
+    frame[3] = (uint8_t)(msg_len >> 8);
+    frame[4] = (uint8_t)msg_len;
+    stream->tx_wr += GRPC_FRAME_HEADER_LEN + msg_len;
+}
+
+static void _tx_put_config(sr_stream_t *stream)
+{
+    uint8_t recognition_config[96];
+    uint8_t streaming_config[128];
+    int n = 0;
+    n += pb_put_tag(recognition_config + n, 1, PB_VARINT);
+    n += pb_put_varint(recognition_config + n, pb_encoding_map[stream->encoding]);
+    n += pb_put_tag(recognition_config + n, 2, PB_VARINT);
+    n += pb_put_varint(recognition_config + n, stream->sample_rate);
+    n += pb_put_bytes(recognition_config + n, 3, stream->lang_code, strnlen(stream->lang_code, 32));
+
+    int m = pb_put_bytes(streaming_config, 1, recognition_config, n);
+    if (stream->interim_results) {
+        m += pb_put_tag(streaming_config + m, 3, PB_VARINT);
+        m += pb_put_varint(streaming_config + m, 1);
+    }
+    _tx_put_message(stream, 1, streaming_config, m);
+}
+
+static void _append_transcript(sr_stream_t *stream, const uint8_t *text, int len)
+{
+    /* Reserved at init, the final results of one request rarely come close */
+    if (stream->transcript_len + len + 2 > GOOGLE_SR_STREAM_TRANSCRIPT_SIZE) {
+        ESP_LOGW(TAG, "Transcript longer than %d bytes, truncated", GOOGLE_SR_STREAM_TRANSCRIPT_SIZE);
+        len = GOOGLE_SR_STREAM_TRANSCRIPT_SIZE - stream->transcript_len - 2;
+        if (len <= 0) {
+            return;
+        }
+    }
+    if (stream->transcript_len > 0 && len > 0 && text[0] != ' ') {
+        stream->transcript[stream->transcript_len++] = ' ';
+    }
+    memcpy(stream->transcript + stream->transcript_len, text, len);
+    stream->transcript_len += len;
+    stream->transcript[stream->transcript_len] = 0;
+}
+
+static void _handle_result(sr_stream_t *stream, const uint8_t *p, const uint8_t *end)
+{
+    const uint8_t *transcript = NULL;
+    int transcript_len = 0;
+    bool is_final = false;
+    int field, wire_type, len;
+    uint64_t value;
+    const uint8_t *data;
+
+    while (pb_next(&p, end, &field, &wire_type, &value, &data, &len)) {
+        if (field == 1 && wire_type == PB_LEN && transcript == NULL) {
+            /* First SpeechRecognitionAlternative, the most likely one */
+            const uint8_t *ap = data, *aend = data + len;
+            int af, awt, alen;
+            uint64_t av;
+            const uint8_t *adata;
+            while (pb_next(&ap, aend, &af, &awt, &av, &adata, &alen)) {
+                if (af == 1 && awt == PB_LEN) {
+                    transcript = adata;
+                    transcript_len = alen;
+                }
+            }
+        } else if (field == 2 && wire_type == PB_VARINT) {
+            is_final = value != 0;
+        }
+    }
+    if (transcript == NULL) {
+        return;
+    }
+    if (is_final) {
+        _append_transcript(stream, transcript, transcript_len);
+    }
+    if (stream->on_result) {
+        char text[transcript_len + 1];
+        memcpy(text, transcript, transcript_len);
+        text[transcript_len] = 0;
+        stream->on_result(stream->user_ctx, text, is_final);
+    }
+}
+
+static void _handle_response(sr_stream_t *stream, const uint8_t *p, int size)
+{
+    const uint8_t *end = p + size;
+    int field, wire_type, len;
+    uint64_t value;
+    const uint8_t *data;
+
+    while (pb_next(&p, end, &field, &wire_type, &value, &data, &len)) {
+        if (field == 1 && wire_type == PB_LEN) {
+            /* google.rpc.Status error */
+            const uint8_t *sp = data, *send = data + len;
+            int sf, swt, slen;
+            uint64_t sv;
+            const uint8_t *sdata;
+            while (pb_next(&sp, send, &sf, &swt, &sv, &sdata, &slen)) {
+                if (sf == 2 && swt == PB_LEN) {
+                    ESP_LOGE(TAG, "Server error: %.*s", slen, sdata);
+                }
+            }
+            stream->failed = true;
+        } else if (field == 2 && wire_type == PB_LEN) {
+            _handle_result(stream, data, data + len);
+        }
+    }
+}
+
+static ssize_t _h2_send(nghttp2_session *session, const uint8_t *data, size_t length, int flags, void *user_data)
+{
+    sr_stream_t *stream = (sr_stream_t *)user_data;
+    ssize_t ret;
+    if (stream->tls) {
+        ret = esp_tls_conn_write(stream->tls, data, length);
+        if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+            return NGHTTP2_ERR_WOULDBLOCK;
+        }
+    } else {
+        ret = send(stream->sock, data, length, 0);
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return NGHTTP2_ERR_WOULDBLOCK;
+        }
+    }
+    return ret <= 0 ? NGHTTP2_ERR_CALLBACK_FAILURE : ret;
+}
+
+static ssize_t _h2_recv(nghttp2_session *session, uint8_t *buf, size_t length, int flags, void *user_data)
+{
+    sr_stream_t *stream = (sr_stream_t *)user_data;
+    ssize_t ret;
+    if (stream->tls) {
+        ret = esp_tls_conn_read(stream->tls, buf, length);
+        if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+            return NGHTTP2_ERR_WOULDBLOCK;
+        }
+    } else {
+        ret = recv(stream->sock, buf, length, 0);
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return NGHTTP2_ERR_WOULDBLOCK;
+        }
+    }
+    if (ret == 0) {
+        return NGHTTP2_ERR_EOF;
+    }
+    return ret < 0 ? NGHTTP2_ERR_CALLBACK_FAILURE : ret;
+}
+
+static ssize_t _h2_data_source_read(nghttp2_session *session, int32_t stream_id, uint8_t *buf, size_t length,
+                                    uint32_t *data_flags, nghttp2_data_source *source, void *user_data)
+{
+    sr_stream_t *stream = (sr_stream_t *)user_data;
+    int avail = stream->tx_wr - stream->tx_rd;
+    if (avail == 0) {
+        if (stream->eof) {
+            *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+            return 0;
+        }
+        return NGHTTP2_ERR_DEFERRED;
+    }
+    if (avail > (int)length) {
+        avail = (int)length;
+    }
+    memcpy(buf, stream->tx_buf + stream->tx_rd, avail);
+    stream->tx_rd += avail;
+    return avail;
+}
+
+static int _h2_on_data_chunk_recv(nghttp2_session *session, uint8_t flags, int32_t stream_id,
+                                  const uint8_t *data, size_t len, void *user_data)
+{
+    sr_stream_t *stream = (sr_stream_t *)user_data;
+    if (stream_id != stream->stream_id) {
+        return 0;
+    }
+    VOICE_TRACE_MARK_ONCE(VOICE_TRACE_SR_FIRST_RESPONSE, 0);
+    while (len > 0) {
+        if (stream->rx_hdr_len < GRPC_FRAME_HEADER_LEN) {
+            stream->rx_hdr[stream->rx_hdr_len++] = *data++;
+            len--;
+            if (stream->rx_hdr_len < GRPC_FRAME_HEADER_LEN) {
+                continue;
+            }
+            uint32_t msg_len = ((uint32_t)stream->rx_hdr[1] << 24) | ((uint32_t)stream->rx_hdr[2] << 16)
+                               | ((uint32_t)stream->rx_hdr[3] << 8) | stream->rx_hdr[4];
+            if (msg_len > GOOGLE_SR_STREAM_RX_SIZE) {
+                ESP_LOGE(TAG, "Response message too long, len=%u", (unsigned)msg_len);
+                stream->failed = true;
+                return NGHTTP2_ERR_CALLBACK_FAILURE;
+            }
+            stream->rx_need = (int)msg_len;
+            stream->rx_len = 0;
+        }
+        int n = stream->rx_need - stream->rx_len;
+        if (n > (int)len) {
+            n = (int)len;
+        }
+        memcpy(stream->rx_buf + stream->rx_len, data, n);
+        stream->rx_len += n;
+        data += n;
+        len -= n;
+        if (stream->rx_len == stream->rx_need) {
+            _handle_response(stream, stream->rx_buf, stream->rx_len);
+            stream->rx_hdr_len = 0;
+        }
+    }
+    return 0;
+}
+
+static int _h2_on_header(nghttp2_session *session, const nghttp2_frame *frame, const uint8_t *name, size_t namelen,
+                         const uint8_t *value, size_t valuelen, uint8_t flags, void *user_data)
+{
+    sr_stream_t *stream = (sr_stream_t *)user_data;
+    if (frame->hd.stream_id != stream->stream_id) {
+        return 0;
+    }
+    if (namelen == 11 && memcmp(name, "grpc-status", 11) == 0 && !(valuelen == 1 && value[0] == '0')) {
+        ESP_LOGE(TAG, "grpc-status=%.*s", (int)valuelen, value);
+        stream->failed = true;
+    } else if (namelen == 12 && memcmp(name, "grpc-message", 12) == 0) {
+        ESP_LOGE(TAG, "grpc-message=%.*s", (int)valuelen, value);
+    } else if (namelen == 7 && memcmp(name, ":status", 7) == 0 && !(valuelen == 3 && memcmp(value, "200", 3) == 0)) {
+        ESP_LOGE(TAG, "HTTP status=%.*s", (int)valuelen, value);
+        stream->failed = true;
+    }
+    return 0;
+}
+
+static int _h2_on_stream_close(nghttp2_session *session, int32_t stream_id, uint32_t error_code, void *user_data)
+{
+    sr_stream_t *stream = (sr_stream_t *)user_data;
+    if (stream_id == stream->stream_id) {
+        if (error_code) {
+            ESP_LOGE(TAG, "Stream closed with error_code=%d", (int)error_code);
+            stream->failed = true;
+        }
+        stream->closed = true;
+    }
+    return 0;
+}
+
+static esp_err_t _h2_pump(sr_stream_t *stream)
+{
+    int ret = nghttp2_session_send(stream->h2);
+    if (ret == 0) {
+        ret = nghttp2_session_recv(stream->h2);
+    }
+    if (ret != 0) {
+        ESP_LOGE(TAG, "HTTP/2 session error: %s", nghttp2_strerror(ret));
+        stream->failed = true;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static const char *alpn_protos[] = { "h2", NULL };
+
+static void _get_target(sr_stream_t *stream, conn_pool_target_t *target)
+{
+    *target = (conn_pool_target_t) {
+        .host = stream->host,
+        .port = stream->port,
+        .plain_text = stream->plain_text,
+        .alpn_protos = alpn_protos,
+        .cacert_pem = stream->cacert_pem,
+        .skip_common_name = stream->cacert_pem != NULL,
+    };
+}
+
+static void _h2_session_free(void *session)
+{
+    nghttp2_session_del((nghttp2_session *)session);
+}
+
+static esp_err_t _connect(sr_stream_t *stream, bool fresh)
+{
+    conn_pool_target_t target;
+    _get_target(stream, &target);
+    stream->conn = fresh ? conn_pool_connect(&target, 0) : conn_pool_get(&target, 0);
+    if (stream->conn == NULL) {
+        return ESP_FAIL;
+    }
+    stream->tls = stream->conn->tls;
+    stream->sock = stream->conn->sock;
+    /* A warm connection still carries the HTTP/2 session of the previous request */
+    stream->h2 = (nghttp2_session *)stream->conn->user_data;
+    stream->conn->user_data = NULL;
+    if (stream->h2) {
+        nghttp2_session_set_user_data(stream->h2, stream);
+    }
+    int flags = fcntl(stream->sock, F_GETFL, 0);
+    fcntl(stream->sock, F_SETFL, flags | O_NONBLOCK);
+    return ESP_OK;
+}
+
+static void _disconnect(sr_stream_t *stream, bool keep)
+{
+    if (keep && stream->h2 && nghttp2_session_check_request_allowed(stream->h2)) {
+        stream->conn->user_data = stream->h2;
+        stream->conn->user_free = _h2_session_free;
+        conn_pool_put(stream->conn, true);
+    } else {
+        if (stream->h2) {
+            nghttp2_session_del(stream->h2);
+        }
+        conn_pool_put(stream->conn, false);
+    }
+    stream->h2 = NULL;
+    stream->conn = NULL;
+    stream->tls = NULL;
+    stream->sock = -1;
+}
+
+static esp_err_t _h2_session_new(sr_stream_t *stream)
+{
+    nghttp2_session_callbacks *callbacks;
+    if (nghttp2_session_callbacks_new(&callbacks) != 0) {
+        return ESP_FAIL;
+    }
+    nghttp2_session_callbacks_set_send_callback(callbacks, _h2_send);
+    nghttp2_session_callbacks_set_recv_callback(callbacks, _h2_recv);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, _h2_on_data_chunk_recv);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, _h2_on_header);
+    nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, _h2_on_stream_close);
+    int ret = nghttp2_session_client_new(&stream->h2, callbacks, stream);
+    nghttp2_session_callbacks_del(callbacks);
+    if (ret != 0) {
+        return ESP_FAIL;
+    }
+    nghttp2_submit_settings(stream->h2, NGHTTP2_FLAG_NONE, NULL, 0);
+    return ESP_OK;
+}
+
+#define MAKE_NV(NAME, VALUE, VALUELEN) { (uint8_t *)(NAME), (uint8_t *)(VALUE), sizeof(NAME) - 1, (VALUELEN), NGHTTP2_NV_FLAG_NONE }
+#define MAKE_NV2(NAME, VALUE) MAKE_NV(NAME, VALUE, sizeof(VALUE) - 1)
+
+static esp_err_t _sr_stream_submit(sr_stream_t *stream)
+{
+    if (stream->h2 == NULL && _h2_session_new(stream) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    /* Handle what arrived while the connection was idle, e.g. GOAWAY */
+    if (_h2_pump(stream) != ESP_OK || !nghttp2_session_check_request_allowed(stream->h2)) {
+        return ESP_FAIL;
+    }
+    const nghttp2_nv nva[] = {
+        MAKE_NV2(":method", "POST"),
+        MAKE_NV(":scheme", stream->plain_text ? "http" : "https", stream->plain_text ? 4 : 5),
+        MAKE_NV(":authority", stream->host, strlen(stream->host)),
+        MAKE_NV2(":path", GOOGLE_SR_STREAM_PATH),
+        MAKE_NV2("content-type", "application/grpc"),
+        MAKE_NV2("te", "trailers"),
+        MAKE_NV("x-goog-api-key", stream->api_key, strlen(stream->api_key)),
+    };
+    nghttp2_data_provider data_provider = {
+        .read_callback = _h2_data_source_read,
+    };
+    stream->tx_rd = stream->tx_wr = 0;
+    _tx_put_config(stream);
+    stream->stream_id = nghttp2_submit_request(stream->h2, NULL, nva, sizeof(nva) / sizeof(nva[0]), &data_provider, stream);
+    if (stream->stream_id < 0 || _h2_pump(stream) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _sr_stream_open(audio_element_handle_t self)
+{
+    sr_stream_t *stream = (sr_stream_t *)audio_element_getdata(self);
+    if (stream->is_open) {
+        return ESP_OK;
+    }
+    stream->stream_id = 0;     /* Until submitted, frames of a previous request are not ours */
+    stream->eof = false;
+    stream->closed = false;
+    stream->failed = false;
+    stream->tx_rd = stream->tx_wr = 0;
+    stream->rx_hdr_len = 0;
+    stream->transcript_len = 0;
+    stream->transcript[0] = 0;
+
+    /* A warm connection may have been closed by the server meanwhile, retry once with a new one */
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (_connect(stream, attempt > 0) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        bool reused = stream->conn->reused;
+        if (_sr_stream_submit(stream) == ESP_OK) {
+            break;
+        }
+        _disconnect(stream, false);
+        if (!reused) {
+            ESP_LOGE(TAG, "Failed to submit StreamingRecognize request");
+            return ESP_FAIL;
+        }
+        ESP_LOGW(TAG, "Warm connection lost, reconnecting");
+        stream->failed = false;
+    }
+    stream->is_open = true;
+    ESP_LOGI(TAG, "StreamingRecognize stream opened, id=%d", (int)stream->stream_id);
+    if (stream->on_open) {
+        stream->on_open(stream->user_ctx);
+    }
+    return ESP_OK;
+}
+
+static audio_element_err_t _sr_stream_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    sr_stream_t *stream = (sr_stream_t *)audio_element_getdata(self);
+    int written = 0;
+    while (written < len) {
+        if (stream->failed || stream->closed) {
+            return AEL_IO_FAIL;
+        }
+        int piece = len - written;
+        if (piece > GRPC_AUDIO_PIECE_MAX) {
+            piece = GRPC_AUDIO_PIECE_MAX;
+        }
+        /* Back-pressure: keep the session moving until the frame fits */
+        while (_tx_free(stream) < piece + 16) {
+            if (_h2_pump(stream) != ESP_OK || stream->closed) {
+                return AEL_IO_FAIL;
+            }
+            if (_tx_free(stream) < piece + 16) {
+                vTaskDelay(1);
+            }
+        }
+        _tx_put_message(stream, 2, buffer + written, piece);
+        VOICE_TRACE_MARK_ONCE(VOICE_TRACE_SR_FIRST_CHUNK, 0);
+        written += piece;
+        nghttp2_session_resume_data(stream->h2, stream->stream_id);
+        if (_h2_pump(stream) != ESP_OK) {
+            return AEL_IO_FAIL;
+        }
+    }
+    return written;
+}
+
+static audio_element_err_t _sr_stream_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    int w_size = 0;
+    if (r_size > 0) {
+        w_size = audio_element_output(self, in_buffer, r_size);
+        if (w_size > 0) {
+            audio_element_update_byte_pos(self, w_size);
+        }
+    } else {
+        w_size = r_size;
+    }
+    return w_size;
+}
+
+static esp_err_t _sr_stream_close(audio_element_handle_t self)
+{
+    sr_stream_t *stream = (sr_stream_t *)audio_element_getdata(self);
+    if (!stream->is_open) {
+        return ESP_OK;
+    }
+    stream->is_open = false;
+    stream->eof = true;
+    nghttp2_session_resume_data(stream->h2, stream->stream_id);
+    VOICE_TRACE_MARK(VOICE_TRACE_SR_LAST_CHUNK, 0);
+
+    /* Half-closed: wait for the final results and the trailers */
+    TickType_t start = xTaskGetTickCount();
+    while (!stream->closed && !stream->failed
+            && (xTaskGetTickCount() - start) < pdMS_TO_TICKS(GOOGLE_SR_STREAM_FINAL_TIMEOUT_MS)) {
+        if (_h2_pump(stream) != ESP_OK) {
+            break;
+        }
+        if (!stream->closed) {
+            vTaskDelay(1);
+        }
+    }
+    if (!stream->closed) {
+        ESP_LOGW(TAG, "No final result after %d ms", GOOGLE_SR_STREAM_FINAL_TIMEOUT_MS);
+    }
+    /* Keep the connection and its HTTP/2 session warm for the next request */
+    _disconnect(stream, stream->closed && !stream->failed);
+    if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
+        audio_element_report_info(self);
+        audio_element_set_byte_pos(self, 0);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _sr_stream_destroy(audio_element_handle_t self)
+{
+    sr_stream_t *stream = (sr_stream_t *)audio_element_getdata(self);
+    audio_free(stream->tx_buf);
+    audio_free(stream->rx_buf);
+    audio_free(stream->transcript);
+    audio_free(stream->host);
+    audio_free(stream->api_key);
+    audio_free(stream->lang_code);
+    audio_free(stream);
+    return ESP_OK;
+}
+
+audio_element_handle_t sr_stream_init(sr_stream_cfg_t *config)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    audio_element_handle_t el;
+    sr_stream_t *stream = audio_calloc(1, sizeof(sr_stream_t));
+    AUDIO_MEM_CHECK(TAG, stream, return NULL);
+
+    stream->sock = -1;
+    stream->host = audio_strdup(config->host ? config->host : GOOGLE_SR_STREAM_HOST);
+    stream->port = config->port > 0 ? config->port : GOOGLE_SR_STREAM_PORT;
+    stream->plain_text = config->plain_text;
+    stream->cacert_pem = config->cacert_pem;
+    stream->api_key = audio_strdup(config->api_key);
+    stream->lang_code = audio_strdup(config->lang_code);
+    stream->sample_rate = config->sample_rate;
+    stream->encoding = config->encoding;
+    stream->interim_results = config->interim_results;
+    stream->on_open = config->on_open;
+    stream->on_result = config->on_result;
+    stream->user_ctx = config->user_ctx;
+    stream->tx_buf = audio_malloc(GOOGLE_SR_STREAM_TX_SIZE);
+    stream->rx_buf = audio_malloc(GOOGLE_SR_STREAM_RX_SIZE);
+    stream->transcript = audio_calloc(1, GOOGLE_SR_STREAM_TRANSCRIPT_SIZE);
+    AUDIO_MEM_CHECK(TAG, stream->host && stream->api_key && stream->lang_code
+                    && stream->tx_buf && stream->rx_buf && stream->transcript, goto _sr_stream_init_exit);
+
+    cfg.open = _sr_stream_open;
+    cfg.close = _sr_stream_close;
+    cfg.process = _sr_stream_process;
+    cfg.destroy = _sr_stream_destroy;
+    cfg.write = _sr_stream_write;
+    cfg.task_stack = config->task_stack > 0 ? config->task_stack : GOOGLE_SR_STREAM_TASK_STACK;
+    cfg.tag = "sr_stream";
+    el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, goto _sr_stream_init_exit);
+    audio_element_setdata(el, stream);
+    return el;
+_sr_stream_init_exit:
+    audio_free(stream->tx_buf);
+    audio_free(stream->rx_buf);
+    audio_free(stream->transcript);
+    audio_free(stream->host);
+    audio_free(stream->api_key);
+    audio_free(stream->lang_code);
+    audio_free(stream);
+    return NULL;
+}
+
+esp_err_t sr_stream_preconnect(audio_element_handle_t el)
+{
+    sr_stream_t *stream = (sr_stream_t *)audio_element_getdata(el);
+    conn_pool_target_t target;
+    _get_target(stream, &target);
+    return conn_pool_preconnect(&target);
+}
+
+const char *sr_stream_get_transcript(audio_element_handle_t el)
+{
+    sr_stream_t *stream = (sr_stream_t *)audio_element_getdata(el);
+    if (stream->transcript_len == 0) {
+        return NULL;
+    }
+    return stream->transcript;
+}
@@ -0,0 +1,108 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _GOOGLE_SR_STREAM_H_
+#define _GOOGLE_SR_STREAM_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+#include "google_sr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GOOGLE_SR_STREAM_HOST           "speech.googleapis.com"
+#define GOOGLE_SR_STREAM_PORT           (443)
+#define GOOGLE_SR_STREAM_TASK_STACK     (8*1024)
+#define GOOGLE_SR_STREAM_TX_SIZE        (8*1024)
+#define GOOGLE_SR_STREAM_RX_SIZE        (4*1024)
+#define GOOGLE_SR_STREAM_TRANSCRIPT_SIZE (1024)
+#define GOOGLE_SR_STREAM_FINAL_TIMEOUT_MS (3000)
+
+typedef void (*sr_stream_open_cb)(void *ctx);
+typedef void (*sr_stream_result_cb)(void *ctx, const char *text, bool is_final);
+
+/**
+ * Google Cloud Speech-to-Text StreamingRecognize (gRPC over HTTP/2) writer configurations
+ */
+typedef struct {
+    const char          *host;              /*!< Server host, NULL for GOOGLE_SR_STREAM_HOST */
+    int                 port;               /*!< Server port, 0 for GOOGLE_SR_STREAM_PORT */
+    bool                plain_text;         /*!< Use h2c without TLS (local stand-in servers only) */
+    const char          *cacert_pem;        /*!< CA of a local TLS stand-in server, NULL for the certificate bundle */
+    const char          *api_key;           /*!< API Key */
+    const char          *lang_code;         /*!< Speech-to-Text language code */
+    int                 sample_rate;        /*!< Sample rate of the 16-bit mono audio written to the element */
+    google_sr_encoding_t encoding;          /*!< Encoding of the audio written to the element */
+    bool                interim_results;    /*!< Ask the server for interim (non-final) hypotheses */
+    int                 task_stack;         /*!< Element task stack size */
+    sr_stream_open_cb   on_open;            /*!< Called once the request stream is open */
+    sr_stream_result_cb on_result;          /*!< Called for every interim and final hypothesis */
+    void                *user_ctx;          /*!< Context passed to the callbacks */
+} sr_stream_cfg_t;
+
+/**
+ * @brief      Create an audio element writing audio to StreamingRecognize
+ *
+ *             The request is opened when the element opens, every buffer written by the
+ *             upstream element is sent as an `audio_content` message as soon as it arrives,
+ *             and the stream is half-closed when the element closes. Closing waits (at most
+ *             GOOGLE_SR_STREAM_FINAL_TIMEOUT_MS) for the final hypothesis.
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle
+ */
+audio_element_handle_t sr_stream_init(sr_stream_cfg_t *config);
+
+/**
+ * @brief      Open a connection to the server in the background, so that the next request
+ *             does not wait for the TCP and TLS handshakes
+ *
+ *             The connection (and its HTTP/2 session) is also kept after every request that
+ *             ended cleanly. Both are managed by the connection pool.
+ *
+ * @param      el    The element
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t sr_stream_preconnect(audio_element_handle_t el);
+
+/**
+ * @brief      Get the final transcript of the last request
+ *
+ * @param[in]  el    The StreamingRecognize element
+ *
+ * @return     All final results joined together, NULL if nothing was recognized
+ */
+const char *sr_stream_get_transcript(audio_element_handle_t el);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
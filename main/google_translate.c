@@ -0,0 +1,891 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "audio_error.h"
+#include "audio_mem.h"
+#include "google_translate.h"
+#include "json_escape.h"
+#include "conn_pool.h"
+#include "voice_trace.h"
+
+static const char *TAG = "GOOGLE_TRANSLATE";
+
+#define GOOGLE_TRANSLATE_REQUEST_HEAD   "POST /language/translate/v2?key=%s HTTP/1.1\r\n"\
+                                        "Host: %s\r\n"\
+                                        "Content-Type: application/json; charset=utf-8\r\n"\
+                                        "Content-Length: %d\r\n"\
+                                        "\r\n"
+#define GOOGLE_TRANSLATE_TEMPLATE_HEAD  "{\"source\":\"%s\",\"target\":\"%s\",\"format\":\"text\",\"q\":\""
+#define GOOGLE_TRANSLATE_TEMPLATE_TAIL  "\"}"
+#define GOOGLE_TRANSLATE_RESULT_KEY     "translatedText"
+/* Room for the request line with the API key and the headers, or the response headers */
+#define GOOGLE_TRANSLATE_BUFFER_MIN     (1024)
+
+typedef enum {
+    TR_REQ_FREE = 0,
+    TR_REQ_QUEUED,
+    TR_REQ_DONE,
+    TR_REQ_FAILED,
+} tr_req_state_t;
+
+typedef struct {
+    int             id;
+    tr_req_state_t  state;
+    char            source_lang[GOOGLE_TRANSLATE_LANG_MAX];
+    char            target_lang[GOOGLE_TRANSLATE_LANG_MAX];
+    char            *text;
+    char            *result;
+    int64_t         start_us;
+} tr_request_t;
+
+typedef struct {
+    uint64_t    key;
+    uint32_t    last_use;       /* 0 while empty */
+    char        *text;
+} tr_cache_entry_t;
+
+/* Response body framing */
+typedef enum {
+    BODY_LENGTH = 0,            /* Content-Length bytes */
+    BODY_UNTIL_CLOSE,           /* Neither length nor chunks, the server closes the connection */
+    BODY_CHUNK_SIZE,
+    BODY_CHUNK_EXT,
+    BODY_CHUNK_DATA,
+    BODY_CHUNK_DATA_END,
+    BODY_CHUNK_TRAILER,
+    BODY_DONE,
+} tr_body_state_t;
+
+/* Search of the translation in the JSON body */
+typedef enum {
+    SCAN_OUTSIDE = 0,           /* Between tokens */
+    SCAN_STRING,                /* Inside a string that may be the key */
+    SCAN_AFTER_KEY,             /* The key matched, expecting ':' */
+    SCAN_BEFORE_VALUE,          /* Expecting the opening quote of the value */
+    SCAN_VALUE,                 /* Copying the value */
+    SCAN_ESCAPE,                /* After a backslash in the value */
+    SCAN_UNICODE,               /* Reading the 4 hex digits of \uXXXX */
+    SCAN_DONE,
+} tr_scan_state_t;
+
+typedef struct google_translate {
+    char                    *api_key;
+    char                    *host;
+    int                     port;
+    bool                    plain_text;
+    const char              *cacert_pem;
+    char                    *buffer;
+    int                     buffer_size;
+    int                     text_max;
+    mem_arena_handle_t      mem;
+    tr_request_t            requests[GOOGLE_TRANSLATE_REQUESTS];
+    int                     next_id;
+    QueueHandle_t           queue;
+    SemaphoreHandle_t       lock;           /* Guards the request states and the stats */
+    SemaphoreHandle_t       task_exit;
+    TaskHandle_t            task;
+    audio_event_iface_handle_t evt;
+    tr_cache_entry_t        *cache;         /* Only used by the request task */
+    int                     cache_num;
+    int                     cache_used;
+    uint32_t                cache_clock;
+    google_translate_stats_t stats;
+    /* Response of the request in progress */
+    int                     status;
+    bool                    keep_alive;
+    tr_body_state_t         body;
+    int                     body_left;
+    int                     line_len;
+    int                     received;
+    bool                    reused;
+    uint32_t                connect_ms;
+    uint32_t                response_ms;
+    tr_scan_state_t         scan;
+    int                     match;
+    bool                    escaped;
+    uint32_t                unicode;
+    int                     unicode_len;
+    uint16_t                high_surrogate;
+    char                    *out;
+    int                     out_len;
+    bool                    overflow;
+} google_translate_t;
+
+static void _tr_send_event(google_translate_t *tr, google_translate_event_t event, int id)
+{
+    audio_event_iface_msg_t msg = {
+        .cmd = event,
+        .data = (void *)(intptr_t)id,
+        .source = tr,
+        .source_type = GOOGLE_TRANSLATE_EVENT_SOURCE_TYPE,
+    };
+    if (audio_event_iface_sendout(tr->evt, &msg) != ESP_OK) {
+        ESP_LOGW(TAG, "Event %d of request %d lost", event, id);
+    }
+}
+
+/* 64-bit FNV-1a of the text and the language pair */
+static uint64_t _tr_cache_key(const tr_request_t *req)
+{
+    const char *parts[3] = { req->text, req->source_lang, req->target_lang };
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 3; i++) {
+        /* The terminator keeps ("ab", "c") apart from ("a", "bc") */
+        const uint8_t *p = (const uint8_t *)parts[i];
+        do {
+            h ^= *p;
+            h *= 0x100000001b3ULL;
+        } while (*p++);
+    }
+    return h;
+}
+
+static tr_cache_entry_t *_tr_cache_find(google_translate_t *tr, uint64_t key)
+{
+    for (int i = 0; i < tr->cache_num; i++) {
+        if (tr->cache[i].last_use && tr->cache[i].key == key) {
+            tr->cache[i].last_use = ++tr->cache_clock;
+            return &tr->cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void _tr_cache_put(google_translate_t *tr, uint64_t key, const char *text)
+{
+    /* An empty entry, or the least recently used one */
+    tr_cache_entry_t *entry = &tr->cache[0];
+    for (int i = 0; i < tr->cache_num && entry->last_use; i++) {
+        if (tr->cache[i].last_use < entry->last_use) {
+            entry = &tr->cache[i];
+        }
+    }
+    if (entry->last_use == 0) {
+        tr->cache_used++;
+    }
+    entry->key = key;
+    entry->last_use = ++tr->cache_clock;
+    strcpy(entry->text, text);
+}
+
+static void _tr_get_target(google_translate_t *tr, conn_pool_target_t *target)
+{
+    *target = (conn_pool_target_t) {
+        .host = tr->host,
+        .port = tr->port,
+        .plain_text = tr->plain_text,
+        .cacert_pem = tr->cacert_pem,
+        .skip_common_name = tr->cacert_pem != NULL,
+    };
+}
+
+static esp_err_t _tr_write(conn_pool_conn_t *conn, const char *data, int len)
+{
+    while (len > 0) {
+        int ret = conn->tls ? esp_tls_conn_write(conn->tls, data, len) : send(conn->sock, data, len, 0);
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Error write request, %d", ret);
+            return ESP_FAIL;
+        }
+        data += ret;
+        len -= ret;
+    }
+    return ESP_OK;
+}
+
+static int _tr_read(conn_pool_conn_t *conn, char *buf, int len)
+{
+    return conn->tls ? esp_tls_conn_read(conn->tls, buf, len) : recv(conn->sock, buf, len, 0);
+}
+
+/* Length of the text once escaped as a JSON string */
+static int _tr_escaped_len(const char *text)
+{
+    char scratch[64];
+    int len = strlen(text);
+    int pos = 0, total = 0;
+    while (pos < len) {
+        int out_len;
+        pos += json_escape(text + pos, len - pos, scratch, sizeof(scratch), &out_len);
+        total += out_len;
+    }
+    return total;
+}
+
+/* The request goes out in one write when it fits the buffer, which it does for spoken phrases */
+static esp_err_t _tr_send_request(google_translate_t *tr, conn_pool_conn_t *conn, tr_request_t *req)
+{
+    int text_len = strlen(req->text);
+    int body_len = snprintf(NULL, 0, GOOGLE_TRANSLATE_TEMPLATE_HEAD, req->source_lang, req->target_lang)
+                   + _tr_escaped_len(req->text) + strlen(GOOGLE_TRANSLATE_TEMPLATE_TAIL);
+    int len = snprintf(tr->buffer, tr->buffer_size, GOOGLE_TRANSLATE_REQUEST_HEAD, tr->api_key, tr->host, body_len);
+    len += snprintf(tr->buffer + len, tr->buffer_size - len, GOOGLE_TRANSLATE_TEMPLATE_HEAD,
+                    req->source_lang, req->target_lang);
+    if (len >= tr->buffer_size) {
+        ESP_LOGE(TAG, "Please use a translation buffer size greater than %d", len);
+        return ESP_FAIL;
+    }
+    int pos = 0;
+    while (pos < text_len) {
+        if (tr->buffer_size - len < JSON_ESCAPE_MAX_OUT_CHAR) {
+            if (_tr_write(conn, tr->buffer, len) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            len = 0;
+        }
+        int out_len;
+        pos += json_escape(req->text + pos, text_len - pos, tr->buffer + len, tr->buffer_size - len, &out_len);
+        len += out_len;
+    }
+    int tail_len = strlen(GOOGLE_TRANSLATE_TEMPLATE_TAIL);
+    if (tr->buffer_size - len < tail_len) {
+        if (_tr_write(conn, tr->buffer, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        len = 0;
+    }
+    memcpy(tr->buffer + len, GOOGLE_TRANSLATE_TEMPLATE_TAIL, tail_len);
+    return _tr_write(conn, tr->buffer, len + tail_len);
+}
+
+static void _tr_put(google_translate_t *tr, const char *data, int len)
+{
+    if (tr->out_len + len > tr->text_max) {
+        tr->overflow = true;
+        return;
+    }
+    memcpy(tr->out + tr->out_len, data, len);
+    tr->out_len += len;
+}
+
+static void _tr_put_code_point(google_translate_t *tr, uint32_t cp)
+{
+    char utf8[4];
+    int n;
+    if (cp < 0x80) {
+        utf8[0] = cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        utf8[0] = 0xC0 | (cp >> 6);
+        utf8[1] = 0x80 | (cp & 0x3F);
+        n = 2;
+    } else if (cp < 0x10000) {
+        utf8[0] = 0xE0 | (cp >> 12);
+        utf8[1] = 0x80 | ((cp >> 6) & 0x3F);
+        utf8[2] = 0x80 | (cp & 0x3F);
+        n = 3;
+    } else {
+        utf8[0] = 0xF0 | (cp >> 18);
+        utf8[1] = 0x80 | ((cp >> 12) & 0x3F);
+        utf8[2] = 0x80 | ((cp >> 6) & 0x3F);
+        utf8[3] = 0x80 | (cp & 0x3F);
+        n = 4;
+    }
+    _tr_put(tr, utf8, n);
+}
+
+/* A high surrogate not followed by a low one */
+static void _tr_put_lone_surrogate(google_translate_t *tr)
+{
+    if (tr->high_surrogate) {
+        tr->high_surrogate = 0;
+        _tr_put_code_point(tr, 0xFFFD);
+    }
+}
+
+static void _tr_put_unicode(google_translate_t *tr, uint32_t unit)
+{
+    if (tr->high_surrogate && unit >= 0xDC00 && unit <= 0xDFFF) {
+        _tr_put_code_point(tr, 0x10000 + ((tr->high_surrogate - 0xD800) << 10) + (unit - 0xDC00));
+        tr->high_surrogate = 0;
+        return;
+    }
+    _tr_put_lone_surrogate(tr);
+    if (unit >= 0xD800 && unit <= 0xDBFF) {
+        tr->high_surrogate = unit;
+    } else if (unit >= 0xDC00 && unit <= 0xDFFF) {
+        _tr_put_code_point(tr, 0xFFFD);
+    } else {
+        _tr_put_code_point(tr, unit);
+    }
+}
+
+/* Finds the first "translatedText" member and copies its unescaped value, across any splits */
+static void _tr_scan(google_translate_t *tr, const char *in, int len)
+{
+    static const char key[] = GOOGLE_TRANSLATE_RESULT_KEY;
+    const int key_len = sizeof(key) - 1;
+    const char *end = in + len;
+    while (in < end) {
+        char c = *in;
+        switch (tr->scan) {
+            case SCAN_OUTSIDE:
+                if (c == '"') {
+                    tr->scan = SCAN_STRING;
+                    tr->match = 0;
+                    tr->escaped = false;
+                }
+                break;
+            case SCAN_STRING:
+                if (tr->escaped) {
+                    tr->escaped = false;
+                    tr->match = -1;
+                } else if (c == '\\') {
+                    tr->escaped = true;
+                } else if (c == '"') {
+                    tr->scan = tr->match == key_len ? SCAN_AFTER_KEY : SCAN_OUTSIDE;
+                } else if (tr->match >= 0 && tr->match < key_len && c == key[tr->match]) {
+                    tr->match++;
+                } else {
+                    tr->match = -1;
+                }
+                break;
+            case SCAN_AFTER_KEY:
+                if (c == ':') {
+                    tr->scan = SCAN_BEFORE_VALUE;
+                } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                    /* It was a string value that looks like the key, rescan this character */
+                    tr->scan = SCAN_OUTSIDE;
+                    continue;
+                }
+                break;
+            case SCAN_BEFORE_VALUE:
+                if (c == '"') {
+                    tr->scan = SCAN_VALUE;
+                } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                    tr->scan = SCAN_OUTSIDE;
+                    continue;
+                }
+                break;
+            case SCAN_VALUE: {
+                /* Plain characters are copied in runs */
+                const char *run = in;
+                while (in < end && *in != '"' && *in != '\\') {
+                    in++;
+                }
+                if (in > run) {
+                    _tr_put_lone_surrogate(tr);
+                    _tr_put(tr, run, in - run);
+                }
+                if (in == end) {
+                    continue;
+                }
+                if (*in == '"') {
+                    _tr_put_lone_surrogate(tr);
+                    tr->scan = SCAN_DONE;
+                } else {
+                    tr->scan = SCAN_ESCAPE;
+                }
+                break;
+            }
+            case SCAN_ESCAPE: {
+                static const char from[] = "\"\\/bfnrt";
+                static const char to[] = "\"\\/\b\f\n\r\t";
+                const char *e = strchr(from, c);
+                tr->scan = SCAN_VALUE;
+                if (c == 'u') {
+                    tr->scan = SCAN_UNICODE;
+                    tr->unicode = 0;
+                    tr->unicode_len = 0;
+                } else if (c != '\0' && e) {
+                    _tr_put_lone_surrogate(tr);
+                    _tr_put(tr, &to[e - from], 1);
+                } else {
+                    tr->overflow = true;
+                    tr->scan = SCAN_DONE;
+                }
+                break;
+            }
+            case SCAN_UNICODE: {
+                int v = c >= '0' && c <= '9' ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : -1;
+                if (v < 0) {
+                    tr->overflow = true;
+                    tr->scan = SCAN_DONE;
+                    break;
+                }
+                tr->unicode = (tr->unicode << 4) | v;
+                if (++tr->unicode_len == 4) {
+                    _tr_put_unicode(tr, tr->unicode);
+                    tr->scan = SCAN_VALUE;
+                }
+                break;
+            }
+            case SCAN_DONE:
+                return;
+        }
+        in++;
+    }
+}
+
+/* Takes the payload out of the body framing, returns false once the body is complete */
+static bool _tr_body_feed(google_translate_t *tr, const char *in, int len)
+{
+    const char *end = in + len;
+    while (in < end && tr->body != BODY_DONE) {
+        char c = *in;
+        switch (tr->body) {
+            case BODY_LENGTH:
+            case BODY_UNTIL_CLOSE:
+            case BODY_CHUNK_DATA: {
+                int n = end - in;
+                if (tr->body != BODY_UNTIL_CLOSE && n > tr->body_left) {
+                    n = tr->body_left;
+                }
+                if (tr->status == 200) {
+                    _tr_scan(tr, in, n);
+                }
+                in += n;
+                tr->body_left -= n;
+                if (tr->body == BODY_LENGTH && tr->body_left == 0) {
+                    tr->body = BODY_DONE;
+                } else if (tr->body == BODY_CHUNK_DATA && tr->body_left == 0) {
+                    tr->body = BODY_CHUNK_DATA_END;
+                }
+                continue;
+            }
+            case BODY_CHUNK_SIZE: {
+                int v = c >= '0' && c <= '9' ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : -1;
+                if (v >= 0) {
+                    if (tr->body_left > (INT32_MAX >> 4)) {
+                        return false;
+                    }
+                    tr->body_left = (tr->body_left << 4) | v;
+                    break;
+                }
+                tr->body = BODY_CHUNK_EXT;
+                continue;
+            }
+            case BODY_CHUNK_EXT:
+                if (c == '\n') {
+                    tr->body = tr->body_left > 0 ? BODY_CHUNK_DATA : BODY_CHUNK_TRAILER;
+                    tr->line_len = 0;
+                }
+                break;
+            case BODY_CHUNK_DATA_END:
+                if (c == '\n') {
+                    tr->body = BODY_CHUNK_SIZE;
+                    tr->body_left = 0;
+                }
+                break;
+            case BODY_CHUNK_TRAILER:
+                /* Trailer lines until an empty one */
+                if (c == '\n') {
+                    if (tr->line_len == 0) {
+                        tr->body = BODY_DONE;
+                    }
+                    tr->line_len = 0;
+                } else if (c != '\r') {
+                    tr->line_len++;
+                }
+                break;
+            case BODY_DONE:
+                break;
+        }
+        in++;
+    }
+    return tr->body != BODY_DONE;
+}
+
+/* Header lines, the status line first */
+static esp_err_t _tr_parse_headers(google_translate_t *tr, char *headers)
+{
+    char *line = headers;
+    if (sscanf(line, "HTTP/1.%*d %d", &tr->status) != 1) {
+        ESP_LOGE(TAG, "Invalid response");
+        return ESP_FAIL;
+    }
+    tr->keep_alive = strncmp(line, "HTTP/1.0", 8) != 0;
+    tr->body = BODY_UNTIL_CLOSE;
+    /* The end of the headers is cut off, the last line ends the search */
+    while ((line = strstr(line, "\r\n")) != NULL) {
+        line += 2;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            tr->body = BODY_LENGTH;
+            tr->body_left = atoi(line + 15);
+        } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked")) {
+            tr->body = BODY_CHUNK_SIZE;
+            tr->body_left = 0;
+        } else if (strncasecmp(line, "Connection:", 11) == 0) {
+            char *value = line + 11;
+            while (*value == ' ') {
+                value++;
+            }
+            tr->keep_alive = strncasecmp(value, "close", 5) != 0;
+        }
+    }
+    if (tr->body == BODY_LENGTH && tr->body_left == 0) {
+        tr->body = BODY_DONE;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _tr_receive(google_translate_t *tr, conn_pool_conn_t *conn, tr_request_t *req, int64_t sent_us)
+{
+    tr->scan = SCAN_OUTSIDE;
+    tr->high_surrogate = 0;
+    tr->out = req->result;
+    tr->out_len = 0;
+    tr->overflow = false;
+
+    /* The headers are collected whole, the body is handled as it arrives */
+    int len = 0;
+    char *body = NULL;
+    while (body == NULL) {
+        if (len >= tr->buffer_size - 1) {
+            ESP_LOGE(TAG, "Response headers larger than the buffer");
+            return ESP_FAIL;
+        }
+        int ret = _tr_read(conn, tr->buffer + len, tr->buffer_size - 1 - len);
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Error read response, %d", ret);
+            return ESP_FAIL;
+        }
+        tr->received += ret;
+        len += ret;
+        tr->buffer[len] = '\0';
+        body = strstr(tr->buffer, "\r\n\r\n");
+    }
+    tr->response_ms = (esp_timer_get_time() - sent_us) / 1000;
+    *body = '\0';
+    if (_tr_parse_headers(tr, tr->buffer) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    body += 4;
+    bool more = _tr_body_feed(tr, body, tr->buffer + len - body);
+    while (more) {
+        int ret = _tr_read(conn, tr->buffer, tr->buffer_size);
+        if (ret == 0 && tr->body == BODY_UNTIL_CLOSE) {
+            tr->body = BODY_DONE;
+            tr->keep_alive = false;
+            break;
+        }
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Error read response, %d", ret);
+            return ESP_FAIL;
+        }
+        more = _tr_body_feed(tr, tr->buffer, ret);
+    }
+    if (tr->body != BODY_DONE) {
+        ESP_LOGE(TAG, "Invalid response framing");
+        return ESP_FAIL;
+    }
+    if (tr->status != 200) {
+        ESP_LOGE(TAG, "Translation failed, HTTP %d", tr->status);
+        return ESP_FAIL;
+    }
+    if (tr->overflow) {
+        ESP_LOGE(TAG, "Translation longer than %d bytes or malformed", tr->text_max);
+        return ESP_FAIL;
+    }
+    if (tr->scan != SCAN_DONE) {
+        ESP_LOGE(TAG, "No translation in response");
+        return ESP_FAIL;
+    }
+    req->result[tr->out_len] = '\0';
+    return ESP_OK;
+}
+
+static esp_err_t _tr_http_request(google_translate_t *tr, tr_request_t *req)
+{
+    conn_pool_target_t target;
+    _tr_get_target(tr, &target);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int64_t start = esp_timer_get_time();
+        conn_pool_conn_t *conn = attempt == 0 ? conn_pool_get(&target, 0) : conn_pool_connect(&target, 0);
+        if (conn == NULL) {
+            return ESP_FAIL;
+        }
+        tr->connect_ms = (esp_timer_get_time() - start) / 1000;
+        tr->reused = conn->reused;
+        struct timeval tv = {
+            .tv_sec = GOOGLE_TRANSLATE_TIMEOUT_MS / 1000,
+            .tv_usec = (GOOGLE_TRANSLATE_TIMEOUT_MS % 1000) * 1000,
+        };
+        setsockopt(conn->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(conn->sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        tr->received = 0;
+        tr->keep_alive = false;
+        tr->body = BODY_UNTIL_CLOSE;
+        esp_err_t ret = _tr_send_request(tr, conn, req);
+        if (ret == ESP_OK) {
+            VOICE_TRACE_MARK(VOICE_TRACE_TRANSLATE_SENT, 0);
+            ret = _tr_receive(tr, conn, req, esp_timer_get_time());
+        }
+        /* An error response read to its end leaves the connection usable */
+        conn_pool_put(conn, tr->body == BODY_DONE && tr->keep_alive);
+        if (ret == ESP_OK) {
+            return ESP_OK;
+        }
+        /* The server may have closed a warm connection meanwhile, retry once on a new one */
+        if (!tr->reused || tr->received > 0) {
+            return ESP_FAIL;
+        }
+        ESP_LOGW(TAG, "Warm connection lost, reconnecting");
+    }
+    return ESP_FAIL;
+}
+
+static void _tr_task(void *pv)
+{
+    google_translate_t *tr = (google_translate_t *)pv;
+    tr_request_t *req;
+    while (xQueueReceive(tr->queue, &req, portMAX_DELAY) == pdTRUE && req != NULL) {
+        uint32_t queue_ms = (esp_timer_get_time() - req->start_us) / 1000;
+        uint64_t key = _tr_cache_key(req);
+        tr_cache_entry_t *entry = tr->cache ? _tr_cache_find(tr, key) : NULL;
+        esp_err_t ret = ESP_OK;
+        tr->connect_ms = tr->response_ms = 0;
+        tr->reused = false;
+        if (entry) {
+            strcpy(req->result, entry->text);
+        } else {
+            ret = _tr_http_request(tr, req);
+            if (ret == ESP_OK && tr->cache) {
+                _tr_cache_put(tr, key, req->result);
+            }
+        }
+        if (ret == ESP_OK) {
+            VOICE_TRACE_MARK(VOICE_TRACE_TRANSLATE_DONE, entry != NULL);
+        }
+        xSemaphoreTake(tr->lock, portMAX_DELAY);
+        uint32_t total_ms = (esp_timer_get_time() - req->start_us) / 1000;
+        tr->stats.last_queue_ms = queue_ms;
+        tr->stats.last_total_ms = total_ms;
+        tr->stats.cache_entries = tr->cache_used;
+        if (entry) {
+            tr->stats.cache_hits++;
+        } else {
+            tr->stats.last_connect_ms = tr->connect_ms;
+            tr->stats.last_response_ms = tr->response_ms;
+            tr->stats.total_network_ms += total_ms;
+            tr->stats.reused += ret == ESP_OK && tr->reused;
+        }
+        if (ret != ESP_OK) {
+            tr->stats.failures++;
+        }
+        req->state = ret == ESP_OK ? TR_REQ_DONE : TR_REQ_FAILED;
+        int id = req->id;
+        xSemaphoreGive(tr->lock);
+        ESP_LOGD(TAG, "Request %d %s in %u ms%s", id, ret == ESP_OK ? "done" : "failed",
+                 (unsigned)total_ms, entry ? " from cache" : "");
+        _tr_send_event(tr, ret == ESP_OK ? GOOGLE_TRANSLATE_EVENT_DONE : GOOGLE_TRANSLATE_EVENT_FAILED, id);
+    }
+    xSemaphoreGive(tr->task_exit);
+    vTaskDelete(NULL);
+}
+
+google_translate_handle_t google_translate_init(google_translate_config_t *config)
+{
+    google_translate_t *tr = calloc(1, sizeof(google_translate_t));
+    AUDIO_MEM_CHECK(TAG, tr, return NULL);
+
+    tr->buffer_size = config->buffer_size > 0 ? config->buffer_size : DEFAULT_TRANSLATE_BUFFER_SIZE;
+    if (tr->buffer_size < GOOGLE_TRANSLATE_BUFFER_MIN) {
+        tr->buffer_size = GOOGLE_TRANSLATE_BUFFER_MIN;
+    }
+    tr->text_max = config->text_max > 0 ? config->text_max : GOOGLE_TRANSLATE_TEXT_MAX;
+    tr->cache_num = config->cache_enable ? (config->cache_entries > 0 ? config->cache_entries : GOOGLE_TRANSLATE_CACHE_ENTRIES) : 0;
+    const char *host = config->host ? config->host : GOOGLE_TRANSLATE_HOST;
+    tr->port = config->port > 0 ? config->port : GOOGLE_TRANSLATE_PORT;
+    tr->plain_text = config->plain_text;
+    tr->cacert_pem = config->cacert_pem;
+
+    /* Buffers, the request texts and the phrase cache are carved from one PSRAM block at init */
+    int text_size = MEM_ARENA_SIZE(tr->text_max + 1);
+    tr->mem = mem_arena_create(MEM_ARENA_SIZE(tr->buffer_size) + MEM_ARENA_SIZE(strlen(config->api_key) + 1)
+                               + MEM_ARENA_SIZE(strlen(host) + 1) + GOOGLE_TRANSLATE_REQUESTS * 2 * text_size
+                               + MEM_ARENA_SIZE(tr->cache_num * sizeof(tr_cache_entry_t)) + tr->cache_num * text_size,
+                               MEM_ARENA_PREFER_SPIRAM);
+    AUDIO_MEM_CHECK(TAG, tr->mem, goto exit_translate_init);
+    tr->buffer = mem_arena_alloc(tr->mem, tr->buffer_size);
+    tr->api_key = mem_arena_strdup(tr->mem, config->api_key);
+    tr->host = mem_arena_strdup(tr->mem, host);
+    for (int i = 0; i < GOOGLE_TRANSLATE_REQUESTS; i++) {
+        tr->requests[i].text = mem_arena_alloc(tr->mem, tr->text_max + 1);
+        tr->requests[i].result = mem_arena_alloc(tr->mem, tr->text_max + 1);
+    }
+    if (tr->cache_num > 0) {
+        tr->cache = mem_arena_alloc(tr->mem, tr->cache_num * sizeof(tr_cache_entry_t));
+        memset(tr->cache, 0, tr->cache_num * sizeof(tr_cache_entry_t));
+        for (int i = 0; i < tr->cache_num; i++) {
+            tr->cache[i].text = mem_arena_alloc(tr->mem, tr->text_max + 1);
+        }
+    }
+
+    tr->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, tr->lock, goto exit_translate_init);
+    tr->task_exit = xSemaphoreCreateBinary();
+    AUDIO_MEM_CHECK(TAG, tr->task_exit, goto exit_translate_init);
+    /* One slot per request, a request is never refused for lack of room */
+    tr->queue = xQueueCreate(GOOGLE_TRANSLATE_REQUESTS + 1, sizeof(tr_request_t *));
+    AUDIO_MEM_CHECK(TAG, tr->queue, goto exit_translate_init);
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    tr->evt = audio_event_iface_init(&evt_cfg);
+    AUDIO_MEM_CHECK(TAG, tr->evt, goto exit_translate_init);
+
+    if (xTaskCreate(_tr_task, "translate", GOOGLE_TRANSLATE_TASK_STACK, tr,
+                    config->task_prio > 0 ? config->task_prio : GOOGLE_TRANSLATE_TASK_PRIO, &tr->task) != pdPASS) {
+        ESP_LOGE(TAG, "Error create translation task");
+        tr->task = NULL;
+        goto exit_translate_init;
+    }
+    return tr;
+exit_translate_init:
+    google_translate_destroy(tr);
+    return NULL;
+}
+
+esp_err_t google_translate_destroy(google_translate_handle_t tr)
+{
+    if (tr == NULL) {
+        return ESP_FAIL;
+    }
+    if (tr->task) {
+        /* Quits after the request in progress */
+        tr_request_t *quit = NULL;
+        xQueueSendToFront(tr->queue, &quit, portMAX_DELAY);
+        xSemaphoreTake(tr->task_exit, portMAX_DELAY);
+    }
+    if (tr->queue) {
+        vQueueDelete(tr->queue);
+    }
+    if (tr->lock) {
+        vSemaphoreDelete(tr->lock);
+    }
+    if (tr->task_exit) {
+        vSemaphoreDelete(tr->task_exit);
+    }
+    if (tr->evt) {
+        audio_event_iface_destroy(tr->evt);
+    }
+    mem_arena_destroy(tr->mem);
+    free(tr);
+    return ESP_OK;
+}
+
+int google_translate_start(google_translate_handle_t tr, const char *text, const char *source_lang, const char *target_lang)
+{
+    if (strlen(text) > (size_t)tr->text_max || strlen(source_lang) >= GOOGLE_TRANSLATE_LANG_MAX
+            || strlen(target_lang) >= GOOGLE_TRANSLATE_LANG_MAX) {
+        ESP_LOGE(TAG, "Text longer than %d bytes or language code too long", tr->text_max);
+        return -1;
+    }
+    /* A free slot, or the finished request started longest ago */
+    xSemaphoreTake(tr->lock, portMAX_DELAY);
+    tr_request_t *req = NULL;
+    for (int i = 0; i < GOOGLE_TRANSLATE_REQUESTS; i++) {
+        tr_request_t *r = &tr->requests[i];
+        if (r->state == TR_REQ_QUEUED) {
+            continue;
+        }
+        if (req == NULL || r->state == TR_REQ_FREE || (req->state != TR_REQ_FREE && r->id < req->id)) {
+            req = r;
+        }
+    }
+    if (req == NULL) {
+        xSemaphoreGive(tr->lock);
+        ESP_LOGW(TAG, "All %d requests are waiting", GOOGLE_TRANSLATE_REQUESTS);
+        return -1;
+    }
+    strcpy(req->text, text);
+    strcpy(req->source_lang, source_lang);
+    strcpy(req->target_lang, target_lang);
+    req->id = tr->next_id++;
+    req->state = TR_REQ_QUEUED;
+    req->start_us = esp_timer_get_time();
+    tr->stats.requests++;
+    int id = req->id;
+    xSemaphoreGive(tr->lock);
+    xQueueSend(tr->queue, &req, 0);
+    return id;
+}
+
+const char *google_translate_get_result(google_translate_handle_t tr, int id)
+{
+    const char *result = NULL;
+    xSemaphoreTake(tr->lock, portMAX_DELAY);
+    for (int i = 0; i < GOOGLE_TRANSLATE_REQUESTS; i++) {
+        if (tr->requests[i].state == TR_REQ_DONE && tr->requests[i].id == id) {
+            result = tr->requests[i].result;
+            break;
+        }
+    }
+    xSemaphoreGive(tr->lock);
+    return result;
+}
+
+bool google_translate_check_event(google_translate_handle_t tr, audio_event_iface_msg_t *msg, google_translate_event_t *event)
+{
+    if (msg->source_type != GOOGLE_TRANSLATE_EVENT_SOURCE_TYPE || msg->source != (void *)tr) {
+        return false;
+    }
+    if (event) {
+        *event = (google_translate_event_t)msg->cmd;
+    }
+    return true;
+}
+
+esp_err_t google_translate_set_listener(google_translate_handle_t tr, audio_event_iface_handle_t listener)
+{
+    if (listener) {
+        audio_event_iface_set_listener(tr->evt, listener);
+    }
+    return ESP_OK;
+}
+
+esp_err_t google_translate_preconnect(google_translate_handle_t tr)
+{
+    conn_pool_target_t target;
+    _tr_get_target(tr, &target);
+    return conn_pool_preconnect(&target);
+}
+
+esp_err_t google_translate_get_stats(google_translate_handle_t tr, google_translate_stats_t *stats)
+{
+    if (tr == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(tr->lock, portMAX_DELAY);
+    *stats = tr->stats;
+    xSemaphoreGive(tr->lock);
+    return ESP_OK;
+}
+
+esp_err_t google_translate_get_mem_stats(google_translate_handle_t tr, mem_arena_stats_t *stats)
+{
+    return mem_arena_get_stats(tr->mem, stats);
+}
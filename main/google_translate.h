@@ -0,0 +1,205 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _GOOGLE_TRANSLATE_H_
+#define _GOOGLE_TRANSLATE_H_
+
+#include "esp_err.h"
+#include "audio_event_iface.h"
+#include "audio_common.h"
+#include "mem_arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GOOGLE_TRANSLATE_HOST           "translation.googleapis.com"
+#define GOOGLE_TRANSLATE_PORT           (443)
+#define DEFAULT_TRANSLATE_BUFFER_SIZE   (2048)
+#define GOOGLE_TRANSLATE_TEXT_MAX       (1024)  /*!< Default longest source text and translation */
+#define GOOGLE_TRANSLATE_LANG_MAX       (16)    /*!< Longest language code, with the terminator */
+#define GOOGLE_TRANSLATE_REQUESTS       (4)     /*!< Requests queued or with a readable result */
+#define GOOGLE_TRANSLATE_CACHE_ENTRIES  (32)
+#define GOOGLE_TRANSLATE_TIMEOUT_MS     (10*1000)
+#define GOOGLE_TRANSLATE_TASK_STACK     (6*1024)
+#define GOOGLE_TRANSLATE_TASK_PRIO      (5)
+
+/**
+ * Google Cloud Translation events sent to the listener, `msg.source_type` is
+ * GOOGLE_TRANSLATE_EVENT_SOURCE_TYPE, `msg.source` is the Translation context, `msg.cmd` is one
+ * of these and `msg.data` the request id. Requests are reported in the order they were started
+ */
+typedef enum {
+    GOOGLE_TRANSLATE_EVENT_DONE = 1,    /*!< The translation is ready, see google_translate_get_result */
+    GOOGLE_TRANSLATE_EVENT_FAILED,      /*!< The request failed */
+} google_translate_event_t;
+
+#define GOOGLE_TRANSLATE_EVENT_SOURCE_TYPE (AUDIO_ELEMENT_TYPE_SERVICE)
+
+typedef struct google_translate* google_translate_handle_t;
+
+typedef struct {
+    const char *api_key;
+    const char *host;           /*!< Server host, NULL for GOOGLE_TRANSLATE_HOST */
+    int port;                   /*!< Server port, 0 for GOOGLE_TRANSLATE_PORT */
+    bool plain_text;            /*!< HTTP without TLS (local stand-in servers only) */
+    const char *cacert_pem;     /*!< CA of a local TLS stand-in server, NULL for the certificate bundle */
+    int buffer_size;            /*!< Request and response buffer, 0 for DEFAULT_TRANSLATE_BUFFER_SIZE */
+    int text_max;               /*!< Longest source text and translation in bytes, 0 for GOOGLE_TRANSLATE_TEXT_MAX */
+    bool cache_enable;          /*!< Answer phrases already translated from PSRAM */
+    int cache_entries;          /*!< Phrases kept, 0 for GOOGLE_TRANSLATE_CACHE_ENTRIES */
+    int task_prio;              /*!< Request task priority, 0 for GOOGLE_TRANSLATE_TASK_PRIO */
+} google_translate_config_t;
+
+/**
+ * Translation counters and the stage durations of the latest request
+ */
+typedef struct {
+    uint32_t requests;          /*!< Requests started */
+    uint32_t cache_hits;        /*!< Requests answered from the cache */
+    uint32_t failures;          /*!< Requests that failed */
+    uint32_t reused;            /*!< Network requests sent on a warm connection */
+    uint32_t last_queue_ms;     /*!< Latest request: waiting for the previous ones */
+    uint32_t last_connect_ms;   /*!< Latest network request: getting the connection, about 0 when warm */
+    uint32_t last_response_ms;  /*!< Latest network request: from the request sent to the response headers */
+    uint32_t last_total_ms;     /*!< Latest request: from google_translate_start to the result */
+    uint32_t total_network_ms;  /*!< Sum of `last_total_ms` of the network requests */
+    int      cache_entries;     /*!< Phrases in the cache */
+} google_translate_stats_t;
+
+/**
+ * @brief      Initialize Google Cloud Translation, this function will return a Translation context
+ *
+ * @param      config  The configuration
+ *
+ * @return     The Translation context
+ */
+google_translate_handle_t google_translate_init(google_translate_config_t *config);
+
+/**
+ * @brief      Translate text without blocking
+ *
+ *             Requests are handled one after the other by a background task, each on the warm
+ *             connection left by the previous one. A phrase found in the cache is answered
+ *             without a request. The result is reported with GOOGLE_TRANSLATE_EVENT_DONE.
+ *
+ * @param[in]  tr           The Translation context
+ * @param[in]  text         The text
+ * @param[in]  source_lang  The language of the text, e.g. "en"
+ * @param[in]  target_lang  The language to translate to, e.g. "es"
+ *
+ * @return     The request id, -1 if the text or a language code is too long, or
+ *             GOOGLE_TRANSLATE_REQUESTS requests are still waiting
+ */
+int google_translate_start(google_translate_handle_t tr, const char *text, const char *source_lang, const char *target_lang);
+
+/**
+ * @brief      Get the translation of a request
+ *
+ *             It stays readable until GOOGLE_TRANSLATE_REQUESTS more requests are started.
+ *
+ * @param[in]  tr  The Translation context
+ * @param[in]  id  The request id
+ *
+ * @return     The translation, NULL if the request is unknown, not done or failed
+ */
+const char *google_translate_get_result(google_translate_handle_t tr, int id);
+
+/**
+ * @brief      Check if the message is a Translation event
+ *
+ * @param[in]  tr     The Translation context
+ * @param      msg    The message
+ * @param[out] event  The event, may be NULL
+ *
+ * @return
+ *  - true
+ *  - false
+ */
+bool google_translate_check_event(google_translate_handle_t tr, audio_event_iface_msg_t *msg, google_translate_event_t *event);
+
+/**
+ * @brief      Register listener for the Translation context
+ *
+ * @param[in]  tr        The Translation context
+ * @param[in]  listener  The listener
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_FAIL
+ */
+esp_err_t google_translate_set_listener(google_translate_handle_t tr, audio_event_iface_handle_t listener);
+
+/**
+ * @brief      Open a connection to the server in the background, so that the next request
+ *             does not wait for the handshake. Call it while the device is idle
+ *
+ * @param[in]  tr  The Translation context
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_FAIL
+ */
+esp_err_t google_translate_preconnect(google_translate_handle_t tr);
+
+/**
+ * @brief      Get the counters and latencies
+ *
+ * @param[in]  tr     The Translation context
+ * @param[out] stats  The stats
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_ERR_INVALID_ARG
+ */
+esp_err_t google_translate_get_stats(google_translate_handle_t tr, google_translate_stats_t *stats);
+
+/**
+ * @brief      Get the usage of the memory arena holding the buffers and the cache
+ *
+ * @param[in]  tr     The Translation context
+ * @param[out] stats  The stats
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_ERR_INVALID_ARG
+ */
+esp_err_t google_translate_get_mem_stats(google_translate_handle_t tr, mem_arena_stats_t *stats);
+
+/**
+ * @brief      Cleanup the Translation object, waiting for the request in progress
+ *
+ * @param[in]  tr  The Translation context
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_FAIL
+ */
+esp_err_t google_translate_destroy(google_translate_handle_t tr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -25,10 +25,12 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
-#include "mbedtls/base64.h"
 
 #include "esp_http_client.h"
 #include "sdkconfig.h"
@@ -39,36 +41,194 @@
 #include "audio_hal.h"
 #include "http_stream.h"
 #include "i2s_stream.h"
+#include "raw_stream.h"
+#include "ringbuf.h"
 #include "mp3_decoder.h"
+#include "opus_decoder.h"
 #include "google_tts.h"
-#include "json_utils.h"
+#include "json_b64_scanner.h"
+#include "json_escape.h"
+#include "http_chunk_writer.h"
+#include "tts_cache.h"
+#include "jitter_buffer.h"
+#include "mem_arena.h"
+#include "voice_trace.h"
 
 static const char *TAG = "GOOGLE_TTS";
 
 #define GOOGLE_TTS_ENDPOINT         "https://texttospeech.googleapis.com/v1beta1/text:synthesize?key=%s"
-#define GOOGLE_TTS_TEMPLATE         "{"\
-                                        "\"audioConfig\": { \"audioEncoding\" : \"MP3\", \"sampleRateHertz\": %d },"\
+#define GOOGLE_TTS_TEMPLATE_HEAD    "{"\
+                                        "\"audioConfig\": { \"audioEncoding\" : \"%s\", \"sampleRateHertz\": %d },"\
                                         "\"voice\": { \"languageCode\" : \"%s\" },"\
-                                        "\"input\": { \"text\" : \"%s\" }"\
+                                        "\"input\": { \"text\" : \""
+#define GOOGLE_TTS_TEMPLATE_TAIL    "\" }"\
                                     "}"
 #define GOOGLE_TTS_TASK_STACK (8*1024)
+#define WAV_CHUNK_HEADER_LEN        (8)
+
+static const char *encoding_map[] = {
+    [TTS_ENCODING_MP3] = "MP3",
+    [TTS_ENCODING_LINEAR16] = "LINEAR16",
+    [TTS_ENCODING_OGG_OPUS] = "OGG_OPUS",
+};
+
+/* An armed request gives up if no text comes within this time */
+#define GOOGLE_TTS_ARM_TIMEOUT_MS   (15*1000)
+/* Text is only handed to an armed request this long before it gives up */
+#define GOOGLE_TTS_ARM_MARGIN_MS    (500)
+/* Long-form: segments waiting for synthesis, and how long the stream stays open once they are done */
+#define GOOGLE_TTS_QUEUE_LEN        (16)
+#define GOOGLE_TTS_QUEUE_LINGER_MS  (300)
+#define GOOGLE_TTS_QUEUE_TASK_STACK (3*1024)
+#define GOOGLE_TTS_QUEUE_TASK_PRIO  (5)
+/* Playback tap: small buffers keep the tapped audio close to what the speaker plays */
+#define GOOGLE_TTS_TAP_BUFFER_LEN   (512)
+#define GOOGLE_TTS_TAP_RB_SIZE      (2*1024)
+
+typedef struct {
+    char lang_code[GOOGLE_TTS_LANG_MAX];
+    char text[GOOGLE_TTS_SEGMENT_MAX + 1];
+} tts_segment_t;
 
 typedef struct google_tts {
     audio_pipeline_handle_t pipeline;
     audio_element_handle_t  i2s_writer;
     audio_element_handle_t  http_stream_reader;
     audio_element_handle_t  mp3_decoder;
+    audio_element_handle_t  opus_decoder;
+    google_tts_encoding_t   encoding;
+    const char              *decoder_tag;
+    uint8_t                 wav_hdr[WAV_CHUNK_HEADER_LEN];
+    int                     wav_hdr_len;
+    int                     wav_skip;
+    bool                    wav_data;       /* LINEAR16 header skipped, the rest is PCM */
     char                    *api_key;
     char                    *lang_code;
     int                     buffer_size;
     char                    *buffer;
-    char                    *text;
-    bool                    is_begin;
+    char                    *text;          /* Empty while an armed request waits */
+    int                     text_max;
+    mem_arena_handle_t      mem;
+    json_b64_scanner_t      scanner;
     int                     tts_total_read;
     int                     sample_rate;
-    int                     remain_len;
+    tts_cache_handle_t      cache;
+    audio_element_handle_t  cache_reader;
+    uint64_t                cache_key;
+    const char              *source_tag;
+    audio_event_iface_handle_t listener;
+    bool                    armed;          /* Request open, waiting for the text */
+    int64_t                 armed_until_us; /* When the armed request stops waiting */
+    SemaphoreHandle_t       text_ready;
+    audio_event_iface_handle_t evt;
+    audio_element_handle_t  queue_source;   /* Long-form: synthesized segments are written here */
+    QueueHandle_t           segments;
+    QueueHandle_t           free_segments;
+    SemaphoreHandle_t       queue_lock;
+    SemaphoreHandle_t       queue_task_exit;
+    TaskHandle_t            queue_task;
+    bool                    queue_running;  /* The producer still takes segments */
+    bool                    queue_abort;
+    audio_element_handle_t  tap;            /* Passes the audio to I2S, showing it to tap_cb */
+    google_tts_tap_cb_t     tap_cb;
+    void                    *tap_ctx;
+    bool                    tap_linked;
+    audio_element_handle_t  jitter;         /* Smooths the decoded audio into steady playback, may be NULL */
 } google_tts_t;
 
+/* Returns how many leading bytes still belong to the WAV header, up to the "data" chunk payload */
+static int _tts_wav_header_skip(google_tts_t *tts, const uint8_t *buf, int len)
+{
+    int i = 0;
+    while (i < len && !tts->wav_data) {
+        if (tts->wav_skip > 0) {
+            int n = len - i < tts->wav_skip ? len - i : tts->wav_skip;
+            i += n;
+            tts->wav_skip -= n;
+            continue;
+        }
+        tts->wav_hdr[tts->wav_hdr_len++] = buf[i++];
+        if (tts->wav_hdr_len < WAV_CHUNK_HEADER_LEN) {
+            continue;
+        }
+        tts->wav_hdr_len = 0;
+        uint32_t size = tts->wav_hdr[4] | (tts->wav_hdr[5] << 8) | (tts->wav_hdr[6] << 16) | ((uint32_t)tts->wav_hdr[7] << 24);
+        if (memcmp(tts->wav_hdr, "RIFF", 4) == 0) {
+            /* Only the "WAVE" form type follows, then the chunks */
+            tts->wav_skip = 4;
+        } else if (memcmp(tts->wav_hdr, "data", 4) == 0) {
+            tts->wav_data = true;
+        } else {
+            tts->wav_skip = size + (size & 1);
+        }
+    }
+    return i;
+}
+
+static int _tts_write_text(http_chunk_writer_t *body, const char *text)
+{
+    /* Escaped piece by piece into the chunk, the text can be any length */
+    int len = strlen(text);
+    int pos = 0, total = 0;
+    while (pos < len) {
+        int out_len;
+        if (http_chunk_writer_room(body) < JSON_ESCAPE_MAX_OUT_CHAR && http_chunk_writer_flush(body, false) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        pos += json_escape(text + pos, len - pos, http_chunk_writer_tail(body), http_chunk_writer_room(body), &out_len);
+        if (http_chunk_writer_commit(body, out_len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        total += out_len;
+    }
+    return total;
+}
+
+static int _tts_write_body(esp_http_client_handle_t http, google_tts_t *tts)
+{
+    /* The whole body is gathered in the scratch buffer and sent as one chunk, together with the
+     * end of the body, unless the text does not fit */
+    http_chunk_writer_t body;
+    http_chunk_writer_init(&body, http, tts->buffer, tts->buffer_size, tts->buffer_size, 0);
+    int len = snprintf(http_chunk_writer_tail(&body), http_chunk_writer_room(&body), GOOGLE_TTS_TEMPLATE_HEAD,
+                       encoding_map[tts->encoding], tts->sample_rate, tts->lang_code);
+    if (len >= http_chunk_writer_room(&body)) {
+        ESP_LOGE(TAG, "Please use TTS buffer size greater than %d", HTTP_CHUNK_BUFFER_SIZE(len));
+        return ESP_FAIL;
+    }
+    http_chunk_writer_commit(&body, len);
+    int total = len;
+    if (tts->armed) {
+        /* The head goes out while the text is awaited */
+        if (http_chunk_writer_flush(&body, false) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        if (xSemaphoreTake(tts->text_ready, pdMS_TO_TICKS(GOOGLE_TTS_ARM_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "No text for the armed request");
+            return ESP_FAIL;
+        }
+        if (tts->text[0] == '\0') {
+            /* Disarmed */
+            return ESP_FAIL;
+        }
+    }
+    len = _tts_write_text(&body, tts->text);
+    if (len < 0) {
+        return ESP_FAIL;
+    }
+    total += len;
+    len = strlen(GOOGLE_TTS_TEMPLATE_TAIL);
+    if (http_chunk_writer_room(&body) < len && http_chunk_writer_flush(&body, false) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    memcpy(http_chunk_writer_tail(&body), GOOGLE_TTS_TEMPLATE_TAIL, len);
+    if (http_chunk_writer_end(&body, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    ESP_LOGD(TAG, "Request body: %u bytes in %u writes", body.wire_bytes, body.writes);
+    return total + len;
+}
+
 static esp_err_t _http_stream_reader_event_handle(http_stream_event_msg_t *msg)
 {
     esp_http_client_handle_t http = (esp_http_client_handle_t)msg->http_client;
@@ -80,66 +240,74 @@ static esp_err_t _http_stream_reader_event_handle(http_stream_event_msg_t *msg)
         // Post text data
         ESP_LOGI(TAG, "[ + ] HTTP client HTTP_STREAM_PRE_REQUEST, lenght=%d", msg->buffer_len);
         tts->tts_total_read = 0;
-        tts->is_begin = true;
-        int payload_len = snprintf(tts->buffer, tts->buffer_size, GOOGLE_TTS_TEMPLATE, tts->sample_rate, tts->lang_code, tts->text);
-        esp_http_client_set_post_field(http, tts->buffer, payload_len);
+        json_b64_scanner_init(&tts->scanner, "audioContent");
+        tts->wav_hdr_len = 0;
+        tts->wav_skip = 0;
+        tts->wav_data = tts->encoding != TTS_ENCODING_LINEAR16;
+        /* A length of -1 opens the request with chunked transfer encoding, the body is streamed in
+         * ON_REQUEST, where an armed request waits for its text */
+        esp_http_client_set_post_field(http, tts->buffer, -1);
         esp_http_client_set_method(http, HTTP_METHOD_POST);
         esp_http_client_set_header(http, "Content-Type", "application/json");
-        tts->remain_len = 0;
         return ESP_OK;
     }
 
+    if (msg->event_id == HTTP_STREAM_ON_REQUEST) {
+        return _tts_write_body(http, tts);
+    }
+
     if (msg->event_id == HTTP_STREAM_ON_RESPONSE) {
         ESP_LOGD(TAG, "[ + ] HTTP client HTTP_STREAM_ON_RESPONSE, lenght=%d", msg->buffer_len);
-        /* Read first chunk */
-        int process_data_len = 0;
-        char *data_ptr = tts->buffer;
-        int align_read = msg->buffer_len * 4 / 3;
-        align_read -= (align_read % 4);
-        align_read -= tts->remain_len;
-        read_len = esp_http_client_read(http, tts->remain_len + tts->buffer, align_read);
-
-        // ESP_LOGI(TAG, "Need read = %d, read_len=%d, tts->remain_len=%d", align_read, read_len, tts->remain_len);
-        if (read_len <= 0) {
-            return read_len;
+        int max_read = JSON_B64_SCANNER_MAX_IN(msg->buffer_len);
+        if (max_read > tts->buffer_size) {
+            max_read = tts->buffer_size;
         }
-        process_data_len = read_len + tts->remain_len;
-
-        if (tts->is_begin) {
-            tts->is_begin = false;
-
-            while (*data_ptr != ':' && process_data_len) {
-                process_data_len--;
-                data_ptr++;
+        /* Keep reading until some audio comes out, the member may start several reads in */
+        while (!json_b64_scanner_done(&tts->scanner)) {
+            read_len = esp_http_client_read(http, tts->buffer, max_read);
+            if (read_len <= 0) {
+                break;
             }
-            while (*data_ptr != '"' && process_data_len) {
-                process_data_len--;
-                data_ptr++;
+            int audio_len = json_b64_scanner_feed(&tts->scanner, tts->buffer, read_len, msg->buffer, msg->buffer_len);
+            if (audio_len < 0) {
+                ESP_LOGE(TAG, "Invalid audioContent in response");
+                if (tts->cache) {
+                    tts_cache_put_end(tts->cache, false);
+                }
+                return ESP_FAIL;
+            }
+            if (audio_len > 0 && !tts->wav_data) {
+                /* LINEAR16 comes as a WAV file, the I2S writer only wants the samples */
+                int skip = _tts_wav_header_skip(tts, (const uint8_t *)msg->buffer, audio_len);
+                audio_len -= skip;
+                memmove(msg->buffer, msg->buffer + skip, audio_len);
+            }
+            if (audio_len > 0) {
+                VOICE_TRACE_MARK_ONCE(VOICE_TRACE_TTS_FIRST_BYTE, 0);
+                tts->tts_total_read += audio_len;
+                if (tts->cache) {
+                    tts_cache_put_data(tts->cache, msg->buffer, audio_len);
+                }
+                return audio_len;
             }
-            // *data_ptr = 0;
-            data_ptr++;
-            process_data_len--;
-
         }
-        unsigned int mp3_len = 0;
-        int keep_next_time = 0;
-        if (process_data_len > 0) {
-            data_ptr[process_data_len] = 0;
-            keep_next_time = process_data_len % 4;
-            process_data_len -= keep_next_time;
-            tts->remain_len = keep_next_time;
-            mbedtls_base64_decode(msg->buffer, msg->buffer_len, &mp3_len, (unsigned char *)data_ptr, process_data_len);
-            memcpy(tts->buffer, data_ptr + process_data_len, keep_next_time);
+        if (tts->tts_total_read == 0) {
+            ESP_LOGE(TAG, "No audioContent in response");
         }
-        if (mp3_len == 0) {
-            return ESP_FAIL;
+        if (tts->cache) {
+            tts_cache_put_end(tts->cache, tts->tts_total_read > 0 && json_b64_scanner_done(&tts->scanner));
         }
-        return mp3_len;
+        /* End of audio */
+        return ESP_FAIL;
     }
 
     if (msg->event_id == HTTP_STREAM_POST_REQUEST) {
         ESP_LOGI(TAG, "[ + ] HTTP client HTTP_STREAM_POST_REQUEST, write end chunked marker");
-
+        VOICE_TRACE_MARK(VOICE_TRACE_TTS_REQUEST_SENT, 0);
+        /* The text, and so the cache key, is only known once the body is sent */
+        if (tts->cache) {
+            tts_cache_put_begin(tts->cache, tts->cache_key);
+        }
     }
 
     if (msg->event_id == HTTP_STREAM_FINISH_REQUEST) {
@@ -149,6 +317,225 @@ static esp_err_t _http_stream_reader_event_handle(http_stream_event_msg_t *msg)
     return ESP_OK;
 }
 
+static const char *_tts_decoder_tag(google_tts_encoding_t encoding)
+{
+    if (encoding == TTS_ENCODING_MP3) {
+        return "tts_mp3";
+    } else if (encoding == TTS_ENCODING_OGG_OPUS) {
+        return "tts_opus";
+    }
+    return NULL;
+}
+
+static void _tts_link_source(google_tts_t *tts, const char *source_tag)
+{
+    const char *decoder_tag = _tts_decoder_tag(tts->encoding);
+    bool tap = tts->tap_cb != NULL;
+    if (tts->source_tag == source_tag && tts->decoder_tag == decoder_tag && tts->tap_linked == tap) {
+        return;
+    }
+    /* LINEAR16 samples go to I2S as they are */
+    const char *link_tag[5];
+    int link_num = 0;
+    link_tag[link_num++] = source_tag;
+    if (decoder_tag) {
+        link_tag[link_num++] = decoder_tag;
+    }
+    if (tts->jitter) {
+        link_tag[link_num++] = "tts_jitter";
+    }
+    if (tap) {
+        link_tag[link_num++] = "tts_tap";
+    }
+    link_tag[link_num++] = "tts_i2s";
+    audio_pipeline_stop(tts->pipeline);
+    audio_pipeline_wait_for_stop(tts->pipeline);
+    audio_pipeline_breakup_elements(tts->pipeline, NULL);
+    audio_pipeline_relink(tts->pipeline, &link_tag[0], link_num);
+    if (tts->listener) {
+        audio_pipeline_set_listener(tts->pipeline, tts->listener);
+    }
+    tts->source_tag = source_tag;
+    tts->decoder_tag = decoder_tag;
+    tts->tap_linked = tap;
+}
+
+static audio_element_err_t _tts_tap_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    google_tts_t *tts = (google_tts_t *)audio_element_getdata(self);
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    if (tts->tap_cb) {
+        tts->tap_cb(in_buffer, r_size, tts->tap_ctx);
+    }
+    int w_size = audio_element_output(self, in_buffer, r_size);
+    return w_size < 0 ? w_size : r_size;
+}
+
+static esp_err_t _tts_prepare_decoder(google_tts_t *tts, google_tts_encoding_t encoding)
+{
+    if (encoding == TTS_ENCODING_OGG_OPUS && tts->opus_decoder == NULL) {
+        opus_decoder_cfg_t opus_cfg = DEFAULT_OPUS_DECODER_CONFIG();
+        tts->opus_decoder = decoder_opus_init(&opus_cfg);
+        AUDIO_MEM_CHECK(TAG, tts->opus_decoder, return ESP_ERR_NO_MEM);
+        audio_pipeline_register(tts->pipeline, tts->opus_decoder, "tts_opus");
+    } else if (encoding != TTS_ENCODING_MP3 && encoding != TTS_ENCODING_LINEAR16 && encoding != TTS_ENCODING_OGG_OPUS) {
+        ESP_LOGE(TAG, "Unsupported encoding %d", encoding);
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static void _tts_send_event(google_tts_t *tts, google_tts_event_t event, int data)
+{
+    audio_event_iface_msg_t msg = {
+        .cmd = event,
+        .data = (void *)(intptr_t)data,
+        .source = tts,
+        .source_type = GOOGLE_TTS_EVENT_SOURCE_TYPE,
+    };
+    audio_event_iface_sendout(tts->evt, &msg);
+}
+
+/* Length of the next segment: a sentence, or a clause or words of a sentence longer than `max_len` */
+static int _tts_segment_len(const char *text, int max_len)
+{
+    const uint8_t *p = (const uint8_t *)text;
+    int clause = 0, space = 0;
+    int i;
+    for (i = 0; p[i] && i < max_len; i++) {
+        int end = 0;
+        if (p[i] == '.' || p[i] == '!' || p[i] == '?') {
+            end = 1;
+        } else if ((p[i] == 0xE3 && p[i + 1] == 0x80 && p[i + 2] == 0x82)
+                   || (p[i] == 0xEF && p[i + 1] == 0xBC && (p[i + 2] == 0x81 || p[i + 2] == 0x9F))) {
+            /* Fullwidth full stop, exclamation and question marks, not followed by spaces */
+            end = 3;
+        }
+        if (end) {
+            int j = i + end;
+            while (p[j] == '.' || p[j] == '!' || p[j] == '?' || p[j] == '"' || p[j] == '\'' || p[j] == ')') {
+                j++;
+            }
+            /* "3.5" or "e.g." inside a word is not the end of a sentence */
+            if ((end == 3 || p[j] == '\0' || p[j] == ' ' || p[j] == '\n') && j <= max_len) {
+                return j;
+            }
+        }
+        if (p[i] == ',' || p[i] == ';' || p[i] == ':') {
+            clause = i + 1;
+        } else if (p[i] == ' ') {
+            space = i;
+        }
+    }
+    if (p[i] == '\0') {
+        return i;
+    }
+    if (clause > 0) {
+        return clause;
+    }
+    if (space > 0) {
+        return space;
+    }
+    /* No break at all, at least keep characters whole */
+    int len = i;
+    while (len > 0 && (p[len] & 0xC0) == 0x80) {
+        len--;
+    }
+    return len > 0 ? len : i;
+}
+
+static audio_element_err_t _tts_queue_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    google_tts_t *tts = (google_tts_t *)context;
+    return raw_stream_write(tts->queue_source, buffer, len);
+}
+
+static esp_err_t _tts_queue_segment(google_tts_t *tts, tts_segment_t *segment)
+{
+    /* text_max is at least GOOGLE_TTS_SEGMENT_MAX */
+    strcpy(tts->text, segment->text);
+    strcpy(tts->lang_code, segment->lang_code);
+    if (tts->cache) {
+        tts->cache_key = tts_cache_key(tts->text, tts->lang_code, encoding_map[tts->encoding], tts->sample_rate);
+        if (tts_cache_open(tts->cache, tts->cache_key) == ESP_OK) {
+            int len;
+            esp_err_t ret = ESP_OK;
+            while ((len = tts_cache_read(tts->cache, (uint8_t *)tts->buffer, tts->buffer_size)) > 0) {
+                if (raw_stream_write(tts->queue_source, tts->buffer, len) < 0) {
+                    ret = ESP_FAIL;
+                    break;
+                }
+            }
+            tts_cache_close(tts->cache);
+            return ret;
+        }
+    }
+    /* The HTTP reader runs on its own, its output is appended to the stream being played */
+    snprintf(tts->buffer, tts->buffer_size, GOOGLE_TTS_ENDPOINT, tts->api_key);
+    audio_element_set_uri(tts->http_stream_reader, tts->buffer);
+    audio_element_set_write_cb(tts->http_stream_reader, _tts_queue_write, tts);
+    audio_element_reset_state(tts->http_stream_reader);
+    audio_element_run(tts->http_stream_reader);
+    audio_element_resume(tts->http_stream_reader, 0, 0);
+    audio_element_wait_for_stop(tts->http_stream_reader);
+    return audio_element_get_state(tts->http_stream_reader) == AEL_STATE_FINISHED ? ESP_OK : ESP_FAIL;
+}
+
+static void _tts_queue_task(void *pv)
+{
+    google_tts_t *tts = (google_tts_t *)pv;
+    tts_segment_t *segment;
+    int index = 0;
+    while (!tts->queue_abort) {
+        if (xQueueReceive(tts->segments, &segment, pdMS_TO_TICKS(GOOGLE_TTS_QUEUE_LINGER_MS)) != pdTRUE) {
+            xSemaphoreTake(tts->queue_lock, portMAX_DELAY);
+            if (uxQueueMessagesWaiting(tts->segments) > 0) {
+                xSemaphoreGive(tts->queue_lock);
+                continue;
+            }
+            /* Nothing more to say, the pipeline plays what is buffered and finishes */
+            tts->queue_running = false;
+            xSemaphoreGive(tts->queue_lock);
+            /* Reported before the end of the stream, so it comes ahead of the end of playback */
+            _tts_send_event(tts, GOOGLE_TTS_EVENT_QUEUE_DONE, index);
+            audio_element_set_ringbuf_done(tts->queue_source);
+            break;
+        }
+        esp_err_t ret = _tts_queue_segment(tts, segment);
+        xQueueSend(tts->free_segments, &segment, 0);
+        if (tts->queue_abort) {
+            break;
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Segment %d failed, skipped", index);
+        }
+        _tts_send_event(tts, ret == ESP_OK ? GOOGLE_TTS_EVENT_SEGMENT_DONE : GOOGLE_TTS_EVENT_SEGMENT_FAILED, index);
+        index++;
+    }
+    xSemaphoreGive(tts->queue_task_exit);
+    vTaskDelete(NULL);
+}
+
+static void _tts_queue_stop(google_tts_t *tts)
+{
+    tts_segment_t *segment;
+    if (tts->queue_task) {
+        tts->queue_abort = true;
+        rb_abort(audio_element_get_output_ringbuf(tts->queue_source));
+        audio_element_stop(tts->http_stream_reader);
+        xSemaphoreTake(tts->queue_task_exit, portMAX_DELAY);
+        tts->queue_task = NULL;
+        tts->queue_abort = false;
+    }
+    while (tts->segments && xQueueReceive(tts->segments, &segment, 0) == pdTRUE) {
+        xQueueSend(tts->free_segments, &segment, 0);
+    }
+    tts->queue_running = false;
+}
+
 google_tts_handle_t google_tts_init(google_tts_config_t *config)
 {
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
@@ -162,13 +549,42 @@ google_tts_handle_t google_tts_init(google_tts_config_t *config)
         tts->buffer_size = DEFAULT_TTS_BUFFER_SIZE;
     }
 
-    tts->buffer = malloc(tts->buffer_size);
-    AUDIO_MEM_CHECK(TAG, tts->buffer, goto exit_tts_init);
+    tts->text_max = config->text_max > 0 ? config->text_max : GOOGLE_TTS_TEXT_MAX;
+    if (tts->text_max < GOOGLE_TTS_SEGMENT_MAX) {
+        tts->text_max = GOOGLE_TTS_SEGMENT_MAX;
+    }
 
-    tts->api_key = strdup(config->api_key);
-    AUDIO_MEM_CHECK(TAG, tts->api_key, goto exit_tts_init);
+    /* Buffers, text and the long-form segment slots are carved from one PSRAM block at init,
+     * so speaking does not allocate. None of it is used for DMA */
+    tts->mem = mem_arena_create(MEM_ARENA_SIZE(tts->buffer_size) + MEM_ARENA_SIZE(tts->text_max + 1)
+                                + MEM_ARENA_SIZE(GOOGLE_TTS_LANG_MAX) + MEM_ARENA_SIZE(strlen(config->api_key) + 1)
+                                + MEM_ARENA_SIZE(GOOGLE_TTS_QUEUE_LEN * sizeof(tts_segment_t)), MEM_ARENA_PREFER_SPIRAM);
+    AUDIO_MEM_CHECK(TAG, tts->mem, goto exit_tts_init);
+    tts->buffer = mem_arena_alloc(tts->mem, tts->buffer_size);
+    tts->text = mem_arena_alloc(tts->mem, tts->text_max + 1);
+    tts->lang_code = mem_arena_alloc(tts->mem, GOOGLE_TTS_LANG_MAX);
+    tts->api_key = mem_arena_strdup(tts->mem, config->api_key);
+    tts_segment_t *segment_pool = mem_arena_alloc(tts->mem, GOOGLE_TTS_QUEUE_LEN * sizeof(tts_segment_t));
+    tts->text_ready = xSemaphoreCreateBinary();
+    AUDIO_MEM_CHECK(TAG, tts->text_ready, goto exit_tts_init);
+    tts->segments = xQueueCreate(GOOGLE_TTS_QUEUE_LEN, sizeof(tts_segment_t *));
+    AUDIO_MEM_CHECK(TAG, tts->segments, goto exit_tts_init);
+    tts->free_segments = xQueueCreate(GOOGLE_TTS_QUEUE_LEN, sizeof(tts_segment_t *));
+    AUDIO_MEM_CHECK(TAG, tts->free_segments, goto exit_tts_init);
+    for (int i = 0; i < GOOGLE_TTS_QUEUE_LEN; i++) {
+        tts_segment_t *segment = &segment_pool[i];
+        xQueueSend(tts->free_segments, &segment, 0);
+    }
+    tts->queue_lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, tts->queue_lock, goto exit_tts_init);
+    tts->queue_task_exit = xSemaphoreCreateBinary();
+    AUDIO_MEM_CHECK(TAG, tts->queue_task_exit, goto exit_tts_init);
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    tts->evt = audio_event_iface_init(&evt_cfg);
+    AUDIO_MEM_CHECK(TAG, tts->evt, goto exit_tts_init);
 
     tts->sample_rate = config->playback_sample_rate;
+    tts->encoding = config->encoding;
 
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.type = AUDIO_STREAM_WRITER;
@@ -185,11 +601,62 @@ google_tts_handle_t google_tts_init(google_tts_config_t *config)
     mp3_decoder_cfg_t mp3_cfg = DEFAULT_MP3_DECODER_CONFIG();
     tts->mp3_decoder = mp3_decoder_init(&mp3_cfg);
 
+    raw_stream_cfg_t raw_cfg = RAW_STREAM_CFG_DEFAULT();
+    raw_cfg.type = AUDIO_STREAM_WRITER;
+    raw_cfg.out_rb_size = GOOGLE_TTS_QUEUE_BUFFER_SIZE;
+    tts->queue_source = raw_stream_init(&raw_cfg);
+    AUDIO_MEM_CHECK(TAG, tts->queue_source, goto exit_tts_init);
+
+    audio_element_cfg_t tap_cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    tap_cfg.process = _tts_tap_process;
+    tap_cfg.buffer_len = GOOGLE_TTS_TAP_BUFFER_LEN;
+    tap_cfg.out_rb_size = GOOGLE_TTS_TAP_RB_SIZE;
+    tap_cfg.tag = "tts_tap";
+    tts->tap = audio_element_init(&tap_cfg);
+    AUDIO_MEM_CHECK(TAG, tts->tap, goto exit_tts_init);
+    audio_element_setdata(tts->tap, tts);
+
     audio_pipeline_register(tts->pipeline, tts->http_stream_reader, "tts_http");
     audio_pipeline_register(tts->pipeline, tts->mp3_decoder,        "tts_mp3");
     audio_pipeline_register(tts->pipeline, tts->i2s_writer,         "tts_i2s");
-    const char *link_tag[3] = {"tts_http", "tts_mp3", "tts_i2s"};
-    audio_pipeline_link(tts->pipeline, &link_tag[0], 3);
+    audio_pipeline_register(tts->pipeline, tts->queue_source,       "tts_queue");
+    audio_pipeline_register(tts->pipeline, tts->tap,                "tts_tap");
+    if (_tts_prepare_decoder(tts, tts->encoding) != ESP_OK) {
+        goto exit_tts_init;
+    }
+    if (config->cache_enable) {
+        tts_cache_cfg_t cache_cfg = {
+            .mem_size = config->cache_mem_size,
+        };
+        tts->cache = tts_cache_init(&cache_cfg);
+        AUDIO_MEM_CHECK(TAG, tts->cache, goto exit_tts_init);
+        tts->cache_reader = tts_cache_reader_init(tts->cache);
+        AUDIO_MEM_CHECK(TAG, tts->cache_reader, goto exit_tts_init);
+        audio_pipeline_register(tts->pipeline, tts->cache_reader, "tts_cache");
+    }
+    if (config->jitter_buffer_enable) {
+        jitter_buffer_cfg_t jitter_cfg = {
+            .sample_rate = config->playback_sample_rate,
+            .min_ms = config->jitter_min_ms,
+            .max_ms = config->jitter_max_ms,
+        };
+        tts->jitter = jitter_buffer_init(&jitter_cfg);
+        AUDIO_MEM_CHECK(TAG, tts->jitter, goto exit_tts_init);
+        audio_pipeline_register(tts->pipeline, tts->jitter, "tts_jitter");
+    }
+    const char *link_tag[4];
+    int link_num = 0;
+    link_tag[link_num++] = "tts_http";
+    tts->decoder_tag = _tts_decoder_tag(tts->encoding);
+    if (tts->decoder_tag) {
+        link_tag[link_num++] = tts->decoder_tag;
+    }
+    if (tts->jitter) {
+        link_tag[link_num++] = "tts_jitter";
+    }
+    link_tag[link_num++] = "tts_i2s";
+    audio_pipeline_link(tts->pipeline, &link_tag[0], link_num);
+    tts->source_tag = "tts_http";
     i2s_stream_set_clk(tts->i2s_writer, config->playback_sample_rate, 16, 1);
     return tts;
 exit_tts_init:
@@ -202,13 +669,30 @@ esp_err_t google_tts_destroy(google_tts_handle_t tts)
     if (tts == NULL) {
         return ESP_FAIL;
     }
-    audio_pipeline_stop(tts->pipeline);
-    audio_pipeline_wait_for_stop(tts->pipeline);
+    google_tts_stop(tts);
     audio_pipeline_terminate(tts->pipeline);
     audio_pipeline_remove_listener(tts->pipeline);
     audio_pipeline_deinit(tts->pipeline);
-    free(tts->buffer);
-    free(tts->api_key);
+    tts_cache_destroy(tts->cache);
+    if (tts->text_ready) {
+        vSemaphoreDelete(tts->text_ready);
+    }
+    if (tts->segments) {
+        vQueueDelete(tts->segments);
+    }
+    if (tts->free_segments) {
+        vQueueDelete(tts->free_segments);
+    }
+    if (tts->queue_lock) {
+        vSemaphoreDelete(tts->queue_lock);
+    }
+    if (tts->queue_task_exit) {
+        vSemaphoreDelete(tts->queue_task_exit);
+    }
+    if (tts->evt) {
+        audio_event_iface_destroy(tts->evt);
+    }
+    mem_arena_destroy(tts->mem);
     free(tts);
     return ESP_OK;
 }
@@ -217,48 +701,273 @@ esp_err_t google_tts_set_listener(google_tts_handle_t tts, audio_event_iface_han
 {
     if (listener) {
         audio_pipeline_set_listener(tts->pipeline, listener);
+        audio_event_iface_set_listener(tts->evt, listener);
+        tts->listener = listener;
     }
     return ESP_OK;
 }
 
 bool google_tts_check_event_finish(google_tts_handle_t tts, audio_event_iface_msg_t *msg)
 {
+    /* The decoder reports the stream info right before its first output */
+    if (msg->source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg->cmd == AEL_MSG_CMD_REPORT_MUSIC_INFO
+            && (msg->source == (void *) tts->mp3_decoder || msg->source == (void *) tts->opus_decoder)) {
+        VOICE_TRACE_MARK_ONCE(VOICE_TRACE_TTS_FIRST_SAMPLE, 0);
+        audio_element_info_t info = {0};
+        audio_element_getinfo((audio_element_handle_t)msg->source, &info);
+        if (info.sample_rates > 0 && info.channels > 0) {
+            i2s_stream_set_clk(tts->i2s_writer, info.sample_rates, info.bits, info.channels);
+            if (tts->jitter) {
+                jitter_buffer_set_format(tts->jitter, info.sample_rates, info.channels);
+            }
+        }
+    }
     if (msg->source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg->source == (void *) tts->i2s_writer
             && msg->cmd == AEL_MSG_CMD_REPORT_STATUS
-            && (((int)msg->data == AEL_STATUS_STATE_STOPPED) || ((int)msg->data == AEL_STATUS_STATE_FINISHED))) {
+            && (((int)(intptr_t)msg->data == AEL_STATUS_STATE_STOPPED)
+                || ((int)(intptr_t)msg->data == AEL_STATUS_STATE_FINISHED))) {
+        VOICE_TRACE_MARK(VOICE_TRACE_TTS_DONE, 0);
+        /* Nothing is playing, the cache task persists the new entries meanwhile */
+        if (tts->cache) {
+            tts_cache_sync_start(tts->cache);
+        }
         return true;
     }
     return false;
 }
 
 
-esp_err_t google_tts_start(google_tts_handle_t tts, const char *text, const char *lang_code)
+esp_err_t google_tts_arm(google_tts_handle_t tts, const char *lang_code)
 {
-    free(tts->lang_code);
-    free(tts->text);
-    tts->lang_code = strdup(lang_code);
-    if (tts->lang_code == NULL) {
-        ESP_LOGE(TAG, "Error no mem");
-        return ESP_ERR_NO_MEM;
-    }
-    tts->text = strdup(text);
-    if (tts->text == NULL) {
-        free(tts->lang_code);
-        ESP_LOGE(TAG, "Error no mem");
-        return ESP_ERR_NO_MEM;
+    /* The codec is free only once the previous answer has fully stopped */
+    google_tts_stop(tts);
+    if (strlen(lang_code) >= GOOGLE_TTS_LANG_MAX) {
+        ESP_LOGE(TAG, "Language code too long");
+        return ESP_ERR_INVALID_SIZE;
     }
+    strcpy(tts->lang_code, lang_code);
+    tts->text[0] = '\0';
     snprintf(tts->buffer, tts->buffer_size, GOOGLE_TTS_ENDPOINT, tts->api_key);
+    audio_element_set_uri(tts->http_stream_reader, tts->buffer);
+    _tts_link_source(tts, "tts_http");
+    xSemaphoreTake(tts->text_ready, 0);
+    tts->armed = true;
+    tts->armed_until_us = esp_timer_get_time() + GOOGLE_TTS_ARM_TIMEOUT_MS * 1000LL;
+    audio_pipeline_reset_items_state(tts->pipeline);
+    audio_pipeline_reset_ringbuffer(tts->pipeline);
+    audio_pipeline_run(tts->pipeline);
+    return ESP_OK;
+}
+
+static bool _tts_take_armed(google_tts_t *tts, const char *text, const char *lang_code)
+{
+    int len = strlen(text);
+    if (!tts->armed || strcmp(tts->lang_code, lang_code) != 0 || len == 0 || len > tts->text_max) {
+        return false;
+    }
+    /* The request may have failed to connect, or be about to give up on the text: the text would
+     * be lost with it */
+    audio_element_state_t state = audio_element_get_state(tts->http_stream_reader);
+    if (state != AEL_STATE_INIT && state != AEL_STATE_INITIALIZING && state != AEL_STATE_RUNNING) {
+        ESP_LOGW(TAG, "Armed request ended (state %d), opening a new one", state);
+        return false;
+    }
+    if (esp_timer_get_time() > tts->armed_until_us - GOOGLE_TTS_ARM_MARGIN_MS * 1000LL) {
+        ESP_LOGW(TAG, "Armed request about to time out, opening a new one");
+        return false;
+    }
+    memcpy(tts->text, text, len + 1);
+    tts->armed = false;
+    xSemaphoreGive(tts->text_ready);
+    return true;
+}
+
+esp_err_t google_tts_start(google_tts_handle_t tts, const char *text, const char *lang_code)
+{
+    if (tts->queue_task) {
+        google_tts_stop(tts);
+    }
+    if (strlen(text) > (size_t)tts->text_max && tts->encoding != TTS_ENCODING_OGG_OPUS
+            && strlen(lang_code) < GOOGLE_TTS_LANG_MAX) {
+        /* More than one request holds, spoken sentence by sentence as one stream instead */
+        ESP_LOGI(TAG, "Text longer than %d bytes, spoken in segments", tts->text_max);
+        return google_tts_enqueue(tts, text, lang_code);
+    }
+    if (strlen(text) > (size_t)tts->text_max || strlen(lang_code) >= GOOGLE_TTS_LANG_MAX) {
+        ESP_LOGE(TAG, "Text longer than %d bytes or language code too long", tts->text_max);
+        if (tts->armed) {
+            google_tts_stop(tts);
+        }
+        return ESP_ERR_INVALID_SIZE;
+    }
+    bool cached = false;
+    if (tts->cache) {
+        if (!tts->armed) {
+            /* The lookup rewinds the cache reader, which may still be playing the previous answer */
+            google_tts_stop(tts);
+        }
+        tts->cache_key = tts_cache_key(text, lang_code, encoding_map[tts->encoding], tts->sample_rate);
+        cached = tts_cache_open(tts->cache, tts->cache_key) == ESP_OK;
+    }
+    if (!cached && _tts_take_armed(tts, text, lang_code)) {
+        ESP_LOGD(TAG, "Text sent on the armed request");
+        return ESP_OK;
+    }
+    if (tts->armed) {
+        google_tts_stop(tts);
+    }
+    strcpy(tts->lang_code, lang_code);
+    strcpy(tts->text, text);
+    if (cached) {
+        ESP_LOGI(TAG, "Playing from cache");
+        _tts_link_source(tts, "tts_cache");
+    } else {
+        snprintf(tts->buffer, tts->buffer_size, GOOGLE_TTS_ENDPOINT, tts->api_key);
+        audio_element_set_uri(tts->http_stream_reader, tts->buffer);
+        _tts_link_source(tts, "tts_http");
+    }
     audio_pipeline_reset_items_state(tts->pipeline);
     audio_pipeline_reset_ringbuffer(tts->pipeline);
-    audio_element_set_uri(tts->http_stream_reader, tts->buffer);
     audio_pipeline_run(tts->pipeline);
     return ESP_OK;
 }
 
 esp_err_t google_tts_stop(google_tts_handle_t tts)
 {
+    if (tts->armed) {
+        /* Wake the request waiting for text, it fails without a body */
+        tts->armed = false;
+        xSemaphoreGive(tts->text_ready);
+    }
+    _tts_queue_stop(tts);
     audio_pipeline_stop(tts->pipeline);
     audio_pipeline_wait_for_stop(tts->pipeline);
     ESP_LOGD(TAG, "TTS Stopped");
     return ESP_OK;
 }
+
+esp_err_t google_tts_enqueue(google_tts_handle_t tts, const char *text, const char *lang_code)
+{
+    if (tts->encoding == TTS_ENCODING_OGG_OPUS) {
+        /* Chained Ogg streams are not decoded */
+        ESP_LOGE(TAG, "Long-form needs MP3 or LINEAR16");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    /* Checked before anything runs, a failed call leaves playback as it was */
+    if (strlen(lang_code) >= GOOGLE_TTS_LANG_MAX) {
+        ESP_LOGE(TAG, "Language code too long");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    xSemaphoreTake(tts->queue_lock, portMAX_DELAY);
+    bool start = !tts->queue_running;
+    xSemaphoreGive(tts->queue_lock);
+    if (start) {
+        /* One continuous stream: segments -> tts_queue -> decoder -> I2S */
+        google_tts_stop(tts);
+        _tts_link_source(tts, "tts_queue");
+        audio_pipeline_reset_items_state(tts->pipeline);
+        audio_pipeline_reset_ringbuffer(tts->pipeline);
+        audio_pipeline_run(tts->pipeline);
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(tts->queue_lock, portMAX_DELAY);
+    while (*text) {
+        while (*text == ' ' || *text == '\n' || *text == '\t' || *text == '\r') {
+            text++;
+        }
+        int len = _tts_segment_len(text, GOOGLE_TTS_SEGMENT_MAX);
+        int trimmed = len;
+        while (trimmed > 0 && (text[trimmed - 1] == ' ' || text[trimmed - 1] == '\n')) {
+            trimmed--;
+        }
+        if (trimmed > 0) {
+            tts_segment_t *segment;
+            if (xQueueReceive(tts->free_segments, &segment, 0) != pdTRUE) {
+                ESP_LOGW(TAG, "Segment queue full, text dropped");
+                ret = ESP_FAIL;
+                break;
+            }
+            memcpy(segment->text, text, trimmed);
+            segment->text[trimmed] = '\0';
+            strcpy(segment->lang_code, lang_code);
+            xQueueSend(tts->segments, &segment, 0);
+        }
+        text += len;
+    }
+    tts->queue_running = true;
+    xSemaphoreGive(tts->queue_lock);
+
+    if (start) {
+        xSemaphoreTake(tts->queue_task_exit, 0);
+        if (xTaskCreate(_tts_queue_task, "tts_queue", GOOGLE_TTS_QUEUE_TASK_STACK, tts,
+                        GOOGLE_TTS_QUEUE_TASK_PRIO, &tts->queue_task) != pdPASS) {
+            ESP_LOGE(TAG, "Error create TTS queue task");
+            tts->queue_task = NULL;
+            _tts_queue_stop(tts);
+            return ESP_FAIL;
+        }
+    }
+    return ret;
+}
+
+bool google_tts_check_event(google_tts_handle_t tts, audio_event_iface_msg_t *msg, google_tts_event_t *event)
+{
+    if (msg->source_type != GOOGLE_TTS_EVENT_SOURCE_TYPE || msg->source != (void *)tts) {
+        return false;
+    }
+    if (event) {
+        *event = (google_tts_event_t)msg->cmd;
+    }
+    return true;
+}
+
+esp_err_t google_tts_set_encoding(google_tts_handle_t tts, google_tts_encoding_t encoding)
+{
+    esp_err_t ret = _tts_prepare_decoder(tts, encoding);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (encoding == tts->encoding) {
+        return ESP_OK;
+    }
+    google_tts_stop(tts);
+    tts->encoding = encoding;
+    /* A decoder sets the clock from the stream info, LINEAR16 plays at the requested rate */
+    i2s_stream_set_clk(tts->i2s_writer, tts->sample_rate, 16, 1);
+    if (tts->jitter) {
+        jitter_buffer_set_format(tts->jitter, tts->sample_rate, 1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t google_tts_get_cache_stats(google_tts_handle_t tts, tts_cache_stats_t *stats)
+{
+    if (tts->cache == NULL) {
+        return ESP_FAIL;
+    }
+    tts_cache_get_stats(tts->cache, stats);
+    return ESP_OK;
+}
+
+esp_err_t google_tts_get_playback_stats(google_tts_handle_t tts, jitter_buffer_stats_t *stats)
+{
+    if (tts->jitter == NULL) {
+        return ESP_FAIL;
+    }
+    return jitter_buffer_get_stats(tts->jitter, stats);
+}
+
+esp_err_t google_tts_get_mem_stats(google_tts_handle_t tts, mem_arena_stats_t *stats)
+{
+    return mem_arena_get_stats(tts->mem, stats);
+}
+
+esp_err_t google_tts_set_playback_tap(google_tts_handle_t tts, google_tts_tap_cb_t cb, void *ctx)
+{
+    google_tts_stop(tts);
+    tts->tap_cb = cb;
+    tts->tap_ctx = ctx;
+    _tts_link_source(tts, tts->source_tag);
+    return ESP_OK;
+}
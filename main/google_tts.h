@@ -27,20 +27,63 @@
 
 #include "esp_err.h"
 #include "audio_event_iface.h"
+#include "audio_common.h"
+#include "tts_cache.h"
+#include "jitter_buffer.h"
+#include "mem_arena.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define DEFAULT_TTS_BUFFER_SIZE (2048)
+#define GOOGLE_TTS_TEXT_MAX             (1024)      /*!< Default longest text google_tts_start sends in one request */
+#define GOOGLE_TTS_LANG_MAX             (36)        /*!< Longest language code, with the terminator */
+#define GOOGLE_TTS_SEGMENT_MAX          (300)       /*!< Long-form: longest segment sent in one request */
+#define GOOGLE_TTS_QUEUE_BUFFER_SIZE    (64*1024)   /*!< Long-form: audio synthesized ahead of playback */
+
+/**
+ * Google Cloud Text-to-Speech audio encoding
+ */
+typedef enum {
+    TTS_ENCODING_MP3 = 0,   /*!< MP3, decoded in software */
+    TTS_ENCODING_LINEAR16,  /*!< PCM 16-bit mono, played without decoding, largest download */
+    TTS_ENCODING_OGG_OPUS,  /*!< Opus in an Ogg container, smallest download */
+} google_tts_encoding_t;
+
+/**
+ * Google Cloud Text-to-Speech long-form events sent to the listener, `msg.source_type` is
+ * GOOGLE_TTS_EVENT_SOURCE_TYPE, `msg.source` is the Text-to-Speech context, `msg.cmd` is one
+ * of these and `msg.data` the segment index
+ */
+typedef enum {
+    GOOGLE_TTS_EVENT_SEGMENT_DONE = 1,  /*!< Audio of a segment is fully downloaded and queued for playback */
+    GOOGLE_TTS_EVENT_SEGMENT_FAILED,    /*!< A segment could not be synthesized and is skipped */
+    GOOGLE_TTS_EVENT_QUEUE_DONE,        /*!< No segment left, playback finishes once the queued audio is played */
+} google_tts_event_t;
+
+#define GOOGLE_TTS_EVENT_SOURCE_TYPE (AUDIO_ELEMENT_TYPE_SERVICE)
 
 typedef struct google_tts* google_tts_handle_t;
 
+/**
+ * Receives the audio on its way to I2S, from the pipeline task
+ */
+typedef void (*google_tts_tap_cb_t)(const void *pcm, int len, void *ctx);
+
 typedef struct {
     const char *api_key;
     const char *lang_code;
     int playback_sample_rate;
     int buffer_size;
+    bool cache_enable;      /*!< Replay audio of text already synthesized from PSRAM or flash */
+    int cache_mem_size;     /*!< PSRAM used by the cache, 0 for TTS_CACHE_MEM_SIZE */
+    google_tts_encoding_t encoding; /*!< Audio encoding requested from the server */
+    int text_max;           /*!< Longest text google_tts_start sends in one request, reserved at init, 0 for GOOGLE_TTS_TEXT_MAX */
+    bool jitter_buffer_enable;  /*!< Prebuffer the audio by the measured download speed, and play silence
+                                     instead of glitching when the download stalls */
+    int jitter_min_ms;      /*!< Smallest prebuffer, 0 for JITTER_BUFFER_MIN_MS */
+    int jitter_max_ms;      /*!< Largest prebuffer, reserved at init, 0 for JITTER_BUFFER_MAX_MS */
 } google_tts_config_t;
 
 /**
@@ -55,16 +98,71 @@ google_tts_handle_t google_tts_init(google_tts_config_t *config);
 /**
  * @brief      Start sending text to Google Cloud Text-to-Speech and play audio received
  *
+ *             Text longer than `text_max` is spoken as by google_tts_enqueue, except with
+ *             TTS_ENCODING_OGG_OPUS.
+ *
  * @param[in]  tts        The Text-to-Speech context
  * @param[in]  text       The text
  * @param[in]  lang_code  The language code
  *
  * @return
  *  - ESP_OK
+ *  - ESP_ERR_INVALID_SIZE  The language code is too long, or the text is longer than `text_max` with TTS_ENCODING_OGG_OPUS
  *  - ESP_FAIL
  */
 esp_err_t google_tts_start(google_tts_handle_t tts, const char *text, const char *lang_code);
 
+/**
+ * @brief      Open the next request before the text is known
+ *
+ *             Waits for the previous playback to stop, connects and sends everything but the
+ *             text. The following google_tts_start with the same language only has to send
+ *             the text; other calls, or a cached text, drop the armed request.
+ *
+ * @param[in]  tts        The Text-to-Speech context
+ * @param[in]  lang_code  The language code
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_ERR_NO_MEM
+ */
+esp_err_t google_tts_arm(google_tts_handle_t tts, const char *lang_code);
+
+/**
+ * @brief      Speak long text, sentence by sentence, without blocking
+ *
+ *             The text is split at sentence ends, or at clauses and words for sentences
+ *             longer than GOOGLE_TTS_SEGMENT_MAX. Each segment is synthesized while the
+ *             previous one plays, and all of them feed one continuous stream to I2S, so
+ *             playback starts after the first sentence. Text enqueued before
+ *             GOOGLE_TTS_EVENT_QUEUE_DONE is appended to the stream, later text starts a new one. Not supported with TTS_ENCODING_OGG_OPUS.
+ *
+ * @param[in]  tts        The Text-to-Speech context
+ * @param[in]  text       The text
+ * @param[in]  lang_code  The language code
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_FAIL  The segment queue is full, the rest of the text is dropped
+ *  - ESP_ERR_INVALID_SIZE  The language code is too long, nothing is enqueued
+ *  - ESP_ERR_NO_MEM
+ *  - ESP_ERR_NOT_SUPPORTED
+ */
+esp_err_t google_tts_enqueue(google_tts_handle_t tts, const char *text, const char *lang_code);
+
+/**
+ * @brief      Check if the message is a long-form Text-to-Speech event
+ *
+ * @param[in]  tts    The Text-to-Speech context
+ * @param      msg    The message
+ * @param[out] event  The event, may be NULL
+ *
+ * @return
+ *  - true
+ *  - false
+ */
+bool google_tts_check_event(google_tts_handle_t tts, audio_event_iface_msg_t *msg, google_tts_event_t *event);
+
 /**
  * @brief      Stop playing audio from Google Cloud Text-to-Speech
  *
@@ -111,6 +209,77 @@ esp_err_t google_tts_destroy(google_tts_handle_t tts);
  */
 bool google_tts_check_event_finish(google_tts_handle_t tts, audio_event_iface_msg_t *msg);
 
+/**
+ * @brief      Change the audio encoding requested from the server
+ *
+ *             Stops the current playback if the encoding changes, the pipeline is relinked
+ *             with the matching decoder (or none for LINEAR16) by the next request.
+ *
+ * @param[in]  tts       The Text-to-Speech context
+ * @param[in]  encoding  The encoding
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_ERR_INVALID_ARG
+ *  - ESP_ERR_NO_MEM
+ */
+esp_err_t google_tts_set_encoding(google_tts_handle_t tts, google_tts_encoding_t encoding);
+
+/**
+ * @brief      Get the audio cache counters
+ *
+ * @param[in]  tts    The Text-to-Speech context
+ * @param[out] stats  The counters
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_FAIL  The cache is not enabled
+ */
+esp_err_t google_tts_get_cache_stats(google_tts_handle_t tts, tts_cache_stats_t *stats);
+
+/**
+ * @brief      Get the playback stats of the current or last answer: startup delay, underruns
+ *             and buffer depth
+ *
+ * @param[in]  tts    The Text-to-Speech context
+ * @param[out] stats  The stats
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_FAIL  The jitter buffer is not enabled
+ */
+esp_err_t google_tts_get_playback_stats(google_tts_handle_t tts, jitter_buffer_stats_t *stats);
+
+/**
+ * @brief      Get the usage of the memory arena holding the context buffers
+ *
+ *             See mem_arena_get_heap_stats for the heap figures.
+ *
+ * @param[in]  tts    The Text-to-Speech context
+ * @param[out] stats  The stats
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_ERR_INVALID_ARG
+ */
+esp_err_t google_tts_get_mem_stats(google_tts_handle_t tts, mem_arena_stats_t *stats);
+
+/**
+ * @brief      Show the played audio to a callback, e.g. as the echo canceller far end
+ *
+ *             The audio is tapped right before the I2S writer, with little buffering between.
+ *             Stops the current playback, the pipeline is relinked with the tap (or without
+ *             it, if `cb` is NULL).
+ *
+ * @param[in]  tts  The Text-to-Speech context
+ * @param[in]  cb   The callback, NULL to remove the tap
+ * @param[in]  ctx  The callback context
+ *
+ * @return
+ *  - ESP_OK
+ */
+esp_err_t google_tts_set_playback_tap(google_tts_handle_t tts, google_tts_tap_cb_t cb, void *ctx);
+
 #ifdef __cplusplus
 }
 #endif
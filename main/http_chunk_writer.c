@@ -0,0 +1,104 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "http_chunk_writer.h"
+
+static const char *TAG = "HTTP_CHUNK_WRITER";
+
+void http_chunk_writer_init(http_chunk_writer_t *writer, esp_http_client_handle_t http, char *buffer, int size,
+                            int flush_size, int flush_ms)
+{
+    memset(writer, 0, sizeof(http_chunk_writer_t));
+    writer->http = http;
+    writer->buffer = buffer;
+    writer->payload_max = size - HTTP_CHUNK_HEAD_ROOM - HTTP_CHUNK_TAIL_ROOM;
+    writer->flush_size = flush_size < writer->payload_max ? flush_size : writer->payload_max;
+    writer->flush_us = flush_ms * 1000;
+}
+
+esp_err_t http_chunk_writer_commit(http_chunk_writer_t *writer, int len)
+{
+    if (len <= 0) {
+        return ESP_OK;
+    }
+    if (writer->fill == 0) {
+        writer->since_us = esp_timer_get_time();
+    }
+    writer->fill += len;
+    if (writer->fill >= writer->flush_size) {
+        return http_chunk_writer_flush(writer, false);
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_chunk_writer_end(http_chunk_writer_t *writer, int len)
+{
+    writer->fill += len > 0 ? len : 0;
+    return http_chunk_writer_flush(writer, true);
+}
+
+esp_err_t http_chunk_writer_poll(http_chunk_writer_t *writer)
+{
+    if (writer->fill > 0 && writer->flush_us > 0 && esp_timer_get_time() - writer->since_us >= writer->flush_us) {
+        return http_chunk_writer_flush(writer, false);
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_chunk_writer_flush(http_chunk_writer_t *writer, bool last)
+{
+    if (writer->fill == 0 && !last) {
+        return ESP_OK;
+    }
+    /* An empty payload would read as the last chunk, only the end of the body is sent then */
+    char *frame = writer->buffer + HTTP_CHUNK_HEAD_ROOM;
+    int frame_len = 0;
+    if (writer->fill > 0) {
+        char head[HTTP_CHUNK_HEAD_ROOM + 1];
+        int head_len = snprintf(head, sizeof(head), "%x\r\n", writer->fill);
+        frame -= head_len;
+        memcpy(frame, head, head_len);
+        frame_len = head_len + writer->fill;
+        memcpy(frame + frame_len, "\r\n", 2);
+        frame_len += 2;
+    }
+    if (last) {
+        memcpy(frame + frame_len, "0\r\n\r\n", 5);
+        frame_len += 5;
+    }
+    if (esp_http_client_write(writer->http, frame, frame_len) != frame_len) {
+        ESP_LOGE(TAG, "Error write chunked content");
+        return ESP_FAIL;
+    }
+    writer->writes++;
+    writer->wire_bytes += frame_len;
+    writer->payload_bytes += writer->fill;
+    writer->fill = 0;
+    return ESP_OK;
+}
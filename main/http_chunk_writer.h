@@ -0,0 +1,142 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _HTTP_CHUNK_WRITER_H_
+#define _HTTP_CHUNK_WRITER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Chunk size line in front of the payload (up to 6 hex digits, keeps the payload word aligned),
+ * and the chunk end with the last chunk marker behind it */
+#define HTTP_CHUNK_HEAD_ROOM        (8)
+#define HTTP_CHUNK_TAIL_ROOM        (7)
+
+/**
+ * Room a buffer needs for `payload` bytes of chunk payload
+ */
+#define HTTP_CHUNK_BUFFER_SIZE(payload)     ((payload) + HTTP_CHUNK_HEAD_ROOM + HTTP_CHUNK_TAIL_ROOM)
+
+/**
+ * Chunked transfer encoding writer. The payload is gathered in place in the caller's buffer,
+ * behind room for the chunk size line, so a chunk is framed without copying and sent with a
+ * single esp_http_client_write: one TLS record and TCP segment instead of three. Small pieces
+ * are batched into one chunk up to a flush size or a deadline.
+ */
+typedef struct {
+    esp_http_client_handle_t http;
+    char        *buffer;
+    int         payload_max;
+    int         flush_size;     /* Gathered payload that is sent at once */
+    int         flush_us;       /* Longest time payload waits for more, checked by http_chunk_writer_poll */
+    int         fill;
+    int64_t     since_us;       /* When the first byte of the gathered payload came */
+    uint32_t    writes;         /* Writes issued */
+    uint32_t    wire_bytes;     /* Bytes written, framing included */
+    uint32_t    payload_bytes;  /* Payload bytes written */
+} http_chunk_writer_t;
+
+/**
+ * @brief      Reset the writer for a new request body
+ *
+ * @param      writer       The writer
+ * @param      http         The HTTP client, opened for a chunked request
+ * @param      buffer       The chunk buffer, 4-byte aligned so that the payload is
+ * @param[in]  size         The buffer size, more than HTTP_CHUNK_BUFFER_SIZE(0)
+ * @param[in]  flush_size   Payload gathered before a chunk is sent, at most the payload room, 0 to
+ *                          send every commit
+ * @param[in]  flush_ms     Longest time gathered payload waits, 0 for no deadline
+ */
+void http_chunk_writer_init(http_chunk_writer_t *writer, esp_http_client_handle_t http, char *buffer, int size,
+                            int flush_size, int flush_ms);
+
+/**
+ * @brief      Where the next payload bytes go
+ */
+static inline char *http_chunk_writer_tail(http_chunk_writer_t *writer)
+{
+    return writer->buffer + HTTP_CHUNK_HEAD_ROOM + writer->fill;
+}
+
+/**
+ * @brief      Payload bytes that still fit in the chunk
+ */
+static inline int http_chunk_writer_room(http_chunk_writer_t *writer)
+{
+    return writer->payload_max - writer->fill;
+}
+
+/**
+ * @brief      Add `len` bytes written at http_chunk_writer_tail to the chunk, and send the chunk
+ *             once it reaches the flush size
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL  The write failed
+ */
+esp_err_t http_chunk_writer_commit(http_chunk_writer_t *writer, int len);
+
+/**
+ * @brief      Add the last `len` payload bytes written at http_chunk_writer_tail and end the body,
+ *             all in one write
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL  The write failed
+ */
+esp_err_t http_chunk_writer_end(http_chunk_writer_t *writer, int len);
+
+/**
+ * @brief      Send the chunk if its payload has waited for the flush deadline
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL  The write failed
+ */
+esp_err_t http_chunk_writer_poll(http_chunk_writer_t *writer);
+
+/**
+ * @brief      Send the gathered payload, if any, as one chunk
+ *
+ * @param      writer  The writer
+ * @param[in]  last    Also end the body, in the same write
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL  The write failed
+ */
+esp_err_t http_chunk_writer_flush(http_chunk_writer_t *writer, bool last);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,362 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_element.h"
+#include "audio_common.h"
+#include "audio_mem.h"
+#include "ringbuf.h"
+#include "jitter_buffer.h"
+
+static const char *TAG = "JITTER_BUFFER";
+
+#define JB_FRAME_MAX_SAMPLES    (48000 * 2 * JITTER_BUFFER_FRAME_MS / 1000)
+#define JB_READ_SIZE            (1024)
+/* A few frames between the buffer and the output, the buffer itself holds the jitter */
+#define JB_OUT_RB_SIZE          (2*1024)
+/* The download speed is measured once this much time has passed since the first input */
+#define JB_RATE_MIN_MS          (200)
+/* The stall estimate loses 1 ms every this many ms, so that it carries over to the next streams */
+#define JB_STALL_DECAY          (64)
+
+typedef enum {
+    JB_IDLE = 0,        /* Nothing received yet */
+    JB_PREBUFFER,
+    JB_PLAYING,
+    JB_REBUFFER,        /* Ran dry, silence until the target is buffered again */
+} jb_state_t;
+
+typedef struct jitter_buffer {
+    ringbuf_handle_t    store;
+    int                 store_size;
+    int                 sample_rate;
+    int                 channels;
+    int                 bytes_per_sec;
+    int                 frame_bytes;
+    int                 fade_frames;
+    int                 min_ms;
+    int                 max_ms;
+    jb_state_t          state;
+    bool                eos;
+    bool                throttled;      /* Input was held back by a full buffer, it is faster than shown */
+    int64_t             first_ms;       /* First input of the stream */
+    int64_t             last_ms;        /* Last input */
+    int64_t             received;       /* Input after the first, which came at the start of the measurement */
+    int                 wait_ms;        /* Waited for input since the last input */
+    int                 stall;          /* Longest wait in 1/JB_STALL_DECAY ms, losing one unit every ms */
+    int                 rate_permille;
+    int                 fade_in;        /* Sample frames left of the ramp out of silence */
+    int                 fade_out;       /* Sample frames left of the ramp into silence */
+    int16_t             last[2];        /* Last sample played of each channel */
+    int16_t             frame[JB_FRAME_MAX_SAMPLES];
+    jitter_buffer_stats_t stats;
+} jitter_buffer_t;
+
+static int64_t _jb_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static int _jb_ms(jitter_buffer_t *jb, int64_t bytes)
+{
+    return (int)(bytes * 1000 / jb->bytes_per_sec);
+}
+
+static void _jb_set_format(jitter_buffer_t *jb, int sample_rate, int channels)
+{
+    jb->sample_rate = sample_rate;
+    jb->channels = channels;
+    jb->bytes_per_sec = sample_rate * channels * 2;
+    jb->frame_bytes = sample_rate * JITTER_BUFFER_FRAME_MS / 1000 * channels * 2;
+    jb->fade_frames = sample_rate * JITTER_BUFFER_FADE_MS / 1000;
+}
+
+static int _jb_target_ms(jitter_buffer_t *jb)
+{
+    int target = jb->min_ms + jb->stall / JB_STALL_DECAY;
+    if (jb->rate_permille < 1000) {
+        /* Enough that a slow download does not run dry within the horizon */
+        target += JITTER_BUFFER_HORIZON_MS * (1000 - jb->rate_permille) / 1000;
+    }
+    int max = _jb_ms(jb, jb->store_size) - JITTER_BUFFER_FRAME_MS;
+    max = max < jb->max_ms ? max : jb->max_ms;
+    return target < max ? target : max;
+}
+
+static void _jb_push(jitter_buffer_t *jb, const char *buf, int len, int64_t now, int waited)
+{
+    if (jb->state == JB_IDLE) {
+        /* The wait for the first input is the server, not the network */
+        jb->state = JB_PREBUFFER;
+        jb->first_ms = now;
+        jb->received = -len;
+    } else {
+        /* Only time spent waiting for input counts, not time the output blocked */
+        int stall = (jb->wait_ms + waited) * JB_STALL_DECAY;
+        int decayed = jb->stall - (int)(now - jb->last_ms);
+        jb->stall = stall > decayed ? stall : decayed;
+    }
+    jb->wait_ms = 0;
+    jb->last_ms = now;
+    jb->received += len;
+    int elapsed = (int)(now - jb->first_ms);
+    if (elapsed >= JB_RATE_MIN_MS && !jb->throttled) {
+        jb->rate_permille = _jb_ms(jb, jb->received) * 1000 / elapsed;
+    }
+    rb_write(jb->store, (char *)buf, len, 0);
+    int depth_ms = _jb_ms(jb, rb_bytes_filled(jb->store));
+    if (depth_ms > jb->stats.max_depth_ms) {
+        jb->stats.max_depth_ms = depth_ms;
+    }
+}
+
+/* Silence, ramping down from the last samples played first */
+static void _jb_silence(jitter_buffer_t *jb, int16_t *out, int frames)
+{
+    for (int f = 0; f < frames; f++) {
+        for (int c = 0; c < jb->channels; c++) {
+            out[f * jb->channels + c] = jb->fade_out > 0 ? jb->last[c] * jb->fade_out / jb->fade_frames : 0;
+        }
+        if (jb->fade_out > 0) {
+            jb->fade_out--;
+        }
+    }
+}
+
+static void _jb_played(jitter_buffer_t *jb, int16_t *pcm, int frames)
+{
+    for (int f = 0; f < frames && jb->fade_in > 0; f++, jb->fade_in--) {
+        for (int c = 0; c < jb->channels; c++) {
+            pcm[f * jb->channels + c] = pcm[f * jb->channels + c] * (jb->fade_frames - jb->fade_in) / jb->fade_frames;
+        }
+    }
+    if (frames > 0) {
+        memcpy(jb->last, &pcm[(frames - 1) * jb->channels], jb->channels * sizeof(int16_t));
+    }
+}
+
+/* The next frame to output into `jb->frame`, 0 for none yet. `starved` allows a frame of silence */
+static int _jb_pull(jitter_buffer_t *jb, int64_t now, bool starved)
+{
+    int sample_bytes = 2 * jb->channels;
+    int depth = rb_bytes_filled(jb->store);
+    int avail = depth - depth % sample_bytes;
+    if (jb->state == JB_PREBUFFER || jb->state == JB_REBUFFER) {
+        int target = _jb_target_ms(jb);
+        if (_jb_ms(jb, depth) >= target || (jb->eos && avail > 0)) {
+            if (jb->state == JB_PREBUFFER) {
+                jb->stats.startup_ms = (int)(now - jb->first_ms);
+            } else {
+                jb->fade_in = jb->fade_frames;
+            }
+            jb->stats.target_ms = target;
+            jb->state = JB_PLAYING;
+        } else if (jb->state == JB_REBUFFER && starved) {
+            _jb_silence(jb, jb->frame, jb->frame_bytes / sample_bytes);
+            jb->stats.underrun_ms += JITTER_BUFFER_FRAME_MS;
+            return jb->frame_bytes;
+        } else {
+            return 0;
+        }
+    }
+    if (jb->state != JB_PLAYING) {
+        return 0;
+    }
+    if (avail >= jb->frame_bytes || (jb->eos && avail > 0)) {
+        int len = avail < jb->frame_bytes ? avail : jb->frame_bytes;
+        rb_read(jb->store, (char *)jb->frame, len, 0);
+        _jb_played(jb, jb->frame, len / sample_bytes);
+        int depth_ms = _jb_ms(jb, depth - len);
+        if (jb->stats.min_depth_ms < 0 || depth_ms < jb->stats.min_depth_ms) {
+            jb->stats.min_depth_ms = depth_ms;
+        }
+        return len;
+    }
+    if (jb->eos || !starved) {
+        return 0;
+    }
+    /* Ran dry: what is left, then down into silence instead of a click */
+    if (avail > 0) {
+        rb_read(jb->store, (char *)jb->frame, avail, 0);
+        _jb_played(jb, jb->frame, avail / sample_bytes);
+    }
+    jb->fade_in = 0;
+    jb->fade_out = jb->fade_frames;
+    _jb_silence(jb, jb->frame + avail / 2, (jb->frame_bytes - avail) / sample_bytes);
+    jb->stats.underruns++;
+    jb->stats.underrun_ms += _jb_ms(jb, jb->frame_bytes - avail);
+    jb->stats.min_depth_ms = 0;
+    jb->state = JB_REBUFFER;
+    ESP_LOGD(TAG, "Underrun, rebuffering %d ms", _jb_target_ms(jb));
+    return jb->frame_bytes;
+}
+
+static esp_err_t _jb_open(audio_element_handle_t self)
+{
+    jitter_buffer_t *jb = (jitter_buffer_t *)audio_element_getdata(self);
+    rb_reset(jb->store);
+    jb->state = JB_IDLE;
+    jb->eos = false;
+    jb->throttled = false;
+    jb->received = 0;
+    jb->wait_ms = 0;
+    jb->fade_in = 0;
+    jb->fade_out = 0;
+    memset(jb->last, 0, sizeof(jb->last));
+    memset(&jb->stats, 0, sizeof(jb->stats));
+    jb->stats.min_depth_ms = -1;
+    jb->stats.startup_ms = -1;
+    /* Waiting longer for input than a frame would let the output run dry unnoticed */
+    audio_element_set_input_timeout(self, pdMS_TO_TICKS(JITTER_BUFFER_FRAME_MS));
+    return ESP_OK;
+}
+
+static audio_element_err_t _jb_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    jitter_buffer_t *jb = (jitter_buffer_t *)audio_element_getdata(self);
+    bool starved = false;
+    int room = rb_bytes_available(jb->store);
+    int64_t now = _jb_now_ms();
+    if (!jb->eos && room < in_len) {
+        /* Input is held back by the full buffer, the output below blocks until a frame is played */
+        jb->throttled = true;
+    }
+    if (!jb->eos && room > 0) {
+        int r_size = audio_element_input(self, in_buffer, in_len < room ? in_len : room);
+        int64_t start = now;
+        now = _jb_now_ms();
+        if (r_size > 0) {
+            _jb_push(jb, in_buffer, r_size, now, (int)(now - start));
+        } else if (r_size == AEL_IO_TIMEOUT) {
+            jb->wait_ms += (int)(now - start);
+            starved = true;
+        } else if (r_size == AEL_IO_DONE || r_size == AEL_IO_OK) {
+            jb->eos = true;
+        } else {
+            return r_size;
+        }
+    }
+
+    /* Silence is due once the output has less left to play than the next wait for input */
+    ringbuf_handle_t out_rb = audio_element_get_output_ringbuf(self);
+    if (out_rb) {
+        starved = rb_bytes_filled(out_rb) < 2 * jb->frame_bytes;
+    }
+    int len;
+    while ((len = _jb_pull(jb, now, starved)) > 0) {
+        int w_size = audio_element_output(self, (char *)jb->frame, len);
+        if (w_size < 0) {
+            return w_size;
+        }
+        starved = out_rb && rb_bytes_filled(out_rb) < 2 * jb->frame_bytes;
+        /* Rather take more input than block on a full output */
+        if (!jb->eos && out_rb && rb_bytes_available(out_rb) < jb->frame_bytes && rb_bytes_available(jb->store) > 0) {
+            break;
+        }
+    }
+    if (jb->eos && rb_bytes_filled(jb->store) < 2 * jb->channels) {
+        return AEL_IO_DONE;
+    }
+    return in_len;
+}
+
+static esp_err_t _jb_destroy(audio_element_handle_t self)
+{
+    jitter_buffer_t *jb = (jitter_buffer_t *)audio_element_getdata(self);
+    if (jb->store) {
+        rb_destroy(jb->store);
+    }
+    audio_free(jb);
+    return ESP_OK;
+}
+
+esp_err_t jitter_buffer_set_format(audio_element_handle_t self, int sample_rate, int channels)
+{
+    jitter_buffer_t *jb = self ? (jitter_buffer_t *)audio_element_getdata(self) : NULL;
+    if (jb == NULL || sample_rate <= 0 || sample_rate > 48000 || channels < 1 || channels > 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _jb_set_format(jb, sample_rate, channels);
+    return ESP_OK;
+}
+
+esp_err_t jitter_buffer_get_stats(audio_element_handle_t self, jitter_buffer_stats_t *stats)
+{
+    jitter_buffer_t *jb = self ? (jitter_buffer_t *)audio_element_getdata(self) : NULL;
+    if (jb == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *stats = jb->stats;
+    stats->depth_ms = _jb_ms(jb, rb_bytes_filled(jb->store));
+    stats->rate_permille = jb->rate_permille;
+    stats->stall_ms = jb->stall / JB_STALL_DECAY;
+    return ESP_OK;
+}
+
+audio_element_handle_t jitter_buffer_init(jitter_buffer_cfg_t *config)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    audio_element_handle_t el;
+    jitter_buffer_t *jb = audio_calloc(1, sizeof(jitter_buffer_t));
+    AUDIO_MEM_CHECK(TAG, jb, return NULL);
+    if (config->sample_rate <= 0 || config->sample_rate > 48000 || config->channels > 2) {
+        ESP_LOGE(TAG, "Unsupported format %d Hz, %d channels", config->sample_rate, config->channels);
+        audio_free(jb);
+        return NULL;
+    }
+    _jb_set_format(jb, config->sample_rate, config->channels > 0 ? config->channels : 1);
+    jb->min_ms = config->min_ms > 0 ? config->min_ms : JITTER_BUFFER_MIN_MS;
+    jb->max_ms = config->max_ms > 0 ? config->max_ms : JITTER_BUFFER_MAX_MS;
+    jb->max_ms = jb->max_ms > jb->min_ms ? jb->max_ms : jb->min_ms;
+    /* Unknown until measured, no allowance for a slow download */
+    jb->rate_permille = 1000;
+    jb->store_size = jb->bytes_per_sec / 1000 * (jb->max_ms + JITTER_BUFFER_FRAME_MS);
+    jb->store = rb_create(jb->store_size, 1);
+    AUDIO_MEM_CHECK(TAG, jb->store, goto _jb_init_exit);
+
+    cfg.open = _jb_open;
+    cfg.process = _jb_process;
+    cfg.destroy = _jb_destroy;
+    cfg.buffer_len = JB_READ_SIZE;
+    cfg.out_rb_size = JB_OUT_RB_SIZE;
+    cfg.task_stack = config->task_stack > 0 ? config->task_stack : JITTER_BUFFER_TASK_STACK;
+    if (config->task_prio > 0) {
+        cfg.task_prio = config->task_prio;
+    }
+    cfg.tag = "jitter";
+    el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, goto _jb_init_exit);
+    audio_element_setdata(el, jb);
+    ESP_LOGD(TAG, "%d bytes, prebuffer %d to %d ms", jb->store_size, jb->min_ms, jb->max_ms);
+    return el;
+_jb_init_exit:
+    if (jb->store) {
+        rb_destroy(jb->store);
+    }
+    audio_free(jb);
+    return NULL;
+}
@@ -0,0 +1,118 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _JITTER_BUFFER_H_
+#define _JITTER_BUFFER_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JITTER_BUFFER_MIN_MS            (60)    /*!< Smallest prebuffer, for a fast and steady download */
+#define JITTER_BUFFER_MAX_MS            (1000)  /*!< Largest prebuffer, also the buffer size */
+#define JITTER_BUFFER_HORIZON_MS        (2000)  /*!< Playback a download slower than real time must sustain */
+#define JITTER_BUFFER_FRAME_MS          (10)    /*!< Output frame, and the longest wait for input */
+#define JITTER_BUFFER_FADE_MS           (4)     /*!< Ramp into and out of underrun silence */
+#define JITTER_BUFFER_TASK_STACK        (3*1024)
+
+/**
+ * Jitter buffer configurations, the audio is 16-bit PCM
+ */
+typedef struct {
+    int     sample_rate;        /*!< Sample rate, see jitter_buffer_set_format */
+    int     channels;           /*!< Channels, 0 for mono */
+    int     min_ms;             /*!< Smallest prebuffer, 0 for JITTER_BUFFER_MIN_MS */
+    int     max_ms;             /*!< Largest prebuffer and buffer size, 0 for JITTER_BUFFER_MAX_MS */
+    int     task_stack;         /*!< Element task stack size, 0 for default */
+    int     task_prio;          /*!< Element task priority, 0 for default */
+} jitter_buffer_cfg_t;
+
+/**
+ * Playback of the current (or last) stream, reset when the element is run again. The download
+ * speed and stall estimates carry over, they set the prebuffer of the next stream.
+ */
+typedef struct {
+    int         target_ms;      /*!< Prebuffer playback started with, or last restarted with after an underrun */
+    int         depth_ms;       /*!< Audio buffered now */
+    int         min_depth_ms;   /*!< Lowest depth while playing, -1 before playback */
+    int         max_depth_ms;   /*!< Highest depth */
+    int         startup_ms;     /*!< From the first audio received to the start of playback, -1 before */
+    uint32_t    underruns;      /*!< Times playback ran dry, each played as silence until the target is refilled */
+    uint32_t    underrun_ms;    /*!< Silence played for underruns */
+    int         rate_permille;  /*!< Download speed in ‰ of the playback speed */
+    int         stall_ms;       /*!< Expected longest wait for input, a decaying peak */
+} jitter_buffer_stats_t;
+
+/**
+ * @brief      Create an audio element smoothing a bursty stream into steady playback
+ *
+ *             Nothing is output until the buffer holds a target amount of audio: the smallest
+ *             prebuffer, plus the longest recent stall of the input, plus what a download slower
+ *             than real time would lose over JITTER_BUFFER_HORIZON_MS. When it runs dry anyway,
+ *             the audio fades out into silence, which is played until the target is buffered
+ *             again and then faded in. Place it right before the output, its own output buffer
+ *             is only a few frames.
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle
+ */
+audio_element_handle_t jitter_buffer_init(jitter_buffer_cfg_t *config);
+
+/**
+ * @brief      Set the format of the audio, e.g. as reported by the decoder
+ *
+ *             Call before the audio of the stream arrives.
+ *
+ * @param      self         The jitter buffer element
+ * @param[in]  sample_rate  The sample rate
+ * @param[in]  channels     The channels
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t jitter_buffer_set_format(audio_element_handle_t self, int sample_rate, int channels);
+
+/**
+ * @brief      Get the playback state of the stream
+ *
+ * @param      self   The jitter buffer element
+ * @param[out] stats  The stats
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t jitter_buffer_get_stats(audio_element_handle_t self, jitter_buffer_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "json_b64_scanner.h"
+
+typedef enum {
+    SCAN_OUTSIDE = 0,   /* Between tokens */
+    SCAN_STRING,        /* Inside a string that may be the key */
+    SCAN_AFTER_KEY,     /* The key matched, expecting ':' */
+    SCAN_BEFORE_VALUE,  /* Expecting the opening quote of the value */
+    SCAN_VALUE,         /* Decoding the value */
+    SCAN_DONE,
+} scan_state_t;
+
+static inline bool _is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline int _b64_value(char c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    if (c == '+' || c == '-') {
+        return 62;
+    }
+    if (c == '/' || c == '_') {
+        return 63;
+    }
+    return -1;
+}
+
+void json_b64_scanner_init(json_b64_scanner_t *scanner, const char *key)
+{
+    memset(scanner, 0, sizeof(json_b64_scanner_t));
+    scanner->key_len = strnlen(key, JSON_B64_SCANNER_KEY_MAX - 1);
+    memcpy(scanner->key, key, scanner->key_len);
+    scanner->state = SCAN_OUTSIDE;
+}
+
+bool json_b64_scanner_done(json_b64_scanner_t *scanner)
+{
+    return scanner->state == SCAN_DONE;
+}
+
+int json_b64_scanner_feed(json_b64_scanner_t *scanner, const char *in, int in_len, uint8_t *out, int out_size)
+{
+    uint8_t *o = out;
+    const char *end = in + in_len;
+
+    while (in < end) {
+        char c = *in;
+        switch (scanner->state) {
+            case SCAN_OUTSIDE:
+                if (c == '"') {
+                    scanner->state = SCAN_STRING;
+                    scanner->match = 0;
+                    scanner->escaped = false;
+                }
+                break;
+            case SCAN_STRING:
+                if (scanner->escaped) {
+                    scanner->escaped = false;
+                    scanner->match = -1;
+                } else if (c == '\\') {
+                    scanner->escaped = true;
+                } else if (c == '"') {
+                    scanner->state = scanner->match == scanner->key_len ? SCAN_AFTER_KEY : SCAN_OUTSIDE;
+                } else if (scanner->match >= 0 && scanner->match < scanner->key_len && c == scanner->key[scanner->match]) {
+                    scanner->match++;
+                } else {
+                    scanner->match = -1;
+                }
+                break;
+            case SCAN_AFTER_KEY:
+                if (c == ':') {
+                    scanner->state = SCAN_BEFORE_VALUE;
+                } else if (!_is_space(c)) {
+                    /* It was a string value that looks like the key, rescan this character */
+                    scanner->state = SCAN_OUTSIDE;
+                    continue;
+                }
+                break;
+            case SCAN_BEFORE_VALUE:
+                if (c == '"') {
+                    scanner->state = SCAN_VALUE;
+                    scanner->escaped = false;
+                    scanner->quad = 0;
+                    scanner->quad_len = 0;
+                    scanner->pad = 0;
+                } else if (!_is_space(c)) {
+                    scanner->state = SCAN_OUTSIDE;
+                    continue;
+                }
+                break;
+            case SCAN_VALUE: {
+                int v;
+                if (c == '\\' && !scanner->escaped) {
+                    scanner->escaped = true;
+                    break;
+                }
+                if (c == '"' && !scanner->escaped) {
+                    if (scanner->quad_len != 0) {
+                        /* Unpadded tail */
+                        int bytes = scanner->quad_len - 1;
+                        scanner->quad <<= 6 * (4 - scanner->quad_len);
+                        for (int i = 0; i < bytes && o < out + out_size; i++) {
+                            *o++ = (uint8_t)(scanner->quad >> (16 - 8 * i));
+                        }
+                    }
+                    scanner->state = SCAN_DONE;
+                    break;
+                }
+                if (scanner->escaped) {
+                    scanner->escaped = false;
+                    if (c != '/') {
+                        return -1;
+                    }
+                }
+                if (c == '=') {
+                    scanner->pad++;
+                    v = 0;
+                } else if ((v = _b64_value(c)) < 0 || scanner->pad) {
+                    return -1;
+                }
+                scanner->quad = (scanner->quad << 6) | v;
+                if (++scanner->quad_len == 4) {
+                    int bytes = 3 - scanner->pad;
+                    if (o + bytes > out + out_size) {
+                        return -1;
+                    }
+                    if (bytes > 0) {
+                        *o++ = (uint8_t)(scanner->quad >> 16);
+                    }
+                    if (bytes > 1) {
+                        *o++ = (uint8_t)(scanner->quad >> 8);
+                    }
+                    if (bytes > 2) {
+                        *o++ = (uint8_t)scanner->quad;
+                    }
+                    scanner->quad = 0;
+                    scanner->quad_len = 0;
+                }
+                break;
+            }
+            case SCAN_DONE:
+                in = end;
+                continue;
+        }
+        in++;
+    }
+    scanner->total += o - out;
+    return o - out;
+}
@@ -0,0 +1,93 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _JSON_B64_SCANNER_H_
+#define _JSON_B64_SCANNER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_B64_SCANNER_KEY_MAX    (32)
+
+/**
+ * Largest input that json_b64_scanner_feed() can take for `out_size` bytes of output
+ */
+#define JSON_B64_SCANNER_MAX_IN(out_size)   (((out_size) / 3) * 4 - 4)
+
+/**
+ * Resumable scanner that finds a string member of a JSON document by key and base64-decodes
+ * its value, whatever the chunk boundaries are. Other members, nesting and member order are
+ * skipped over.
+ */
+typedef struct {
+    char        key[JSON_B64_SCANNER_KEY_MAX];
+    int         key_len;
+    int         state;
+    int         match;      /* Characters of the current string that matched the key */
+    bool        escaped;
+    uint32_t    quad;       /* Pending base64 sextets */
+    int         quad_len;
+    int         pad;
+    int         total;      /* Decoded bytes so far */
+} json_b64_scanner_t;
+
+/**
+ * @brief      Reset the scanner to look for `key`
+ *
+ * @param      scanner  The scanner
+ * @param[in]  key      The member name, e.g. "audioContent"
+ */
+void json_b64_scanner_init(json_b64_scanner_t *scanner, const char *key);
+
+/**
+ * @brief      Scan the next part of the document
+ *
+ * @param      scanner   The scanner
+ * @param[in]  in        The input
+ * @param[in]  in_len    The input length, at most JSON_B64_SCANNER_MAX_IN(out_size)
+ * @param      out       The decoded output
+ * @param[in]  out_size  The output size
+ *
+ * @return     Number of decoded bytes written to `out`, -1 on malformed base64
+ */
+int json_b64_scanner_feed(json_b64_scanner_t *scanner, const char *in, int in_len, uint8_t *out, int out_size);
+
+/**
+ * @brief      Check whether the whole value has been decoded
+ *
+ * @param      scanner  The scanner
+ *
+ * @return     true once the closing quote of the value was seen
+ */
+bool json_b64_scanner_done(json_b64_scanner_t *scanner);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include "json_escape.h"
+
+/* Length of the valid UTF-8 sequence at `p`, 0 if it is not one */
+static int _utf8_len(const uint8_t *p, int avail)
+{
+    int len;
+    uint8_t lo = 0x80, hi = 0xBF;
+    if (p[0] < 0x80) {
+        return 1;
+    } else if (p[0] >= 0xC2 && p[0] <= 0xDF) {
+        len = 2;
+    } else if (p[0] >= 0xE0 && p[0] <= 0xEF) {
+        len = 3;
+        /* No overlong forms, no surrogates */
+        if (p[0] == 0xE0) {
+            lo = 0xA0;
+        } else if (p[0] == 0xED) {
+            hi = 0x9F;
+        }
+    } else if (p[0] >= 0xF0 && p[0] <= 0xF4) {
+        len = 4;
+        /* No overlong forms, nothing above U+10FFFF */
+        if (p[0] == 0xF0) {
+            lo = 0x90;
+        } else if (p[0] == 0xF4) {
+            hi = 0x8F;
+        }
+    } else {
+        return 0;
+    }
+    if (len > avail || p[1] < lo || p[1] > hi) {
+        return 0;
+    }
+    for (int i = 2; i < len; i++) {
+        if (p[i] < 0x80 || p[i] > 0xBF) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+int json_escape(const char *in, int in_len, char *out, int out_size, int *out_len)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    const uint8_t *p = (const uint8_t *)in;
+    int i = 0, o = 0;
+    while (i < in_len) {
+        char esc[JSON_ESCAPE_MAX_OUT_CHAR];
+        const char *src = esc;
+        int n, consumed = 1;
+        uint8_t c = p[i];
+        if (c == '"' || c == '\\') {
+            esc[0] = '\\';
+            esc[1] = c;
+            n = 2;
+        } else if (c < 0x20) {
+            esc[0] = '\\';
+            n = 2;
+            switch (c) {
+                case '\n': esc[1] = 'n'; break;
+                case '\r': esc[1] = 'r'; break;
+                case '\t': esc[1] = 't'; break;
+                case '\b': esc[1] = 'b'; break;
+                case '\f': esc[1] = 'f'; break;
+                default:
+                    memcpy(esc + 1, "u00", 3);
+                    esc[4] = hex[c >> 4];
+                    esc[5] = hex[c & 0xF];
+                    n = 6;
+                    break;
+            }
+        } else {
+            n = _utf8_len(p + i, in_len - i);
+            if (n == 0) {
+                src = "\\uFFFD";
+                n = 6;
+            } else {
+                src = in + i;
+                consumed = n;
+            }
+        }
+        if (o + n > out_size) {
+            break;
+        }
+        memcpy(out + o, src, n);
+        o += n;
+        i += consumed;
+    }
+    *out_len = o;
+    return i;
+}
@@ -0,0 +1,60 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _JSON_ESCAPE_H_
+#define _JSON_ESCAPE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Longest output of a single input character, a "\u00XX" or "\uFFFD" escape
+ */
+#define JSON_ESCAPE_MAX_OUT_CHAR    (6)
+
+/**
+ * @brief      Escape text as the contents of a JSON string, as much of it as fits
+ *
+ *             Quotes, backslashes and control characters are escaped. Valid UTF-8 is copied
+ *             as is, every byte of an invalid or truncated sequence becomes "\uFFFD", so the
+ *             output is always a valid JSON string body. Characters and escapes are never
+ *             split, call again with the rest of the input once `out` has been flushed.
+ *
+ * @param[in]  in        The input
+ * @param[in]  in_len    The input length
+ * @param[out] out       The output
+ * @param[in]  out_size  The output size, at least JSON_ESCAPE_MAX_OUT_CHAR
+ * @param[out] out_len   Bytes written to `out`
+ *
+ * @return     Bytes of `in` consumed, less than `in_len` when `out` is full
+ */
+int json_escape(const char *in, int in_len, char *out, int out_size, int *out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "audio_error.h"
+#include "audio_mem.h"
+#include "mem_arena.h"
+
+static const char *TAG = "MEM_ARENA";
+
+typedef struct mem_arena {
+    char    *base;
+    size_t  size;
+    size_t  used;
+    bool    spiram;
+} mem_arena_t;
+
+mem_arena_handle_t mem_arena_create(size_t size, mem_arena_placement_t placement)
+{
+    mem_arena_t *arena = audio_calloc(1, sizeof(mem_arena_t));
+    AUDIO_MEM_CHECK(TAG, arena, return NULL);
+    size = MEM_ARENA_SIZE(size);
+    if (placement == MEM_ARENA_PREFER_SPIRAM) {
+        arena->base = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        arena->spiram = arena->base != NULL;
+    }
+    if (arena->base == NULL) {
+        uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        if (placement == MEM_ARENA_DMA) {
+            caps |= MALLOC_CAP_DMA;
+        }
+        arena->base = heap_caps_malloc(size, caps);
+    }
+    if (arena->base == NULL) {
+        ESP_LOGE(TAG, "No room for a %d bytes arena", (int)size);
+        audio_free(arena);
+        return NULL;
+    }
+    memset(arena->base, 0, size);
+    arena->size = size;
+    ESP_LOGD(TAG, "%d bytes in %s", (int)size, arena->spiram ? "PSRAM" : "internal RAM");
+    return arena;
+}
+
+void *mem_arena_alloc(mem_arena_handle_t arena, size_t size)
+{
+    size = MEM_ARENA_SIZE(size);
+    if (arena == NULL || size > arena->size - arena->used) {
+        ESP_LOGE(TAG, "Arena exhausted, %d bytes asked, %d left", (int)size, arena ? (int)(arena->size - arena->used) : 0);
+        return NULL;
+    }
+    void *p = arena->base + arena->used;
+    arena->used += size;
+    return p;
+}
+
+char *mem_arena_strdup(mem_arena_handle_t arena, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *copy = mem_arena_alloc(arena, len);
+    if (copy) {
+        memcpy(copy, str, len);
+    }
+    return copy;
+}
+
+esp_err_t mem_arena_get_stats(mem_arena_handle_t arena, mem_arena_stats_t *stats)
+{
+    if (arena == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    stats->size = arena->size;
+    stats->used = arena->used;
+    stats->spiram = arena->spiram;
+    return ESP_OK;
+}
+
+void mem_arena_destroy(mem_arena_handle_t arena)
+{
+    if (arena == NULL) {
+        return;
+    }
+    heap_caps_free(arena->base);
+    audio_free(arena);
+}
+
+static void _region_stats(uint32_t caps, mem_heap_region_stats_t *stats)
+{
+    stats->free = heap_caps_get_free_size(caps);
+    stats->min_free = heap_caps_get_minimum_free_size(caps);
+    stats->largest_block = heap_caps_get_largest_free_block(caps);
+    stats->fragmentation = stats->free ? 100 - (int)(stats->largest_block * 100 / stats->free) : 0;
+}
+
+void mem_arena_get_heap_stats(mem_heap_stats_t *stats)
+{
+    _region_stats(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, &stats->internal);
+    _region_stats(MALLOC_CAP_SPIRAM, &stats->spiram);
+}
+
+void mem_arena_log_stats(mem_arena_handle_t arena, const char *name)
+{
+    mem_heap_stats_t heap;
+    mem_arena_get_heap_stats(&heap);
+    if (arena) {
+        ESP_LOGI(TAG, "%s arena: %d/%d bytes in %s", name, (int)arena->used, (int)arena->size,
+                 arena->spiram ? "PSRAM" : "internal RAM");
+    }
+    ESP_LOGI(TAG, "Internal: free %d, min free %d, largest %d, frag %d%%", (int)heap.internal.free,
+             (int)heap.internal.min_free, (int)heap.internal.largest_block, heap.internal.fragmentation);
+    if (heap.spiram.free) {
+        ESP_LOGI(TAG, "PSRAM: free %d, min free %d, largest %d, frag %d%%", (int)heap.spiram.free,
+                 (int)heap.spiram.min_free, (int)heap.spiram.largest_block, heap.spiram.fragmentation);
+    }
+}
@@ -0,0 +1,147 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _MEM_ARENA_H_
+#define _MEM_ARENA_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEM_ARENA_ALIGN             (4)
+/* Room needed in an arena for an allocation of `n` bytes */
+#define MEM_ARENA_SIZE(n)           (((n) + MEM_ARENA_ALIGN - 1) & ~(MEM_ARENA_ALIGN - 1))
+
+/**
+ * Where an arena lives
+ */
+typedef enum {
+    MEM_ARENA_PREFER_SPIRAM = 0,    /*!< PSRAM if present, internal RAM otherwise. Not for DMA */
+    MEM_ARENA_INTERNAL,             /*!< Internal RAM, for data touched with the cache disabled */
+    MEM_ARENA_DMA,                  /*!< Internal DMA capable RAM */
+} mem_arena_placement_t;
+
+/**
+ * Arena usage. Nothing is freed before the arena is destroyed, so `used` is also its high-water mark
+ */
+typedef struct {
+    size_t size;                    /*!< Bytes reserved */
+    size_t used;                    /*!< Bytes handed out */
+    bool   spiram;                  /*!< The arena is in PSRAM */
+} mem_arena_stats_t;
+
+/**
+ * Heap state of one memory type
+ */
+typedef struct {
+    size_t free;                    /*!< Free bytes now */
+    size_t min_free;                /*!< Lowest free bytes since boot, the heap high-water mark */
+    size_t largest_block;           /*!< Largest allocation that can succeed now */
+    int    fragmentation;           /*!< Percent of the free bytes outside the largest block */
+} mem_heap_region_stats_t;
+
+/**
+ * Heap state, see mem_arena_get_heap_stats
+ */
+typedef struct {
+    mem_heap_region_stats_t internal;   /*!< Internal 8-bit capable RAM */
+    mem_heap_region_stats_t spiram;     /*!< PSRAM, all zero without it */
+} mem_heap_stats_t;
+
+typedef struct mem_arena *mem_arena_handle_t;
+
+/**
+ * @brief      Reserve one block that a context carves its long-lived buffers from
+ *
+ * @param      size       Total size, the sum of MEM_ARENA_SIZE of every allocation
+ * @param      placement  The placement
+ *
+ * @return     The arena, NULL if out of memory
+ */
+mem_arena_handle_t mem_arena_create(size_t size, mem_arena_placement_t placement);
+
+/**
+ * @brief      Take zeroed memory from the arena
+ *
+ * @param      arena  The arena
+ * @param      size   The size
+ *
+ * @return     MEM_ARENA_ALIGN aligned memory, NULL if the arena is exhausted
+ */
+void *mem_arena_alloc(mem_arena_handle_t arena, size_t size);
+
+/**
+ * @brief      Copy a string into the arena
+ *
+ * @param      arena  The arena
+ * @param      str    The string
+ *
+ * @return     The copy, NULL if the arena is exhausted
+ */
+char *mem_arena_strdup(mem_arena_handle_t arena, const char *str);
+
+/**
+ * @brief      Get the arena usage
+ *
+ * @param      arena  The arena
+ * @param[out] stats  The stats
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t mem_arena_get_stats(mem_arena_handle_t arena, mem_arena_stats_t *stats);
+
+/**
+ * @brief      Release the arena and everything taken from it
+ *
+ * @param      arena  The arena, may be NULL
+ */
+void mem_arena_destroy(mem_arena_handle_t arena);
+
+/**
+ * @brief      Get the free, high-water and fragmentation figures of the heaps
+ *
+ * @param[out] stats  The stats
+ */
+void mem_arena_get_heap_stats(mem_heap_stats_t *stats);
+
+/**
+ * @brief      Log the heap stats and, if given, the arena usage
+ *
+ * @param      arena  The arena, may be NULL
+ * @param      name   Name of the arena owner for the log
+ */
+void mem_arena_log_stats(mem_arena_handle_t arena, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,410 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <math.h>
+#include <string.h>
+#include "esp_log.h"
+#include "audio_element.h"
+#include "audio_common.h"
+#include "audio_mem.h"
+#include "mic_frontend.h"
+
+static const char *TAG = "MIC_FRONTEND";
+
+#define FFT_N               (MIC_FRONTEND_FFT_SIZE)
+#define FFT_LOG2N           (8)
+#define HOP                 (FFT_N / 2)
+#define BINS                (FFT_N / 2 + 1)
+
+/* DC blocker corner */
+#define DC_CORNER_HZ        (10)
+/* Biquad coefficients are Q28, the DC blocker state keeps 8 fraction bits */
+#define BIQUAD_Q            (28)
+#define DC_STATE_Q          (8)
+/* The first hops seed the noise estimate */
+#define NS_INIT_HOPS        (8)
+/* Noise estimate follows a falling level within a few hops and a rising one in about 1 s */
+#define NS_POWER_SHIFT      (1)
+#define NS_FALL_SHIFT       (3)
+#define NS_RISE_SHIFT       (7)
+/* A band 6 dB above the estimate likely holds speech, the estimate then rises in about 8 s */
+#define NS_SPEECH_SHIFT     (2)
+#define NS_SPEECH_RISE      (10)
+/* Subtract twice the noise estimate, it is a mean and the instant noise power varies around it */
+#define NS_OVERSUB_SHIFT    (1)
+/* AGC gain is Q10, hops quieter than the gate hold it, hop peaks are kept below the limit */
+#define AGC_Q               (10)
+#define AGC_GATE_DBFS       (-50)
+#define AGC_LIMIT           (29000)
+#define AGC_RELEASE_SHIFT   (5)
+
+typedef struct mic_frontend {
+    int         sample_rate;
+    bool        highpass;
+    bool        agc_enable;
+    bool        ns_enable;
+    /* DC blocker and high-pass */
+    int32_t     dc_r;                   /* Q15 pole */
+    int32_t     dc_x1;
+    int32_t     dc_y1;                  /* DC_STATE_Q */
+    int32_t     bq_b[3];
+    int32_t     bq_a[2];
+    int32_t     bq_x[2];
+    int32_t     bq_y[2];
+    int64_t     bq_err;                 /* Truncation error fed back, or it builds up a DC offset */
+    /* Noise suppression */
+    int16_t     win[FFT_N];             /* sqrt-Hann, Q15 */
+    int16_t     cos_tab[FFT_N / 2];
+    int16_t     sin_tab[FFT_N / 2];
+    uint8_t     bitrev[FFT_N];
+    int32_t     ana[FFT_N];             /* Last two hops after the high-pass */
+    int32_t     re[FFT_N];
+    int32_t     im[FFT_N];
+    int32_t     ola[HOP];
+    uint64_t    power[BINS];
+    uint64_t    noise[BINS];
+    int16_t     gain[BINS];             /* Q15 */
+    int16_t     ns_floor;               /* Q15 */
+    int         ns_hops;
+    /* AGC */
+    uint64_t    agc_target_ms;          /* Target mean square */
+    uint32_t    agc_gate_ms;
+    int32_t     agc_max;                /* AGC_Q */
+    int32_t     agc_gain;
+    int32_t     agc_applied;
+    /* Hop buffers */
+    int16_t     in[HOP];
+    int         fill;
+    int32_t     frame[HOP];
+    int16_t     out[HOP];
+} mic_frontend_t;
+
+static inline int16_t _sat16(int32_t x)
+{
+    return x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : x;
+}
+
+static uint32_t _isqrt64(uint64_t x)
+{
+    uint64_t r = 0, bit = 1ULL << 62;
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+static void _design(mic_frontend_t *fe, mic_frontend_cfg_t *config)
+{
+    fe->dc_r = (int32_t)lrintf((1.0f - 2 * M_PI * DC_CORNER_HZ / fe->sample_rate) * 32768.0f);
+
+    /* RBJ high-pass, Q = 1/sqrt(2) */
+    int hz = config->highpass_hz > 0 ? config->highpass_hz : MIC_FRONTEND_HIGHPASS_HZ;
+    fe->highpass = config->highpass_hz >= 0 && hz < fe->sample_rate / 2;
+    float w0 = 2 * M_PI * hz / fe->sample_rate;
+    float alpha = sinf(w0) / (2 * 0.70710678f);
+    float a0 = 1 + alpha;
+    float scale = (float)(1 << BIQUAD_Q) / a0;
+    fe->bq_b[0] = lrintf((1 + cosf(w0)) / 2 * scale);
+    fe->bq_b[1] = lrintf(-(1 + cosf(w0)) * scale);
+    fe->bq_b[2] = fe->bq_b[0];
+    fe->bq_a[0] = lrintf(-2 * cosf(w0) * scale);
+    fe->bq_a[1] = lrintf((1 - alpha) * scale);
+
+    for (int i = 0; i < FFT_N; i++) {
+        fe->win[i] = (int16_t)lrintf(sinf(M_PI * i / FFT_N) * 32767.0f);
+        int r = 0;
+        for (int b = 0; b < FFT_LOG2N; b++) {
+            r |= ((i >> b) & 1) << (FFT_LOG2N - 1 - b);
+        }
+        fe->bitrev[i] = r;
+    }
+    for (int i = 0; i < FFT_N / 2; i++) {
+        fe->cos_tab[i] = (int16_t)lrintf(cosf(2 * M_PI * i / FFT_N) * 32767.0f);
+        fe->sin_tab[i] = (int16_t)lrintf(sinf(2 * M_PI * i / FFT_N) * 32767.0f);
+    }
+    int floor_db = config->ns_floor_db < 0 ? config->ns_floor_db : MIC_FRONTEND_NS_FLOOR_DB;
+    fe->ns_floor = (int16_t)lrintf(powf(10, floor_db / 20.0f) * 32767.0f);
+
+    int target_db = config->agc_target_dbfs < 0 ? config->agc_target_dbfs : MIC_FRONTEND_AGC_TARGET_DBFS;
+    int max_db = config->agc_max_gain_db > 0 ? config->agc_max_gain_db : MIC_FRONTEND_AGC_MAX_GAIN_DB;
+    float target = 32768.0f * powf(10, target_db / 20.0f);
+    float gate = 32768.0f * powf(10, AGC_GATE_DBFS / 20.0f);
+    fe->agc_target_ms = (uint64_t)(target * target);
+    fe->agc_gate_ms = (uint32_t)(gate * gate);
+    fe->agc_max = lrintf(powf(10, max_db / 20.0f) * (1 << AGC_Q));
+}
+
+/* DC removal and high-pass of the input hop into the second half of the analysis frame */
+static void _filter_hop(mic_frontend_t *fe, int32_t *dst)
+{
+    int32_t x1 = fe->dc_x1, y1 = fe->dc_y1;
+    int64_t err = fe->bq_err;
+    int32_t bx0 = fe->bq_x[0], bx1 = fe->bq_x[1], by0 = fe->bq_y[0], by1 = fe->bq_y[1];
+    for (int i = 0; i < HOP; i++) {
+        int32_t x = fe->in[i];
+        y1 = (x - x1) * (1 << DC_STATE_Q) + (int32_t)(((int64_t)fe->dc_r * y1 + (1 << 14)) >> 15);
+        x1 = x;
+        int32_t v = y1 >> DC_STATE_Q;
+        if (fe->highpass) {
+            int64_t acc = (int64_t)fe->bq_b[0] * v + (int64_t)fe->bq_b[1] * bx0 + (int64_t)fe->bq_b[2] * bx1
+                          - (int64_t)fe->bq_a[0] * by0 - (int64_t)fe->bq_a[1] * by1 + err;
+            bx1 = bx0;
+            bx0 = v;
+            by1 = by0;
+            by0 = (int32_t)(acc >> BIQUAD_Q);
+            err = acc - (int64_t)by0 * (1 << BIQUAD_Q);
+            v = by0;
+        }
+        dst[i] = _sat16(v);
+    }
+    fe->dc_x1 = x1;
+    fe->dc_y1 = y1;
+    fe->bq_err = err;
+    fe->bq_x[0] = bx0;
+    fe->bq_x[1] = bx1;
+    fe->bq_y[0] = by0;
+    fe->bq_y[1] = by1;
+}
+
+/* In place radix-2 FFT, unscaled: the values grow by up to FFT_N */
+static void _fft(mic_frontend_t *fe, int32_t *re, int32_t *im, bool inverse)
+{
+    for (int i = 0; i < FFT_N; i++) {
+        int j = fe->bitrev[i];
+        if (j > i) {
+            int32_t t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+    for (int len = 2, step = FFT_N / 2; len <= FFT_N; len <<= 1, step >>= 1) {
+        int half = len >> 1;
+        for (int k = 0; k < half; k++) {
+            int32_t wr = fe->cos_tab[k * step];
+            int32_t wi = inverse ? fe->sin_tab[k * step] : -fe->sin_tab[k * step];
+            for (int a = k; a < FFT_N; a += len) {
+                int b = a + half;
+                int32_t tr = (int32_t)(((int64_t)re[b] * wr - (int64_t)im[b] * wi + (1 << 14)) >> 15);
+                int32_t ti = (int32_t)(((int64_t)re[b] * wi + (int64_t)im[b] * wr + (1 << 14)) >> 15);
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/* Gain of one band, 1 - 2 * noise / power, in Q15 */
+static int16_t _ns_gain(mic_frontend_t *fe, uint64_t power, uint64_t noise)
+{
+    uint64_t sub = noise << NS_OVERSUB_SHIFT;
+    if (sub >= power) {
+        return fe->ns_floor;
+    }
+    /* Bring the power to 31 bits so the ratio is a 32-bit division */
+    int sh = 33 - __builtin_clzll(power);
+    uint32_t p = sh > 0 ? power >> sh : power << -sh;
+    uint32_t n = sh > 0 ? sub >> sh : sub << -sh;
+    int32_t g = 32767 - (int32_t)(n / ((p >> 15) + 1));
+    return g > fe->ns_floor ? g : fe->ns_floor;
+}
+
+static void _suppress(mic_frontend_t *fe)
+{
+    for (int i = 0; i < FFT_N; i++) {
+        fe->re[i] = (fe->ana[i] * fe->win[i] + (1 << 14)) >> 15;
+        fe->im[i] = 0;
+    }
+    _fft(fe, fe->re, fe->im, false);
+    for (int k = 0; k < BINS; k++) {
+        uint64_t p = (uint64_t)((int64_t)fe->re[k] * fe->re[k]) + (uint64_t)((int64_t)fe->im[k] * fe->im[k]);
+        uint64_t *n = &fe->noise[k];
+        /* Smoothing the band power and the gain over time keeps random peaks of the noise
+         * from opening the band, the musical noise of plain spectral subtraction */
+        fe->power[k] += ((int64_t)p - (int64_t)fe->power[k]) / (1 << NS_POWER_SHIFT);
+        p = fe->power[k];
+        if (fe->ns_hops < NS_INIT_HOPS) {
+            /* Mean of the first hops, the values stay below 2^48 */
+            *n = (int64_t)*n + ((int64_t)p - (int64_t)*n) / (fe->ns_hops + 1);
+        } else if (p < *n) {
+            *n -= (*n - p) >> NS_FALL_SHIFT;
+        } else if (p < *n << NS_SPEECH_SHIFT) {
+            *n += (p - *n) >> NS_RISE_SHIFT;
+        } else {
+            *n += (p - *n) >> NS_SPEECH_RISE;
+        }
+        fe->gain[k] = (fe->gain[k] + _ns_gain(fe, p, *n)) >> 1;
+    }
+    if (fe->ns_hops < NS_INIT_HOPS) {
+        fe->ns_hops++;
+    }
+    for (int k = 0; k < BINS; k++) {
+        int32_t g = fe->gain[k];
+        fe->re[k] = (int32_t)(((int64_t)fe->re[k] * g) >> 15);
+        fe->im[k] = (int32_t)(((int64_t)fe->im[k] * g) >> 15);
+        if (k > 0 && k < FFT_N / 2) {
+            fe->re[FFT_N - k] = (int32_t)(((int64_t)fe->re[FFT_N - k] * g) >> 15);
+            fe->im[FFT_N - k] = (int32_t)(((int64_t)fe->im[FFT_N - k] * g) >> 15);
+        }
+    }
+    _fft(fe, fe->re, fe->im, true);
+    for (int i = 0; i < HOP; i++) {
+        /* Undo the FFT_N gain of the inverse transform with the synthesis window, rounded */
+        int32_t head = (int32_t)(((int64_t)fe->re[i] * fe->win[i] + (1 << (14 + FFT_LOG2N))) >> (15 + FFT_LOG2N));
+        int32_t tail = (int32_t)(((int64_t)fe->re[i + HOP] * fe->win[i + HOP] + (1 << (14 + FFT_LOG2N))) >> (15 + FFT_LOG2N));
+        fe->frame[i] = fe->ola[i] + head;
+        fe->ola[i] = tail;
+    }
+}
+
+static void _agc(mic_frontend_t *fe)
+{
+    uint64_t sum = 0;
+    int32_t peak = 0;
+    for (int i = 0; i < HOP; i++) {
+        int32_t x = fe->frame[i];
+        sum += (int64_t)x * x;
+        x = x < 0 ? -x : x;
+        peak = x > peak ? x : peak;
+    }
+    uint32_t ms = sum / HOP;
+    if (ms > fe->agc_gate_ms) {
+        int32_t want = _isqrt64((fe->agc_target_ms << (2 * AGC_Q)) / ms);
+        want = want > fe->agc_max ? fe->agc_max : want;
+        if (want < fe->agc_gain) {
+            fe->agc_gain = (fe->agc_gain + want) >> 1;
+        } else {
+            fe->agc_gain += (want - fe->agc_gain) >> AGC_RELEASE_SHIFT;
+        }
+    }
+    int32_t gain = fe->agc_gain;
+    if (peak > 0 && ((int64_t)peak * gain >> AGC_Q) > AGC_LIMIT) {
+        gain = ((int64_t)AGC_LIMIT << AGC_Q) / peak;
+    }
+    /* Ramp up across the hop, come down at once so the limit holds */
+    int32_t from = gain > fe->agc_applied ? fe->agc_applied : gain;
+    for (int i = 0; i < HOP; i++) {
+        int32_t g = from + (gain - from) * i / HOP;
+        fe->frame[i] = (fe->frame[i] * g) >> AGC_Q;
+    }
+    fe->agc_applied = gain;
+}
+
+static esp_err_t _frontend_open(audio_element_handle_t self)
+{
+    mic_frontend_t *fe = (mic_frontend_t *)audio_element_getdata(self);
+    fe->fill = 0;
+    fe->dc_x1 = fe->dc_y1 = 0;
+    memset(fe->bq_x, 0, sizeof(fe->bq_x));
+    memset(fe->bq_y, 0, sizeof(fe->bq_y));
+    fe->bq_err = 0;
+    memset(fe->ana, 0, sizeof(fe->ana));
+    memset(fe->ola, 0, sizeof(fe->ola));
+    memset(fe->power, 0, sizeof(fe->power));
+    for (int k = 0; k < BINS; k++) {
+        fe->gain[k] = 32767;
+    }
+    fe->ns_hops = 0;
+    fe->agc_gain = fe->agc_applied = 1 << AGC_Q;
+    return ESP_OK;
+}
+
+static audio_element_err_t _frontend_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    mic_frontend_t *fe = (mic_frontend_t *)audio_element_getdata(self);
+    int r_size = audio_element_input(self, (char *)fe->in + fe->fill, sizeof(fe->in) - fe->fill);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    fe->fill += r_size;
+    if (fe->fill < (int)sizeof(fe->in)) {
+        return r_size;
+    }
+    fe->fill = 0;
+
+    if (fe->ns_enable) {
+        memcpy(fe->ana, fe->ana + HOP, HOP * sizeof(int32_t));
+        _filter_hop(fe, fe->ana + HOP);
+        _suppress(fe);
+    } else {
+        _filter_hop(fe, fe->frame);
+    }
+    if (fe->agc_enable) {
+        _agc(fe);
+    }
+    for (int i = 0; i < HOP; i++) {
+        fe->out[i] = _sat16(fe->frame[i]);
+    }
+    int w_size = audio_element_output(self, (char *)fe->out, sizeof(fe->out));
+    return w_size < 0 ? w_size : r_size;
+}
+
+static esp_err_t _frontend_destroy(audio_element_handle_t self)
+{
+    mic_frontend_t *fe = (mic_frontend_t *)audio_element_getdata(self);
+    audio_free(fe);
+    return ESP_OK;
+}
+
+audio_element_handle_t mic_frontend_init(mic_frontend_cfg_t *config)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    audio_element_handle_t el;
+    mic_frontend_t *fe = audio_calloc(1, sizeof(mic_frontend_t));
+    AUDIO_MEM_CHECK(TAG, fe, return NULL);
+    fe->sample_rate = config->sample_rate > 0 ? config->sample_rate : 16000;
+    fe->agc_enable = config->agc_enable;
+    fe->ns_enable = config->ns_enable;
+    _design(fe, config);
+
+    cfg.open = _frontend_open;
+    cfg.process = _frontend_process;
+    cfg.destroy = _frontend_destroy;
+    cfg.task_stack = config->task_stack > 0 ? config->task_stack : MIC_FRONTEND_TASK_STACK;
+    if (config->task_prio > 0) {
+        cfg.task_prio = config->task_prio;
+    }
+    cfg.tag = "frontend";
+    el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {
+        audio_free(fe);
+        return NULL;
+    });
+    audio_element_setdata(el, fe);
+    return el;
+}
@@ -0,0 +1,77 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _MIC_FRONTEND_H_
+#define _MIC_FRONTEND_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIC_FRONTEND_FFT_SIZE           (256)   /*!< Noise suppression frame, half of it is the hop */
+#define MIC_FRONTEND_HIGHPASS_HZ        (100)
+#define MIC_FRONTEND_AGC_TARGET_DBFS    (-20)
+#define MIC_FRONTEND_AGC_MAX_GAIN_DB    (24)
+#define MIC_FRONTEND_NS_FLOOR_DB        (-12)
+#define MIC_FRONTEND_TASK_STACK         (3*1024)
+
+/**
+ * Microphone front-end configurations, every stage runs on 16-bit mono
+ */
+typedef struct {
+    int     sample_rate;        /*!< Sample rate */
+    int     highpass_hz;        /*!< High-pass corner, 0 for MIC_FRONTEND_HIGHPASS_HZ, -1 for DC removal only */
+    bool    agc_enable;         /*!< Automatic gain control with a limiter */
+    int     agc_target_dbfs;    /*!< Speech level the AGC aims for, 0 for MIC_FRONTEND_AGC_TARGET_DBFS */
+    int     agc_max_gain_db;    /*!< Largest AGC boost, 0 for MIC_FRONTEND_AGC_MAX_GAIN_DB */
+    bool    ns_enable;          /*!< Spectral subtraction noise suppression */
+    int     ns_floor_db;        /*!< Lowest gain of a noise-only band, 0 for MIC_FRONTEND_NS_FLOOR_DB */
+    int     task_stack;         /*!< Element task stack size, 0 for default */
+    int     task_prio;          /*!< Element task priority, 0 for default */
+} mic_frontend_cfg_t;
+
+/**
+ * @brief      Create an audio element conditioning microphone audio
+ *
+ *             In one pass over each hop of MIC_FRONTEND_FFT_SIZE / 2 samples: DC removal and a
+ *             2nd order Butterworth high-pass, then spectral subtraction against an adaptive
+ *             noise estimate (sqrt-Hann weighted overlap-add), then AGC with a limiter that
+ *             never lets a hop clip. Everything is fixed-point; noise suppression adds half an
+ *             FFT frame of latency.
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle
+ */
+audio_element_handle_t mic_frontend_init(mic_frontend_cfg_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,454 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "sr_response_parser.h"
+
+typedef enum {
+    ROLE_OTHER = 0,
+    ROLE_ROOT,          /* { "results": ... } */
+    ROLE_RESULTS,       /* "results": [ ... ] */
+    ROLE_RESULT,        /* One segment */
+    ROLE_ALTERNATIVES,  /* "alternatives": [ ... ] */
+    ROLE_ALTERNATIVE,   /* One alternative */
+} frame_role_t;
+
+typedef enum {
+    KEY_OTHER = 0,
+    KEY_RESULTS,
+    KEY_ALTERNATIVES,
+    KEY_TRANSCRIPT,
+    KEY_CONFIDENCE,
+    KEY_RESULT_END_TIME,
+} frame_key_t;
+
+typedef enum {
+    STATE_TOKEN = 0,    /* Between tokens */
+    STATE_STRING,
+    STATE_ESCAPE,
+    STATE_UNICODE,
+    STATE_SCALAR,       /* Number or literal */
+} parser_state_t;
+
+typedef enum {
+    TARGET_NONE = 0,
+    TARGET_KEY,
+    TARGET_TRANSCRIPT,
+    TARGET_END_TIME,
+    TARGET_CONFIDENCE,
+} parser_target_t;
+
+static const struct {
+    const char *name;
+    frame_key_t key;
+} key_map[] = {
+    { "results",        KEY_RESULTS },
+    { "alternatives",   KEY_ALTERNATIVES },
+    { "transcript",     KEY_TRANSCRIPT },
+    { "confidence",     KEY_CONFIDENCE },
+    { "resultEndTime",  KEY_RESULT_END_TIME },
+};
+
+static google_sr_segment_t *_segment(sr_response_parser_t *parser)
+{
+    return &parser->result->segments[parser->result->num_segments - 1];
+}
+
+static google_sr_alternative_t *_alternative(sr_response_parser_t *parser)
+{
+    google_sr_segment_t *segment = _segment(parser);
+    return &segment->alternatives[segment->num_alternatives - 1];
+}
+
+static void _arena_put(sr_response_parser_t *parser, char c)
+{
+    /* Always keep room for the terminator */
+    if (parser->arena_used + 1 < parser->arena_size) {
+        parser->arena[parser->arena_used++] = c;
+    } else {
+        parser->result->truncated = true;
+    }
+}
+
+static bool _arena_terminate(sr_response_parser_t *parser)
+{
+    if (parser->arena_used < parser->arena_size) {
+        parser->arena[parser->arena_used++] = 0;
+        return true;
+    }
+    parser->result->truncated = true;
+    return false;
+}
+
+static void _put_char(sr_response_parser_t *parser, char c)
+{
+    if (parser->target == TARGET_TRANSCRIPT) {
+        _arena_put(parser, c);
+    } else if (parser->target != TARGET_NONE) {
+        if (parser->token_len < SR_RESPONSE_PARSER_TOKEN_MAX - 1) {
+            parser->token[parser->token_len++] = c;
+        } else if (parser->target == TARGET_KEY) {
+            /* Longer than any key we look for */
+            parser->token_len = SR_RESPONSE_PARSER_TOKEN_MAX;
+        }
+    }
+}
+
+static void _put_code_point(sr_response_parser_t *parser, uint32_t cp)
+{
+    if (cp < 0x80) {
+        _put_char(parser, cp);
+    } else if (cp < 0x800) {
+        _put_char(parser, 0xc0 | (cp >> 6));
+        _put_char(parser, 0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        _put_char(parser, 0xe0 | (cp >> 12));
+        _put_char(parser, 0x80 | ((cp >> 6) & 0x3f));
+        _put_char(parser, 0x80 | (cp & 0x3f));
+    } else {
+        _put_char(parser, 0xf0 | (cp >> 18));
+        _put_char(parser, 0x80 | ((cp >> 12) & 0x3f));
+        _put_char(parser, 0x80 | ((cp >> 6) & 0x3f));
+        _put_char(parser, 0x80 | (cp & 0x3f));
+    }
+}
+
+/* A high surrogate not followed by a low one stands for nothing, replace it */
+static void _flush_surrogate(sr_response_parser_t *parser)
+{
+    if (parser->high_surrogate) {
+        _put_code_point(parser, 0xfffd);
+        parser->high_surrogate = 0;
+    }
+}
+
+static sr_response_frame_t *_top(sr_response_parser_t *parser)
+{
+    if (parser->depth == 0 || parser->skip_depth) {
+        return NULL;
+    }
+    return &parser->stack[parser->depth - 1];
+}
+
+/**
+ * Decide where the value that starts now goes
+ */
+static parser_target_t _value_target(sr_response_parser_t *parser, bool is_string)
+{
+    sr_response_frame_t *frame = _top(parser);
+    if (frame == NULL || !frame->is_object) {
+        return TARGET_NONE;
+    }
+    if (is_string && frame->role == ROLE_ALTERNATIVE && frame->key == KEY_TRANSCRIPT) {
+        return TARGET_TRANSCRIPT;
+    }
+    if (is_string && frame->role == ROLE_RESULT && frame->key == KEY_RESULT_END_TIME) {
+        return TARGET_END_TIME;
+    }
+    if (!is_string && frame->role == ROLE_ALTERNATIVE && frame->key == KEY_CONFIDENCE) {
+        return TARGET_CONFIDENCE;
+    }
+    return TARGET_NONE;
+}
+
+static void _push(sr_response_parser_t *parser, bool is_object)
+{
+    sr_response_frame_t *parent = _top(parser);
+    if (parser->skip_depth || parser->depth == SR_RESPONSE_PARSER_MAX_DEPTH) {
+        parser->skip_depth++;
+        return;
+    }
+    frame_role_t role = ROLE_OTHER;
+    google_sr_result_t *result = parser->result;
+    if (parent == NULL) {
+        role = is_object ? ROLE_ROOT : ROLE_OTHER;
+    } else if (parent->role == ROLE_ROOT && parent->key == KEY_RESULTS && !is_object) {
+        role = ROLE_RESULTS;
+    } else if (parent->role == ROLE_RESULTS && is_object) {
+        if (result->num_segments < GOOGLE_SR_MAX_SEGMENTS) {
+            google_sr_segment_t *segment = &result->segments[result->num_segments++];
+            segment->num_alternatives = 0;
+            segment->result_end_time_ms = -1;
+            role = ROLE_RESULT;
+        } else {
+            result->truncated = true;
+        }
+    } else if (parent->role == ROLE_RESULT && parent->key == KEY_ALTERNATIVES && !is_object) {
+        role = ROLE_ALTERNATIVES;
+    } else if (parent->role == ROLE_ALTERNATIVES && is_object) {
+        google_sr_segment_t *segment = _segment(parser);
+        if (segment->num_alternatives < GOOGLE_SR_MAX_ALTERNATIVES) {
+            google_sr_alternative_t *alternative = &segment->alternatives[segment->num_alternatives++];
+            alternative->transcript = NULL;
+            alternative->confidence = 0;
+            role = ROLE_ALTERNATIVE;
+        } else {
+            result->truncated = true;
+        }
+    }
+    sr_response_frame_t *frame = &parser->stack[parser->depth++];
+    frame->role = role;
+    frame->key = KEY_OTHER;
+    frame->is_object = is_object;
+    frame->expect_key = is_object;
+}
+
+static void _pop(sr_response_parser_t *parser, bool is_object)
+{
+    if (parser->skip_depth) {
+        parser->skip_depth--;
+        return;
+    }
+    if (parser->depth == 0 || parser->stack[parser->depth - 1].is_object != is_object) {
+        parser->error = true;
+        return;
+    }
+    parser->depth--;
+}
+
+static void _end_string(sr_response_parser_t *parser)
+{
+    sr_response_frame_t *frame = _top(parser);
+    switch (parser->target) {
+        case TARGET_KEY:
+            frame->key = KEY_OTHER;
+            for (int i = 0; i < (int)(sizeof(key_map) / sizeof(key_map[0])); i++) {
+                if (parser->token_len == (int)strlen(key_map[i].name)
+                        && memcmp(parser->token, key_map[i].name, parser->token_len) == 0) {
+                    frame->key = key_map[i].key;
+                    break;
+                }
+            }
+            break;
+        case TARGET_TRANSCRIPT:
+            if (_arena_terminate(parser)) {
+                _alternative(parser)->transcript = parser->text;
+            }
+            break;
+        case TARGET_END_TIME:
+            /* Duration such as "2.100s" */
+            parser->token[parser->token_len] = 0;
+            _segment(parser)->result_end_time_ms = (int)(strtof(parser->token, NULL) * 1000 + 0.5f);
+            break;
+        default:
+            break;
+    }
+    parser->target = TARGET_NONE;
+}
+
+static void _end_scalar(sr_response_parser_t *parser)
+{
+    if (parser->target == TARGET_CONFIDENCE) {
+        parser->token[parser->token_len] = 0;
+        _alternative(parser)->confidence = strtof(parser->token, NULL);
+    }
+    parser->target = TARGET_NONE;
+}
+
+void sr_response_parser_init(sr_response_parser_t *parser, google_sr_result_t *result, char *arena, int arena_size)
+{
+    memset(parser, 0, sizeof(sr_response_parser_t));
+    memset(result, 0, sizeof(google_sr_result_t));
+    parser->result = result;
+    parser->arena = arena;
+    parser->arena_size = arena_size;
+}
+
+esp_err_t sr_response_parser_feed(sr_response_parser_t *parser, const char *data, int len)
+{
+    const char *end = data + len;
+    while (data < end && !parser->error) {
+        char c = *data;
+        switch (parser->state) {
+            case STATE_TOKEN: {
+                sr_response_frame_t *frame = _top(parser);
+                if (c == '{' || c == '[') {
+                    _push(parser, c == '{');
+                } else if (c == '}' || c == ']') {
+                    _pop(parser, c == '}');
+                } else if (c == ',') {
+                    if (frame && frame->is_object) {
+                        frame->expect_key = true;
+                    }
+                } else if (c == ':') {
+                    if (frame && frame->is_object) {
+                        frame->expect_key = false;
+                    }
+                } else if (c == '"') {
+                    parser->state = STATE_STRING;
+                    parser->token_len = 0;
+                    if (frame && frame->is_object && frame->expect_key) {
+                        parser->target = TARGET_KEY;
+                    } else {
+                        parser->target = _value_target(parser, true);
+                        if (parser->target == TARGET_TRANSCRIPT) {
+                            parser->text = parser->arena + parser->arena_used;
+                        }
+                    }
+                } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                    parser->state = STATE_SCALAR;
+                    parser->token_len = 0;
+                    parser->target = _value_target(parser, false);
+                    continue;
+                }
+                break;
+            }
+            case STATE_STRING:
+                if (c == '\\') {
+                    parser->state = STATE_ESCAPE;
+                    break;
+                }
+                _flush_surrogate(parser);
+                if (c == '"') {
+                    _end_string(parser);
+                    parser->state = STATE_TOKEN;
+                } else {
+                    _put_char(parser, c);
+                }
+                break;
+            case STATE_ESCAPE:
+                parser->state = STATE_STRING;
+                if (c != 'u') {
+                    _flush_surrogate(parser);
+                }
+                switch (c) {
+                    case 'n':
+                        _put_char(parser, '\n');
+                        break;
+                    case 't':
+                        _put_char(parser, '\t');
+                        break;
+                    case 'r':
+                        _put_char(parser, '\r');
+                        break;
+                    case 'b':
+                        _put_char(parser, '\b');
+                        break;
+                    case 'f':
+                        _put_char(parser, '\f');
+                        break;
+                    case 'u':
+                        parser->state = STATE_UNICODE;
+                        parser->unicode = 0;
+                        parser->unicode_len = 0;
+                        break;
+                    default:
+                        _put_char(parser, c);
+                        break;
+                }
+                break;
+            case STATE_UNICODE: {
+                int v = (c >= '0' && c <= '9') ? c - '0'
+                        : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                        : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+                if (v < 0) {
+                    parser->error = true;
+                    break;
+                }
+                parser->unicode = (parser->unicode << 4) | v;
+                if (++parser->unicode_len == 4) {
+                    parser->state = STATE_STRING;
+                    if (parser->unicode >= 0xdc00 && parser->unicode < 0xe000) {
+                        /* A low surrogate alone is not a character either */
+                        _put_code_point(parser, parser->high_surrogate
+                                        ? 0x10000 + ((parser->high_surrogate - 0xd800) << 10) + (parser->unicode - 0xdc00)
+                                        : 0xfffd);
+                        parser->high_surrogate = 0;
+                    } else {
+                        _flush_surrogate(parser);
+                        if (parser->unicode >= 0xd800 && parser->unicode < 0xdc00) {
+                            parser->high_surrogate = parser->unicode;
+                        } else {
+                            _put_code_point(parser, parser->unicode);
+                        }
+                    }
+                }
+                break;
+            }
+            case STATE_SCALAR:
+                if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                    _end_scalar(parser);
+                    parser->state = STATE_TOKEN;
+                    continue;
+                }
+                _put_char(parser, c);
+                break;
+        }
+        data++;
+    }
+    return parser->error ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t sr_response_parser_finish(sr_response_parser_t *parser)
+{
+    google_sr_result_t *result = parser->result;
+    esp_err_t ret = (parser->error || parser->depth || parser->skip_depth || parser->state != STATE_TOKEN) ? ESP_FAIL : ESP_OK;
+    if (parser->state == STATE_STRING && parser->target == TARGET_TRANSCRIPT) {
+        /* Keep the arena consistent if the body was cut */
+        _arena_terminate(parser);
+    }
+
+    /* A single segment is used in place, several are joined behind the strings */
+    const char *first = NULL;
+    int texts = 0;
+    for (int i = 0; i < result->num_segments; i++) {
+        google_sr_segment_t *segment = &result->segments[i];
+        if (segment->num_alternatives > 0 && segment->alternatives[0].transcript) {
+            first = first ? first : segment->alternatives[0].transcript;
+            texts++;
+        }
+    }
+    result->transcript = first;
+    if (texts < 2) {
+        return ret;
+    }
+    char *joined = parser->arena + parser->arena_used;
+    int joined_len = 0;
+    for (int i = 0; i < result->num_segments; i++) {
+        google_sr_segment_t *segment = &result->segments[i];
+        if (segment->num_alternatives == 0 || segment->alternatives[0].transcript == NULL) {
+            continue;
+        }
+        const char *text = segment->alternatives[0].transcript;
+        int len = strlen(text);
+        bool space = joined_len > 0 && joined[joined_len - 1] != ' ' && text[0] != ' ';
+        if (parser->arena_used + joined_len + space + len + 1 > parser->arena_size) {
+            /* Keep the segments joined so far, or the first one alone */
+            result->truncated = true;
+            break;
+        }
+        if (space) {
+            joined[joined_len++] = ' ';
+        }
+        memcpy(joined + joined_len, text, len);
+        joined_len += len;
+    }
+    if (joined_len > 0) {
+        joined[joined_len] = 0;
+        parser->arena_used += joined_len + 1;
+        result->transcript = joined;
+    }
+    return ret;
+}
@@ -0,0 +1,108 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _SR_RESPONSE_PARSER_H_
+#define _SR_RESPONSE_PARSER_H_
+
+#include "esp_err.h"
+#include "google_sr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SR_RESPONSE_PARSER_MAX_DEPTH    (8)
+#define SR_RESPONSE_PARSER_TOKEN_MAX    (24)
+
+typedef struct {
+    uint8_t role;
+    uint8_t key;
+    bool    is_object;
+    bool    expect_key;
+} sr_response_frame_t;
+
+/**
+ * Streaming parser for `speech:recognize` responses. It consumes the body in pieces of any
+ * size and writes strings directly into a caller-provided arena, so memory use does not
+ * depend on the response size.
+ */
+typedef struct {
+    google_sr_result_t  *result;
+    char                *arena;
+    int                 arena_size;
+    int                 arena_used;
+    sr_response_frame_t stack[SR_RESPONSE_PARSER_MAX_DEPTH];
+    int                 depth;
+    int                 skip_depth;     /* Nesting below the tracked stack */
+    int                 state;
+    int                 target;         /* Where the current string/scalar goes */
+    char                token[SR_RESPONSE_PARSER_TOKEN_MAX];
+    int                 token_len;
+    char                *text;          /* Transcript being written into the arena */
+    int                 unicode;        /* \\uXXXX code unit being read */
+    int                 unicode_len;
+    uint16_t            high_surrogate;
+    bool                error;
+} sr_response_parser_t;
+
+/**
+ * @brief      Reset the parser and the result
+ *
+ * @param      parser      The parser
+ * @param      result      The result to fill in
+ * @param      arena       Storage for the result strings
+ * @param[in]  arena_size  The arena size
+ */
+void sr_response_parser_init(sr_response_parser_t *parser, google_sr_result_t *result, char *arena, int arena_size);
+
+/**
+ * @brief      Parse the next part of the response body
+ *
+ * @param      parser  The parser
+ * @param[in]  data    The data
+ * @param[in]  len     The data length
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL  The body is not valid JSON
+ */
+esp_err_t sr_response_parser_feed(sr_response_parser_t *parser, const char *data, int len);
+
+/**
+ * @brief      Finish parsing and join the most likely alternative of every segment into
+ *             `result->transcript`
+ *
+ * @param      parser  The parser
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL  The body was malformed or incomplete
+ */
+esp_err_t sr_response_parser_finish(sr_response_parser_t *parser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
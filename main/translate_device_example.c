@@ -17,19 +17,32 @@
 #include "periph_led.h"
 #include "google_sr.h"
 #include "google_tts.h"
+#include "google_translate.h"
+#include "voice_trace.h"
 #include "audio_idf_version.h"
 #include "esp_netif.h"
 
 static const char *TAG = "CLOUD_API_TEST";
 
 #define GOOGLE_SR_LANG "en-US"                  //https://cloud.google.com/speech-to-text/docs/languages
-#define GOOGLE_TTS_LANG "en-US"                 //https://cloud.google.com/text-to-speech/docs/voices
+#define GOOGLE_TRANSLATE_SOURCE "en"            //https://cloud.google.com/translate/docs/languages
+#define GOOGLE_TRANSLATE_TARGET "es"
+#define GOOGLE_TTS_LANG "es-ES"                 //https://cloud.google.com/text-to-speech/docs/voices
 #define RECORD_PLAYBACK_SAMPLE_RATE (16000) 
 
 static esp_periph_set_handle_t periph_set;
 static google_sr_handle_t sr;
 static google_tts_handle_t tts;
+static google_translate_handle_t translator;
 static audio_event_iface_handle_t evt_listener;
+static bool sr_running;
+static int sr_session = -1;
+// Barge-in: answers to sessions before this one, and translations started before it, are not spoken
+static int answer_session;
+static int answer_request;
+static int last_request = -1;
+// Linking a trained keyword model, defined with this name, makes the device hands-free
+extern const wake_word_model_t wake_word_model __attribute__((weak));
 
 void google_sr_begin(google_sr_handle_t sr)
 {
@@ -75,22 +88,49 @@ static void google_sr_init_start(){
         .record_sample_rates = RECORD_PLAYBACK_SAMPLE_RATE,
         .encoding = ENCODING_LINEAR16,
         .on_begin = google_sr_begin,
+        .vad_enable = true,
+        .vad_auto_stop = true,
+        .frontend_enable = true,
+        .frontend_agc = true,
+        .frontend_ns = true,
+        .aec_enable = true,
+        .wake_word_model = &wake_word_model,
     };
     sr = google_sr_init(&sr_config);
     ESP_LOGI(TAG, "%s", CONFIG_GOOGLE_API_KEY);
     ESP_LOGI(TAG, "I2S->HTTP SR Audio pipeline initialized");
 }
 
+static void tts_playback_tap(const void *pcm, int len, void *ctx){
+    // The played answer is the echo canceller reference, so the user can talk over it
+    google_sr_feed_reference(sr, pcm, len);
+}
+
 static void google_tts_init_start(){
     // Initialize google tts handler
     google_tts_config_t tts_config = {
         .api_key = CONFIG_GOOGLE_API_KEY,
         .playback_sample_rate = RECORD_PLAYBACK_SAMPLE_RATE,
+        .cache_enable = true,
+        .encoding = TTS_ENCODING_LINEAR16,
+        .jitter_buffer_enable = true,
     };
     tts = google_tts_init(&tts_config);
+    google_tts_set_playback_tap(tts, tts_playback_tap, NULL);
     ESP_LOGI(TAG, "HTTP->I2S TTS Audio pipeline initialized");
 }
 
+static void google_translate_init_start(){
+    // Initialize google translation handler, repeated phrases are answered from its cache
+    google_translate_config_t translate_config = {
+        .api_key = CONFIG_GOOGLE_API_KEY,
+        .cache_enable = true,
+    };
+    translator = google_translate_init(&translate_config);
+    google_translate_preconnect(translator);
+    ESP_LOGI(TAG, "Translation initialized");
+}
+
 static void audio_event_listener_setup_start(){
     // Initialize audio event listener
     audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
@@ -100,12 +140,69 @@ static void audio_event_listener_setup_start(){
     google_sr_set_listener(sr, evt_listener);
     // Connect event listener to the TTS adf pipeline, so that it can monitor TTS pipeline events
     google_tts_set_listener(tts, evt_listener);
+    // Connect event listener to the translation, so that it can receive the translations
+    google_translate_set_listener(translator, evt_listener);
     // Connect event listener to board peripherals, so that it can listen to peripherals events
     audio_event_iface_set_listener(esp_periph_set_get_event_iface(periph_set), evt_listener);
 
     ESP_LOGI(TAG, "Audio event listener initialized and setup");
 }
 
+static void sr_finish_and_arm_tts(){
+    // End the SR request (no-op if VAD already ended it), the transcript arrives as an event
+    if (!sr_running) {
+        return;
+    }
+    sr_running = false;
+    VOICE_TRACE_MARK(VOICE_TRACE_BUTTON_RELEASE, 0);
+    ESP_LOGI(TAG, "[ * ] Finish SR request");
+    google_sr_finish(sr);
+    // Open the TTS request while SR finalizes, so playback starts as soon as the text is known
+    google_tts_arm(tts, GOOGLE_TTS_LANG);
+}
+
+static void translate_transcript(int session){
+    // The next utterance may be captured already, it is answered when its own transcript arrives
+    if (session == sr_session) {
+        sr_running = false;
+    }
+    if (session < answer_session) {
+        ESP_LOGI(TAG, "Speech of session %d was interrupted, not answered", session);
+        return;
+    }
+    const google_sr_result_t *result = google_sr_get_session_result(sr, session);
+    const char *response_text = result ? result->transcript : NULL;
+    if (response_text == NULL) {
+        ESP_LOGW(TAG, "Nothing recognized");
+        google_tts_stop(tts);
+        return;
+    }
+    ESP_LOGI(TAG, "response text = %s", response_text);
+    // The armed TTS request waits for the translation
+    int request = google_translate_start(translator, response_text, GOOGLE_TRANSLATE_SOURCE, GOOGLE_TRANSLATE_TARGET);
+    if (request < 0) {
+        google_tts_stop(tts);
+        return;
+    }
+    last_request = request;
+}
+
+static void speak_translation(int request){
+    if (request < answer_request) {
+        ESP_LOGI(TAG, "Translation %d was interrupted, not spoken", request);
+        return;
+    }
+    const char *translation = google_translate_get_result(translator, request);
+    if (translation == NULL) {
+        ESP_LOGW(TAG, "Nothing translated");
+        google_tts_stop(tts);
+        return;
+    }
+    ESP_LOGI(TAG, "translation = %s", translation);
+    ESP_LOGI(TAG, "TTS Start");
+    google_tts_start(tts, translation, GOOGLE_TTS_LANG);
+}
+
 void event_process_Task(void *pv)
 {       
     audio_event_iface_msg_t msg;
@@ -119,31 +216,89 @@ void event_process_Task(void *pv)
 
         if(google_tts_check_event_finish(tts, &msg)) {
             ESP_LOGI(TAG, "[ * ] TTS Finish");
+            voice_trace_log_summary();
+            tts_cache_stats_t stats;
+            if (google_tts_get_cache_stats(tts, &stats) == ESP_OK) {
+                ESP_LOGI(TAG, "TTS cache: %u hits (%u flash), %u misses, %u evictions",
+                         stats.mem_hits + stats.flash_hits, stats.flash_hits, stats.misses, stats.evictions);
+            }
+            jitter_buffer_stats_t playback;
+            if (google_tts_get_playback_stats(tts, &playback) == ESP_OK) {
+                ESP_LOGI(TAG, "Playback: started after %d ms (prebuffer %d ms), %u underruns (%u ms silence), depth %d..%d ms",
+                         playback.startup_ms, playback.target_ms, playback.underruns, playback.underrun_ms,
+                         playback.min_depth_ms, playback.max_depth_ms);
+            }
+            // Heap high-water and fragmentation, for monitoring field units
+            mem_arena_log_stats(NULL, NULL);
+            echo_canceller_stats_t aec_stats;
+            if (google_sr_get_aec_stats(sr, &aec_stats) == ESP_OK) {
+                ESP_LOGI(TAG, "AEC: ERLE %.1f dB, echo peak at %d ms", aec_stats.erle_db, aec_stats.peak_ms);
+            }
+            google_translate_stats_t translate_stats;
+            if (google_translate_get_stats(translator, &translate_stats) == ESP_OK) {
+                ESP_LOGI(TAG, "Translation: %u ms (connect %u ms, response %u ms), %u/%u from cache",
+                         translate_stats.last_total_ms, translate_stats.last_connect_ms, translate_stats.last_response_ms,
+                         translate_stats.cache_hits, translate_stats.requests);
+            }
+            // Idle until the next button press, warm up the translation connection meanwhile
+            google_translate_preconnect(translator);
+            continue;
+        }
+
+        google_tts_event_t tts_event;
+        if(google_tts_check_event(tts, &msg, &tts_event)) {
+            ESP_LOGI(TAG, "[ * ] TTS segment %d: %s", (int)(intptr_t)msg.data,
+                     tts_event == GOOGLE_TTS_EVENT_SEGMENT_DONE ? "queued" :
+                     tts_event == GOOGLE_TTS_EVENT_SEGMENT_FAILED ? "failed" : "all queued");
+            continue;
+        }
+
+        google_translate_event_t translate_event;
+        if(google_translate_check_event(translator, &msg, &translate_event)) {
+            speak_translation((int)(intptr_t)msg.data);
+            continue;
+        }
+
+        google_sr_event_t sr_event;
+        if(google_sr_check_event(sr, &msg, &sr_event)) {
+            if (sr_event == GOOGLE_SR_EVENT_SPEECH_START) {
+                ESP_LOGI(TAG, "[ * ] Speech detected");
+                // Barge-in: the user talks over the answer, stop it, and drop the answers still on their way
+                google_tts_stop(tts);
+                answer_session = (int)(intptr_t)msg.data;
+                answer_request = last_request + 1;
+            } else if (sr_event == GOOGLE_SR_EVENT_SPEECH_END) {
+                ESP_LOGI(TAG, "[ * ] End of speech");
+                sr_finish_and_arm_tts();
+            } else if (sr_event == GOOGLE_SR_EVENT_FINAL_TRANSCRIPT) {
+                translate_transcript((int)(intptr_t)msg.data);
+            } else if (sr_event == GOOGLE_SR_EVENT_WAKE_WORD && (int)(intptr_t)msg.data >= 0) {
+                // Hands-free: the request is already running, the end of speech closes it
+                ESP_LOGI(TAG, "[ * ] Wake word");
+                sr_session = (int)(intptr_t)msg.data;
+                sr_running = true;
+            }
             continue;
         }
         
         ESP_LOGI(TAG, "[ * ] Event received: src_type:%d, source:%p cmd:%d, data:%p, data_len:%d", msg.source_type, msg.source, msg.cmd, msg.data, msg.data_len);
 
         if ((msg.source_type == PERIPH_ID_TOUCH || msg.source_type == PERIPH_ID_BUTTON || msg.source_type == PERIPH_ID_ADC_BTN)) {
-            if((int)msg.data == get_input_rec_id()) {
+            if((int)(intptr_t)msg.data == get_input_rec_id()) {
                 if(msg.cmd == PERIPH_BUTTON_PRESSED) {
-                    google_tts_stop(tts);
+                    VOICE_TRACE_MARK(VOICE_TRACE_BUTTON_PRESS, 0);
+                    // Any answer keeps playing until speech is detected, its echo is cancelled
                     ESP_LOGI(TAG, "[ * ] Resuming SR pipeline");
-                    google_sr_start(sr);
+                    // Starts even while the previous utterance is still being recognized
+                    if (google_sr_start(sr) == ESP_OK) {
+                        sr_session = google_sr_get_session(sr);
+                        sr_running = true;
+                    }
                 } 
                 else if(msg.cmd == PERIPH_BUTTON_RELEASE || msg.cmd == PERIPH_BUTTON_LONG_RELEASE){
-                    ESP_LOGI(TAG, "[ * ] Stop SR pipeline");
-
-                    char* response_text = google_sr_stop(sr);
-                    if (response_text == NULL) {
-                        continue;
-                    }
-                    ESP_LOGI(TAG, "response text = %s", response_text);
-                    vTaskDelay(2000 / portTICK_PERIOD_MS);
-                    ESP_LOGI(TAG, "TTS Start");
-                    google_tts_start(tts, response_text, GOOGLE_TTS_LANG);   
+                    sr_finish_and_arm_tts();
                 } 
-                else if ((int)msg.data == get_input_mode_id()) {
+                else if ((int)(intptr_t)msg.data == get_input_mode_id()) {
                     ESP_LOGI(TAG, "Mode button was pressed, exit now");
                     break;
                 }
@@ -154,6 +309,7 @@ void event_process_Task(void *pv)
     ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
     google_sr_destroy(sr);
     google_tts_destroy(tts);
+    google_translate_destroy(translator);
     // Stop all periph before removing the listener 
     esp_periph_set_stop_all(periph_set);
     audio_event_iface_remove_listener(esp_periph_set_get_event_iface(periph_set), evt_listener);
@@ -180,6 +336,7 @@ void app_main(void)
     wifi_init_start();                                  //Start wifi
     google_sr_init_start();                             //Initialize (i2s_read)->(http_write) audio pipeline for sr
     google_tts_init_start();                            //Initialize (http_write)->(mp3_decoder)->(i2s_write) audio pipeline for tts
+    google_translate_init_start();                      //Initialize the translation between sr and tts
     audio_event_listener_setup_start();                 //Init audio event listener and connect it to pipelines + peripherals
 
     xTaskCreate(event_process_Task, "event_process", 4 * 4096, NULL, 5, 0);  
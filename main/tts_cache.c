@@ -0,0 +1,626 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "tts_cache.h"
+
+static const char *TAG = "TTS_CACHE";
+
+#define TTS_CACHE_SECTOR_SIZE       (4096)
+#define TTS_CACHE_RECORD_MAGIC      (0x43535454)    /* "TTSC" */
+#define TTS_CACHE_VERIFY_CHUNK      (512)
+#define TTS_CACHE_READER_BUFFER_LEN (2048)
+
+/* Header at the start of the first sector of every flash record, the audio follows it */
+typedef struct {
+    uint32_t    magic;
+    uint32_t    seq;
+    uint64_t    key;
+    uint32_t    len;
+    uint32_t    data_crc;
+    uint32_t    reserved;
+    uint32_t    hdr_crc;        /* CRC of the fields above */
+} tts_cache_record_t;
+
+typedef struct {
+    uint64_t    key;
+    uint32_t    seq;
+    uint16_t    sector;
+    uint16_t    num_sectors;
+    uint32_t    len;
+} tts_cache_flash_entry_t;
+
+typedef struct {
+    uint64_t    key;
+    uint8_t     *data;
+    int         len;
+    uint32_t    last_use;
+    bool        dirty;          /* Not written to flash yet */
+    bool        pinned;         /* Open for reading */
+    bool        writing;        /* Being written to flash, the data is not freed */
+    bool        evicted;        /* Out of the LRU, only kept until it is written to flash */
+} tts_cache_mem_entry_t;
+
+typedef struct tts_cache {
+    SemaphoreHandle_t           lock;
+    SemaphoreHandle_t           write_lock;     /* One write-back at a time, flash is written without `lock` */
+    SemaphoreHandle_t           write_wake;
+    SemaphoreHandle_t           write_exit;
+    bool                        write_quit;
+    int                         mem_size;
+    int                         max_entry_size;
+    tts_cache_mem_entry_t       mem[TTS_CACHE_MEM_ENTRIES];
+    int                         mem_used;
+    uint32_t                    use_clock;
+    const esp_partition_t       *part;
+    tts_cache_flash_entry_t     *flash;
+    int                         flash_count;
+    int                         num_sectors;
+    int                         head;           /* Sector the next record is written at */
+    uint32_t                    seq;
+    tts_cache_mem_entry_t       *rd_mem;        /* Open entry, NULL for a flash record */
+    uint32_t                    rd_offset;
+    int                         rd_len;
+    int                         rd_pos;
+    bool                        rd_open;
+    uint64_t                    put_key;        /* Entry being collected */
+    uint8_t                     *put_buf;       /* max_entry_size, reserved at init */
+    int                         put_len;
+    bool                        putting;
+    tts_cache_stats_t           stats;
+} tts_cache_t;
+
+static uint32_t _record_crc(const tts_cache_record_t *rec)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)rec, offsetof(tts_cache_record_t, hdr_crc));
+}
+
+static int _record_sectors(int len)
+{
+    return (sizeof(tts_cache_record_t) + len + TTS_CACHE_SECTOR_SIZE - 1) / TTS_CACHE_SECTOR_SIZE;
+}
+
+static int _flash_find(tts_cache_t *cache, uint64_t key)
+{
+    int found = -1;
+    for (int i = 0; i < cache->flash_count; i++) {
+        if (cache->flash[i].key == key && (found < 0 || cache->flash[i].seq > cache->flash[found].seq)) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+static void _flash_remove(tts_cache_t *cache, int idx)
+{
+    cache->flash[idx] = cache->flash[--cache->flash_count];
+}
+
+static void _flash_drop_range(tts_cache_t *cache, int first, int count)
+{
+    for (int i = 0; i < cache->flash_count;) {
+        tts_cache_flash_entry_t *e = &cache->flash[i];
+        if (e->sector < first + count && e->sector + e->num_sectors > first) {
+            _flash_remove(cache, i);
+            cache->stats.flash_evictions++;
+            continue;
+        }
+        i++;
+    }
+}
+
+/*
+ * Take the sectors of a new record at the head of the log, with the lock held. The records they
+ * overlap are dropped from the index, the record itself is indexed once it is written.
+ */
+static esp_err_t _flash_reserve(tts_cache_t *cache, uint64_t key, int len, tts_cache_flash_entry_t *e)
+{
+    int n = _record_sectors(len);
+    if (n > cache->num_sectors) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    int first = cache->head + n > cache->num_sectors ? 0 : cache->head;
+    if (cache->rd_open && cache->rd_mem == NULL) {
+        /* The open record is read without the lock, it must not be erased under the reader */
+        int rd_first = cache->rd_offset / TTS_CACHE_SECTOR_SIZE;
+        if (first < rd_first + _record_sectors(cache->rd_len) && first + n > rd_first) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    _flash_drop_range(cache, first, n);
+    cache->head = (first + n) % cache->num_sectors;
+    *e = (tts_cache_flash_entry_t) {
+        .key = key,
+        .seq = cache->seq++,
+        .sector = first,
+        .num_sectors = n,
+        .len = len,
+    };
+    return ESP_OK;
+}
+
+static esp_err_t _flash_write(tts_cache_t *cache, const tts_cache_flash_entry_t *e, const uint8_t *data)
+{
+    uint32_t offset = e->sector * TTS_CACHE_SECTOR_SIZE;
+    /*
+     * Records are erased header first and the header is written last, so a record cut
+     * short by a reset is never seen as valid
+     */
+    if (esp_partition_erase_range(cache->part, offset, e->num_sectors * TTS_CACHE_SECTOR_SIZE) != ESP_OK
+            || esp_partition_write(cache->part, offset + sizeof(tts_cache_record_t), data, e->len) != ESP_OK) {
+        ESP_LOGE(TAG, "Error writing sector %d", e->sector);
+        return ESP_FAIL;
+    }
+    tts_cache_record_t rec = {
+        .magic = TTS_CACHE_RECORD_MAGIC,
+        .seq = e->seq,
+        .key = e->key,
+        .len = e->len,
+        .data_crc = esp_rom_crc32_le(0, data, e->len),
+    };
+    rec.hdr_crc = _record_crc(&rec);
+    if (esp_partition_write(cache->part, offset, &rec, sizeof(rec)) != ESP_OK) {
+        ESP_LOGE(TAG, "Error writing sector %d", e->sector);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void _flash_scan(tts_cache_t *cache)
+{
+    tts_cache_record_t rec;
+    bool found = false;
+    for (int s = 0; s < cache->num_sectors;) {
+        if (esp_partition_read(cache->part, s * TTS_CACHE_SECTOR_SIZE, &rec, sizeof(rec)) == ESP_OK
+                && rec.magic == TTS_CACHE_RECORD_MAGIC && rec.hdr_crc == _record_crc(&rec)
+                && s + _record_sectors(rec.len) <= cache->num_sectors) {
+            int n = _record_sectors(rec.len);
+            cache->flash[cache->flash_count++] = (tts_cache_flash_entry_t) {
+                .key = rec.key,
+                .seq = rec.seq,
+                .sector = s,
+                .num_sectors = n,
+                .len = rec.len,
+            };
+            /* The newest record ends where the log continues */
+            if (!found || rec.seq >= cache->seq) {
+                found = true;
+                cache->seq = rec.seq + 1;
+                cache->head = (s + n) % cache->num_sectors;
+            }
+            s += n;
+            continue;
+        }
+        s++;
+    }
+}
+
+static bool _flash_verify(tts_cache_t *cache, const tts_cache_flash_entry_t *e)
+{
+    uint8_t chunk[TTS_CACHE_VERIFY_CHUNK];
+    tts_cache_record_t rec;
+    uint32_t offset = e->sector * TTS_CACHE_SECTOR_SIZE;
+    if (esp_partition_read(cache->part, offset, &rec, sizeof(rec)) != ESP_OK) {
+        return false;
+    }
+    uint32_t crc = 0;
+    offset += sizeof(rec);
+    for (uint32_t pos = 0; pos < e->len;) {
+        int n = e->len - pos < sizeof(chunk) ? e->len - pos : sizeof(chunk);
+        if (esp_partition_read(cache->part, offset + pos, chunk, n) != ESP_OK) {
+            return false;
+        }
+        crc = esp_rom_crc32_le(crc, chunk, n);
+        pos += n;
+    }
+    return crc == rec.data_crc;
+}
+
+static void _mem_free(tts_cache_mem_entry_t *e)
+{
+    audio_free(e->data);
+    memset(e, 0, sizeof(tts_cache_mem_entry_t));
+}
+
+static bool _mem_evict_one(tts_cache_t *cache)
+{
+    tts_cache_mem_entry_t *lru = NULL;
+    for (int i = 0; i < TTS_CACHE_MEM_ENTRIES; i++) {
+        tts_cache_mem_entry_t *e = &cache->mem[i];
+        if (e->data && !e->pinned && !e->evicted && (lru == NULL || (int32_t)(e->last_use - lru->last_use) < 0)) {
+            lru = e;
+        }
+    }
+    if (lru == NULL) {
+        return false;
+    }
+    cache->mem_used -= lru->len;
+    cache->stats.evictions++;
+    if (lru->dirty || lru->writing) {
+        /* Not synced yet, the next write-back spills it to flash and frees it */
+        lru->evicted = true;
+    } else {
+        _mem_free(lru);
+    }
+    return true;
+}
+
+/* Write the entries only held in RAM to flash, the lock is only taken between flash operations */
+static esp_err_t _write_back(tts_cache_t *cache)
+{
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(cache->write_lock, portMAX_DELAY);
+    while (ret == ESP_OK) {
+        tts_cache_mem_entry_t *e = NULL;
+        tts_cache_flash_entry_t rec;
+        xSemaphoreTake(cache->lock, portMAX_DELAY);
+        for (int i = 0; i < TTS_CACHE_MEM_ENTRIES && e == NULL; i++) {
+            if (cache->mem[i].data && cache->mem[i].dirty) {
+                e = &cache->mem[i];
+            }
+        }
+        if (e == NULL) {
+            xSemaphoreGive(cache->lock);
+            break;
+        }
+        ret = _flash_reserve(cache, e->key, e->len, &rec);
+        if (ret == ESP_ERR_INVALID_SIZE) {
+            /* Larger than the partition, it is only kept in RAM */
+            e->dirty = false;
+            if (e->evicted) {
+                _mem_free(e);
+            }
+            ret = ESP_OK;
+        }
+        bool write = ret == ESP_OK && e->dirty;
+        e->writing = write;
+        xSemaphoreGive(cache->lock);
+        if (!write) {
+            continue;
+        }
+
+        ret = _flash_write(cache, &rec, e->data);
+        xSemaphoreTake(cache->lock, portMAX_DELAY);
+        e->writing = false;
+        if (ret == ESP_OK) {
+            cache->flash[cache->flash_count++] = rec;
+            cache->stats.flash_writes++;
+            e->dirty = false;
+        }
+        if (e->evicted) {
+            /* Written or lost, it is not kept any longer */
+            _mem_free(e);
+        }
+        xSemaphoreGive(cache->lock);
+    }
+    xSemaphoreGive(cache->write_lock);
+    return ret;
+}
+
+static void _write_task(void *pv)
+{
+    tts_cache_t *cache = (tts_cache_t *)pv;
+    while (1) {
+        xSemaphoreTake(cache->write_wake, portMAX_DELAY);
+        if (cache->write_quit) {
+            break;
+        }
+        _write_back(cache);
+    }
+    xSemaphoreGive(cache->write_exit);
+    vTaskDelete(NULL);
+}
+
+static tts_cache_mem_entry_t *_mem_free_slot(tts_cache_t *cache)
+{
+    for (int i = 0; i < TTS_CACHE_MEM_ENTRIES; i++) {
+        if (cache->mem[i].data == NULL) {
+            return &cache->mem[i];
+        }
+    }
+    return NULL;
+}
+
+uint64_t tts_cache_key(const char *text, const char *lang_code, const char *encoding, int sample_rate)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const char *parts[3] = { text, lang_code, encoding };
+    for (int i = 0; i < 3; i++) {
+        /* The terminator separates the fields */
+        const char *p = parts[i];
+        do {
+            hash = (hash ^ (uint8_t)*p) * 0x100000001b3ULL;
+        } while (*p++);
+    }
+    for (int i = 0; i < 4; i++) {
+        hash = (hash ^ (uint8_t)(sample_rate >> (8 * i))) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+esp_err_t tts_cache_open(tts_cache_handle_t cache, uint64_t key)
+{
+    tts_cache_close(cache);
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    for (int i = 0; i < TTS_CACHE_MEM_ENTRIES; i++) {
+        tts_cache_mem_entry_t *e = &cache->mem[i];
+        if (e->data && !e->evicted && e->key == key) {
+            e->pinned = true;
+            e->last_use = ++cache->use_clock;
+            cache->rd_mem = e;
+            cache->rd_len = e->len;
+            cache->stats.mem_hits++;
+            goto _cache_opened;
+        }
+    }
+    int idx = cache->part ? _flash_find(cache, key) : -1;
+    if (idx >= 0 && !_flash_verify(cache, &cache->flash[idx])) {
+        ESP_LOGW(TAG, "Corrupted record at sector %d", cache->flash[idx].sector);
+        _flash_remove(cache, idx);
+        idx = -1;
+    }
+    if (idx < 0) {
+        cache->stats.misses++;
+        xSemaphoreGive(cache->lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+    cache->rd_offset = cache->flash[idx].sector * TTS_CACHE_SECTOR_SIZE + sizeof(tts_cache_record_t);
+    cache->rd_len = cache->flash[idx].len;
+    cache->stats.flash_hits++;
+_cache_opened:
+    cache->rd_pos = 0;
+    cache->rd_open = true;
+    xSemaphoreGive(cache->lock);
+    return ESP_OK;
+}
+
+int tts_cache_read(tts_cache_handle_t cache, uint8_t *buffer, int len)
+{
+    if (!cache->rd_open) {
+        return 0;
+    }
+    if (len > cache->rd_len - cache->rd_pos) {
+        len = cache->rd_len - cache->rd_pos;
+    }
+    if (cache->rd_mem) {
+        memcpy(buffer, cache->rd_mem->data + cache->rd_pos, len);
+    } else if (len > 0 && esp_partition_read(cache->part, cache->rd_offset + cache->rd_pos, buffer, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    cache->rd_pos += len;
+    return len;
+}
+
+void tts_cache_close(tts_cache_handle_t cache)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    if (cache->rd_mem) {
+        cache->rd_mem->pinned = false;
+        cache->rd_mem = NULL;
+    }
+    cache->rd_open = false;
+    xSemaphoreGive(cache->lock);
+}
+
+void tts_cache_put_begin(tts_cache_handle_t cache, uint64_t key)
+{
+    cache->put_len = 0;
+    cache->put_key = key;
+    cache->putting = true;
+}
+
+void tts_cache_put_data(tts_cache_handle_t cache, const void *data, int len)
+{
+    if (!cache->putting) {
+        return;
+    }
+    if (cache->put_len + len > cache->max_entry_size) {
+        ESP_LOGD(TAG, "Entry larger than %d, not cached", cache->max_entry_size);
+        tts_cache_put_end(cache, false);
+        return;
+    }
+    memcpy(cache->put_buf + cache->put_len, data, len);
+    cache->put_len += len;
+}
+
+void tts_cache_put_end(tts_cache_handle_t cache, bool commit)
+{
+    if (!cache->putting) {
+        return;
+    }
+    cache->putting = false;
+    int len = cache->put_len;
+    if (!commit || len == 0 || len > cache->mem_size) {
+        return;
+    }
+    /* Sized once the length is known, the staging buffer is kept for the next entry */
+    uint8_t *data = audio_malloc(len);
+    AUDIO_MEM_CHECK(TAG, data, return);
+    memcpy(data, cache->put_buf, len);
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    tts_cache_mem_entry_t *slot;
+    while (cache->mem_used + len > cache->mem_size || (slot = _mem_free_slot(cache)) == NULL) {
+        if (!_mem_evict_one(cache)) {
+            xSemaphoreGive(cache->lock);
+            audio_free(data);
+            return;
+        }
+    }
+    slot->key = cache->put_key;
+    slot->data = data;
+    slot->len = len;
+    slot->last_use = ++cache->use_clock;
+    slot->dirty = cache->part != NULL;
+    cache->mem_used += len;
+    xSemaphoreGive(cache->lock);
+    ESP_LOGD(TAG, "Cached %d bytes, %d/%d used", len, cache->mem_used, cache->mem_size);
+}
+
+esp_err_t tts_cache_sync(tts_cache_handle_t cache)
+{
+    if (cache->part == NULL) {
+        return ESP_OK;
+    }
+    return _write_back(cache);
+}
+
+void tts_cache_sync_start(tts_cache_handle_t cache)
+{
+    if (cache->write_wake) {
+        xSemaphoreGive(cache->write_wake);
+    }
+}
+
+void tts_cache_get_stats(tts_cache_handle_t cache, tts_cache_stats_t *stats)
+{
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    *stats = cache->stats;
+    stats->mem_used = cache->mem_used;
+    stats->mem_entries = 0;
+    for (int i = 0; i < TTS_CACHE_MEM_ENTRIES; i++) {
+        stats->mem_entries += cache->mem[i].data != NULL && !cache->mem[i].evicted;
+    }
+    stats->flash_entries = cache->flash_count;
+    xSemaphoreGive(cache->lock);
+}
+
+tts_cache_handle_t tts_cache_init(tts_cache_cfg_t *config)
+{
+    tts_cache_t *cache = audio_calloc(1, sizeof(tts_cache_t));
+    AUDIO_MEM_CHECK(TAG, cache, return NULL);
+    cache->lock = xSemaphoreCreateMutex();
+    cache->write_lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, cache->lock && cache->write_lock, goto _cache_init_exit);
+    cache->mem_size = config->mem_size > 0 ? config->mem_size : TTS_CACHE_MEM_SIZE;
+    cache->max_entry_size = config->max_entry_size > 0 ? config->max_entry_size : TTS_CACHE_MAX_ENTRY_SIZE;
+    cache->put_buf = audio_malloc(cache->max_entry_size);
+    AUDIO_MEM_CHECK(TAG, cache->put_buf, goto _cache_init_exit);
+
+    const char *label = config->partition_label ? config->partition_label : TTS_CACHE_PARTITION_LABEL;
+    cache->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (cache->part == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" partition, audio is only cached in RAM", label);
+        return cache;
+    }
+    cache->num_sectors = cache->part->size / TTS_CACHE_SECTOR_SIZE;
+    cache->flash = audio_calloc(cache->num_sectors, sizeof(tts_cache_flash_entry_t));
+    AUDIO_MEM_CHECK(TAG, cache->flash, goto _cache_init_exit);
+    _flash_scan(cache);
+    ESP_LOGI(TAG, "%d entries in flash, next sector %d", cache->flash_count, cache->head);
+
+    cache->write_wake = xSemaphoreCreateBinary();
+    cache->write_exit = xSemaphoreCreateBinary();
+    AUDIO_MEM_CHECK(TAG, cache->write_wake && cache->write_exit, goto _cache_init_exit);
+    int task_stack = config->task_stack > 0 ? config->task_stack : TTS_CACHE_TASK_STACK;
+    if (xTaskCreate(_write_task, "tts_cache", task_stack, cache, TTS_CACHE_TASK_PRIO, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Error create tts_cache task");
+        vSemaphoreDelete(cache->write_exit);
+        cache->write_exit = NULL;
+        goto _cache_init_exit;
+    }
+    return cache;
+_cache_init_exit:
+    tts_cache_destroy(cache);
+    return NULL;
+}
+
+void tts_cache_destroy(tts_cache_handle_t cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    if (cache->write_exit) {
+        cache->write_quit = true;
+        xSemaphoreGive(cache->write_wake);
+        xSemaphoreTake(cache->write_exit, portMAX_DELAY);
+        vSemaphoreDelete(cache->write_exit);
+    }
+    if (cache->write_wake) {
+        vSemaphoreDelete(cache->write_wake);
+    }
+    if (cache->write_lock) {
+        vSemaphoreDelete(cache->write_lock);
+    }
+    for (int i = 0; i < TTS_CACHE_MEM_ENTRIES; i++) {
+        audio_free(cache->mem[i].data);
+    }
+    audio_free(cache->put_buf);
+    audio_free(cache->flash);
+    if (cache->lock) {
+        vSemaphoreDelete(cache->lock);
+    }
+    audio_free(cache);
+}
+
+static audio_element_err_t _cache_reader_read(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    tts_cache_handle_t cache = (tts_cache_handle_t)audio_element_getdata(self);
+    return tts_cache_read(cache, (uint8_t *)buffer, len);
+}
+
+static audio_element_err_t _cache_reader_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    return audio_element_output(self, in_buffer, r_size);
+}
+
+static esp_err_t _cache_reader_open(audio_element_handle_t self)
+{
+    return ESP_OK;
+}
+
+static esp_err_t _cache_reader_close(audio_element_handle_t self)
+{
+    tts_cache_close((tts_cache_handle_t)audio_element_getdata(self));
+    return ESP_OK;
+}
+
+audio_element_handle_t tts_cache_reader_init(tts_cache_handle_t cache)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _cache_reader_open;
+    cfg.close = _cache_reader_close;
+    cfg.process = _cache_reader_process;
+    cfg.read = _cache_reader_read;
+    cfg.buffer_len = TTS_CACHE_READER_BUFFER_LEN;
+    cfg.task_stack = TTS_CACHE_READER_TASK_STACK;
+    cfg.tag = "tts_cache";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, return NULL);
+    audio_element_setdata(el, cache);
+    return el;
+}
@@ -0,0 +1,191 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _TTS_CACHE_H_
+#define _TTS_CACHE_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TTS_CACHE_PARTITION_LABEL   "tts_cache"
+#define TTS_CACHE_MEM_SIZE          (256*1024)
+#define TTS_CACHE_MEM_ENTRIES       (16)
+#define TTS_CACHE_MAX_ENTRY_SIZE    (64*1024)
+#define TTS_CACHE_READER_TASK_STACK (3*1024)
+#define TTS_CACHE_TASK_STACK        (3*1024)
+#define TTS_CACHE_TASK_PRIO         (3)
+
+typedef struct tts_cache* tts_cache_handle_t;
+
+/**
+ * TTS audio cache configurations
+ */
+typedef struct {
+    int         mem_size;           /*!< PSRAM used by the LRU tier, 0 for TTS_CACHE_MEM_SIZE */
+    int         max_entry_size;     /*!< Larger audio is not cached, reserved at init to collect entries, 0 for TTS_CACHE_MAX_ENTRY_SIZE */
+    const char  *partition_label;   /*!< Flash tier partition, NULL for TTS_CACHE_PARTITION_LABEL */
+    int         task_stack;         /*!< Flash write-back task stack size, 0 for TTS_CACHE_TASK_STACK */
+} tts_cache_cfg_t;
+
+/**
+ * TTS audio cache counters
+ */
+typedef struct {
+    uint32_t    mem_hits;           /*!< Lookups served from PSRAM */
+    uint32_t    flash_hits;         /*!< Lookups served from flash */
+    uint32_t    misses;             /*!< Lookups that found nothing */
+    uint32_t    evictions;          /*!< Entries dropped from PSRAM to make room */
+    uint32_t    flash_writes;       /*!< Entries written to flash */
+    uint32_t    flash_evictions;    /*!< Flash records overwritten by newer ones */
+    int         mem_used;           /*!< Bytes of audio held in PSRAM */
+    int         mem_entries;        /*!< Entries held in PSRAM */
+    int         flash_entries;      /*!< Valid records in flash */
+} tts_cache_stats_t;
+
+/**
+ * @brief      Create the cache
+ *
+ *             Audio is kept in a PSRAM LRU. Entries are written to the flash partition by
+ *             tts_cache_sync or tts_cache_sync_start (entries evicted before that are kept
+ *             until then), where they are stored as a circular log so that every sector is
+ *             erased equally often, and are found again after a reboot. Without the partition
+ *             only the PSRAM tier is used.
+ *
+ * @param      config  The configuration
+ *
+ * @return     The cache handle
+ */
+tts_cache_handle_t tts_cache_init(tts_cache_cfg_t *config);
+
+/**
+ * @brief      Destroy the cache, entries not synced to flash are lost
+ *
+ * @param      cache  The cache handle
+ */
+void tts_cache_destroy(tts_cache_handle_t cache);
+
+/**
+ * @brief      Compute the cache key of a synthesis request
+ *
+ * @param[in]  text         The text
+ * @param[in]  lang_code    The language code
+ * @param[in]  encoding     The audio encoding name
+ * @param[in]  sample_rate  The sample rate
+ *
+ * @return     64-bit FNV-1a hash of the four
+ */
+uint64_t tts_cache_key(const char *text, const char *lang_code, const char *encoding, int sample_rate);
+
+/**
+ * @brief      Look up an entry and open it for tts_cache_read, only one entry is open at a time
+ *
+ * @param      cache  The cache handle
+ * @param[in]  key    The key
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NOT_FOUND
+ */
+esp_err_t tts_cache_open(tts_cache_handle_t cache, uint64_t key);
+
+/**
+ * @brief      Read the open entry
+ *
+ * @return     Bytes read, 0 at the end of the entry
+ */
+int tts_cache_read(tts_cache_handle_t cache, uint8_t *buffer, int len);
+
+/**
+ * @brief      Close the open entry
+ */
+void tts_cache_close(tts_cache_handle_t cache);
+
+/**
+ * @brief      Start collecting the audio of a new entry, a collection that was not ended is dropped
+ *
+ * @param      cache  The cache handle
+ * @param[in]  key    The key
+ */
+void tts_cache_put_begin(tts_cache_handle_t cache, uint64_t key);
+
+/**
+ * @brief      Append audio to the entry being collected, it is dropped if it grows too large
+ */
+void tts_cache_put_data(tts_cache_handle_t cache, const void *data, int len);
+
+/**
+ * @brief      Finish collecting, insert the entry if `commit` is set, evicting the least
+ *             recently used entries as needed
+ */
+void tts_cache_put_end(tts_cache_handle_t cache, bool commit);
+
+/**
+ * @brief      Write the entries only held in PSRAM to flash, call it while nothing is playing
+ *
+ *             Lookups and inserts are not blocked by the flash writes, only the sectors of
+ *             an open flash entry are not overwritten.
+ *
+ * @param      cache  The cache handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_STATE  The log reached the open entry, the rest is written by a later sync
+ *     - ESP_FAIL
+ */
+esp_err_t tts_cache_sync(tts_cache_handle_t cache);
+
+/**
+ * @brief      Run tts_cache_sync on the cache task and return at once
+ *
+ * @param      cache  The cache handle
+ */
+void tts_cache_sync_start(tts_cache_handle_t cache);
+
+/**
+ * @brief      Get the cache counters
+ *
+ * @param      cache  The cache handle
+ * @param[out] stats  The counters
+ */
+void tts_cache_get_stats(tts_cache_handle_t cache, tts_cache_stats_t *stats);
+
+/**
+ * @brief      Create an audio element that outputs the entry opened with tts_cache_open
+ *
+ * @param      cache  The cache handle
+ *
+ * @return     The audio element handle
+ */
+audio_element_handle_t tts_cache_reader_init(tts_cache_handle_t cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_element.h"
+#include "audio_common.h"
+#include "audio_mem.h"
+#include "vad_filter.h"
+
+static const char *TAG = "VAD_FILTER";
+
+/* Noise floor never drops below this mean square (about -60 dBFS) */
+#define VAD_MIN_NOISE_FLOOR     (1000)
+/* Loud frames are speech regardless of the zero-crossing rate */
+#define VAD_LOUD_RATIO          (8)
+/* Moderately raised frames are speech only when they look voiced */
+#define VAD_VOICED_RATIO        (3)
+#define VAD_VOICED_ZCR_PCT      (25)
+
+typedef enum {
+    VAD_STATE_SILENCE = 0,
+    VAD_STATE_SPEECH,
+    VAD_STATE_ENDED,
+} vad_state_t;
+
+typedef struct vad_filter {
+    int                 sample_rate;
+    int                 hangover_frames;
+    int                 lookback_frames;
+    bool                auto_stop;
+    vad_filter_event_cb on_event;
+    void                *user_ctx;
+    int                 frame_samples;
+    int16_t             *frame;
+    int                 frame_fill;
+    int16_t             *lookback;      /* Ring of the frames seen before the onset was confirmed */
+    int                 lookback_head;
+    int                 lookback_count;
+    vad_state_t         state;
+    int                 onset_count;
+    int                 hang_left;
+    uint32_t            noise_floor;
+    bool                floor_ready;
+} vad_filter_t;
+
+static bool _classify(vad_filter_t *vad, const int16_t *x, int n)
+{
+    uint64_t sum = 0;
+    int zc = 0;
+    for (int i = 0; i < n; i++) {
+        sum += (int32_t)x[i] * x[i];
+    }
+    for (int i = 1; i < n; i++) {
+        zc += (x[i - 1] ^ x[i]) < 0;
+    }
+    uint32_t energy = (uint32_t)(sum / n);
+    if (!vad->floor_ready) {
+        vad->noise_floor = energy > VAD_MIN_NOISE_FLOOR ? energy : VAD_MIN_NOISE_FLOOR;
+        vad->floor_ready = true;
+    }
+
+    uint64_t floor = vad->noise_floor;
+    bool speech = energy > floor * VAD_LOUD_RATIO
+                  || (energy > floor * VAD_VOICED_RATIO && zc * 100 < n * VAD_VOICED_ZCR_PCT);
+    if (!speech) {
+        /* Follow the floor down quickly and up slowly */
+        if (energy < vad->noise_floor) {
+            vad->noise_floor -= (vad->noise_floor - energy) / 4;
+        } else {
+            vad->noise_floor += (energy - vad->noise_floor) / 32;
+        }
+        if (vad->noise_floor < VAD_MIN_NOISE_FLOOR) {
+            vad->noise_floor = VAD_MIN_NOISE_FLOOR;
+        }
+    }
+    return speech;
+}
+
+static void _lookback_push(vad_filter_t *vad)
+{
+    memcpy(vad->lookback + vad->lookback_head * vad->frame_samples, vad->frame, vad->frame_samples * sizeof(int16_t));
+    vad->lookback_head = (vad->lookback_head + 1) % vad->lookback_frames;
+    if (vad->lookback_count < vad->lookback_frames) {
+        vad->lookback_count++;
+    }
+}
+
+static int _lookback_flush(audio_element_handle_t self, vad_filter_t *vad)
+{
+    int first = (vad->lookback_head + vad->lookback_frames - vad->lookback_count) % vad->lookback_frames;
+    int frame_bytes = vad->frame_samples * sizeof(int16_t);
+    for (int i = 0; i < vad->lookback_count; i++) {
+        int idx = (first + i) % vad->lookback_frames;
+        int ret = audio_element_output(self, (char *)(vad->lookback + idx * vad->frame_samples), frame_bytes);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    vad->lookback_count = 0;
+    return ESP_OK;
+}
+
+static void _notify(vad_filter_t *vad, vad_filter_event_t event)
+{
+    ESP_LOGD(TAG, "%s", event == VAD_FILTER_SPEECH_START ? "Speech start" : "Speech end");
+    if (vad->on_event) {
+        vad->on_event(event, vad->user_ctx);
+    }
+}
+
+static esp_err_t _vad_open(audio_element_handle_t self)
+{
+    vad_filter_t *vad = (vad_filter_t *)audio_element_getdata(self);
+    vad->frame_fill = 0;
+    vad->lookback_head = 0;
+    vad->lookback_count = 0;
+    vad->state = VAD_STATE_SILENCE;
+    vad->onset_count = 0;
+    vad->floor_ready = false;
+    return ESP_OK;
+}
+
+static esp_err_t _vad_close(audio_element_handle_t self)
+{
+    vad_filter_t *vad = (vad_filter_t *)audio_element_getdata(self);
+    if (vad->state == VAD_STATE_SPEECH) {
+        _notify(vad, VAD_FILTER_SPEECH_END);
+    }
+    vad->state = VAD_STATE_SILENCE;
+    return ESP_OK;
+}
+
+static audio_element_err_t _vad_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    vad_filter_t *vad = (vad_filter_t *)audio_element_getdata(self);
+    int frame_bytes = vad->frame_samples * sizeof(int16_t);
+    if (vad->state == VAD_STATE_ENDED) {
+        return AEL_IO_DONE;
+    }
+    int r_size = audio_element_input(self, (char *)vad->frame + vad->frame_fill, frame_bytes - vad->frame_fill);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    vad->frame_fill += r_size;
+    if (vad->frame_fill < frame_bytes) {
+        return r_size;
+    }
+    vad->frame_fill = 0;
+
+    bool speech = _classify(vad, vad->frame, vad->frame_samples);
+    int ret = r_size;
+    if (vad->state == VAD_STATE_SILENCE) {
+        _lookback_push(vad);
+        vad->onset_count = speech ? vad->onset_count + 1 : 0;
+        if (vad->onset_count >= VAD_FILTER_ONSET_FRAMES) {
+            vad->state = VAD_STATE_SPEECH;
+            vad->hang_left = vad->hangover_frames;
+            _notify(vad, VAD_FILTER_SPEECH_START);
+            ret = _lookback_flush(self, vad);
+        }
+        return ret < 0 ? ret : r_size;
+    }
+
+    ret = audio_element_output(self, (char *)vad->frame, frame_bytes);
+    if (ret < 0) {
+        return ret;
+    }
+    if (speech) {
+        vad->hang_left = vad->hangover_frames;
+    } else if (--vad->hang_left <= 0) {
+        _notify(vad, VAD_FILTER_SPEECH_END);
+        vad->onset_count = 0;
+        vad->lookback_count = 0;
+        if (vad->auto_stop) {
+            vad->state = VAD_STATE_ENDED;
+            return AEL_IO_DONE;
+        }
+        vad->state = VAD_STATE_SILENCE;
+    }
+    return r_size;
+}
+
+static esp_err_t _vad_destroy(audio_element_handle_t self)
+{
+    vad_filter_t *vad = (vad_filter_t *)audio_element_getdata(self);
+    audio_free(vad->frame);
+    audio_free(vad->lookback);
+    audio_free(vad);
+    return ESP_OK;
+}
+
+audio_element_handle_t vad_filter_init(vad_filter_cfg_t *config)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    audio_element_handle_t el;
+    vad_filter_t *vad = audio_calloc(1, sizeof(vad_filter_t));
+    AUDIO_MEM_CHECK(TAG, vad, return NULL);
+
+    int hangover_ms = config->hangover_ms > 0 ? config->hangover_ms : VAD_FILTER_HANGOVER_MS;
+    int pre_speech_ms = config->pre_speech_ms > 0 ? config->pre_speech_ms : VAD_FILTER_PRE_SPEECH_MS;
+    vad->sample_rate = config->sample_rate > 0 ? config->sample_rate : 16000;
+    vad->frame_samples = vad->sample_rate * VAD_FILTER_FRAME_MS / 1000;
+    vad->hangover_frames = hangover_ms / VAD_FILTER_FRAME_MS;
+    vad->lookback_frames = pre_speech_ms / VAD_FILTER_FRAME_MS + VAD_FILTER_ONSET_FRAMES;
+    vad->auto_stop = config->auto_stop;
+    vad->on_event = config->on_event;
+    vad->user_ctx = config->user_ctx;
+    vad->frame = audio_malloc(vad->frame_samples * sizeof(int16_t));
+    vad->lookback = audio_malloc(vad->lookback_frames * vad->frame_samples * sizeof(int16_t));
+    AUDIO_MEM_CHECK(TAG, vad->frame && vad->lookback, goto _vad_init_exit);
+
+    cfg.open = _vad_open;
+    cfg.close = _vad_close;
+    cfg.process = _vad_process;
+    cfg.destroy = _vad_destroy;
+    cfg.task_stack = config->task_stack > 0 ? config->task_stack : VAD_FILTER_TASK_STACK;
+    cfg.tag = "vad";
+    el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, goto _vad_init_exit);
+    audio_element_setdata(el, vad);
+    return el;
+_vad_init_exit:
+    audio_free(vad->frame);
+    audio_free(vad->lookback);
+    audio_free(vad);
+    return NULL;
+}
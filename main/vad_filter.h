@@ -0,0 +1,79 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _VAD_FILTER_H_
+#define _VAD_FILTER_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VAD_FILTER_FRAME_MS         (20)
+#define VAD_FILTER_ONSET_FRAMES     (3)
+#define VAD_FILTER_PRE_SPEECH_MS    (200)
+#define VAD_FILTER_HANGOVER_MS      (700)
+#define VAD_FILTER_TASK_STACK       (3*1024)
+
+typedef enum {
+    VAD_FILTER_SPEECH_START = 1,    /*!< First speech frame, after the onset confirmation */
+    VAD_FILTER_SPEECH_END,          /*!< Hangover expired after the last speech frame */
+} vad_filter_event_t;
+
+typedef void (*vad_filter_event_cb)(vad_filter_event_t event, void *ctx);
+
+/**
+ * Voice activity detection filter configurations
+ */
+typedef struct {
+    int                 sample_rate;    /*!< Sample rate of the 16-bit mono input */
+    int                 hangover_ms;    /*!< Silence after speech before it is considered ended, 0 for default */
+    int                 pre_speech_ms;  /*!< Audio kept from before the onset, 0 for default */
+    bool                auto_stop;      /*!< Finish the stream at the end of speech */
+    int                 task_stack;     /*!< Element task stack size */
+    vad_filter_event_cb on_event;       /*!< Speech start/end notification */
+    void                *user_ctx;      /*!< Context passed to `on_event` */
+} vad_filter_cfg_t;
+
+/**
+ * @brief      Create an audio element that drops silence around speech
+ *
+ *             Frames are classified with short-time energy against an adaptive noise floor
+ *             and zero-crossing rate. Nothing is output before speech starts (except the
+ *             `pre_speech_ms` lookback), and trailing silence after the hangover is dropped,
+ *             or ends the stream with `auto_stop`.
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle
+ */
+audio_element_handle_t vad_filter_init(vad_filter_cfg_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
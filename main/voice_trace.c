@@ -0,0 +1,205 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "voice_trace.h"
+
+static const char *TAG = "VOICE_TRACE";
+
+#if VOICE_TRACE_ENABLE
+
+static const char *stage_names[VOICE_TRACE_STAGE_MAX] = {
+    [VOICE_TRACE_BUTTON_PRESS]      = "button press",
+    [VOICE_TRACE_SR_FIRST_FRAME]    = "sr first frame",
+    [VOICE_TRACE_SR_CONNECTED]      = "sr connected",
+    [VOICE_TRACE_SR_FIRST_CHUNK]    = "sr first chunk",
+    [VOICE_TRACE_BUTTON_RELEASE]    = "button release",
+    [VOICE_TRACE_SR_LAST_CHUNK]     = "sr last chunk",
+    [VOICE_TRACE_SR_FIRST_RESPONSE] = "sr first response",
+    [VOICE_TRACE_SR_TRANSCRIPT]     = "sr transcript",
+    [VOICE_TRACE_TRANSLATE_SENT]    = "translate sent",
+    [VOICE_TRACE_TRANSLATE_DONE]    = "translate done",
+    [VOICE_TRACE_TTS_REQUEST_SENT]  = "tts request sent",
+    [VOICE_TRACE_TTS_FIRST_BYTE]    = "tts first byte",
+    [VOICE_TRACE_TTS_FIRST_SAMPLE]  = "tts first sample",
+    [VOICE_TRACE_TTS_DONE]          = "tts done",
+};
+
+/* Writers claim a slot with an atomic increment, the sequence number tells readers the slot is complete */
+static voice_trace_record_t s_ring[VOICE_TRACE_RECORDS];
+static uint32_t s_ring_seq[VOICE_TRACE_RECORDS];
+static uint32_t s_head;
+static uint32_t s_last[VOICE_TRACE_STAGE_MAX];
+static uint32_t s_marked;
+
+static void _trace_record(voice_trace_stage_t stage, uint16_t arg)
+{
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    uint32_t seq = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    uint32_t slot = seq & (VOICE_TRACE_RECORDS - 1);
+    __atomic_store_n(&s_ring_seq[slot], 0, __ATOMIC_RELAXED);
+    /* The cleared sequence number is seen before any of the new record */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    s_ring[slot].time_us = now;
+    s_ring[slot].stage = stage;
+    s_ring[slot].reserved = 0;
+    s_ring[slot].arg = arg;
+    __atomic_store_n(&s_ring_seq[slot], seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&s_last[stage], now, __ATOMIC_RELAXED);
+}
+
+void voice_trace_mark(voice_trace_stage_t stage, uint16_t arg)
+{
+    if ((unsigned)stage >= VOICE_TRACE_STAGE_MAX) {
+        return;
+    }
+    if (stage == VOICE_TRACE_BUTTON_PRESS) {
+        __atomic_store_n(&s_marked, 1u << stage, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_or(&s_marked, 1u << stage, __ATOMIC_RELAXED);
+    }
+    _trace_record(stage, arg);
+}
+
+void voice_trace_mark_once(voice_trace_stage_t stage, uint16_t arg)
+{
+    if ((unsigned)stage >= VOICE_TRACE_STAGE_MAX) {
+        return;
+    }
+    if (__atomic_fetch_or(&s_marked, 1u << stage, __ATOMIC_RELAXED) & (1u << stage)) {
+        return;
+    }
+    _trace_record(stage, arg);
+}
+
+esp_err_t voice_trace_get(voice_trace_stage_t stage, uint32_t *time_us)
+{
+    if ((unsigned)stage >= VOICE_TRACE_STAGE_MAX
+            || !(__atomic_load_n(&s_marked, __ATOMIC_RELAXED) & (1u << stage))) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *time_us = __atomic_load_n(&s_last[stage], __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+int voice_trace_read(voice_trace_record_t *records, int max)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    uint32_t seq = head > VOICE_TRACE_RECORDS ? head - VOICE_TRACE_RECORDS : 0;
+    int count = 0;
+    for (; seq < head && count < max; seq++) {
+        uint32_t slot = seq & (VOICE_TRACE_RECORDS - 1);
+        if (__atomic_load_n(&s_ring_seq[slot], __ATOMIC_ACQUIRE) != seq + 1) {
+            continue;
+        }
+        records[count] = s_ring[slot];
+        /* The copy is done before the sequence number is read again, or a torn record could pass */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        /* Overwritten while copying */
+        if (__atomic_load_n(&s_ring_seq[slot], __ATOMIC_ACQUIRE) != seq + 1) {
+            continue;
+        }
+        count++;
+    }
+    return count;
+}
+
+int voice_trace_dump(uint8_t *buffer, int size)
+{
+    voice_trace_record_t records[VOICE_TRACE_RECORDS];
+    int max = (size - 4) / 8;
+    if (max <= 0) {
+        return 0;
+    }
+    int count = voice_trace_read(records, max < VOICE_TRACE_RECORDS ? max : VOICE_TRACE_RECORDS);
+    uint8_t *p = buffer;
+    *p++ = VOICE_TRACE_DUMP_MAGIC & 0xFF;
+    *p++ = VOICE_TRACE_DUMP_MAGIC >> 8;
+    *p++ = VOICE_TRACE_DUMP_VERSION;
+    *p++ = count;
+    for (int i = 0; i < count; i++) {
+        uint32_t t = records[i].time_us;
+        *p++ = t;
+        *p++ = t >> 8;
+        *p++ = t >> 16;
+        *p++ = t >> 24;
+        *p++ = records[i].stage;
+        *p++ = records[i].reserved;
+        *p++ = records[i].arg;
+        *p++ = records[i].arg >> 8;
+    }
+    return p - buffer;
+}
+
+void voice_trace_log_summary(void)
+{
+    uint32_t start, prev, t;
+    if (voice_trace_get(VOICE_TRACE_BUTTON_PRESS, &start) != ESP_OK) {
+        return;
+    }
+    prev = start;
+    for (int stage = VOICE_TRACE_BUTTON_PRESS + 1; stage < VOICE_TRACE_STAGE_MAX; stage++) {
+        if (voice_trace_get(stage, &t) != ESP_OK) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-18s +%6u ms (%+6d ms)", stage_names[stage],
+                 (unsigned)((t - start) / 1000), (int)(t - prev) / 1000);
+        prev = t;
+    }
+}
+
+#else
+
+void voice_trace_mark(voice_trace_stage_t stage, uint16_t arg)
+{
+}
+
+void voice_trace_mark_once(voice_trace_stage_t stage, uint16_t arg)
+{
+}
+
+esp_err_t voice_trace_get(voice_trace_stage_t stage, uint32_t *time_us)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+int voice_trace_read(voice_trace_record_t *records, int max)
+{
+    return 0;
+}
+
+int voice_trace_dump(uint8_t *buffer, int size)
+{
+    return 0;
+}
+
+void voice_trace_log_summary(void)
+{
+    ESP_LOGD(TAG, "Tracing disabled");
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _VOICE_TRACE_H_
+#define _VOICE_TRACE_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Build with -DVOICE_TRACE_ENABLE=0 to compile every mark out */
+#ifndef VOICE_TRACE_ENABLE
+#define VOICE_TRACE_ENABLE          (1)
+#endif
+
+#define VOICE_TRACE_RECORDS         (64)    /*!< Ring size, a power of two */
+#define VOICE_TRACE_DUMP_MAGIC      (0x5456)
+#define VOICE_TRACE_DUMP_VERSION    (2)     /*!< Bumped when the stage numbers change */
+
+/**
+ * Stages of a voice round trip, in the order they normally happen
+ */
+typedef enum {
+    VOICE_TRACE_BUTTON_PRESS = 0,       /*!< Start of an interaction, re-arms the "first" marks */
+    VOICE_TRACE_SR_FIRST_FRAME,         /*!< First live I2S frame queued for upload */
+    VOICE_TRACE_SR_CONNECTED,           /*!< SR connection (and TLS) established */
+    VOICE_TRACE_SR_FIRST_CHUNK,         /*!< First audio sent */
+    VOICE_TRACE_BUTTON_RELEASE,         /*!< User done talking (button or end of speech) */
+    VOICE_TRACE_SR_LAST_CHUNK,          /*!< End of the request body sent */
+    VOICE_TRACE_SR_FIRST_RESPONSE,      /*!< First byte of the SR response */
+    VOICE_TRACE_SR_TRANSCRIPT,          /*!< Final transcript available */
+    VOICE_TRACE_TRANSLATE_SENT,         /*!< Translation request sent */
+    VOICE_TRACE_TRANSLATE_DONE,         /*!< Translation available, `arg` is 1 when it came from the cache */
+    VOICE_TRACE_TTS_REQUEST_SENT,       /*!< TTS request body sent */
+    VOICE_TRACE_TTS_FIRST_BYTE,         /*!< First MP3 byte of the TTS response */
+    VOICE_TRACE_TTS_FIRST_SAMPLE,       /*!< First decoded audio handed to I2S */
+    VOICE_TRACE_TTS_DONE,               /*!< Playback finished */
+    VOICE_TRACE_STAGE_MAX,
+} voice_trace_stage_t;
+
+/**
+ * One trace record
+ */
+typedef struct {
+    uint32_t time_us;                   /*!< Low 32 bits of esp_timer_get_time */
+    uint8_t  stage;                     /*!< voice_trace_stage_t */
+    uint8_t  reserved;
+    uint16_t arg;                       /*!< Stage specific value, e.g. a byte count in KiB */
+} voice_trace_record_t;
+
+#if VOICE_TRACE_ENABLE
+#define VOICE_TRACE_MARK(stage, arg)        voice_trace_mark(stage, arg)
+#define VOICE_TRACE_MARK_ONCE(stage, arg)   voice_trace_mark_once(stage, arg)
+#else
+#define VOICE_TRACE_MARK(stage, arg)        ((void)0)
+#define VOICE_TRACE_MARK_ONCE(stage, arg)   ((void)0)
+#endif
+
+/**
+ * @brief      Record a stage, safe from any task, never blocks
+ *
+ * @param[in]  stage  The stage
+ * @param[in]  arg    Stage specific value
+ */
+void voice_trace_mark(voice_trace_stage_t stage, uint16_t arg);
+
+/**
+ * @brief      Record a stage only the first time it happens since the last VOICE_TRACE_BUTTON_PRESS
+ *
+ * @param[in]  stage  The stage
+ * @param[in]  arg    Stage specific value
+ */
+void voice_trace_mark_once(voice_trace_stage_t stage, uint16_t arg);
+
+/**
+ * @brief      Get the time of the latest mark of a stage
+ *
+ * @param[in]  stage    The stage
+ * @param[out] time_us  Low 32 bits of esp_timer_get_time at the mark
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NOT_FOUND      Not marked since the last VOICE_TRACE_BUTTON_PRESS
+ *     - ESP_ERR_NOT_SUPPORTED  Tracing compiled out
+ */
+esp_err_t voice_trace_get(voice_trace_stage_t stage, uint32_t *time_us);
+
+/**
+ * @brief      Copy the records in the ring, oldest first
+ *
+ * @param[out] records  The records
+ * @param[in]  max      Capacity of `records`
+ *
+ * @return     Number of records copied
+ */
+int voice_trace_read(voice_trace_record_t *records, int max);
+
+/**
+ * @brief      Write the ring as a compact binary dump
+ *
+ *             Little endian: u16 magic VOICE_TRACE_DUMP_MAGIC, u8 version, u8 record count,
+ *             then 8 bytes per record (u32 time_us, u8 stage, u8 reserved, u16 arg).
+ *
+ * @param[out] buffer  The output buffer
+ * @param[in]  size    Size of `buffer`
+ *
+ * @return     Bytes written, 0 if tracing is compiled out
+ */
+int voice_trace_dump(uint8_t *buffer, int size);
+
+/**
+ * @brief      Log the stages of the current interaction relative to VOICE_TRACE_BUTTON_PRESS
+ */
+void voice_trace_log_summary(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,447 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <math.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_element.h"
+#include "audio_common.h"
+#include "audio_mem.h"
+#include "wake_word.h"
+
+static const char *TAG = "WAKE_WORD";
+
+/* The real frame goes through a complex FFT of half its size */
+#define FFT_N               (WAKE_WORD_FFT_SIZE)
+#define FFT_HALF            (FFT_N / 2)
+#define FFT_HALF_LOG2       (8)
+#define BINS                (FFT_N / 2 + 1)
+#define HOP                 (WAKE_WORD_SAMPLE_RATE * WAKE_WORD_FRAME_MS / 1000)
+#define MEL_LOW_HZ          (20.0f)
+#define MEL_HIGH_HZ         (7600.0f)
+#define PREEMPH_Q15         (31785)     /* 0.97 */
+/* Bin powers are scaled down so the filterbank sums fit 64 bits */
+#define POWER_SHIFT         (16)
+#define SCORE_FRAMES        (4)
+#define REFRACTORY_FRAMES   (WAKE_WORD_REFRACTORY_MS / WAKE_WORD_FRAME_MS)
+
+typedef struct wake_word {
+    const wake_word_model_t *model;
+    int                 threshold;
+    wake_word_detect_cb on_detect;
+    void                *user_ctx;
+    volatile bool       active;
+    bool                restart;
+    /* Tables */
+    int16_t             win[FFT_N];             /* Hann, Q15 */
+    int16_t             cos_tab[FFT_HALF];      /* cos(2 pi k / FFT_N), Q15 */
+    int16_t             sin_tab[FFT_HALF];
+    uint8_t             bitrev[FFT_HALF];
+    uint8_t             log2_frac[256];         /* log2(1 + i / 256), Q8 */
+    uint16_t            mel_start[WAKE_WORD_MEL_BANDS];
+    uint16_t            mel_len[WAKE_WORD_MEL_BANDS];
+    uint16_t            mel_pos[WAKE_WORD_MEL_BANDS];
+    int16_t             mel_w[2 * BINS];        /* Triangle weights, Q15 */
+    int16_t             dct[WAKE_WORD_MAX_MFCC][WAKE_WORD_MEL_BANDS];   /* Q15, from c1 */
+    /* Analysis */
+    int16_t             in[HOP];
+    int                 fill;
+    int32_t             last;                   /* Previous sample, for the pre-emphasis */
+    int32_t             ana[FFT_N];             /* Latest pre-emphasized samples */
+    int32_t             re[FFT_HALF];
+    int32_t             im[FFT_HALF];
+    uint64_t            power[BINS];
+    int32_t             logmel[WAKE_WORD_MEL_BANDS];
+    /* Model */
+    int8_t              feat[WAKE_WORD_MAX_FRAMES * WAKE_WORD_MAX_MFCC];    /* Oldest frame first */
+    int                 frames;                 /* Frames collected since the start, up to num_frames */
+    int8_t              act[2][WAKE_WORD_MAX_UNITS];
+    int32_t             out[WAKE_WORD_MAX_UNITS];
+    int32_t             scores[SCORE_FRAMES];
+    int                 score_pos;
+    int                 hold;                   /* Frames left of the refractory period */
+    uint64_t            cost_us;
+    wake_word_stats_t   stats;
+} wake_word_t;
+
+static inline int8_t _sat8(int32_t x)
+{
+    return x > INT8_MAX ? INT8_MAX : x < INT8_MIN ? INT8_MIN : x;
+}
+
+static inline int32_t _round_shift(int64_t x, int shift)
+{
+    return (int32_t)(shift > 0 ? (x + (1LL << (shift - 1))) >> shift : x);
+}
+
+static float _mel(float hz)
+{
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float _hz(float mel)
+{
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+static void _design(wake_word_t *ww)
+{
+    for (int i = 0; i < FFT_N; i++) {
+        ww->win[i] = (int16_t)lrintf((0.5f - 0.5f * cosf(2 * M_PI * i / FFT_N)) * 32767.0f);
+    }
+    for (int i = 0; i < FFT_HALF; i++) {
+        int r = 0;
+        for (int b = 0; b < FFT_HALF_LOG2; b++) {
+            r |= ((i >> b) & 1) << (FFT_HALF_LOG2 - 1 - b);
+        }
+        ww->bitrev[i] = r;
+        ww->cos_tab[i] = (int16_t)lrintf(cosf(2 * M_PI * i / FFT_N) * 32767.0f);
+        ww->sin_tab[i] = (int16_t)lrintf(sinf(2 * M_PI * i / FFT_N) * 32767.0f);
+    }
+    for (int i = 0; i < 256; i++) {
+        ww->log2_frac[i] = (uint8_t)lrintf(log2f(1.0f + i / 256.0f) * 256.0f);
+    }
+
+    /* Triangles between equally spaced mel points, every band covers at least its center bin */
+    float lo = _mel(MEL_LOW_HZ), hi = _mel(MEL_HIGH_HZ);
+    float bin_hz = (float)WAKE_WORD_SAMPLE_RATE / FFT_N;
+    int pos = 0;
+    for (int m = 0; m < WAKE_WORD_MEL_BANDS; m++) {
+        float left = _hz(lo + (hi - lo) * m / (WAKE_WORD_MEL_BANDS + 1)) / bin_hz;
+        float center = _hz(lo + (hi - lo) * (m + 1) / (WAKE_WORD_MEL_BANDS + 1)) / bin_hz;
+        float right = _hz(lo + (hi - lo) * (m + 2) / (WAKE_WORD_MEL_BANDS + 1)) / bin_hz;
+        int first = (int)ceilf(left), end = (int)ceilf(right);
+        bool narrow = end <= first;
+        if (narrow) {
+            first = lrintf(center);
+            end = first + 1;
+        }
+        ww->mel_start[m] = first;
+        ww->mel_len[m] = end - first;
+        ww->mel_pos[m] = pos;
+        for (int k = first; k < end; k++) {
+            float w = narrow ? 1.0f : k <= center ? (k - left) / (center - left) : (right - k) / (right - center);
+            ww->mel_w[pos++] = (int16_t)lrintf(fmaxf(w, 1.0f / 64) * 32767.0f);
+        }
+    }
+    for (int k = 0; k < WAKE_WORD_MAX_MFCC; k++) {
+        for (int m = 0; m < WAKE_WORD_MEL_BANDS; m++) {
+            ww->dct[k][m] = (int16_t)lrintf(cosf(M_PI * (k + 1) * (m + 0.5f) / WAKE_WORD_MEL_BANDS) * 32767.0f);
+        }
+    }
+}
+
+/* In place radix-2 FFT of FFT_HALF points, input in bit-reversed order, unscaled */
+static void _fft(wake_word_t *ww)
+{
+    int32_t *re = ww->re, *im = ww->im;
+    for (int len = 2, step = FFT_N / 2; len <= FFT_HALF; len <<= 1, step >>= 1) {
+        int half = len >> 1;
+        for (int k = 0; k < half; k++) {
+            int32_t wr = ww->cos_tab[k * step];
+            int32_t wi = -ww->sin_tab[k * step];
+            for (int a = k; a < FFT_HALF; a += len) {
+                int b = a + half;
+                int32_t tr = (int32_t)(((int64_t)re[b] * wr - (int64_t)im[b] * wi + (1 << 14)) >> 15);
+                int32_t ti = (int32_t)(((int64_t)re[b] * wi + (int64_t)im[b] * wr + (1 << 14)) >> 15);
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/* log2(x + 1) in Q8, from the leading one and the 8 bits after it */
+static int32_t _log2_q8(wake_word_t *ww, uint64_t x)
+{
+    x += 1;
+    int n = 63 - __builtin_clzll(x);
+    uint32_t frac = (uint32_t)(n >= 8 ? x >> (n - 8) : x << (8 - n)) & 0xff;
+    return (n << 8) + ww->log2_frac[frac];
+}
+
+/* One MFCC frame of the latest FFT_N samples, appended to the features */
+static void _features(wake_word_t *ww)
+{
+    const wake_word_model_t *model = ww->model;
+    /* Even samples are the real part, odd ones the imaginary part */
+    for (int n = 0; n < FFT_HALF; n++) {
+        int b = ww->bitrev[n];
+        ww->re[b] = (int32_t)(((int64_t)ww->ana[2 * n] * ww->win[2 * n] + (1 << 14)) >> 15);
+        ww->im[b] = (int32_t)(((int64_t)ww->ana[2 * n + 1] * ww->win[2 * n + 1] + (1 << 14)) >> 15);
+    }
+    _fft(ww);
+
+    /* Split into the spectrum of the real frame: X[k] = E[k] + exp(-2 pi i k / FFT_N) O[k], doubled */
+    for (int k = 0; k <= FFT_HALF; k++) {
+        int a = k & (FFT_HALF - 1), b = (FFT_HALF - k) & (FFT_HALF - 1);
+        int64_t er = (int64_t)ww->re[a] + ww->re[b];
+        int64_t ei = (int64_t)ww->im[a] - ww->im[b];
+        int64_t odd_r = (int64_t)ww->im[a] + ww->im[b];
+        int64_t odd_i = (int64_t)ww->re[b] - ww->re[a];
+        int64_t wr = k < FFT_HALF ? ww->cos_tab[k] : -32767;
+        int64_t wi = k < FFT_HALF ? -ww->sin_tab[k] : 0;
+        int64_t xr = er + ((odd_r * wr - odd_i * wi + (1 << 14)) >> 15);
+        int64_t xi = ei + ((odd_r * wi + odd_i * wr + (1 << 14)) >> 15);
+        ww->power[k] = (uint64_t)(xr * xr + xi * xi) >> POWER_SHIFT;
+    }
+
+    for (int m = 0; m < WAKE_WORD_MEL_BANDS; m++) {
+        const uint64_t *p = ww->power + ww->mel_start[m];
+        const int16_t *w = ww->mel_w + ww->mel_pos[m];
+        uint64_t sum = 0;
+        for (int k = 0; k < ww->mel_len[m]; k++) {
+            sum += p[k] * w[k];
+        }
+        ww->logmel[m] = _log2_q8(ww, sum >> 15);
+    }
+
+    int frame_size = model->num_mfcc;
+    int feat_size = model->num_frames * frame_size;
+    memmove(ww->feat, ww->feat + frame_size, feat_size - frame_size);
+    int8_t *frame = ww->feat + feat_size - frame_size;
+    for (int k = 0; k < frame_size; k++) {
+        int64_t c = 0;
+        for (int m = 0; m < WAKE_WORD_MEL_BANDS; m++) {
+            c += (int64_t)ww->logmel[m] * ww->dct[k][m];
+        }
+        frame[k] = _sat8(_round_shift(c, 15 + model->input_shift));
+    }
+}
+
+/* Run the model over the features, the score is the keyword output minus the best filler */
+static int32_t _infer(wake_word_t *ww)
+{
+    const wake_word_model_t *model = ww->model;
+    const int8_t *x = ww->feat;
+    for (int l = 0; l < model->num_layers; l++) {
+        const wake_word_layer_t *layer = &model->layers[l];
+        bool last = l == model->num_layers - 1;
+        int8_t *y = ww->act[l & 1];
+        for (int o = 0; o < layer->out_dim; o++) {
+            const int8_t *w = layer->weights + o * layer->in_dim;
+            int32_t acc = layer->bias ? layer->bias[o] : 0;
+            for (int i = 0; i < layer->in_dim; i++) {
+                acc += w[i] * x[i];
+            }
+            acc = _round_shift(acc, layer->shift);
+            if (layer->relu && acc < 0) {
+                acc = 0;
+            }
+            if (last) {
+                ww->out[o] = acc;
+            } else {
+                y[o] = _sat8(acc);
+            }
+        }
+        x = y;
+    }
+    int32_t filler = INT32_MIN;
+    for (int o = 0; o < model->layers[model->num_layers - 1].out_dim; o++) {
+        if (o != model->keyword_index && ww->out[o] > filler) {
+            filler = ww->out[o];
+        }
+    }
+    return ww->out[model->keyword_index] - filler;
+}
+
+static void _reset(wake_word_t *ww)
+{
+    ww->fill = 0;
+    ww->last = 0;
+    ww->frames = 0;
+    ww->hold = 0;
+    memset(ww->ana, 0, sizeof(ww->ana));
+    memset(ww->feat, 0, sizeof(ww->feat));
+    memset(ww->scores, 0, sizeof(ww->scores));
+}
+
+static void _frame(wake_word_t *ww)
+{
+    int64_t start = esp_timer_get_time();
+    memmove(ww->ana, ww->ana + HOP, (FFT_N - HOP) * sizeof(int32_t));
+    int32_t *dst = ww->ana + FFT_N - HOP;
+    for (int i = 0; i < HOP; i++) {
+        dst[i] = ww->in[i] - ((ww->last * PREEMPH_Q15 + (1 << 14)) >> 15);
+        ww->last = ww->in[i];
+    }
+    _features(ww);
+    if (ww->frames < ww->model->num_frames) {
+        ww->frames++;
+    }
+
+    if (ww->hold > 0) {
+        ww->hold--;
+    }
+    /* Scores are averaged over the last frames, a single frame does not fire */
+    if (ww->frames == ww->model->num_frames) {
+        ww->scores[ww->score_pos] = _infer(ww);
+        ww->score_pos = (ww->score_pos + 1) % SCORE_FRAMES;
+        int32_t score = 0;
+        for (int i = 0; i < SCORE_FRAMES; i++) {
+            score += ww->scores[i] / SCORE_FRAMES;
+        }
+        ww->stats.score = score;
+        if (ww->hold == 0 && score > ww->threshold) {
+            ESP_LOGI(TAG, "Keyword, score %d", (int)score);
+            ww->hold = REFRACTORY_FRAMES;
+            ww->stats.detections++;
+            if (ww->on_detect) {
+                ww->on_detect(ww->user_ctx);
+            }
+        }
+    }
+
+    uint32_t cost = (uint32_t)(esp_timer_get_time() - start);
+    ww->cost_us += cost;
+    ww->stats.frames++;
+    ww->stats.avg_us = (uint32_t)(ww->cost_us / ww->stats.frames);
+    if (cost > ww->stats.max_us) {
+        ww->stats.max_us = cost;
+    }
+}
+
+static esp_err_t _wake_word_open(audio_element_handle_t self)
+{
+    wake_word_t *ww = (wake_word_t *)audio_element_getdata(self);
+    _reset(ww);
+    ww->restart = false;
+    return ESP_OK;
+}
+
+static audio_element_err_t _wake_word_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    wake_word_t *ww = (wake_word_t *)audio_element_getdata(self);
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    /* The audio goes on first, the detector works on a copy */
+    int w_size = audio_element_output(self, in_buffer, r_size);
+    if (!ww->active) {
+        ww->restart = true;
+        return w_size < 0 ? w_size : r_size;
+    }
+    if (ww->restart) {
+        ww->restart = false;
+        _reset(ww);
+    }
+    for (int pos = 0; pos < r_size;) {
+        int n = (int)sizeof(ww->in) - ww->fill;
+        if (n > r_size - pos) {
+            n = r_size - pos;
+        }
+        memcpy((char *)ww->in + ww->fill, in_buffer + pos, n);
+        ww->fill += n;
+        pos += n;
+        if (ww->fill == (int)sizeof(ww->in)) {
+            ww->fill = 0;
+            _frame(ww);
+        }
+    }
+    return w_size < 0 ? w_size : r_size;
+}
+
+static esp_err_t _wake_word_destroy(audio_element_handle_t self)
+{
+    wake_word_t *ww = (wake_word_t *)audio_element_getdata(self);
+    audio_free(ww);
+    return ESP_OK;
+}
+
+esp_err_t wake_word_set_active(audio_element_handle_t self, bool active)
+{
+    wake_word_t *ww = self ? (wake_word_t *)audio_element_getdata(self) : NULL;
+    if (ww == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ww->active = active;
+    return ESP_OK;
+}
+
+esp_err_t wake_word_get_stats(audio_element_handle_t self, wake_word_stats_t *stats)
+{
+    wake_word_t *ww = self ? (wake_word_t *)audio_element_getdata(self) : NULL;
+    if (ww == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *stats = ww->stats;
+    return ESP_OK;
+}
+
+static bool _model_fits(const wake_word_model_t *model)
+{
+    if (model == NULL || model->num_layers <= 0 || model->num_frames <= 0 || model->num_frames > WAKE_WORD_MAX_FRAMES
+            || model->num_mfcc <= 0 || model->num_mfcc > WAKE_WORD_MAX_MFCC) {
+        return false;
+    }
+    int in_dim = model->num_frames * model->num_mfcc;
+    for (int l = 0; l < model->num_layers; l++) {
+        const wake_word_layer_t *layer = &model->layers[l];
+        if (layer->in_dim != in_dim || layer->out_dim <= 0 || layer->out_dim > WAKE_WORD_MAX_UNITS
+                || layer->weights == NULL || layer->shift < 0) {
+            return false;
+        }
+        in_dim = layer->out_dim;
+    }
+    return model->keyword_index >= 0 && model->keyword_index < in_dim && in_dim > 1;
+}
+
+audio_element_handle_t wake_word_init(wake_word_cfg_t *config)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    audio_element_handle_t el;
+    if (!_model_fits(config->model)) {
+        ESP_LOGE(TAG, "The model does not fit the detector");
+        return NULL;
+    }
+    wake_word_t *ww = audio_calloc(1, sizeof(wake_word_t));
+    AUDIO_MEM_CHECK(TAG, ww, return NULL);
+    ww->model = config->model;
+    ww->threshold = config->threshold != 0 ? config->threshold : config->model->threshold;
+    ww->on_detect = config->on_detect;
+    ww->user_ctx = config->user_ctx;
+    ww->active = true;
+    _design(ww);
+
+    cfg.open = _wake_word_open;
+    cfg.process = _wake_word_process;
+    cfg.destroy = _wake_word_destroy;
+    cfg.task_stack = config->task_stack > 0 ? config->task_stack : WAKE_WORD_TASK_STACK;
+    if (config->task_prio > 0) {
+        cfg.task_prio = config->task_prio;
+    }
+    cfg.tag = "wake_word";
+    el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {
+        audio_free(ww);
+        return NULL;
+    });
+    audio_element_setdata(el, ww);
+    return el;
+}
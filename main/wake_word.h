@@ -0,0 +1,147 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef _WAKE_WORD_H_
+#define _WAKE_WORD_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WAKE_WORD_SAMPLE_RATE       (16000)
+#define WAKE_WORD_FRAME_MS          (20)    /*!< Feature hop */
+#define WAKE_WORD_FFT_SIZE          (512)   /*!< Analysis window, 32 ms */
+#define WAKE_WORD_MEL_BANDS         (32)
+#define WAKE_WORD_MAX_MFCC          (16)
+#define WAKE_WORD_MAX_FRAMES        (64)
+#define WAKE_WORD_MAX_UNITS         (128)   /*!< Widest layer after the input */
+#define WAKE_WORD_REFRACTORY_MS     (1000)  /*!< No detection this long after one */
+#define WAKE_WORD_TASK_STACK        (3*1024)
+
+/**
+ * One fully connected layer, `y = (W x + bias) >> shift`, saturated to int8
+ */
+typedef struct {
+    int             in_dim;         /*!< Inputs */
+    int             out_dim;        /*!< Outputs */
+    const int8_t    *weights;       /*!< `out_dim` rows of `in_dim` weights */
+    const int32_t   *bias;          /*!< `out_dim` biases, in the accumulator scale */
+    int             shift;          /*!< Requantization of the accumulator */
+    bool            relu;           /*!< Clamp the outputs at 0 */
+} wake_word_layer_t;
+
+/**
+ * Quantized keyword model over the last `num_frames` MFCC frames, oldest first
+ *
+ * Models have to be trained on the features of this element (for instance by building it
+ * on the host): WAKE_WORD_MEL_BANDS log2 mel energies in Q8, from 20 Hz to 7.6 kHz, turned
+ * into `num_mfcc` unnormalized DCT-II coefficients that are shifted by `input_shift` to int8.
+ * They start at c1: the frame energy c0 is left out so that the talker level does not matter.
+ * The output of the last layer is not saturated, the score is its keyword output minus the
+ * largest other output.
+ */
+typedef struct {
+    int                     num_frames;     /*!< Frames seen at once, up to WAKE_WORD_MAX_FRAMES */
+    int                     num_mfcc;       /*!< Coefficients per frame, up to WAKE_WORD_MAX_MFCC */
+    int                     input_shift;    /*!< Coefficients to int8 */
+    const wake_word_layer_t *layers;        /*!< The first one takes `num_frames * num_mfcc` inputs */
+    int                     num_layers;
+    int                     keyword_index;  /*!< Output of the keyword, the others are filler */
+    int                     threshold;      /*!< Score, averaged over a few frames, that fires */
+} wake_word_model_t;
+
+typedef void (*wake_word_detect_cb)(void *ctx);
+
+/**
+ * Wake word configurations
+ */
+typedef struct {
+    const wake_word_model_t *model;         /*!< The keyword model */
+    int                     threshold;      /*!< Detection threshold, 0 for the model's */
+    wake_word_detect_cb     on_detect;      /*!< Called from the element task when the keyword ends */
+    void                    *user_ctx;      /*!< Context passed to `on_detect` */
+    int                     task_stack;     /*!< Element task stack size, 0 for default */
+    int                     task_prio;      /*!< Element task priority, 0 for default */
+} wake_word_cfg_t;
+
+/**
+ * Wake word detector state
+ */
+typedef struct {
+    uint32_t    frames;             /*!< Feature frames computed */
+    uint32_t    detections;         /*!< Times the keyword fired */
+    uint32_t    avg_us;             /*!< Mean cost of a frame, features and inference */
+    uint32_t    max_us;             /*!< Largest cost of a frame */
+    int         score;              /*!< Latest averaged score */
+} wake_word_stats_t;
+
+/**
+ * @brief      Create an audio element spotting a keyword in 16 kHz 16-bit mono audio
+ *
+ *             The audio passes unchanged. Every WAKE_WORD_FRAME_MS a fixed-point MFCC frame is
+ *             computed (pre-emphasis, Hann window, real FFT, mel filterbank, log2, DCT) and the
+ *             int8 model is run over the latest frames. The detector costs little enough to stay
+ *             on all the time, and nothing runs while it is inactive.
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle, NULL if the model does not fit the limits above
+ */
+audio_element_handle_t wake_word_init(wake_word_cfg_t *config);
+
+/**
+ * @brief      Run or pause the detector, e.g. pause it while the speech is already recorded
+ *
+ *             It starts over with empty features when resumed.
+ *
+ * @param      self    The wake word element
+ * @param[in]  active  Run the detector
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t wake_word_set_active(audio_element_handle_t self, bool active);
+
+/**
+ * @brief      Get the detector state, including the per-frame cost
+ *
+ * @param      self   The wake word element
+ * @param[out] stats  The stats
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t wake_word_get_stats(audio_element_handle_t self, wake_word_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif